@@ -274,6 +274,273 @@ GetEndPointer (
   return (VARIABLE_HEADER *) HEADER_ALIGN ((UINTN) VolHeader + VolHeader->Size);
 }
 
+/**
+  Computes hash of (VendorGuid, VariableName) pair used by the variable index.
+
+  FNV-1a over GUID bytes and name characters. Uses no boot services,
+  so it is safe to call at runtime.
+
+  @param  VariableName  Null-terminated name of the variable.
+  @param  VendorGuid    Vendor GUID of the variable.
+
+  @return 32 bit hash value.
+
+**/
+UINT32
+VariableIndexHash (
+  IN  CHAR16    *VariableName,
+  IN  EFI_GUID  *VendorGuid
+  )
+{
+  UINT32  Hash;
+  UINT8   *Ptr;
+  UINTN   Index;
+
+  Hash = 0x811C9DC5;
+  Ptr  = (UINT8 *) VendorGuid;
+  for (Index = 0; Index < sizeof (EFI_GUID); Index++) {
+    Hash = (Hash ^ Ptr[Index]) * 0x01000193;
+  }
+  for (; *VariableName != 0; VariableName++) {
+    Hash = (Hash ^ (UINT8) *VariableName) * 0x01000193;
+    Hash = (Hash ^ (UINT8) (*VariableName >> 8)) * 0x01000193;
+  }
+  return Hash;
+}
+
+/**
+  Converts variable index slot value to the variable header pointer.
+
+  @param  Entry   Slot value (store offset with VARIABLE_INDEX_VOLATILE flag).
+  @param  Global  Pointer to VARIABLE_GLOBAL structure.
+
+  @return Pointer to variable header.
+
+**/
+VARIABLE_HEADER *
+VariableIndexEntryToPtr (
+  IN  UINT32            Entry,
+  IN  VARIABLE_GLOBAL   *Global
+  )
+{
+  EFI_PHYSICAL_ADDRESS  Base;
+
+  Base = ((Entry & VARIABLE_INDEX_VOLATILE) != 0) ? Global->VolatileVariableBase : Global->NonVolatileVariableBase;
+  return (VARIABLE_HEADER *) ((UINTN) Base + (Entry & ~VARIABLE_INDEX_VOLATILE));
+}
+
+/**
+  Finds the index slot which holds given (VendorGuid, VariableName) pair.
+
+  @param  VariableName  Null-terminated name of the variable.
+  @param  NameSize      Size of VariableName in bytes, including terminator.
+  @param  VendorGuid    Vendor GUID of the variable.
+  @param  Global        Pointer to VARIABLE_GLOBAL structure.
+  @param  FreeSlot      If not NULL, returns the first reusable slot on the
+                        probe sequence (valid only when key is not found).
+
+  @return Pointer to matching slot, or NULL if the key is not in the index.
+
+**/
+UINT32 *
+VariableIndexFindSlot (
+  IN  CHAR16            *VariableName,
+  IN  UINTN             NameSize,
+  IN  EFI_GUID          *VendorGuid,
+  IN  VARIABLE_GLOBAL   *Global,
+  OUT UINT32            **FreeSlot OPTIONAL
+  )
+{
+  UINT32          *Table;
+  UINTN           Mask;
+  UINTN           Slot;
+  UINTN           Probe;
+  VARIABLE_HEADER *Variable;
+
+  Table = mVariableModuleGlobal->VariableIndex;
+  Mask  = mVariableModuleGlobal->VariableIndexMask;
+  if (FreeSlot != NULL) {
+    *FreeSlot = NULL;
+  }
+
+  Slot = VariableIndexHash (VariableName, VendorGuid) & Mask;
+  for (Probe = 0; Probe <= Mask; Probe++, Slot = (Slot + 1) & Mask) {
+    if (Table[Slot] == VARIABLE_INDEX_EMPTY) {
+      if (FreeSlot != NULL && *FreeSlot == NULL) {
+        *FreeSlot = &Table[Slot];
+      }
+      return NULL;
+    }
+    if (Table[Slot] == VARIABLE_INDEX_DELETED) {
+      if (FreeSlot != NULL && *FreeSlot == NULL) {
+        *FreeSlot = &Table[Slot];
+      }
+      continue;
+    }
+    Variable = VariableIndexEntryToPtr (Table[Slot], Global);
+    if (Variable->NameSize == NameSize &&
+        CompareGuid (VendorGuid, &Variable->VendorGuid) &&
+        CompareMem (VariableName, GET_VARIABLE_NAME_PTR (Variable), NameSize) == 0) {
+      return &Table[Slot];
+    }
+  }
+  return NULL;
+}
+
+/**
+  Adds variable to the index, or repoints existing index entry for the same
+  (VendorGuid, VariableName) pair to the given variable.
+
+  @param  Variable  Pointer to the variable header inside variable store.
+  @param  Volatile  TRUE if Variable is in volatile store.
+  @param  Global    Pointer to VARIABLE_GLOBAL structure.
+
+**/
+VOID
+VariableIndexInsert (
+  IN  VARIABLE_HEADER   *Variable,
+  IN  BOOLEAN           Volatile,
+  IN  VARIABLE_GLOBAL   *Global
+  )
+{
+  UINT32  *Slot;
+  UINT32  *FreeSlot;
+  UINT32  Entry;
+
+  if (mVariableModuleGlobal->VariableIndex == NULL) {
+    return;
+  }
+
+  if (Volatile) {
+    Entry = (UINT32) ((UINTN) Variable - (UINTN) Global->VolatileVariableBase) | VARIABLE_INDEX_VOLATILE;
+  } else {
+    Entry = (UINT32) ((UINTN) Variable - (UINTN) Global->NonVolatileVariableBase);
+  }
+
+  Slot = VariableIndexFindSlot (GET_VARIABLE_NAME_PTR (Variable), Variable->NameSize, &Variable->VendorGuid, Global, &FreeSlot);
+  if (Slot == NULL) {
+    Slot = FreeSlot;
+  }
+  //
+  // Index is sized to hold every variable which can fit into the stores
+  //
+  ASSERT (Slot != NULL);
+  if (Slot != NULL) {
+    *Slot = Entry;
+  }
+}
+
+/**
+  Removes (VendorGuid, VariableName) pair of the given variable from the index.
+
+  @param  Variable  Pointer to the variable header inside variable store.
+  @param  Global    Pointer to VARIABLE_GLOBAL structure.
+
+**/
+VOID
+VariableIndexRemove (
+  IN  VARIABLE_HEADER   *Variable,
+  IN  VARIABLE_GLOBAL   *Global
+  )
+{
+  UINT32  *Slot;
+
+  if (mVariableModuleGlobal->VariableIndex == NULL) {
+    return;
+  }
+
+  Slot = VariableIndexFindSlot (GET_VARIABLE_NAME_PTR (Variable), Variable->NameSize, &Variable->VendorGuid, Global, NULL);
+  if (Slot != NULL) {
+    *Slot = VARIABLE_INDEX_DELETED;
+  }
+}
+
+/**
+  Allocates the variable hash index.
+
+  The index is sized so it can never fill up, even if both variable stores
+  are packed with the smallest possible variables.
+
+  @retval EFI_SUCCESS           Index allocated.
+  @retval EFI_OUT_OF_RESOURCES  Not enough runtime memory for the index.
+
+**/
+EFI_STATUS
+InitializeVariableIndex (
+  VOID
+  )
+{
+  UINTN   MaxVariables;
+  UINTN   Slots;
+
+  //
+  // Smallest variable: header, one char name with terminator, one byte of data.
+  // Keep load factor at or below 1/2 for both stores together.
+  //
+  MaxVariables = PcdGet32 (PcdVariableStoreSize) / HEADER_ALIGN (sizeof (VARIABLE_HEADER) + 2 * sizeof (CHAR16) + 1);
+  Slots        = GetPowerOfTwo32 ((UINT32) (MaxVariables * 4));
+  if (Slots < MaxVariables * 4) {
+    Slots <<= 1;
+  }
+
+  mVariableModuleGlobal->VariableIndex = AllocateRuntimeZeroPool (Slots * sizeof (UINT32));
+  if (mVariableModuleGlobal->VariableIndex == NULL) {
+    //
+    // FindVariable() falls back to the linear store walk
+    //
+    mVariableModuleGlobal->VariableIndexMask = 0;
+    return EFI_OUT_OF_RESOURCES;
+  }
+  mVariableModuleGlobal->VariableIndexMask = Slots - 1;
+  DBG ("EmuVariable: variable index with %d slots\n", Slots);
+  return EFI_SUCCESS;
+}
+
+/**
+  Rebuilds the variable hash index from the contents of the variable stores.
+
+  Must be called whenever variables are moved inside the stores
+  (for example after the store has been compacted).
+
+**/
+VOID
+RebuildVariableIndex (
+  VOID
+  )
+{
+  VARIABLE_GLOBAL       *Global;
+  VARIABLE_STORE_HEADER *VariableStoreHeader[2];
+  VARIABLE_HEADER       *Variable;
+  UINTN                 Index;
+
+  if (mVariableModuleGlobal->VariableIndex == NULL) {
+    return;
+  }
+
+  Global = &mVariableModuleGlobal->VariableGlobal[Physical];
+  ZeroMem (mVariableModuleGlobal->VariableIndex, (mVariableModuleGlobal->VariableIndexMask + 1) * sizeof (UINT32));
+
+  //
+  // 0: Non-Volatile, 1: Volatile
+  //
+  VariableStoreHeader[0] = (VARIABLE_STORE_HEADER *) ((UINTN) Global->NonVolatileVariableBase);
+  VariableStoreHeader[1] = (VARIABLE_STORE_HEADER *) ((UINTN) Global->VolatileVariableBase);
+
+  for (Index = 0; Index < 2; Index++) {
+    if (VariableStoreHeader[Index] == NULL) {
+      continue;
+    }
+    for ( Variable = (VARIABLE_HEADER *) HEADER_ALIGN (VariableStoreHeader[Index] + 1)
+        ; (Variable < GetEndPointer (VariableStoreHeader[Index]) && (Variable != NULL))
+        ; Variable = GetNextVariablePtr (Variable)
+        ) {
+      if (Variable->StartId == VARIABLE_DATA && Variable->State == VAR_ADDED) {
+        VariableIndexInsert (Variable, (BOOLEAN) Index, Global);
+      }
+    }
+  }
+}
+
 /**
   Routine used to track statistical information about variable usage. 
   The data is stored in the EFI system table so it can be accessed later.
@@ -935,6 +1202,7 @@ UpdateVariable (
     //
     if (DataSize == 0 || (Attributes & (EFI_VARIABLE_RUNTIME_ACCESS | EFI_VARIABLE_BOOTSERVICE_ACCESS)) == 0) {
       Variable->CurrPtr->State &= VAR_DELETED;
+      VariableIndexRemove (Variable->CurrPtr, Global);
       UpdateVariableInfo (VariableName, VendorGuid, Variable->Volatile, FALSE, FALSE, TRUE, FALSE);
       Status = EFI_SUCCESS;
       goto Done;
@@ -1054,6 +1322,11 @@ UpdateVariable (
     Variable->CurrPtr->State &= VAR_DELETED;
   }
 
+  //
+  // Point the index to the new copy
+  //
+  VariableIndexInsert (NextVariable, (BOOLEAN) ((Attributes & EFI_VARIABLE_NON_VOLATILE) == 0), Global);
+
   UpdateVariableInfo (VariableName, VendorGuid, Variable->Volatile, FALSE, TRUE, FALSE, FALSE);
 
   Status = EFI_SUCCESS;
@@ -1095,6 +1368,7 @@ FindVariable (
   VARIABLE_HEADER       *Variable[2];
   VARIABLE_STORE_HEADER *VariableStoreHeader[2];
   UINTN                 Index;
+  UINT32                *Slot;
 
   //
   // 0: Non-Volatile, 1: Volatile
@@ -1112,6 +1386,33 @@ FindVariable (
   if (VariableName[0] != 0 && VendorGuid == NULL) {
     return EFI_INVALID_PARAMETER;
   }
+
+  if (VariableName[0] != 0 && mVariableModuleGlobal->VariableIndex != NULL) {
+    //
+    // Look the variable up in the hash index
+    //
+    Slot = VariableIndexFindSlot (VariableName, StrSize (VariableName), VendorGuid, Global, NULL);
+    if (Slot != NULL) {
+      Index = ((*Slot & VARIABLE_INDEX_VOLATILE) != 0) ? 1 : 0;
+      Variable[Index] = VariableIndexEntryToPtr (*Slot, Global);
+      if (Variable[Index]->StartId == VARIABLE_DATA && Variable[Index]->State == VAR_ADDED &&
+          !(VariableClassAtRuntime () && ((Variable[Index]->Attributes & EFI_VARIABLE_RUNTIME_ACCESS) == 0))) {
+        PtrTrack->StartPtr  = (VARIABLE_HEADER *) HEADER_ALIGN (VariableStoreHeader[Index] + 1);
+        PtrTrack->EndPtr    = GetEndPointer (VariableStoreHeader[Index]);
+        PtrTrack->CurrPtr   = Variable[Index];
+        PtrTrack->Volatile  = (BOOLEAN) Index;
+        return EFI_SUCCESS;
+      }
+    }
+    //
+    // Same track as after an unsuccessful walk of both stores
+    //
+    PtrTrack->StartPtr  = (VARIABLE_HEADER *) HEADER_ALIGN (VariableStoreHeader[1] + 1);
+    PtrTrack->EndPtr    = GetEndPointer (VariableStoreHeader[1]);
+    PtrTrack->CurrPtr   = NULL;
+    return EFI_NOT_FOUND;
+  }
+
   //
   // Find the variable by walk through non-volatile and volatile variable store
   //
@@ -1332,53 +1633,27 @@ Done:
 }
 
 /**
+  Checks parameters of SetVariable() call.
 
-  This code sets variable in storage blocks (Volatile or Non-Volatile).
+  @param  VariableName           Name of the variable.
+  @param  VendorGuid             Vendor GUID of the variable.
+  @param  Attributes             Attributes bitmask to set for the variable.
+  @param  DataSize               The size in bytes of the Data buffer.
+  @param  Data                   The contents for the variable.
 
-  @param  VariableName           A Null-terminated Unicode string that is the name of the vendor's
-                                 variable.  Each VariableName is unique for each 
-                                 VendorGuid.  VariableName must contain 1 or more 
-                                 Unicode characters.  If VariableName is an empty Unicode 
-                                 string, then EFI_INVALID_PARAMETER is returned.
-  @param  VendorGuid             A unique identifier for the vendor
-  @param  Attributes             Attributes bitmask to set for the variable
-  @param  DataSize               The size in bytes of the Data buffer.  A size of zero causes the
-                                 variable to be deleted.
-  @param  Data                   The contents for the variable
-  @param  Global                 Pointer to VARIABLE_GLOBAL structure
-  @param  VolatileOffset         The offset of last volatile variable
-  @param  NonVolatileOffset      The offset of last non-volatile variable
-
-  @retval EFI_SUCCESS            The firmware has successfully stored the variable and its data as 
-                                 defined by the Attributes.
-  @retval EFI_INVALID_PARAMETER  An invalid combination of attribute bits was supplied, or the 
-                                 DataSize exceeds the maximum allowed, or VariableName is an empty 
-                                 Unicode string, or VendorGuid is NULL.
-  @retval EFI_OUT_OF_RESOURCES   Not enough storage is available to hold the variable and its data.
-  @retval EFI_DEVICE_ERROR       The variable could not be saved due to a hardware failure.
-  @retval EFI_WRITE_PROTECTED    The variable in question is read-only or cannot be deleted.
-  @retval EFI_NOT_FOUND          The variable trying to be updated or deleted was not found.
+  @retval EFI_SUCCESS            Parameters are valid.
+  @retval EFI_INVALID_PARAMETER  Parameters are not valid for SetVariable().
 
 **/
 EFI_STATUS
-EFIAPI
-EmuSetVariable (
+CheckSetVariableParameters (
   IN CHAR16                  *VariableName,
   IN EFI_GUID                *VendorGuid,
   IN UINT32                  Attributes,
   IN UINTN                   DataSize,
-  IN VOID                    *Data,
-  IN VARIABLE_GLOBAL         *Global,
-  IN UINTN                   *VolatileOffset,
-  IN UINTN                   *NonVolatileOffset
+  IN VOID                    *Data
   )
 {
-  VARIABLE_POINTER_TRACK  Variable;
-  EFI_STATUS              Status;
-
-  //
-  // Check input parameters
-  //
   if (VariableName == NULL || VariableName[0] == 0 || VendorGuid == NULL) {
     return EFI_INVALID_PARAMETER;
   }  
@@ -1427,6 +1702,59 @@ EmuSetVariable (
     }  
   }
 
+  return EFI_SUCCESS;
+}
+
+/**
+
+  This code sets variable in storage blocks (Volatile or Non-Volatile).
+
+  @param  VariableName           A Null-terminated Unicode string that is the name of the vendor's
+                                 variable.  Each VariableName is unique for each 
+                                 VendorGuid.  VariableName must contain 1 or more 
+                                 Unicode characters.  If VariableName is an empty Unicode 
+                                 string, then EFI_INVALID_PARAMETER is returned.
+  @param  VendorGuid             A unique identifier for the vendor
+  @param  Attributes             Attributes bitmask to set for the variable
+  @param  DataSize               The size in bytes of the Data buffer.  A size of zero causes the
+                                 variable to be deleted.
+  @param  Data                   The contents for the variable
+  @param  Global                 Pointer to VARIABLE_GLOBAL structure
+  @param  VolatileOffset         The offset of last volatile variable
+  @param  NonVolatileOffset      The offset of last non-volatile variable
+
+  @retval EFI_SUCCESS            The firmware has successfully stored the variable and its data as 
+                                 defined by the Attributes.
+  @retval EFI_INVALID_PARAMETER  An invalid combination of attribute bits was supplied, or the 
+                                 DataSize exceeds the maximum allowed, or VariableName is an empty 
+                                 Unicode string, or VendorGuid is NULL.
+  @retval EFI_OUT_OF_RESOURCES   Not enough storage is available to hold the variable and its data.
+  @retval EFI_DEVICE_ERROR       The variable could not be saved due to a hardware failure.
+  @retval EFI_WRITE_PROTECTED    The variable in question is read-only or cannot be deleted.
+  @retval EFI_NOT_FOUND          The variable trying to be updated or deleted was not found.
+
+**/
+EFI_STATUS
+EFIAPI
+EmuSetVariable (
+  IN CHAR16                  *VariableName,
+  IN EFI_GUID                *VendorGuid,
+  IN UINT32                  Attributes,
+  IN UINTN                   DataSize,
+  IN VOID                    *Data,
+  IN VARIABLE_GLOBAL         *Global,
+  IN UINTN                   *VolatileOffset,
+  IN UINTN                   *NonVolatileOffset
+  )
+{
+  VARIABLE_POINTER_TRACK  Variable;
+  EFI_STATUS              Status;
+
+  Status = CheckSetVariableParameters (VariableName, VendorGuid, Attributes, DataSize, Data);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
   AcquireLockOnlyAtBootTime(&Global->VariableServicesLock);
 
   //
@@ -1446,6 +1774,268 @@ EmuSetVariable (
   return Status;
 }
 
+/**
+  Compacts variable store.
+
+  Drops all variables which are not in VAR_ADDED state and moves the rest
+  to the start of the store. Variable index must be rebuilt afterwards.
+  The scratch buffer is allocated by the caller, so compaction cannot fail
+  half way.
+
+  @param  Volatile              TRUE to compact volatile store, FALSE for non-volatile.
+  @param  Buffer                Scratch buffer at least as big as the store.
+
+**/
+VOID
+ReclaimVariableStore (
+  IN  BOOLEAN               Volatile,
+  IN  UINT8                 *Buffer
+  )
+{
+  VARIABLE_GLOBAL       *Global;
+  VARIABLE_STORE_HEADER *VariableStoreHeader;
+  VARIABLE_HEADER       *Variable;
+  UINT8                 *Dest;
+  UINTN                 VarSize;
+  UINTN                 CommonVariableTotalSize;
+  UINTN                 HwErrVariableTotalSize;
+
+  Global = &mVariableModuleGlobal->VariableGlobal[Physical];
+  if (Volatile) {
+    VariableStoreHeader = (VARIABLE_STORE_HEADER *) ((UINTN) Global->VolatileVariableBase);
+  } else {
+    VariableStoreHeader = (VARIABLE_STORE_HEADER *) ((UINTN) Global->NonVolatileVariableBase);
+  }
+
+  SetMem (Buffer, VariableStoreHeader->Size, 0xff);
+  CopyMem (Buffer, VariableStoreHeader, sizeof (VARIABLE_STORE_HEADER));
+  Dest = (UINT8 *) HEADER_ALIGN (Buffer + sizeof (VARIABLE_STORE_HEADER));
+
+  CommonVariableTotalSize = 0;
+  HwErrVariableTotalSize  = 0;
+  for ( Variable = (VARIABLE_HEADER *) HEADER_ALIGN (VariableStoreHeader + 1)
+      ; (Variable < GetEndPointer (VariableStoreHeader) && (Variable != NULL))
+      ; Variable = GetNextVariablePtr (Variable)
+      ) {
+    if (Variable->State != VAR_ADDED) {
+      continue;
+    }
+    VarSize = (UINTN) GetNextPotentialVariablePtr (Variable) - (UINTN) Variable;
+    CopyMem (Dest, Variable, VarSize);
+    Dest += VarSize;
+    if ((Variable->Attributes & EFI_VARIABLE_HARDWARE_ERROR_RECORD) != 0) {
+      HwErrVariableTotalSize += VarSize;
+    } else {
+      CommonVariableTotalSize += VarSize;
+    }
+  }
+
+  CopyMem (VariableStoreHeader, Buffer, VariableStoreHeader->Size);
+
+  if (Volatile) {
+    mVariableModuleGlobal->VolatileLastVariableOffset = (UINTN) (Dest - Buffer);
+  } else {
+    mVariableModuleGlobal->NonVolatileLastVariableOffset = (UINTN) (Dest - Buffer);
+    mVariableModuleGlobal->CommonVariableTotalSize       = CommonVariableTotalSize;
+    mVariableModuleGlobal->HwErrVariableTotalSize        = HwErrVariableTotalSize;
+  }
+}
+
+/**
+  Returns total size of variables in VAR_ADDED state in the store.
+
+  @param  VariableStoreHeader   Pointer to the variable store.
+
+  @return Size in bytes, including header alignment padding.
+
+**/
+UINTN
+GetLiveVariablesSize (
+  IN  VARIABLE_STORE_HEADER *VariableStoreHeader
+  )
+{
+  VARIABLE_HEADER       *Variable;
+  UINTN                 Size;
+
+  Size = 0;
+  for ( Variable = (VARIABLE_HEADER *) HEADER_ALIGN (VariableStoreHeader + 1)
+      ; (Variable < GetEndPointer (VariableStoreHeader) && (Variable != NULL))
+      ; Variable = GetNextVariablePtr (Variable)
+      ) {
+    if (Variable->State == VAR_ADDED) {
+      Size += (UINTN) GetNextPotentialVariablePtr (Variable) - (UINTN) Variable;
+    }
+  }
+  return Size;
+}
+
+/**
+
+  This code imports a batch of variables into storage blocks.
+
+  The result is the same as calling SetVariable() for each entry in order,
+  but old copies of imported variables are dropped and both stores are
+  compacted only once, before the new variables are appended.
+  Entries that already hold the same attributes and data are left untouched.
+
+  @param  Count                  Number of entries.
+  @param  Entries                Variables to import.
+  @param  Global                 Pointer to VARIABLE_GLOBAL structure.
+
+  @retval EFI_SUCCESS            All variables imported.
+  @retval EFI_INVALID_PARAMETER  Some entry is not valid for SetVariable(); nothing imported.
+  @retval EFI_OUT_OF_RESOURCES   Variables do not fit into the store; nothing imported.
+  @retval EFI_UNSUPPORTED        Called at runtime.
+
+**/
+EFI_STATUS
+EFIAPI
+EmuImportVariables (
+  IN UINTN                       Count,
+  IN EMU_VARIABLE_IMPORT_ENTRY   *Entries,
+  IN VARIABLE_GLOBAL             *Global
+  )
+{
+  EFI_STATUS              Status;
+  EFI_STATUS              ImportStatus;
+  VARIABLE_POINTER_TRACK  Variable;
+  VARIABLE_HEADER         **OldVariables;
+  BOOLEAN                 *Skip;
+  UINT8                   *Buffer;
+  VARIABLE_STORE_HEADER   *VariableStoreHeader[2];
+  UINTN                   Required[2];
+  UINTN                   Available[2];
+  UINTN                   VarNameSize;
+  UINTN                   Index;
+  UINTN                   StoreIndex;
+
+  if (Count == 0) {
+    return EFI_SUCCESS;
+  }
+  if (Entries == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  //
+  // Store can be compacted only while boot services are available
+  //
+  if (VariableClassAtRuntime ()) {
+    return EFI_UNSUPPORTED;
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    Status = CheckSetVariableParameters (Entries[Index].Name, Entries[Index].Guid, Entries[Index].Attributes,
+                                         Entries[Index].DataSize, Entries[Index].Data);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  //
+  // 0: Non-Volatile, 1: Volatile
+  //
+  VariableStoreHeader[0] = (VARIABLE_STORE_HEADER *) ((UINTN) Global->NonVolatileVariableBase);
+  VariableStoreHeader[1] = (VARIABLE_STORE_HEADER *) ((UINTN) Global->VolatileVariableBase);
+
+  //
+  // Everything that may fail is allocated before any variable is touched
+  //
+  OldVariables = AllocateZeroPool (Count * sizeof (VARIABLE_HEADER *));
+  Skip         = AllocateZeroPool (Count * sizeof (BOOLEAN));
+  Buffer       = AllocatePool (MAX (VariableStoreHeader[0]->Size, VariableStoreHeader[1]->Size));
+  if (OldVariables == NULL || Skip == NULL || Buffer == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Exit;
+  }
+
+  AcquireLockOnlyAtBootTime(&Global->VariableServicesLock);
+
+  Required[0] = 0;
+  Required[1] = 0;
+
+  //
+  // Hide old copies of imported variables (in delete transition, so they can be
+  // restored if the import does not fit) and count the space the new ones need.
+  //
+  for (Index = 0; Index < Count; Index++) {
+    FindVariable (Entries[Index].Name, Entries[Index].Guid, &Variable, Global);
+    if (Variable.CurrPtr != NULL) {
+      if (Variable.CurrPtr->Attributes == Entries[Index].Attributes &&
+          Variable.CurrPtr->DataSize == Entries[Index].DataSize &&
+          CompareMem (Entries[Index].Data, GetVariableDataPtr (Variable.CurrPtr), Entries[Index].DataSize) == 0) {
+        Skip[Index] = TRUE;
+        continue;
+      }
+      OldVariables[Index] = Variable.CurrPtr;
+      Variable.CurrPtr->State &= VAR_IN_DELETED_TRANSITION;
+    }
+    if (Entries[Index].DataSize == 0 ||
+        (Entries[Index].Attributes & (EFI_VARIABLE_RUNTIME_ACCESS | EFI_VARIABLE_BOOTSERVICE_ACCESS)) == 0) {
+      continue;
+    }
+    VarNameSize = StrSize (Entries[Index].Name);
+    StoreIndex  = ((Entries[Index].Attributes & EFI_VARIABLE_NON_VOLATILE) != 0) ? 0 : 1;
+    Required[StoreIndex] += HEADER_ALIGN (sizeof (VARIABLE_HEADER) + VarNameSize + GET_PAD_SIZE (VarNameSize) +
+                                          Entries[Index].DataSize + GET_PAD_SIZE (Entries[Index].DataSize));
+  }
+
+  Available[0] = VariableStoreHeader[0]->Size - sizeof (VARIABLE_STORE_HEADER) - PcdGet32 (PcdHwErrStorageSize);
+  Available[1] = VariableStoreHeader[1]->Size - sizeof (VARIABLE_STORE_HEADER);
+  if (GetLiveVariablesSize (VariableStoreHeader[0]) + Required[0] > Available[0] ||
+      GetLiveVariablesSize (VariableStoreHeader[1]) + Required[1] > Available[1]) {
+    for (Index = 0; Index < Count; Index++) {
+      if (OldVariables[Index] != NULL) {
+        OldVariables[Index]->State = VAR_ADDED;
+      }
+    }
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  //
+  // Rebuild the stores once. Old copies in delete transition are not
+  // VAR_ADDED, so compaction drops them; it cannot fail at this point.
+  //
+  ReclaimVariableStore (FALSE, Buffer);
+  ReclaimVariableStore (TRUE, Buffer);
+  RebuildVariableIndex ();
+  Status = EFI_SUCCESS;
+
+  //
+  // Append new variables. Lookup is still needed: the same
+  // variable may be present more than once in Entries.
+  //
+  for (Index = 0; Index < Count; Index++) {
+    if (Skip[Index]) {
+      continue;
+    }
+    FindVariable (Entries[Index].Name, Entries[Index].Guid, &Variable, Global);
+    AutoUpdateLangVariable (Entries[Index].Name, Entries[Index].Data, Entries[Index].DataSize);
+    ImportStatus = UpdateVariable (Entries[Index].Name, Entries[Index].Guid, Entries[Index].Data,
+                                   Entries[Index].DataSize, Entries[Index].Attributes, &Variable);
+    //
+    // Deleting a variable which does not exist is not an error here
+    //
+    if (EFI_ERROR (ImportStatus) && ImportStatus != EFI_NOT_FOUND) {
+      Status = ImportStatus;
+    }
+  }
+
+Done:
+  ReleaseLockOnlyAtBootTime (&Global->VariableServicesLock);
+
+Exit:
+  if (OldVariables != NULL) {
+    FreePool (OldVariables);
+  }
+  if (Skip != NULL) {
+    FreePool (Skip);
+  }
+  if (Buffer != NULL) {
+    FreePool (Buffer);
+  }
+  return Status;
+}
+
 /**
 
   This code returns information about the EFI variables.
@@ -1689,6 +2279,13 @@ InitializeVariableStore (
   VariableStore->Reserved   = 0;
   VariableStore->Reserved1  = 0;
 
+  if (!FullyInitializeStore) {
+    //
+    // Reserved store kept its variables - index them
+    //
+    RebuildVariableIndex ();
+  }
+
   if (!VolatileStore) {
     //
     // Get HOB variable store.
@@ -1764,6 +2361,11 @@ VariableCommonInitialize (
 
   EfiInitializeLock(&mVariableModuleGlobal->VariableGlobal[Physical].VariableServicesLock, TPL_NOTIFY);
 
+  //
+  // Allocate variable index; without it variables are found by walking the stores
+  //
+  InitializeVariableIndex ();
+
   //
   // Intialize volatile variable store
   //
@@ -197,6 +197,7 @@ VariableClassAddressChangeEvent (
   gRT->ConvertPointer (0x0, (VOID **) &mVariableModuleGlobal->PlatformLangCodes);
   gRT->ConvertPointer (0x0, (VOID **) &mVariableModuleGlobal->LangCodes);
   gRT->ConvertPointer (0x0, (VOID **) &mVariableModuleGlobal->PlatformLang);
+  gRT->ConvertPointer (0x0, (VOID **) &mVariableModuleGlobal->VariableIndex);
   gRT->ConvertPointer (
     0x0,
     (VOID **) &mVariableModuleGlobal->VariableGlobal[Physical].NonVolatileVariableBase
@@ -506,6 +507,40 @@ EMU_VARIABLE_CONTROL_PROTOCOL mEmuVariableControlProtocol = {
   (EMU_VARIABLE_CONTROL_UNINSTALL_EMULATION)EmuVariableControlProtocolUninstallEmulation
 };
 
+////////////////////////////////////////
+// 
+// EMU_VARIABLE_IMPORT_PROTOCOL
+//
+
+/**
+ Imports a batch of variables into emulation store.
+ Works only while emulation is installed, so vars do not end up
+ in the emu store when original RT var services are used.
+ **/
+EFI_STATUS
+EFIAPI
+EmuVariableImportProtocolImportVariables (
+  IN EMU_VARIABLE_IMPORT_PROTOCOL  *This,
+  IN UINTN                         Count,
+  IN EMU_VARIABLE_IMPORT_ENTRY     *Entries
+  )
+{
+  EFI_STATUS  Status;
+
+  if (gRT->GetVariable != RuntimeServiceGetVariable) {
+    return EFI_NOT_READY;
+  }
+
+  Status = EmuImportVariables (Count, Entries, &mVariableModuleGlobal->VariableGlobal[Physical]);
+  DBG("EmuVariable ImportVariables: %d vars = %r\n", Count, Status);
+  return Status;
+}
+
+/** EMU_VARIABLE_IMPORT_PROTOCOL */
+EMU_VARIABLE_IMPORT_PROTOCOL mEmuVariableImportProtocol = {
+  EmuVariableImportProtocolImportVariables
+};
+
 
 /**
   EmuVariable Driver main entry point. The Variable driver places the 4 EFI
@@ -543,13 +578,15 @@ VariableServiceInitialize (
 
   
   //
-  // Install EMU_VARIABLE_CONTROL_PROTOCOL on a new handle
+  // Install EMU_VARIABLE_CONTROL_PROTOCOL and EMU_VARIABLE_IMPORT_PROTOCOL on a new handle
   //
   NewHandle = NULL;
   Status = gBS->InstallMultipleProtocolInterfaces (
                                                    &NewHandle,
                                                    &gEmuVariableControlProtocolGuid,
                                                    &mEmuVariableControlProtocol,
+                                                   &gEmuVariableImportProtocolGuid,
+                                                   &mEmuVariableImportProtocol,
                                                    NULL
                                                    );
   DBG(", install gEmuVariableControlProtocolGuid = %r\n", Status);
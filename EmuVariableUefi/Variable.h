@@ -17,12 +17,16 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #ifndef _VARIABLE_H_
 #define _VARIABLE_H_
 
+#ifdef HOST_POSIX
+#include "emuvar_posix_base.h"
+#else
 #include <Uefi.h>
 
 #include <Protocol/VariableWrite.h>
 #include <Protocol/Variable.h>
 
 #include <Protocol/EmuVariableControl.h>
+#include <Protocol/EmuVariableImport.h>
 
 #include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
@@ -40,6 +44,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Guid/EventGroup.h>
 
 #include <Library/MemLogLib.h>
+#endif
 
 #define DEBUG_EMU 1
 
@@ -74,6 +79,16 @@ typedef struct {
   EFI_LOCK              VariableServicesLock;
 } VARIABLE_GLOBAL;
 
+///
+/// Hash index over (VendorGuid, VariableName) of all added variables.
+/// Slots hold offsets into the variable stores instead of pointers, so the
+/// index stays valid across SetVirtualAddressMap; only the table itself
+/// has to be converted.
+///
+#define VARIABLE_INDEX_EMPTY      0x00000000
+#define VARIABLE_INDEX_DELETED    0xFFFFFFFF
+#define VARIABLE_INDEX_VOLATILE   0x80000000
+
 typedef struct {
   VARIABLE_GLOBAL VariableGlobal[2];
   UINTN           VolatileLastVariableOffset;
@@ -84,6 +99,8 @@ typedef struct {
   CHAR8           *LangCodes;
   CHAR8           *PlatformLang;
   CHAR8           Lang[ISO_639_2_ENTRY_SIZE + 1];
+  UINT32          *VariableIndex;
+  UINTN           VariableIndexMask;
 } ESAL_VARIABLE_GLOBAL;
 
 ///
@@ -111,6 +128,33 @@ VariableCommonInitialize (
   IN EFI_SYSTEM_TABLE   *SystemTable
   );
 
+/**
+  Allocates the variable hash index.
+
+  The index is sized so it can never fill up, even if both variable stores
+  are packed with the smallest possible variables.
+
+  @retval EFI_SUCCESS           Index allocated.
+  @retval EFI_OUT_OF_RESOURCES  Not enough runtime memory for the index.
+
+**/
+EFI_STATUS
+InitializeVariableIndex (
+  VOID
+  );
+
+/**
+  Rebuilds the variable hash index from the contents of the variable stores.
+
+  Must be called whenever variables are moved inside the stores
+  (for example after the store has been compacted).
+
+**/
+VOID
+RebuildVariableIndex (
+  VOID
+  );
+
 /**
   Entry point of EmuVariable service module.
 
@@ -285,6 +329,32 @@ EmuSetVariable (
   IN UINTN                   *NonVolatileOffset
   );
 
+/**
+
+  This code imports a batch of variables into storage blocks.
+
+  The result is the same as calling SetVariable() for each entry in order,
+  but old copies of imported variables are dropped and both stores are
+  compacted only once, before the new variables are appended.
+
+  @param  Count                  Number of entries.
+  @param  Entries                Variables to import.
+  @param  Global                 Pointer to VARIABLE_GLOBAL structure.
+
+  @retval EFI_SUCCESS            All variables imported.
+  @retval EFI_INVALID_PARAMETER  Some entry is not valid for SetVariable(); nothing imported.
+  @retval EFI_OUT_OF_RESOURCES   Variables do not fit into the store; nothing imported.
+  @retval EFI_UNSUPPORTED        Called at runtime.
+
+**/
+EFI_STATUS
+EFIAPI
+EmuImportVariables (
+  IN UINTN                       Count,
+  IN EMU_VARIABLE_IMPORT_ENTRY   *Entries,
+  IN VARIABLE_GLOBAL             *Global
+  );
+
 /**
 
   This code returns information about the EFI variables.
@@ -0,0 +1,364 @@
+/**
+ * \file emuvar.c
+ * Trace replay of EmuVariable.c in the POSIX user space environment.
+ *
+ * A pseudo random trace of SetVariable (add, update, delete, attribute
+ * change, full store), GetVariable (hits, misses, short buffers),
+ * GetNextVariableName walks and ImportVariables batches is run twice:
+ * once with the variable hash index, once with the index dropped, so
+ * FindVariable() walks the stores like it did before the index was added.
+ * Every result (status, sizes, attributes, data, returned names) of both
+ * runs must be the same. The end of the trace runs after ExitBootServices,
+ * where boot service variables must not be seen.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Variable.h"
+
+#ifndef TRACE_OPS
+#define TRACE_OPS       100000
+#endif
+#define TRACE_NAMES     700
+#define TRACE_GUIDS     3
+
+EFI_GUID gEfiVariableGuid       = { 0xddcf3616, 0x3275, 0x4164, { 0x98, 0xb6, 0xfe, 0x85, 0x70, 0x7f, 0xfe, 0x7d } };
+EFI_GUID gEfiGlobalVariableGuid = { 0x8be4df61, 0x93ca, 0x11d2, { 0xaa, 0x0d, 0x00, 0xe0, 0x98, 0x03, 0x2b, 0x8c } };
+
+static EFI_GUID mTraceGuids[TRACE_GUIDS] = {
+  { 0x7c436110, 0xab2a, 0x4bbb, { 0xa8, 0x80, 0xfe, 0x41, 0x99, 0x5c, 0x9f, 0x82 } },
+  { 0x4d1ede05, 0x38c7, 0x4a6a, { 0x9c, 0xc6, 0x4b, 0xcc, 0xa8, 0xb3, 0x8c, 0x14 } },
+  { 0x7c436110, 0xab2a, 0x4bbb, { 0xa8, 0x80, 0xfe, 0x41, 0x99, 0x5c, 0x9f, 0x83 } },
+};
+
+static int      failures = 0;
+static BOOLEAN  mAtRuntime;
+
+void emuvar_assert (const char *file, int line, const char *cond)
+{
+    printf("%s:%d: assertion failed: %s\n", file, line, cond);
+    failures++;
+}
+
+/* host versions of the EDK2 library functions the driver uses */
+
+static EFI_STATUS EFIAPI host_install_configuration_table(EFI_GUID *Guid, VOID *Table)
+{
+    return EFI_SUCCESS;
+}
+
+static EFI_BOOT_SERVICES mBootServices = { host_install_configuration_table };
+EFI_BOOT_SERVICES *gBS = &mBootServices;
+
+VOID *CopyMem(VOID *Destination, CONST VOID *Source, UINTN Length) { return memmove(Destination, Source, Length); }
+VOID *SetMem(VOID *Buffer, UINTN Length, UINT8 Value) { return memset(Buffer, Value, Length); }
+VOID *ZeroMem(VOID *Buffer, UINTN Length) { return memset(Buffer, 0, Length); }
+INTN CompareMem(CONST VOID *DestinationBuffer, CONST VOID *SourceBuffer, UINTN Length) { return memcmp(DestinationBuffer, SourceBuffer, Length); }
+BOOLEAN CompareGuid(CONST EFI_GUID *Guid1, CONST EFI_GUID *Guid2) { return memcmp(Guid1, Guid2, sizeof(EFI_GUID)) == 0; }
+EFI_GUID *CopyGuid(EFI_GUID *DestinationGuid, CONST EFI_GUID *SourceGuid) { return memcpy(DestinationGuid, SourceGuid, sizeof(EFI_GUID)); }
+
+VOID *AllocatePool(UINTN AllocationSize) { return malloc(AllocationSize); }
+VOID *AllocateZeroPool(UINTN AllocationSize) { return calloc(1, AllocationSize); }
+VOID *AllocateRuntimePool(UINTN AllocationSize) { return malloc(AllocationSize); }
+VOID *AllocateRuntimeZeroPool(UINTN AllocationSize) { return calloc(1, AllocationSize); }
+VOID FreePool(VOID *Buffer) { free(Buffer); }
+
+VOID *AllocateRuntimeCopyPool(UINTN AllocationSize, CONST VOID *Buffer)
+{
+    VOID *p = malloc(AllocationSize);
+
+    if (p != NULL)
+        memcpy(p, Buffer, AllocationSize);
+    return p;
+}
+
+UINTN StrLen(CONST CHAR16 *String)
+{
+    UINTN n = 0;
+
+    while (String[n] != 0)
+        n++;
+    return n;
+}
+
+UINTN StrSize(CONST CHAR16 *String) { return (StrLen(String) + 1) * sizeof(CHAR16); }
+
+INTN StrCmp(CONST CHAR16 *FirstString, CONST CHAR16 *SecondString)
+{
+    while (*FirstString != 0 && *FirstString == *SecondString) {
+        FirstString++;
+        SecondString++;
+    }
+    return *FirstString - *SecondString;
+}
+
+INTN StrnCmp(CONST CHAR16 *FirstString, CONST CHAR16 *SecondString, UINTN Length)
+{
+    if (Length == 0)
+        return 0;
+    while (*FirstString != 0 && *FirstString == *SecondString && Length > 1) {
+        FirstString++;
+        SecondString++;
+        Length--;
+    }
+    return *FirstString - *SecondString;
+}
+
+CHAR16 *StrCpy(CHAR16 *Destination, CONST CHAR16 *Source) { return memcpy(Destination, Source, StrSize(Source)); }
+UINTN AsciiStrLen(CONST CHAR8 *String) { return strlen(String); }
+UINTN AsciiStrSize(CONST CHAR8 *String) { return strlen(String) + 1; }
+INTN AsciiStrnCmp(CONST CHAR8 *FirstString, CONST CHAR8 *SecondString, UINTN Length) { return strncmp(FirstString, SecondString, Length); }
+
+UINT32 GetPowerOfTwo32(UINT32 Operand)
+{
+    UINT32 p = 1;
+
+    if (Operand == 0)
+        return 0;
+    while (p <= Operand / 2)
+        p <<= 1;
+    return p;
+}
+
+BOOLEAN EFIAPI VariableClassAtRuntime(VOID) { return mAtRuntime; }
+
+/* trace */
+
+static UINT32 rnd_state;
+
+static UINT32 rnd(UINT32 n)
+{
+    rnd_state = rnd_state * 1103515245 + 12345;
+    return (rnd_state >> 8) % n;
+}
+
+static UINT32 result_hash;
+
+static void hash_bytes(const void *p, UINTN n)
+{
+    const UINT8 *b = p;
+
+    while (n-- > 0)
+        result_hash = (result_hash ^ *b++) * 0x01000193;
+}
+
+static void hash_value(UINT64 v)
+{
+    hash_bytes(&v, sizeof(v));
+}
+
+static void make_name(CHAR16 *name, UINT32 n)
+{
+    char buf[32];
+    UINTN i;
+
+    /* names of different length, some share a long prefix */
+    snprintf(buf, sizeof(buf), (n % 3) ? "Var%u" : "BootOrderEntryWithLongName%u", n);
+    for (i = 0; buf[i] != 0; i++)
+        name[i] = buf[i];
+    name[i] = 0;
+}
+
+static VARIABLE_GLOBAL *start_driver(BOOLEAN indexed)
+{
+    mAtRuntime = FALSE;
+    if (EFI_ERROR(VariableCommonInitialize(NULL, NULL))) {
+        printf("VariableCommonInitialize failed\n");
+        exit(1);
+    }
+    if (!indexed) {
+        FreePool(mVariableModuleGlobal->VariableIndex);
+        mVariableModuleGlobal->VariableIndex = NULL;
+        mVariableModuleGlobal->VariableIndexMask = 0;
+    }
+    return &mVariableModuleGlobal->VariableGlobal[Physical];
+}
+
+static void stop_driver(void)
+{
+    VARIABLE_GLOBAL *Global = &mVariableModuleGlobal->VariableGlobal[Physical];
+
+    free((VOID *)(UINTN)Global->VolatileVariableBase);
+    free((VOID *)(UINTN)Global->NonVolatileVariableBase);
+    free(mVariableModuleGlobal->VariableIndex);
+    free(mVariableModuleGlobal->PlatformLangCodes);
+    free(mVariableModuleGlobal->LangCodes);
+    free(mVariableModuleGlobal->PlatformLang);
+    free(mVariableModuleGlobal);
+    mVariableModuleGlobal = NULL;
+}
+
+struct counts {
+    UINTN sets, gets, hits, walks, walked, imports;
+};
+
+/* runs the trace, hashes[i] is the hash of the results after op i */
+static double run_trace(BOOLEAN indexed, UINT32 *hashes, struct counts *c)
+{
+    static CHAR16 name[64], next[64];
+    static UINT8 data[512], out[512];
+    static EMU_VARIABLE_IMPORT_ENTRY entries[16];
+    static CHAR16 import_names[16][64];
+    VARIABLE_GLOBAL *Global;
+    EFI_GUID guid;
+    EFI_STATUS Status;
+    UINT32 attr, op, n, i;
+    UINTN size, k;
+    clock_t start;
+
+    memset(c, 0, sizeof(*c));
+    memset(data, 0, sizeof(data));
+    Global = start_driver(indexed);
+    rnd_state = 2016;
+    result_hash = 0x811C9DC5;
+    start = clock();
+
+    for (op = 0; op < TRACE_OPS; op++) {
+        if (op == TRACE_OPS - TRACE_OPS / 8)
+            mAtRuntime = TRUE;
+
+        n = rnd(TRACE_NAMES);
+        make_name(name, n);
+        guid = mTraceGuids[n % TRACE_GUIDS];
+        /* every name has its attributes, a few changes are tried anyway */
+        attr = EFI_VARIABLE_BOOTSERVICE_ACCESS;
+        if (n % 5 != 0)
+            attr |= EFI_VARIABLE_RUNTIME_ACCESS;
+        if (n % 2 == 0)
+            attr |= EFI_VARIABLE_NON_VOLATILE;
+        if (rnd(50) == 0)
+            attr ^= EFI_VARIABLE_NON_VOLATILE;
+
+        switch (rnd(16)) {
+        case 0: case 1: case 2: case 3: case 4:
+            /* set, big data now and then fills the store */
+            size = 1 + rnd(rnd(20) == 0 ? 500 : 48);
+            for (k = 0; k < size; k++)
+                data[k] = (UINT8)(op + k);
+            Status = EmuSetVariable(name, &guid, attr, size, data, Global,
+                                    &mVariableModuleGlobal->VolatileLastVariableOffset,
+                                    &mVariableModuleGlobal->NonVolatileLastVariableOffset);
+            hash_value(Status);
+            c->sets++;
+            break;
+        case 5:
+            /* delete */
+            Status = EmuSetVariable(name, &guid, attr, 0, NULL, Global,
+                                    &mVariableModuleGlobal->VolatileLastVariableOffset,
+                                    &mVariableModuleGlobal->NonVolatileLastVariableOffset);
+            hash_value(Status);
+            c->sets++;
+            break;
+        case 6:
+            /* get with a buffer that is often too small */
+            size = rnd(16);
+            attr = 0;
+            Status = EmuGetVariable(name, &guid, &attr, &size, out, Global);
+            hash_value(Status);
+            hash_value(size);
+            hash_value(attr);
+            c->gets++;
+            break;
+        case 7:
+            /* walk all variables, now and then */
+            if (rnd(8) == 0) {
+                next[0] = 0;
+                for (;;) {
+                    size = sizeof(next);
+                    Status = EmuGetNextVariableName(&size, next, &guid, Global);
+                    hash_value(Status);
+                    if (EFI_ERROR(Status))
+                        break;
+                    hash_bytes(next, size);
+                    hash_bytes(&guid, sizeof(guid));
+                    c->walked++;
+                }
+                c->walks++;
+                break;
+            }
+            /* fall through */
+        case 8:
+            /* continue a walk from a name, even one that is not there */
+            size = sizeof(name);
+            Status = EmuGetNextVariableName(&size, name, &guid, Global);
+            hash_value(Status);
+            hash_value(size);
+            if (!EFI_ERROR(Status)) {
+                hash_bytes(name, size);
+                hash_bytes(&guid, sizeof(guid));
+            }
+            c->walks++;
+            break;
+        case 9:
+            /* batch import, nvram.plist style; refused at runtime */
+            k = 1 + rnd(16);
+            for (i = 0; i < k; i++) {
+                make_name(import_names[i], rnd(TRACE_NAMES));
+                entries[i].Name = import_names[i];
+                entries[i].Guid = &mTraceGuids[rnd(TRACE_GUIDS)];
+                entries[i].Attributes = EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS;
+                entries[i].DataSize = 1 + rnd(32);
+                entries[i].Data = data;
+            }
+            Status = EmuImportVariables(k, entries, Global);
+            hash_value(Status);
+            c->imports++;
+            break;
+        default:
+            /* get */
+            size = sizeof(out);
+            attr = 0;
+            Status = EmuGetVariable(name, &guid, &attr, &size, out, Global);
+            hash_value(Status);
+            if (!EFI_ERROR(Status)) {
+                hash_value(attr);
+                hash_bytes(out, size);
+                c->hits++;
+            }
+            c->gets++;
+            break;
+        }
+        hashes[op] = result_hash;
+    }
+
+    stop_driver();
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char **argv)
+{
+    static UINT32 indexed_hashes[TRACE_OPS], linear_hashes[TRACE_OPS];
+    struct counts ci, cl;
+    double ti, tl;
+    UINT32 op;
+
+    ti = run_trace(TRUE, indexed_hashes, &ci);
+    tl = run_trace(FALSE, linear_hashes, &cl);
+
+    printf("%u ops: %lu sets, %lu gets (%lu hits), %lu walks (%lu names), %lu imports\n",
+           TRACE_OPS, (unsigned long)ci.sets, (unsigned long)ci.gets, (unsigned long)ci.hits,
+           (unsigned long)ci.walks, (unsigned long)ci.walked, (unsigned long)ci.imports);
+    printf("indexed %.3fs, linear %.3fs\n", ti, tl);
+
+    for (op = 0; op < TRACE_OPS; op++) {
+        if (indexed_hashes[op] != linear_hashes[op]) {
+            printf("results differ from op %u on\n", op);
+            failures++;
+            break;
+        }
+    }
+    if (memcmp(&ci, &cl, sizeof(ci)) != 0) {
+        printf("counts differ\n");
+        failures++;
+    }
+
+    if (failures != 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("all passed\n");
+    return 0;
+}
@@ -0,0 +1,207 @@
+/**
+ * \file emuvar_posix_base.h
+ * Base definitions for building EmuVariable.c in the POSIX user space environment.
+ *
+ * Only the parts of the EDK2 headers the driver uses are here. Library
+ * functions are implemented in emuvar.c, PCDs have the values of
+ * OvmfCloverX64.dsc.
+ */
+
+#ifndef _EMUVAR_POSIX_BASE_H_
+#define _EMUVAR_POSIX_BASE_H_
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define IN
+#define OUT
+#define OPTIONAL
+#define CONST       const
+#define EFIAPI
+
+typedef uint8_t     BOOLEAN;
+typedef int8_t      INT8;
+typedef uint8_t     UINT8;
+typedef int16_t     INT16;
+typedef uint16_t    UINT16;
+typedef int32_t     INT32;
+typedef uint32_t    UINT32;
+typedef int64_t     INT64;
+typedef uint64_t    UINT64;
+typedef intptr_t    INTN;
+typedef uintptr_t   UINTN;
+typedef char        CHAR8;
+typedef uint16_t    CHAR16;
+typedef void        VOID;
+
+#define TRUE        1
+#define FALSE       0
+
+typedef UINTN       EFI_STATUS;
+typedef UINTN       EFI_TPL;
+typedef VOID        *EFI_HANDLE;
+typedef VOID        *EFI_EVENT;
+typedef UINT64      EFI_PHYSICAL_ADDRESS;
+
+typedef struct {
+  UINT32  Data1;
+  UINT16  Data2;
+  UINT16  Data3;
+  UINT8   Data4[8];
+} EFI_GUID;
+
+#define ENCODE_ERROR(a)             ((EFI_STATUS) ((UINTN) 1 << (sizeof (UINTN) * 8 - 1) | (a)))
+#define EFI_ERROR(a)                ((INTN) (EFI_STATUS) (a) < 0)
+
+#define EFI_SUCCESS                 0
+#define EFI_INVALID_PARAMETER       ENCODE_ERROR (2)
+#define EFI_UNSUPPORTED             ENCODE_ERROR (3)
+#define EFI_BUFFER_TOO_SMALL        ENCODE_ERROR (5)
+#define EFI_NOT_READY               ENCODE_ERROR (6)
+#define EFI_DEVICE_ERROR            ENCODE_ERROR (7)
+#define EFI_WRITE_PROTECTED         ENCODE_ERROR (8)
+#define EFI_OUT_OF_RESOURCES        ENCODE_ERROR (9)
+#define EFI_NOT_FOUND               ENCODE_ERROR (14)
+
+#define VA_LIST                     va_list
+#define VA_START(Marker, Parameter) va_start (Marker, Parameter)
+#define VA_ARG(Marker, TYPE)        va_arg (Marker, TYPE)
+#define VA_END(Marker)              va_end (Marker)
+
+#define MIN(a, b)                   (((a) < (b)) ? (a) : (b))
+#define MAX(a, b)                   (((a) > (b)) ? (a) : (b))
+#define ALIGN_VALUE(Value, Alignment) ((Value) + (((Alignment) - (Value)) & ((Alignment) - 1)))
+
+/* a failed ASSERT is a failed test */
+void emuvar_assert (const char *file, int line, const char *cond);
+#define ASSERT(cond)                do { if (!(cond)) emuvar_assert (__FILE__, __LINE__, #cond); } while (0)
+#define ASSERT_EFI_ERROR(status)    ASSERT (!EFI_ERROR (status))
+#define DEBUG(x)
+#define MemLog(...)
+
+/* Guid/VariableFormat.h */
+#define VARIABLE_STORE_FORMATTED            0x5a
+#define VARIABLE_STORE_HEALTHY              0xfe
+#define VARIABLE_DATA                       0x55AA
+#define VAR_IN_DELETED_TRANSITION           0xfe
+#define VAR_DELETED                         0xfd
+#define VAR_HEADER_VALID_ONLY               0x7f
+#define VAR_ADDED                           0x3f
+#define HEADER_ALIGNMENT                    4
+#define HEADER_ALIGN(Header)                (((UINTN) (Header) + HEADER_ALIGNMENT - 1) & (~(HEADER_ALIGNMENT - 1)))
+#define GET_PAD_SIZE(a)                     (((~a) + 1) & (HEADER_ALIGNMENT - 1))
+
+typedef struct {
+  EFI_GUID  Signature;
+  UINT32    Size;
+  UINT8     Format;
+  UINT8     State;
+  UINT16    Reserved;
+  UINT32    Reserved1;
+} VARIABLE_STORE_HEADER;
+
+typedef struct {
+  UINT16    StartId;
+  UINT8     State;
+  UINT8     Reserved;
+  UINT32    Attributes;
+  UINT32    NameSize;
+  UINT32    DataSize;
+  EFI_GUID  VendorGuid;
+} VARIABLE_HEADER;
+
+typedef struct _VARIABLE_INFO_ENTRY VARIABLE_INFO_ENTRY;
+struct _VARIABLE_INFO_ENTRY {
+  VARIABLE_INFO_ENTRY *Next;
+  EFI_GUID            VendorGuid;
+  CHAR16              *Name;
+  BOOLEAN             Volatile;
+  UINT32              ReadCount;
+  UINT32              WriteCount;
+  UINT32              DeleteCount;
+  UINT32              CacheCount;
+};
+
+extern EFI_GUID gEfiVariableGuid;
+extern EFI_GUID gEfiGlobalVariableGuid;
+
+/* Uefi/UefiMultiPhase.h */
+#define EFI_VARIABLE_NON_VOLATILE                 0x00000001
+#define EFI_VARIABLE_BOOTSERVICE_ACCESS           0x00000002
+#define EFI_VARIABLE_RUNTIME_ACCESS               0x00000004
+#define EFI_VARIABLE_HARDWARE_ERROR_RECORD        0x00000008
+#define EFI_VARIABLE_AUTHENTICATED_WRITE_ACCESS   0x00000010
+
+#include <Protocol/EmuVariableImport.h>
+
+/* Library/UefiLib.h, locks are not needed on the host */
+typedef struct {
+  EFI_TPL   Tpl;
+  EFI_TPL   OwnerTpl;
+  UINTN     Lock;
+} EFI_LOCK;
+
+#define TPL_NOTIFY                  16
+#define EfiInitializeLock(L, Priority)  ((L)->Tpl = (Priority), (L)->Lock = 0)
+#define EfiAcquireLock(L)           ((L)->Lock++)
+#define EfiReleaseLock(L)           ((L)->Lock--)
+
+/* Library/PcdLib.h */
+#define _PCD_VALUE_PcdVariableStoreSize             0xe000
+#define _PCD_VALUE_PcdMaxVariableSize               0x2000
+#define _PCD_VALUE_PcdMaxHardwareErrorVariableSize  0x8000
+#define _PCD_VALUE_PcdHwErrStorageSize              0
+#define _PCD_VALUE_PcdEmuVariableNvStoreReserved    0
+#define _PCD_VALUE_PcdVariableCollectStatistics     FALSE
+#define PcdGet32(TokenName)         _PCD_VALUE_##TokenName
+#define PcdGet64(TokenName)         _PCD_VALUE_##TokenName
+#define FeaturePcdGet(TokenName)    _PCD_VALUE_##TokenName
+
+/* Library/HobLib.h, there is no HOB variable store on the host */
+typedef struct {
+  EFI_GUID  Name;
+} EFI_HOB_GUID_TYPE;
+
+#define GetFirstGuidHob(Guid)       ((EFI_HOB_GUID_TYPE *) NULL)
+#define GET_GUID_HOB_DATA(GuidHob)  ((VOID *) ((EFI_HOB_GUID_TYPE *) (GuidHob) + 1))
+
+/* Library/UefiBootServicesTableLib.h, only InstallConfigurationTable is used */
+typedef struct {
+  EFI_STATUS (EFIAPI *InstallConfigurationTable) (EFI_GUID *Guid, VOID *Table);
+} EFI_BOOT_SERVICES;
+
+typedef struct {
+  EFI_BOOT_SERVICES *BootServices;
+} EFI_SYSTEM_TABLE;
+
+extern EFI_BOOT_SERVICES *gBS;
+
+/* Library/BaseMemoryLib.h */
+VOID *CopyMem (VOID *Destination, CONST VOID *Source, UINTN Length);
+VOID *SetMem (VOID *Buffer, UINTN Length, UINT8 Value);
+VOID *ZeroMem (VOID *Buffer, UINTN Length);
+INTN CompareMem (CONST VOID *DestinationBuffer, CONST VOID *SourceBuffer, UINTN Length);
+BOOLEAN CompareGuid (CONST EFI_GUID *Guid1, CONST EFI_GUID *Guid2);
+EFI_GUID *CopyGuid (EFI_GUID *DestinationGuid, CONST EFI_GUID *SourceGuid);
+
+/* Library/MemoryAllocationLib.h */
+VOID *AllocatePool (UINTN AllocationSize);
+VOID *AllocateZeroPool (UINTN AllocationSize);
+VOID *AllocateRuntimePool (UINTN AllocationSize);
+VOID *AllocateRuntimeZeroPool (UINTN AllocationSize);
+VOID *AllocateRuntimeCopyPool (UINTN AllocationSize, CONST VOID *Buffer);
+VOID FreePool (VOID *Buffer);
+
+/* Library/BaseLib.h */
+UINTN StrLen (CONST CHAR16 *String);
+UINTN StrSize (CONST CHAR16 *String);
+INTN StrCmp (CONST CHAR16 *FirstString, CONST CHAR16 *SecondString);
+INTN StrnCmp (CONST CHAR16 *FirstString, CONST CHAR16 *SecondString, UINTN Length);
+CHAR16 *StrCpy (CHAR16 *Destination, CONST CHAR16 *Source);
+UINTN AsciiStrLen (CONST CHAR8 *String);
+UINTN AsciiStrSize (CONST CHAR8 *String);
+INTN AsciiStrnCmp (CONST CHAR8 *FirstString, CONST CHAR8 *SecondString, UINTN Length);
+UINT32 GetPowerOfTwo32 (UINT32 Operand);
+
+#endif
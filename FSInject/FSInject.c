@@ -12,6 +12,9 @@ Module Name:
 
 **/
 
+#ifdef HOST_POSIX
+#include "fsinject_posix_base.h"
+#else
 #include <Library/BaseLib.h>
 #include <Library/UefiLib.h>
 #include <Library/UefiBootServicesTableLib.h>
@@ -28,6 +31,7 @@ Module Name:
 #include <Guid/FileInfo.h>
 #include <Guid/FileSystemInfo.h>
 #include <Guid/FileSystemVolumeLabelInfo.h>
+#endif
 
 #include <Protocol/FSInjectProtocol.h>
 
@@ -220,14 +224,131 @@ StriStartsWithBasic(IN CHAR16 *String1, IN CHAR16 *String2)
 	return Result;
 }
 
+/** Returns child of Node for upper case char Chr, or NULL. */
+FSI_TRIE_NODE*
+EFIAPI
+TrieGetChild(IN FSI_TRIE_NODE *Node, IN CHAR16 Chr)
+{
+	for (Node = Node->Child; Node != NULL; Node = Node->Next) {
+		if (Node->Chr == Chr) {
+			return Node;
+		}
+	}
+	return NULL;
+}
+
+/** Adds String to prefix trie with root Root. Case insensitive like StriStartsWithBasic. Returns FALSE if out of memory. */
+BOOLEAN
+EFIAPI
+TrieAddString(IN FSI_TRIE_NODE *Root, IN CHAR16 *String)
+{
+	FSI_TRIE_NODE	*Node;
+	FSI_TRIE_NODE	*Child;
+	CHAR16			Chr;
+	
+	if (String == NULL) {
+		return TRUE;
+	}
+	// empty string matches only empty name, root Terminal is checked for that alone
+	if (*String == L'\0') {
+		Root->Terminal = TRUE;
+		return TRUE;
+	}
+	
+	Node = Root;
+	for (Chr = ToUpperChar(*String); Chr != L'\0'; Chr = ToUpperChar(*++String)) {
+		Child = TrieGetChild(Node, Chr);
+		if (Child == NULL) {
+			Child = AllocateZeroPool(sizeof(FSI_TRIE_NODE));
+			if (Child == NULL) {
+				return FALSE;
+			}
+			Child->Chr = Chr;
+			Child->Next = Node->Child;
+			Node->Child = Child;
+		}
+		Node = Child;
+	}
+	Node->Terminal = TRUE;
+	return TRUE;
+}
+
+/** Returns TRUE if String starts with some string from prefix trie with root Root. Same result as StriStartsWithBasic for every string in trie. */
+BOOLEAN
+EFIAPI
+TrieStartsWith(IN FSI_TRIE_NODE *Root, IN CHAR16 *String)
+{
+	FSI_TRIE_NODE	*Node;
+	CHAR16			Chr;
+	
+	if (Root == NULL || String == NULL) {
+		return FALSE;
+	}
+	
+	if (*String == L'\0') {
+		return Root->Terminal;
+	}
+	
+	Node = Root;
+	for (Chr = ToUpperChar(*String); Chr != L'\0'; Chr = ToUpperChar(*++String)) {
+		Node = TrieGetChild(Node, Chr);
+		if (Node == NULL) {
+			return FALSE;
+		}
+		if (Node->Terminal) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/** Releases prefix trie with root Node. */
+VOID
+EFIAPI
+TrieFree(IN FSI_TRIE_NODE *Node)
+{
+	FSI_TRIE_NODE	*Next;
+	
+	while (Node != NULL) {
+		Next = Node->Next;
+		TrieFree(Node->Child);
+		FreePool(Node);
+		Node = Next;
+	}
+}
+
+/** Returns TRUE if FName contains one of strings from ForceLoadKexts. */
+BOOLEAN
+EFIAPI
+IsForceLoadKext(IN FSI_STRING_LIST *ForceLoadKexts, IN CHAR16 *FName)
+{
+	FSI_STRING_LIST_ENTRY	*StringEntry;
+	
+	if (ForceLoadKexts == NULL || FName == NULL) {
+		return FALSE;
+	}
+	
+	for (StringEntry = (FSI_STRING_LIST_ENTRY *)GetFirstNode(&ForceLoadKexts->List);
+		 !IsNull (&ForceLoadKexts->List, &StringEntry->List);
+		 StringEntry = (FSI_STRING_LIST_ENTRY *)GetNextNode(&ForceLoadKexts->List, &StringEntry->List)
+		 )
+	{
+		if (StrStr(FName, StringEntry->String) != NULL) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
 /** Composes file name from Parent and FName. Allocates memory for result which should be released by caller. */
 CHAR16*
 EFIAPI
 GetNormalizedFName(IN CHAR16 *Parent, IN CHAR16 *FName)
 {
 	CHAR16			*TmpStr;
-	CHAR16			*TmpStr2;
-	UINTN			Len;
+	UINTN			ParentLen;
+	UINTN			FNameSize;
+	BOOLEAN			AddSeparator;
 	
 	DBG("NormFName('%s' + '%s')", Parent, FName);
 	// case: FName starts with \ "\System\Xx"
@@ -259,15 +380,20 @@ GetNormalizedFName(IN CHAR16 *Parent, IN CHAR16 *FName)
 	
 	// other cases: for now just do Parent + \ + FName
 	// but check if Parent already ends with backslash
+	// every open comes here, so measure both strings just once and copy them
 	else {
-		Len = StrSize(Parent) + StrSize(FName); // has place for extra char (\\) if needed
-		TmpStr = AllocateZeroPool(Len);
-		StrCpy(TmpStr, Parent); 
-		TmpStr2 = GetStrLastChar(Parent);
-		if (TmpStr2 == NULL || *TmpStr2 != L'\\') {
-			StrCat(TmpStr, L"\\"); 
+		ParentLen = StrLen(Parent);
+		FNameSize = StrSize(FName);
+		AddSeparator = (ParentLen == 0 || Parent[ParentLen - 1] != L'\\');
+		TmpStr = AllocatePool((ParentLen + (AddSeparator ? 1 : 0)) * sizeof(CHAR16) + FNameSize);
+		if (TmpStr != NULL) {
+			CopyMem(TmpStr, Parent, ParentLen * sizeof(CHAR16));
+			if (AddSeparator) {
+				TmpStr[ParentLen++] = L'\\';
+			}
+			CopyMem(TmpStr + ParentLen, FName, FNameSize);
 		}
-		FName = StrCat(TmpStr, FName); 
+		FName = TmpStr;
 	}
 	DBG("='%s' ", FName);
 	return FName;
@@ -356,6 +482,479 @@ OpenFileProtocol(
 	return FP;
 }
 
+/**************************************************************************************
+ * FSI_OVERLAY_NODE - in-memory copy of injection dir
+ **************************************************************************************/
+
+/** Returns TRUE if Name with Len chars is equal to NodeName. Case insensitive (only ASCII chars). */
+BOOLEAN
+EFIAPI
+OverlayNameEq(IN CHAR16 *Name, IN UINTN Len, IN CHAR16 *NodeName)
+{
+	UINTN	Index;
+	
+	for (Index = 0; Index < Len; Index++) {
+		if (NodeName[Index] == L'\0' || ToUpperChar(Name[Index]) != ToUpperChar(NodeName[Index])) {
+			return FALSE;
+		}
+	}
+	return NodeName[Len] == L'\0';
+}
+
+/** Finds overlay node for Path relative to overlay root (like "\Xx.kext\Contents").
+  * Returns EFI_NOT_FOUND if there is no such file in SrcDir, EFI_UNSUPPORTED if Path has ".." which is not resolved here.
+  */
+EFI_STATUS
+EFIAPI
+OverlayFind(IN FSI_OVERLAY_NODE *Root, IN CHAR16 *Path, OUT FSI_OVERLAY_NODE **Node)
+{
+	FSI_OVERLAY_NODE	*Dir;
+	UINTN				Len;
+	
+	Dir = Root;
+	while (*Path != L'\0') {
+		if (*Path == L'\\') {
+			Path++;
+			continue;
+		}
+		for (Len = 0; Path[Len] != L'\0' && Path[Len] != L'\\'; Len++);
+		if (Len == 2 && Path[0] == L'.' && Path[1] == L'.') {
+			return EFI_UNSUPPORTED;
+		}
+		if (!(Len == 1 && Path[0] == L'.')) {
+			if ((Dir->Info->Attribute & EFI_FILE_DIRECTORY) == 0) {
+				return EFI_NOT_FOUND;
+			}
+			for (Dir = Dir->Child; Dir != NULL; Dir = Dir->Next) {
+				if (OverlayNameEq(Path, Len, Dir->Info->FileName)) {
+					break;
+				}
+			}
+			if (Dir == NULL) {
+				return EFI_NOT_FOUND;
+			}
+		}
+		Path += Len;
+	}
+	*Node = Dir;
+	return EFI_SUCCESS;
+}
+
+/** Releases overlay node Node with all it's siblings and children. */
+VOID
+EFIAPI
+OverlayFree(IN FSI_OVERLAY_NODE *Node)
+{
+	FSI_OVERLAY_NODE	*Next;
+	
+	while (Node != NULL) {
+		Next = Node->Next;
+		OverlayFree(Node->Child);
+		if (Node->Info != NULL) FreePool(Node->Info);
+		if (Node->Data != NULL) FreePool(Node->Data);
+		FreePool(Node);
+		Node = Next;
+	}
+}
+
+/** Returns EFI_FILE_INFO of FP in allocated buffer, or NULL. */
+EFI_FILE_INFO*
+EFIAPI
+OverlayGetFileInfo(IN EFI_FILE_PROTOCOL *FP)
+{
+	EFI_STATUS			Status;
+	EFI_FILE_INFO		*Info = NULL;
+	UINTN				Size = 0;
+	
+	Status = FP->GetInfo(FP, &gEfiFileInfoGuid, &Size, NULL);
+	if (Status == EFI_BUFFER_TOO_SMALL) {
+		Info = AllocateZeroPool(Size);
+		if (Info != NULL) {
+			Status = FP->GetInfo(FP, &gEfiFileInfoGuid, &Size, Info);
+			if (EFI_ERROR(Status)) {
+				FreePool(Info);
+				Info = NULL;
+			}
+		}
+	}
+	return Info;
+}
+
+/** Reads content of file FP into Node->Data. */
+EFI_STATUS
+EFIAPI
+OverlayLoadFile(IN EFI_FILE_PROTOCOL *FP, IN FSI_OVERLAY_NODE *Node)
+{
+	EFI_STATUS			Status;
+	UINTN				FileSize;
+	UINTN				Done;
+	UINTN				Size;
+	
+	FileSize = (UINTN)Node->Info->FileSize;
+	if (FileSize == 0) {
+		return EFI_SUCCESS;
+	}
+	Node->Data = AllocatePool(FileSize);
+	if (Node->Data == NULL) {
+		return EFI_OUT_OF_RESOURCES;
+	}
+	for (Done = 0; Done < FileSize; Done += Size) {
+		Size = FileSize - Done;
+		Status = FP->Read(FP, &Size, Node->Data + Done);
+		if (EFI_ERROR(Status)) {
+			return Status;
+		}
+		if (Size == 0) {
+			return EFI_END_OF_FILE;
+		}
+	}
+	return EFI_SUCCESS;
+}
+
+/** Reads all entries of dir DirFP into DirNode, recursively. TotalSize is increased by size of loaded files and infos. */
+EFI_STATUS
+EFIAPI
+OverlayLoadDir(IN EFI_FILE_PROTOCOL *DirFP, IN FSI_OVERLAY_NODE *DirNode, IN OUT UINTN *TotalSize)
+{
+	EFI_STATUS			Status;
+	EFI_FILE_PROTOCOL	*FP;
+	EFI_FILE_INFO		*Info;
+	FSI_OVERLAY_NODE	*Node;
+	FSI_OVERLAY_NODE	*Last = NULL;
+	UINTN				InfoSize = SIZE_OF_EFI_FILE_INFO + 256 * sizeof(CHAR16);
+	UINTN				Size;
+	
+	Info = AllocatePool(InfoSize);
+	if (Info == NULL) {
+		return EFI_OUT_OF_RESOURCES;
+	}
+	for (;;) {
+		Size = InfoSize;
+		Status = DirFP->Read(DirFP, &Size, Info);
+		if (Status == EFI_BUFFER_TOO_SMALL) {
+			// long file name - grow the buffer and read this entry again
+			FreePool(Info);
+			InfoSize = Size;
+			Info = AllocatePool(InfoSize);
+			if (Info == NULL) {
+				return EFI_OUT_OF_RESOURCES;
+			}
+			Status = DirFP->Read(DirFP, &Size, Info);
+		}
+		if (EFI_ERROR(Status) || Size == 0) {
+			break;
+		}
+		if (StrCmp(Info->FileName, L".") == 0 || StrCmp(Info->FileName, L"..") == 0) {
+			continue;
+		}
+		
+		*TotalSize += Size;
+		if ((Info->Attribute & EFI_FILE_DIRECTORY) == 0) {
+			*TotalSize += (UINTN)Info->FileSize;
+		}
+		if (*TotalSize > FSI_OVERLAY_MAX_SIZE || Info->FileSize > FSI_OVERLAY_MAX_SIZE) {
+			Status = EFI_BUFFER_TOO_SMALL;
+			break;
+		}
+		
+		Node = AllocateZeroPool(sizeof(FSI_OVERLAY_NODE));
+		if (Node == NULL) {
+			Status = EFI_OUT_OF_RESOURCES;
+			break;
+		}
+		Node->Info = AllocateCopyPool(Size, Info);
+		// link it now - OverlayFree will release it with DirNode on error
+		if (Last != NULL) {
+			Last->Next = Node;
+		} else {
+			DirNode->Child = Node;
+		}
+		Last = Node;
+		DirNode->ChildCount++;
+		if (Node->Info == NULL) {
+			Status = EFI_OUT_OF_RESOURCES;
+			break;
+		}
+		
+		Status = DirFP->Open(DirFP, &FP, Info->FileName, EFI_FILE_MODE_READ, 0);
+		if (EFI_ERROR(Status)) {
+			DBG("OverlayLoad: can not open '%s': %r\n", Info->FileName, Status);
+			break;
+		}
+		if (Info->Attribute & EFI_FILE_DIRECTORY) {
+			Status = OverlayLoadDir(FP, Node, TotalSize);
+		} else {
+			Status = OverlayLoadFile(FP, Node);
+		}
+		FP->Close(FP);
+		if (EFI_ERROR(Status)) {
+			break;
+		}
+	}
+	FreePool(Info);
+	return Status;
+}
+
+/** SrcDirs loaded so far and their total size - FSI_OVERLAY_MAX_SIZE is for all of them */
+FSI_OVERLAY_CACHE	*mOverlays = NULL;
+UINTN				mOverlaysSize = 0;
+
+/** Loads whole SrcDir from source volume into memory. Returns overlay root or NULL if SrcDir is too big or on error. */
+FSI_OVERLAY_NODE*
+EFIAPI
+OverlayLoad(IN EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *SrcFS, IN CHAR16 *SrcDir)
+{
+	EFI_STATUS			Status = EFI_OUT_OF_RESOURCES;
+	EFI_FILE_PROTOCOL	*DirFP;
+	FSI_OVERLAY_NODE	*Root;
+	UINTN				TotalSize = mOverlaysSize;
+	
+	DirFP = OpenFileProtocol(SrcFS, SrcDir, EFI_FILE_MODE_READ, 0);
+	if (DirFP == NULL) {
+		return NULL;
+	}
+	Root = AllocateZeroPool(sizeof(FSI_OVERLAY_NODE));
+	if (Root != NULL) {
+		Root->Info = OverlayGetFileInfo(DirFP);
+		if (Root->Info == NULL) {
+			Status = EFI_DEVICE_ERROR;
+		} else if (Root->Info->Attribute & EFI_FILE_DIRECTORY) {
+			Status = OverlayLoadDir(DirFP, Root, &TotalSize);
+		} else {
+			Status = EFI_NOT_FOUND;
+		}
+	}
+	DirFP->Close(DirFP);
+	
+	if (EFI_ERROR(Status)) {
+		DBG("OverlayLoad('%s') = %r, serving it from source volume\n", SrcDir, Status);
+		OverlayFree(Root);
+		return NULL;
+	}
+	DBG("OverlayLoad('%s') = %d bytes\n", SrcDir, TotalSize - mOverlaysSize);
+	mOverlaysSize = TotalSize;
+	return Root;
+}
+
+/** Returns overlay of SrcDir of FSI_FS, or NULL if it is served from source volume.
+  * SrcDir is read on first call with Load TRUE (first injected open or listing of TgtDir),
+  * so boots which do not inject anything do not read it. Installs with the same SrcDir share it.
+  */
+FSI_OVERLAY_NODE*
+EFIAPI
+OverlayGet(IN FSI_SIMPLE_FILE_SYSTEM_PROTOCOL *FSI_FS, IN BOOLEAN Load)
+{
+	FSI_OVERLAY_CACHE	*Cache;
+	
+	if (FSI_FS->OverlayDone || FSI_FS->SrcFS == NULL || FSI_FS->SrcDir == NULL) {
+		return FSI_FS->Overlay;
+	}
+	for (Cache = mOverlays; Cache != NULL; Cache = Cache->Next) {
+		if (Cache->SrcFS == FSI_FS->SrcFS && StrCmpiBasic(Cache->SrcDir, FSI_FS->SrcDir) == 0) {
+			break;
+		}
+	}
+	if (Cache == NULL) {
+		if (!Load) {
+			return NULL;
+		}
+		Cache = AllocateZeroPool(sizeof(FSI_OVERLAY_CACHE));
+		if (Cache == NULL) {
+			return NULL;
+		}
+		Cache->SrcFS = FSI_FS->SrcFS;
+		Cache->SrcDir = AllocateCopyPool(StrSize(FSI_FS->SrcDir), FSI_FS->SrcDir);
+		if (Cache->SrcDir == NULL) {
+			FreePool(Cache);
+			return NULL;
+		}
+#if FSI_OVERLAY_MAX_SIZE > 0
+		// if it fails, SrcDir is served from source volume as usual
+		Cache->Root = OverlayLoad(FSI_FS->SrcFS, FSI_FS->SrcDir);
+#endif
+		Cache->Next = mOverlays;
+		mOverlays = Cache;
+	}
+	FSI_FS->Overlay = Cache->Root;
+	FSI_FS->OverlayDone = TRUE;
+	return FSI_FS->Overlay;
+}
+
+/** Starts dir listing of Ovl of FSIThis from the beginning. */
+VOID
+EFIAPI
+OverlayRewind(IN FSI_FILE_PROTOCOL *FSIThis)
+{
+	FSIThis->OvlNext = FSIThis->Ovl->Child;
+	FSIThis->OvlPosition = 0;
+	FSIThis->OvlTgtDone = FALSE;
+	if (FSIThis->OvlShadowed != NULL) {
+		ZeroMem(FSIThis->OvlShadowed, FSIThis->Ovl->ChildCount * sizeof(BOOLEAN));
+	}
+}
+
+/** Injection point: marks Ovl entry with FileName as shadowed by the same entry in target dir. */
+VOID
+EFIAPI
+OverlayMarkShadowed(IN FSI_FILE_PROTOCOL *FSIThis, IN CHAR16 *FileName)
+{
+	FSI_OVERLAY_NODE	*Node;
+	UINTN				Index;
+	UINTN				Len;
+	
+	Len = StrLen(FileName);
+	for (Node = FSIThis->Ovl->Child, Index = 0; Node != NULL; Node = Node->Next, Index++) {
+		if (OverlayNameEq(FileName, Len, Node->Info->FileName)) {
+			FSIThis->OvlShadowed[Index] = TRUE;
+			return;
+		}
+	}
+}
+
+/** EFI_FILE_PROTOCOL.Read for file or dir served from overlay. */
+EFI_STATUS
+EFIAPI
+OverlayRead(IN FSI_FILE_PROTOCOL *FSIThis, IN OUT UINTN *BufferSize, OUT VOID *Buffer)
+{
+	FSI_OVERLAY_NODE	*Node;
+	UINT64				FileSize;
+	UINTN				Size;
+	
+	if (FSIThis->Ovl->Info->Attribute & EFI_FILE_DIRECTORY) {
+		// skip entries which are listed from target dir
+		while (FSIThis->OvlNext != NULL && FSIThis->OvlShadowed != NULL
+			   && FSIThis->OvlShadowed[FSIThis->OvlPosition])
+		{
+			FSIThis->OvlNext = FSIThis->OvlNext->Next;
+			FSIThis->OvlPosition++;
+		}
+		Node = FSIThis->OvlNext;
+		if (Node == NULL) {
+			*BufferSize = 0;
+			return EFI_SUCCESS;
+		}
+		Size = (UINTN)Node->Info->Size;
+		if (*BufferSize < Size) {
+			*BufferSize = Size;
+			return EFI_BUFFER_TOO_SMALL;
+		}
+		CopyMem(Buffer, Node->Info, Size);
+		*BufferSize = Size;
+		FSIThis->OvlNext = Node->Next;
+		FSIThis->OvlPosition++;
+		return EFI_SUCCESS;
+	}
+	
+	FileSize = FSIThis->Ovl->Info->FileSize;
+	if (FSIThis->OvlPosition > FileSize) {
+		return EFI_DEVICE_ERROR;
+	}
+	if (*BufferSize > FileSize - FSIThis->OvlPosition) {
+		*BufferSize = (UINTN)(FileSize - FSIThis->OvlPosition);
+	}
+	if (*BufferSize > 0) {
+		CopyMem(Buffer, FSIThis->Ovl->Data + FSIThis->OvlPosition, *BufferSize);
+		FSIThis->OvlPosition += *BufferSize;
+	}
+	return EFI_SUCCESS;
+}
+
+/** EFI_FILE_PROTOCOL.SetPosition for file or dir served from overlay. */
+EFI_STATUS
+EFIAPI
+OverlaySetPosition(IN FSI_FILE_PROTOCOL *FSIThis, IN UINT64 Position)
+{
+	if (FSIThis->Ovl->Info->Attribute & EFI_FILE_DIRECTORY) {
+		if (Position != 0) {
+			return EFI_UNSUPPORTED;
+		}
+		OverlayRewind(FSIThis);
+		return EFI_SUCCESS;
+	}
+	if (Position == MAX_UINT64) {
+		Position = FSIThis->Ovl->Info->FileSize;
+	}
+	FSIThis->OvlPosition = Position;
+	return EFI_SUCCESS;
+}
+
+/** EFI_FILE_PROTOCOL.GetInfo for file or dir served from overlay. Volume infos are taken from source volume. */
+EFI_STATUS
+EFIAPI
+OverlayGetInfo(IN FSI_FILE_PROTOCOL *FSIThis, IN EFI_GUID *InformationType, IN OUT UINTN *BufferSize, OUT VOID *Buffer)
+{
+	EFI_STATUS			Status;
+	EFI_FILE_PROTOCOL	*RootFP;
+	UINTN				Size;
+	
+	if (CompareGuid(InformationType, &gEfiFileInfoGuid)) {
+		Size = (UINTN)FSIThis->Ovl->Info->Size;
+		if (*BufferSize < Size) {
+			*BufferSize = Size;
+			return EFI_BUFFER_TOO_SMALL;
+		}
+		CopyMem(Buffer, FSIThis->Ovl->Info, Size);
+		*BufferSize = Size;
+		return EFI_SUCCESS;
+	}
+	
+	Status = FSIThis->FSI_FS->SrcFS->OpenVolume(FSIThis->FSI_FS->SrcFS, &RootFP);
+	if (EFI_ERROR(Status)) {
+		return Status;
+	}
+	Status = RootFP->GetInfo(RootFP, InformationType, BufferSize, Buffer);
+	RootFP->Close(RootFP);
+	return Status;
+}
+
+/** Opens injected file RelName (relative to SrcDir, starting with \) into FSINew.
+  * It is served from overlay if there is one, else opened with SrcFP on source volume.
+  * LoadOverlay FALSE uses the overlay only if it is loaded already.
+  */
+BOOLEAN
+EFIAPI
+OpenInjected(
+	IN FSI_FILE_PROTOCOL	*FSINew,
+	IN CHAR16				*RelName,
+	IN UINT64				OpenMode,
+	IN UINT64				Attributes,
+	IN BOOLEAN				LoadOverlay
+)
+{
+	EFI_STATUS				Status = EFI_UNSUPPORTED;
+	CHAR16					*InjFName;
+	FSI_OVERLAY_NODE		*Overlay;
+	
+	// overlay is read only - writes go to source volume
+	Overlay = NULL;
+	if ((OpenMode & EFI_FILE_MODE_WRITE) == 0) {
+		Overlay = OverlayGet(FSINew->FSI_FS, LoadOverlay);
+	}
+	if (Overlay != NULL) {
+		Status = OverlayFind(Overlay, RelName, &FSINew->Ovl);
+		if (Status == EFI_SUCCESS) {
+			FSINew->IsDir = (FSINew->Ovl->Info->Attribute & EFI_FILE_DIRECTORY) != 0;
+			FSINew->OvlNext = FSINew->Ovl->Child;
+			FSINew->OvlPosition = 0;
+			DBG("Opened from overlay ");
+			return TRUE;
+		}
+		FSINew->Ovl = NULL;
+		if (Status == EFI_NOT_FOUND) {
+			DBG("not in overlay ");
+			return FALSE;
+		}
+	}
+	
+	InjFName = GetInjectionFName(L"\0", FSINew->FSI_FS->SrcDir, RelName);
+	if (InjFName == NULL) {
+		return FALSE;
+	}
+	FSINew->SrcFP = OpenFileProtocol(FSINew->FSI_FS->SrcFS, InjFName, OpenMode, Attributes);
+	FreePool(InjFName);
+	return FSINew->SrcFP != NULL;
+}
+
 /**************************************************************************************
  * FSI_FILE_PROTOCOL - our implementation of EFI_FILE_PROTOCOL
  **************************************************************************************/
@@ -378,26 +977,21 @@ FSI_FP_Open(
 	CHAR16					*InjFName = NULL;
 	FSI_FILE_PROTOCOL		*FSIThis;
 	FSI_FILE_PROTOCOL		*FSINew;
-	FSI_STRING_LIST			*StringList;
-	FSI_STRING_LIST_ENTRY	*StringEntry;
 
 	DBG("FSI_FP %p.Open('%s', %x, %x) ", This, FileName, OpenMode, Attributes);
 	FSIThis = FSI_FROM_FILE_PROTOCOL(This);
 	NewFName = GetNormalizedFName(FSIThis->FName, FileName);
+	if (NewFName == NULL) {
+		Status = EFI_OUT_OF_RESOURCES;
+		DBG("GetNormalizedFName Status=%r\n", Status);
+		return Status;
+	}
 	
-	StringList = FSIThis->FSI_FS->Blacklist;
-	if (StringList != NULL && !IsListEmpty(&StringList->List)) {
-		// blocking files in Blacklist
-		for (StringEntry = (FSI_STRING_LIST_ENTRY *)GetFirstNode(&StringList->List);
-			 !IsNull (&StringList->List, &StringEntry->List);
-			 StringEntry = (FSI_STRING_LIST_ENTRY *)GetNextNode(&StringList->List, &StringEntry->List)
-			 )
-		{
-			if (StriStartsWithBasic(NewFName, StringEntry->String)) {
-				DBG("Blacklisted\n");
-				return EFI_NOT_FOUND;
-			}
-		}
+	// blocking files in Blacklist
+	if (TrieStartsWith(FSIThis->FSI_FS->BlacklistTrie, NewFName)) {
+		DBG("Blacklisted\n");
+		FreePool(NewFName);
+		return EFI_NOT_FOUND;
 	}
 	
 	// create our FP implementation
@@ -416,17 +1010,13 @@ FSI_FP_Open(
 	if (StrCmpiBasic(NewFName, L"\\mach_kernel") == 0) {
 		DBG("mach_kernel ");
 		if (FSIThis->FSI_FS->SrcDir != NULL && FSIThis->FSI_FS->SrcFS != NULL) {
-			InjFName = GetInjectionFName(L"\0", FSIThis->FSI_FS->SrcDir, NewFName);
-			if (InjFName != NULL) {
-				// if this one exists inside injection dir - should be opened with SrcFP
-				FSINew->SrcFP = OpenFileProtocol(FSIThis->FSI_FS->SrcFS, InjFName, OpenMode, Attributes);
-				if (FSINew->SrcFP != NULL) {
-					FSINew->FromTgt = FALSE;
-					DBG("Opened with SrcFP ");
-					goto SuccessExit;
-				} else {
-					DBG(" no injection, SrcFP->Open=%r ", Status);
-				}
+			// if this one exists inside injection dir - should be opened from there
+			if (OpenInjected(FSINew, NewFName, OpenMode, Attributes, FALSE)) {
+				FSINew->FromTgt = FALSE;
+				DBG("Opened with SrcFP ");
+				goto SuccessExit;
+			} else {
+				DBG(" no injection ");
 			}
 		}
 	}
@@ -434,29 +1024,20 @@ FSI_FP_Open(
 	if (StrCmpiBasic(NewFName, L"\\System\\Library\\Kernels\\kernel") == 0) {
 		DBG("kernel ");
 		if (FSIThis->FSI_FS->SrcDir != NULL && FSIThis->FSI_FS->SrcFS != NULL) {
-			InjFName = GetInjectionFName(L"\0", FSIThis->FSI_FS->SrcDir, L"\\kernel");
-			if (InjFName != NULL) {
-				// if this one exists inside injection dir - should be opened with SrcFP
-				FSINew->SrcFP = OpenFileProtocol(FSIThis->FSI_FS->SrcFS, InjFName, OpenMode, Attributes);
-				if (FSINew->SrcFP != NULL) {
-					FSINew->FromTgt = FALSE;
-					DBG("Opened with SrcFP ");
-					goto SuccessExit;
-				} else {
-					DBG(" no injection, SrcFP->Open=%r ", Status);
-				}
+			// if this one exists inside injection dir - should be opened from there
+			if (OpenInjected(FSINew, L"\\kernel", OpenMode, Attributes, FALSE)) {
+				FSINew->FromTgt = FALSE;
+				DBG("Opened with SrcFP ");
+				goto SuccessExit;
+			} else {
+				DBG(" no injection ");
 			}
-			InjFName = GetInjectionFName(L"\0", FSIThis->FSI_FS->SrcDir, L"\\mach_kernel");
-			if (InjFName != NULL) {
-				// if this one exists inside injection dir - should be opened with SrcFP
-				FSINew->SrcFP = OpenFileProtocol(FSIThis->FSI_FS->SrcFS, InjFName, OpenMode, Attributes);
-				if (FSINew->SrcFP != NULL) {
-					FSINew->FromTgt = FALSE;
-					DBG("Opened with SrcFP ");
-					goto SuccessExit;
-				} else {
-					DBG(" no injection, SrcFP->Open=%r ", Status);
-				}
+			if (OpenInjected(FSINew, L"\\mach_kernel", OpenMode, Attributes, FALSE)) {
+				FSINew->FromTgt = FALSE;
+				DBG("Opened with SrcFP ");
+				goto SuccessExit;
+			} else {
+				DBG(" no injection ");
 			}
 		}
 	}
@@ -483,12 +1064,12 @@ FSI_FP_Open(
 	// handle injection if needed
 	if (EFI_ERROR(Status) && FSIThis->FSI_FS->SrcDir != NULL && FSIThis->FSI_FS->SrcFS != NULL) {
 		// if not found and injection requested: try injection dir
-		InjFName = GetInjectionFName(FSIThis->FSI_FS->TgtDir, FSIThis->FSI_FS->SrcDir, NewFName);
+		// InjFName is name relative to TgtDir
+		InjFName = GetInjectionFName(FSIThis->FSI_FS->TgtDir, L"\0", NewFName);
 		if (InjFName != NULL) {
-			// this one exists inside injection dir - should be opened with SrcFP
+			// this one exists inside injection dir - should be opened with SrcFP or from overlay
 			FSINew->FromTgt = FALSE;
-			FSINew->SrcFP = OpenFileProtocol(FSIThis->FSI_FS->SrcFS, InjFName, OpenMode, Attributes);
-			if (FSINew->SrcFP == NULL) {
+			if (!OpenInjected(FSINew, InjFName, OpenMode, Attributes, TRUE)) {
 				Status = EFI_DEVICE_ERROR;
 				DBG("SrcFP->Open=%r ", Status);
 			} else {
@@ -514,6 +1095,7 @@ FSI_FP_Open(
 					KextsInjected++;
 				}
 			}
+			FreePool(InjFName);
 		}
 
 		if (EFI_ERROR(Status) && FSIThis->TgtFP == NULL) {
@@ -544,19 +1126,38 @@ FSI_FP_Open(
 	if (FSINew->TgtFP != NULL && FSINew->FSI_FS->SrcFS != NULL && FSINew->FSI_FS->SrcDir != NULL
 		&& StrCmpiBasic(FSINew->FSI_FS->TgtDir, FSINew->FName) == 0)
 	{
-		// it is - open injection dir also
+		// it is - list injection dir also
+		// from overlay if we have it: needs flags for overlay entries which are also in target dir
+		// an empty SrcDir has nothing to flag and is listed with OvlShadowed NULL
+		if (OverlayGet(FSINew->FSI_FS, TRUE) != NULL) {
+			if (FSINew->FSI_FS->Overlay->ChildCount > 0) {
+				FSINew->OvlShadowed = AllocateZeroPool(FSINew->FSI_FS->Overlay->ChildCount * sizeof(BOOLEAN));
+			}
+			if (FSINew->FSI_FS->Overlay->ChildCount == 0 || FSINew->OvlShadowed != NULL) {
+				FSINew->Ovl = FSINew->FSI_FS->Overlay;
+				OverlayRewind(FSINew);
+				DBG("Opened also from overlay ");
+			}
+		}
+		// else open injection dir with SrcFP
 		// this FP will have both TgtFP and SrcFP - can be used for test later
 		// in case of error, it will be NULL - all should run fine then, but without injection
-		FSINew->SrcFP = OpenFileProtocol(FSINew->FSI_FS->SrcFS, FSINew->FSI_FS->SrcDir, EFI_FILE_MODE_READ, 0);
-		if (FSINew->SrcFP != NULL) {
-			DBG("Opened also with SrcFP ");
-		} else {
-			DBG("Error opening with SrcFP ");
+		if (FSINew->Ovl == NULL) {
+			FSINew->SrcFP = OpenFileProtocol(FSINew->FSI_FS->SrcFS, FSINew->FSI_FS->SrcDir, EFI_FILE_MODE_READ, 0);
+			if (FSINew->SrcFP != NULL) {
+				DBG("Opened also with SrcFP ");
+			} else {
+				DBG("Error opening with SrcFP ");
+			}
 		}
 	}
 		
 	
 SuccessExit:
+	// decide once if reads of this file should patch OSBundleRequired
+	FSINew->ForceLoad = FSINew->TgtFP != NULL && FSINew->SrcFP == NULL && FSINew->Ovl == NULL
+		&& IsForceLoadKext(FSINew->FSI_FS->ForceLoadKexts, FSINew->FName);
+	
 	// set our implementation as a result
 	*NewHandle = &(FSINew->FP);
 	
@@ -592,6 +1193,9 @@ FSI_FP_Close(IN EFI_FILE_PROTOCOL  *This)
 		FSIThis->SrcFP->Close(FSIThis->SrcFP);
 		FSIThis->SrcFP = NULL;
 	}
+	if (FSIThis->OvlShadowed != NULL) {
+		FreePool(FSIThis->OvlShadowed);
+	}
 	DBG("FName='%s' ", FSIThis->FName);
 	if (FSIThis->FName != NULL) {
 		FreePool(FSIThis->FName);
@@ -624,6 +1228,9 @@ FSI_FP_Delete(IN EFI_FILE_PROTOCOL  *This)
 		FSIThis->SrcFP->Close(FSIThis->SrcFP);
 		FSIThis->SrcFP = NULL;
 	}
+	if (FSIThis->OvlShadowed != NULL) {
+		FreePool(FSIThis->OvlShadowed);
+	}
 	if (FSIThis->FName != NULL) {
 		FreePool(FSIThis->FName);
 		FSIThis->FName = NULL;
@@ -649,15 +1256,31 @@ FSI_FP_Read(
 #endif
 	UINTN					BufferSizeOrig;
 	CHAR8					*String;
-	FSI_STRING_LIST			*StringList;
-	FSI_STRING_LIST_ENTRY	*StringEntry;
 	VOID					*TmpBuffer;
 	UINTN					OrigBufferSize = *BufferSize;
 	
 	DBG("FSI_FP %p.Read(%d, %p) ", This, *BufferSize, Buffer);
 	
 	FSIThis = FSI_FROM_FILE_PROTOCOL(This);
-	if (FSIThis->TgtFP != NULL && FSIThis->SrcFP != NULL) {
+	if (FSIThis->TgtFP != NULL && FSIThis->Ovl != NULL) {
+		// this is injection point with overlay
+		// first read dir entries from Tgt and then those from overlay which are not in Tgt
+		Status = EFI_SUCCESS;
+		if (!FSIThis->OvlTgtDone) {
+			BufferSizeOrig = *BufferSize;
+			Status = FSIThis->TgtFP->Read(FSIThis->TgtFP, BufferSize, Buffer);
+			if (Status == EFI_SUCCESS && *BufferSize > 0) {
+				OverlayMarkShadowed(FSIThis, ((EFI_FILE_INFO *)Buffer)->FileName);
+			} else if (Status == EFI_SUCCESS) {
+				// no more in Tgt - read from overlay
+				FSIThis->OvlTgtDone = TRUE;
+				*BufferSize = BufferSizeOrig;
+			}
+		}
+		if (Status == EFI_SUCCESS && FSIThis->OvlTgtDone) {
+			Status = OverlayRead(FSIThis, BufferSize, Buffer);
+		}
+	} else if (FSIThis->TgtFP != NULL && FSIThis->SrcFP != NULL) {
 		// this is injection point
 		// first read dir entries from Src and then from Tgt
 		BufferSizeOrig = *BufferSize;
@@ -670,7 +1293,6 @@ FSI_FP_Read(
 	} else if (FSIThis->TgtFP != NULL) {
 		// do it with target FP
 		Status = FSIThis->TgtFP->Read(FSIThis->TgtFP, BufferSize, Buffer);
-		StringList = FSIThis->FSI_FS->ForceLoadKexts;
 		if (Status == EFI_INVALID_PARAMETER && *BufferSize == 0) {
 			// On some systems FS driver seems to have alignment restrictions on given buffer.
 			// UEFIs buffers allocated with standard AllocatePool seem to be aligned properly and reads
@@ -683,31 +1305,26 @@ FSI_FP_Read(
 			}
 			FreePool(TmpBuffer);
 		}
-		if (Status == EFI_SUCCESS && StringList != NULL && FSIThis->FName != NULL) {
-			// check ForceLoadKexts
-			for (StringEntry = (FSI_STRING_LIST_ENTRY *)GetFirstNode(&StringList->List);
-				 !IsNull (&StringList->List, &StringEntry->List);
-				 StringEntry = (FSI_STRING_LIST_ENTRY *)GetNextNode(&StringList->List, &StringEntry->List)
-				 )
-			{
-				if (StrStr(FSIThis->FName, StringEntry->String) != NULL) {
-					//Print(L"\nGot: %s\n", FSIThis->FName);
-					String = AsciiStrStr((CHAR8*)Buffer, "<string>Safe Boot</string>");
-					if (String != NULL) {
-						CopyMem (String, "<string>Root</string>     ", 26);
-						Print(L"\nForced load: %s\n", FSIThis->FName);
-						//gBS->Stall(5000000);
-					} else {
-						String = AsciiStrStr((CHAR8*)Buffer, "<string>Network-Root</string>");
-						if (String != NULL) {
-							CopyMem (String, "<string>Root</string>        ", 29);
-							Print(L"\nForced load: %s\n", FSIThis->FName);
-							//gBS->Stall(5000000);
-						}
-					}
+		if (Status == EFI_SUCCESS && FSIThis->ForceLoad) {
+			// file is in ForceLoadKexts - checked at open
+			//Print(L"\nGot: %s\n", FSIThis->FName);
+			String = AsciiStrStr((CHAR8*)Buffer, "<string>Safe Boot</string>");
+			if (String != NULL) {
+				CopyMem (String, "<string>Root</string>     ", 26);
+				Print(L"\nForced load: %s\n", FSIThis->FName);
+				//gBS->Stall(5000000);
+			} else {
+				String = AsciiStrStr((CHAR8*)Buffer, "<string>Network-Root</string>");
+				if (String != NULL) {
+					CopyMem (String, "<string>Root</string>        ", 29);
+					Print(L"\nForced load: %s\n", FSIThis->FName);
+					//gBS->Stall(5000000);
 				}
 			}
 		}
+	} else if (FSIThis->Ovl != NULL) {
+		// do it from overlay
+		Status = OverlayRead(FSIThis, BufferSize, Buffer);
 	} else if (FSIThis->SrcFP != NULL) {
 		// do it with source FP
 		Status = FSIThis->SrcFP->Read(FSIThis->SrcFP, BufferSize, Buffer);
@@ -754,6 +1371,9 @@ FSI_FP_Write(
 	if (FSIThis->TgtFP != NULL) {
 		// do it with target FP
 		Status = FSIThis->TgtFP->Write(FSIThis->TgtFP, BufferSize, Buffer);
+	} else if (FSIThis->Ovl != NULL) {
+		// overlay is opened only for reading
+		Status = EFI_ACCESS_DENIED;
 	} else if (FSIThis->SrcFP != NULL) {
 		// do it with source FP
 		Status = FSIThis->SrcFP->Write(FSIThis->SrcFP, BufferSize, Buffer);
@@ -785,6 +1405,10 @@ FSI_FP_SetPosition(
 		// and with Src
 		Status = FSIThis->SrcFP->SetPosition(FSIThis->SrcFP, Position);
 	}
+	if (FSIThis->Ovl != NULL) {
+		// and with overlay
+		Status = OverlaySetPosition(FSIThis, Position);
+	}
 	DBG("= %r\n", Status);
 	return Status;
 }
@@ -807,6 +1431,14 @@ FSI_FP_GetPosition(
 	if (FSIThis->TgtFP != NULL) {
 		// do it with target FP
 		Status = FSIThis->TgtFP->GetPosition(FSIThis->TgtFP, Position);
+	} else if (FSIThis->Ovl != NULL) {
+		// do it from overlay - not defined for dirs
+		if (FSIThis->IsDir) {
+			Status = EFI_UNSUPPORTED;
+		} else {
+			*Position = FSIThis->OvlPosition;
+			Status = EFI_SUCCESS;
+		}
 	} else if (FSIThis->SrcFP != NULL) {
 		// do it with source FP
 		Status = FSIThis->SrcFP->GetPosition(FSIThis->SrcFP, Position);
@@ -840,6 +1472,9 @@ FSI_FP_GetInfo(
 			FInfo = (EFI_FILE_INFO *)Buffer;
 			FSIThis->IsDir = FInfo->Attribute & EFI_FILE_DIRECTORY;
 		}
+	} else if (FSIThis->Ovl != NULL) {
+		// do it from overlay
+		Status = OverlayGetInfo(FSIThis, InformationType, BufferSize, Buffer);
 	} else if (FSIThis->SrcFP != NULL) {
 		// do it with source FP
 		Status = FSIThis->SrcFP->GetInfo(FSIThis->SrcFP, InformationType, BufferSize, Buffer);
@@ -872,6 +1507,9 @@ FSI_FP_SetInfo(
 	if (FSIThis->TgtFP != NULL) {
 		// do it with target FP
 		Status = FSIThis->TgtFP->SetInfo(FSIThis->TgtFP, InformationType, BufferSize, Buffer);
+	} else if (FSIThis->Ovl != NULL) {
+		// overlay is opened only for reading
+		Status = EFI_ACCESS_DENIED;
 	} else if (FSIThis->SrcFP != NULL) {
 		// do it with source FP
 		Status = FSIThis->SrcFP->SetInfo(FSIThis->SrcFP, InformationType, BufferSize, Buffer);
@@ -897,6 +1535,9 @@ FSI_FP_Flush(
 	if (FSIThis->TgtFP != NULL) {
 		// do it with target FP
 		Status = FSIThis->TgtFP->Flush(FSIThis->TgtFP);
+	} else if (FSIThis->Ovl != NULL) {
+		// nothing to flush in overlay
+		Status = EFI_SUCCESS;
 	} else if (FSIThis->SrcFP != NULL) {
 		// do it with source FP
 		Status = FSIThis->SrcFP->Flush(FSIThis->SrcFP);
@@ -937,6 +1578,9 @@ CreateFSInjectFP(VOID)
 	FSINew->TgtFP = NULL;
 	FSINew->SrcFP = NULL;
 	FSINew->FromTgt = FALSE;
+	FSINew->ForceLoad = FALSE;
+	FSINew->Ovl = NULL;
+	FSINew->OvlShadowed = NULL;
 	
 	return FSINew;
 }
@@ -1015,6 +1659,7 @@ FSInjectionInstall (
 	EFI_SIMPLE_FILE_SYSTEM_PROTOCOL		*TgtFS;
 	EFI_SIMPLE_FILE_SYSTEM_PROTOCOL		*SrcFS;
 	FSI_SIMPLE_FILE_SYSTEM_PROTOCOL		*OurFS;
+	FSI_STRING_LIST_ENTRY				*StringEntry;
 	
 	
 	DBG("FSInjectionInstall ...\n");
@@ -1061,10 +1706,29 @@ FSInjectionInstall (
 			DBG("- AllocateCopyPool for TgtDir or SrcDir: %r\n", Status);
 			goto ErrorExit;
 		}
+		// injected files are loaded into memory by OverlayGet when they are needed first
 	}
 	
 	if (Blacklist != NULL && !IsListEmpty(&Blacklist->List)) {
 		OurFS->Blacklist = Blacklist;
+		// Open checks names against trie, not against the list
+		OurFS->BlacklistTrie = AllocateZeroPool(sizeof(FSI_TRIE_NODE));
+		if (OurFS->BlacklistTrie == NULL) {
+			Status = EFI_OUT_OF_RESOURCES;
+			DBG("- AllocateZeroPool for BlacklistTrie: %r\n", Status);
+			goto ErrorExit;
+		}
+		for (StringEntry = (FSI_STRING_LIST_ENTRY *)GetFirstNode(&Blacklist->List);
+			 !IsNull (&Blacklist->List, &StringEntry->List);
+			 StringEntry = (FSI_STRING_LIST_ENTRY *)GetNextNode(&Blacklist->List, &StringEntry->List)
+			 )
+		{
+			if (!TrieAddString(OurFS->BlacklistTrie, StringEntry->String)) {
+				Status = EFI_OUT_OF_RESOURCES;
+				DBG("- TrieAddString for Blacklist: %r\n", Status);
+				goto ErrorExit;
+			}
+		}
 	}
 	
 	if (ForceLoadKexts != NULL && !IsListEmpty(&ForceLoadKexts->List)) {
@@ -1084,6 +1748,7 @@ FSInjectionInstall (
 ErrorExit:
 	if (OurFS->TgtDir != NULL) FreePool(OurFS->TgtDir);
 	if (OurFS->SrcDir != NULL) FreePool(OurFS->SrcDir);
+	TrieFree(OurFS->BlacklistTrie);
 	FreePool(OurFS);
 	return Status;
 }
@@ -13,6 +13,45 @@ Module Name:
 #ifndef __FSInject_H__
 #define __FSInject_H__
 
+/**
+ * Node of case insensitive prefix trie, used for Blacklist
+ */
+typedef struct _FSI_TRIE_NODE {
+	CHAR16								Chr;			// upper case char of this node
+	BOOLEAN								Terminal;		// TRUE if some string ends with this node
+	struct _FSI_TRIE_NODE				*Child;			// first node for next char
+	struct _FSI_TRIE_NODE				*Next;			// next node for the same char position
+} FSI_TRIE_NODE;
+
+/**
+ * Max size of files and dir entries from all SrcDirs kept in memory as overlay.
+ * A SrcDir which does not fit is served from source volume. 0 disables overlay.
+ */
+#ifndef FSI_OVERLAY_MAX_SIZE
+#define FSI_OVERLAY_MAX_SIZE (64 * 1024 * 1024)
+#endif
+
+/**
+ * Node of overlay - in-memory copy of injection dir (SrcDir) made on first use
+ */
+typedef struct _FSI_OVERLAY_NODE {
+	EFI_FILE_INFO						*Info;			// file info as read from source volume
+	UINT8								*Data;			// file content, NULL for dirs and empty files
+	struct _FSI_OVERLAY_NODE			*Child;			// first dir entry, in source volume order
+	struct _FSI_OVERLAY_NODE			*Next;			// next entry in the same dir
+	UINTN								ChildCount;		// number of dir entries
+} FSI_OVERLAY_NODE;
+
+/**
+ * Overlay of one SrcDir, shared by all installs with the same source
+ */
+typedef struct _FSI_OVERLAY_CACHE {
+	struct _FSI_OVERLAY_CACHE			*Next;			// next loaded SrcDir
+	EFI_SIMPLE_FILE_SYSTEM_PROTOCOL		*SrcFS;			// FS with injection dir
+	CHAR16								*SrcDir;		// injection dir
+	FSI_OVERLAY_NODE					*Root;			// SrcDir in memory, or NULL if it is served from source volume
+} FSI_OVERLAY_CACHE;
+
 /**
  * FSInjection EFI_SIMPLE_FILE_SYSTEM_PROTOCOL private structure
  */
@@ -30,7 +69,10 @@ typedef struct {
 	CHAR16								*SrcDir;		// injection dir that contains files that will be injected into TgtDir
 	
 	FSI_STRING_LIST						*Blacklist;		// linked list of file names to be blocked on target volume
+	FSI_TRIE_NODE						*BlacklistTrie;	// Blacklist as prefix trie, built at install
 	FSI_STRING_LIST						*ForceLoadKexts;// linked list of kext plists
+	FSI_OVERLAY_NODE					*Overlay;		// SrcDir in memory, or NULL - valid if OverlayDone
+	BOOLEAN								OverlayDone;	// TRUE after the overlay was looked up or loaded
 } FSI_SIMPLE_FILE_SYSTEM_PROTOCOL;
 
 /** Signature for FSI_SIMPLE_FILE_SYSTEM_PROTOCOL */
@@ -55,6 +97,12 @@ typedef struct {
 	EFI_FILE_PROTOCOL					*TgtFP;			// target EFI_FILE_PROTOCOL
 	EFI_FILE_PROTOCOL					*SrcFP;			// EFI_FILE_PROTOCOL from injection volume
 	BOOLEAN								FromTgt;		// TRUE if file is opened from original target volume, FALSE if from injection volume
+	BOOLEAN								ForceLoad;		// TRUE if file is one of ForceLoadKexts, set at open
+	FSI_OVERLAY_NODE					*Ovl;			// overlay node if served from memory instead of SrcFP
+	FSI_OVERLAY_NODE					*OvlNext;		// next dir entry to return from Ovl
+	UINT64								OvlPosition;	// position in Ovl file, or index of OvlNext in Ovl dir
+	BOOLEAN								*OvlShadowed;	// injection point: Ovl entries found in target dir
+	BOOLEAN								OvlTgtDone;		// injection point: all target dir entries returned
 } FSI_FILE_PROTOCOL;
 
 /** Signature for FSI_FILE_PROTOCOL */
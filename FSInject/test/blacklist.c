@@ -0,0 +1,186 @@
+/**
+ * \file blacklist.c
+ * Replay test of the name handling of FSInject Open in the POSIX user
+ * space environment.
+ *
+ * A pseudo random trace of opens, with mixed case, ".", ".." and absolute
+ * names, goes through GetNormalizedFName, the Blacklist prefix trie and
+ * IsForceLoadKext of FSInject.c, and through the string concatenation and
+ * list walks FSInject used before. Names, blacklist decisions and force
+ * load decisions must be the same. The run times of both are printed, an
+ * open is followed by 4 reads, which used to search ForceLoadKexts each.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "fsi_host.h"
+
+#ifndef TRACE_OPENS
+#define TRACE_OPENS 200000
+#endif
+
+/* GetNormalizedFName as it was: StrCpy and StrCat into a zeroed buffer */
+static CHAR16 *old_normalized_fname (CHAR16 *Parent, CHAR16 *FName)
+{
+    CHAR16 *TmpStr;
+    CHAR16 *TmpStr2;
+    UINTN Len;
+
+    if (FName[0] == L'\\') {
+        FName = AllocateCopyPool(StrSize(FName), FName);
+    } else if (FName[0] == L'.' && FName[1] == L'\0') {
+        FName = AllocateCopyPool(StrSize(Parent), Parent);
+    } else if (FName[0] == L'.' && FName[1] == L'.' && FName[2] == L'\0') {
+        TmpStr = GetStrLastCharOccurence(Parent, L'\\');
+        if (TmpStr != NULL && TmpStr != Parent) {
+            *TmpStr = L'\0';
+            FName = AllocateCopyPool(StrSize(Parent), Parent);
+            *TmpStr = L'\\';
+        } else {
+            FName = AllocateCopyPool(StrSize(L"\\"), L"\\");
+        }
+    } else {
+        Len = StrSize(Parent) + StrSize(FName);
+        TmpStr = AllocateZeroPool(Len);
+        StrCpy(TmpStr, Parent);
+        TmpStr2 = GetStrLastChar(Parent);
+        if (TmpStr2 == NULL || *TmpStr2 != L'\\') {
+            StrCat(TmpStr, L"\\");
+        }
+        FName = StrCat(TmpStr, FName);
+    }
+    return FName;
+}
+
+/* Blacklist as it was walked */
+static BOOLEAN old_blacklisted (FSI_STRING_LIST *Blacklist, CHAR16 *FName)
+{
+    FSI_STRING_LIST_ENTRY *Entry;
+
+    for (Entry = (FSI_STRING_LIST_ENTRY *)GetFirstNode(&Blacklist->List);
+         !IsNull(&Blacklist->List, &Entry->List);
+         Entry = (FSI_STRING_LIST_ENTRY *)GetNextNode(&Blacklist->List, &Entry->List))
+        if (StriStartsWithBasic(FName, Entry->String))
+            return TRUE;
+    return FALSE;
+}
+
+static const char *blacklist[] = {
+    "\\System\\Library\\Caches\\com.apple.kext.caches\\Startup\\kernelcache",
+    "\\System\\Library\\Caches\\com.apple.kext.caches\\Startup\\Extensions.mkext",
+    "\\System\\Library\\Extensions.mkext",
+    "\\com.apple.recovery.boot\\kernelcache",
+    "\\com.apple.recovery.boot\\Extensions.mkext",
+    "\\System\\Library\\PrelinkedKernels\\prelinkedkernel",
+    "\\usr\\standalone\\i386\\",
+    "",
+    "\\x",
+};
+
+static const char *force_load[] = {
+    "\\AppleRTC.kext\\Contents\\Info.plist",
+    "\\IOAHCIFamily.kext\\Contents\\Info.plist",
+    "\\FakeSMC.kext\\Contents\\Info.plist",
+};
+
+static const char *parents[] = {
+    "\\",
+    "\\System\\Library\\Extensions",
+    "\\system\\library\\caches\\COM.APPLE.KEXT.CACHES\\startup",
+    "\\com.apple.recovery.boot",
+    "\\System\\Library\\Extensions\\AppleRTC.kext\\Contents",
+    "\\X",
+    "\\usr\\standalone\\I386",
+    "",
+};
+
+static const char *names[] = {
+    "kernelcache", "KERNELCACHE", "Extensions.mkext", "Info.plist", ".", "..",
+    "\\System\\Library\\Extensions.mkext", "\\mach_kernel", "AppleRTC.kext",
+    "boot.efi", "Kernelcachex", "foo", "x\\y",
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+int main (void)
+{
+    FSI_STRING_LIST *bl, *fl;
+    FSI_STRING_LIST_ENTRY *e;
+    FSI_TRIE_NODE *trie;
+    CHAR16 **parent, **name, *a, *b;
+    clock_t start;
+    double old_time, new_time;
+    long old_count = 0, new_count = 0;
+    int i, k, round, mismatches = 0;
+
+    bl = FSInjectionCreateStringList();
+    for (i = 0; i < (int)COUNT(blacklist); i++)
+        FSInjectionAddStringToList(bl, host_wide(blacklist[i]));
+    fl = FSInjectionCreateStringList();
+    for (i = 0; i < (int)COUNT(force_load); i++)
+        FSInjectionAddStringToList(fl, host_wide(force_load[i]));
+    /* as FSInjectionInstall builds it */
+    trie = AllocateZeroPool(sizeof(FSI_TRIE_NODE));
+    for (e = (FSI_STRING_LIST_ENTRY *)GetFirstNode(&bl->List); !IsNull(&bl->List, &e->List);
+         e = (FSI_STRING_LIST_ENTRY *)GetNextNode(&bl->List, &e->List))
+        TrieAddString(trie, e->String);
+
+    srand(1);
+    parent = malloc(TRACE_OPENS * sizeof(*parent));
+    name = malloc(TRACE_OPENS * sizeof(*name));
+    for (i = 0; i < TRACE_OPENS; i++) {
+        parent[i] = AllocateCopyPool(sizeof(CHAR16) * 1024, host_wide(parents[rand() % COUNT(parents)]));
+        name[i] = AllocateCopyPool(sizeof(CHAR16) * 1024, host_wide(names[rand() % COUNT(names)]));
+    }
+
+    for (i = 0; i < TRACE_OPENS; i++) {
+        a = old_normalized_fname(parent[i], name[i]);
+        b = GetNormalizedFName(parent[i], name[i]);
+        if (StrCmp(a, b) != 0 || old_blacklisted(bl, a) != TrieStartsWith(trie, b) ||
+            IsForceLoadKext(fl, a) != IsForceLoadKext(fl, b)) {
+            if (mismatches++ < 10)
+                printf("open %d: results differ\n", i);
+        }
+        FreePool(a);
+        FreePool(b);
+    }
+
+    /* each open reads 4 times, the force load search used to run on every read */
+    start = clock();
+    for (round = 0; round < 5; round++)
+        for (i = 0; i < TRACE_OPENS; i++) {
+            a = old_normalized_fname(parent[i], name[i]);
+            if (old_blacklisted(bl, a))
+                old_count++;
+            for (k = 0; k < 4; k++)
+                if (IsForceLoadKext(fl, a))
+                    old_count++;
+            FreePool(a);
+        }
+    old_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    for (round = 0; round < 5; round++)
+        for (i = 0; i < TRACE_OPENS; i++) {
+            BOOLEAN force;
+
+            b = GetNormalizedFName(parent[i], name[i]);
+            if (TrieStartsWith(trie, b))
+                new_count++;
+            force = IsForceLoadKext(fl, b);
+            for (k = 0; k < 4; k++)
+                if (force)
+                    new_count++;
+            FreePool(b);
+        }
+    new_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("%d opens x 5: list walks %.3fs, trie %.3fs\n", TRACE_OPENS, old_time, new_time);
+    TrieFree(trie);
+
+    if (mismatches != 0 || old_count != new_count) {
+        printf("%d mismatches\n", mismatches);
+        return 1;
+    }
+    printf("all passed\n");
+    return 0;
+}
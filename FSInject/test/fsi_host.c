@@ -0,0 +1,266 @@
+/**
+ * \file fsi_host.c
+ * Boot and runtime services and GUIDs FSInject.c uses, and host dirs as
+ * volumes, for the tests in the POSIX user space environment.
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "fsi_host.h"
+
+EFI_GUID gEfiFileInfoGuid                     = { 1 };
+EFI_GUID gEfiFileSystemInfoGuid               = { 2 };
+EFI_GUID gEfiFileSystemVolumeLabelInfoIdGuid  = { 3 };
+EFI_GUID gEfiSimpleFileSystemProtocolGuid     = { 4 };
+EFI_GUID gEfiGlobalVariableGuid               = { 5 };
+EFI_GUID gFSInjectProtocolGuid                = { 6 };
+
+EFI_HANDLE gImageHandle;
+
+/* the handle is the EFI_SIMPLE_FILE_SYSTEM_PROTOCOL itself */
+static EFI_STATUS EFIAPI open_protocol (EFI_HANDLE Handle, EFI_GUID *Protocol, VOID **Interface, EFI_HANDLE AgentHandle, EFI_HANDLE ControllerHandle, UINT32 Attributes)
+{
+    *Interface = Handle;
+    return EFI_SUCCESS;
+}
+
+EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *host_installed_fs;
+
+static EFI_STATUS EFIAPI reinstall_protocol_interface (EFI_HANDLE Handle, EFI_GUID *Protocol, VOID *OldInterface, VOID *NewInterface)
+{
+    host_installed_fs = NewInterface;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI set_variable (CHAR16 *VariableName, EFI_GUID *VendorGuid, UINT32 Attributes, UINTN DataSize, VOID *Data)
+{
+    return EFI_SUCCESS;
+}
+
+static EFI_BOOT_SERVICES boot_services = { open_protocol, reinstall_protocol_interface, NULL };
+static EFI_RUNTIME_SERVICES runtime_services = { set_variable };
+EFI_BOOT_SERVICES *gBS = &boot_services;
+EFI_RUNTIME_SERVICES *gRT = &runtime_services;
+
+CHAR16 *host_wide (const char *s)
+{
+    static CHAR16 buffers[8][1024];
+    static int next = 0;
+    CHAR16 *w = buffers[next++ & 7];
+    int i;
+
+    for (i = 0; s[i] != 0 && i < 1023; i++)
+        w[i] = s[i] == '/' ? '\\' : (unsigned char)s[i];
+    w[i] = 0;
+    return w;
+}
+
+/* file or dir of a HOST_VOLUME */
+typedef struct {
+    EFI_FILE_PROTOCOL FP;
+    HOST_VOLUME *Volume;
+    char Path[1024];
+    int IsDir;
+    UINT64 Position;
+    DIR *Dir;
+} HOST_FILE;
+
+static HOST_FILE *host_file (HOST_VOLUME *volume, const char *path);
+
+static EFI_STATUS host_info (const char *path, const char *name, UINTN *BufferSize, VOID *Buffer)
+{
+    EFI_FILE_INFO *info = Buffer;
+    struct stat st;
+    UINTN len, size, i;
+
+    if (stat(path, &st) != 0)
+        return EFI_NOT_FOUND;
+    len = strlen(name);
+    size = SIZE_OF_EFI_FILE_INFO + (len + 1) * sizeof(CHAR16);
+    if (*BufferSize < size) {
+        *BufferSize = size;
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    memset(info, 0, size);
+    info->Size = size;
+    info->FileSize = S_ISDIR(st.st_mode) ? 0 : (UINT64)st.st_size;
+    info->PhysicalSize = info->FileSize;
+    info->Attribute = S_ISDIR(st.st_mode) ? EFI_FILE_DIRECTORY : 0;
+    for (i = 0; i <= len; i++)
+        info->FileName[i] = (unsigned char)name[i];
+    *BufferSize = size;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI host_open (EFI_FILE_PROTOCOL *This, EFI_FILE_PROTOCOL **NewHandle, CHAR16 *FileName, UINT64 OpenMode, UINT64 Attributes)
+{
+    HOST_FILE *file = (HOST_FILE *)This, *child;
+    char name[1024], path[2048];
+    int i;
+
+    for (i = 0; FileName[i] != 0 && i < 1023; i++)
+        name[i] = FileName[i] == L'\\' ? '/' : (char)FileName[i];
+    name[i] = 0;
+    if (OpenMode & EFI_FILE_MODE_WRITE)
+        return EFI_WRITE_PROTECTED;
+    if (name[0] == '/')
+        snprintf(path, sizeof(path), "%s%s", file->Volume->Root, name);
+    else
+        snprintf(path, sizeof(path), "%s/%s", file->Path, name);
+    child = host_file(file->Volume, path);
+    if (child == NULL)
+        return EFI_NOT_FOUND;
+    *NewHandle = &child->FP;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI host_close (EFI_FILE_PROTOCOL *This)
+{
+    HOST_FILE *file = (HOST_FILE *)This;
+
+    if (file->Dir != NULL)
+        closedir(file->Dir);
+    free(file);
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI host_read (EFI_FILE_PROTOCOL *This, UINTN *BufferSize, VOID *Buffer)
+{
+    HOST_FILE *file = (HOST_FILE *)This;
+    struct dirent *entry;
+    char path[2048];
+    EFI_STATUS status;
+    long position;
+    FILE *f;
+
+    file->Volume->Reads++;
+    if (file->IsDir) {
+        position = telldir(file->Dir);
+        do {
+            entry = readdir(file->Dir);
+        } while (entry != NULL && (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0));
+        if (entry == NULL) {
+            *BufferSize = 0;
+            return EFI_SUCCESS;
+        }
+        snprintf(path, sizeof(path), "%s/%s", file->Path, entry->d_name);
+        status = host_info(path, entry->d_name, BufferSize, Buffer);
+        if (status == EFI_BUFFER_TOO_SMALL)
+            seekdir(file->Dir, position);
+        return status;
+    }
+    f = fopen(file->Path, "rb");
+    if (f == NULL)
+        return EFI_DEVICE_ERROR;
+    fseek(f, (long)file->Position, SEEK_SET);
+    *BufferSize = fread(Buffer, 1, *BufferSize, f);
+    fclose(f);
+    file->Position += *BufferSize;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI host_write (EFI_FILE_PROTOCOL *This, UINTN *BufferSize, VOID *Buffer)
+{
+    return EFI_WRITE_PROTECTED;
+}
+
+static EFI_STATUS EFIAPI host_get_position (EFI_FILE_PROTOCOL *This, UINT64 *Position)
+{
+    HOST_FILE *file = (HOST_FILE *)This;
+
+    if (file->IsDir)
+        return EFI_UNSUPPORTED;
+    *Position = file->Position;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI host_set_position (EFI_FILE_PROTOCOL *This, UINT64 Position)
+{
+    HOST_FILE *file = (HOST_FILE *)This;
+    struct stat st;
+
+    if (file->IsDir) {
+        if (Position != 0)
+            return EFI_UNSUPPORTED;
+        rewinddir(file->Dir);
+        return EFI_SUCCESS;
+    }
+    if (Position == MAX_UINT64 && stat(file->Path, &st) == 0)
+        Position = (UINT64)st.st_size;
+    file->Position = Position;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI host_get_info (EFI_FILE_PROTOCOL *This, EFI_GUID *InformationType, UINTN *BufferSize, VOID *Buffer)
+{
+    HOST_FILE *file = (HOST_FILE *)This;
+    const char *name;
+
+    if (!CompareGuid(InformationType, &gEfiFileInfoGuid))
+        return EFI_UNSUPPORTED;
+    name = strrchr(file->Path, '/');
+    return host_info(file->Path, name != NULL ? name + 1 : file->Path, BufferSize, Buffer);
+}
+
+static EFI_STATUS EFIAPI host_set_info (EFI_FILE_PROTOCOL *This, EFI_GUID *InformationType, UINTN BufferSize, VOID *Buffer)
+{
+    return EFI_WRITE_PROTECTED;
+}
+
+static EFI_STATUS EFIAPI host_flush (EFI_FILE_PROTOCOL *This)
+{
+    return EFI_SUCCESS;
+}
+
+static HOST_FILE *host_file (HOST_VOLUME *volume, const char *path)
+{
+    HOST_FILE *file;
+    struct stat st;
+
+    if (stat(path, &st) != 0)
+        return NULL;
+    file = calloc(1, sizeof(*file));
+    if (file == NULL)
+        return NULL;
+    file->FP.Revision = EFI_FILE_PROTOCOL_REVISION;
+    file->FP.Open = host_open;
+    file->FP.Close = host_close;
+    file->FP.Delete = host_close;
+    file->FP.Read = host_read;
+    file->FP.Write = host_write;
+    file->FP.GetPosition = host_get_position;
+    file->FP.SetPosition = host_set_position;
+    file->FP.GetInfo = host_get_info;
+    file->FP.SetInfo = host_set_info;
+    file->FP.Flush = host_flush;
+    file->Volume = volume;
+    snprintf(file->Path, sizeof(file->Path), "%s", path);
+    file->IsDir = S_ISDIR(st.st_mode);
+    if (file->IsDir)
+        file->Dir = opendir(path);
+    volume->Opens++;
+    return file;
+}
+
+static EFI_STATUS EFIAPI host_open_volume (EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *This, EFI_FILE_PROTOCOL **Root)
+{
+    HOST_VOLUME *volume = (HOST_VOLUME *)This;
+    HOST_FILE *file = host_file(volume, volume->Root);
+
+    if (file == NULL)
+        return EFI_NOT_FOUND;
+    *Root = &file->FP;
+    return EFI_SUCCESS;
+}
+
+HOST_VOLUME *host_volume (const char *root)
+{
+    HOST_VOLUME *volume = calloc(1, sizeof(*volume));
+
+    volume->FS.Revision = EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_REVISION;
+    volume->FS.OpenVolume = host_open_volume;
+    snprintf(volume->Root, sizeof(volume->Root), "%s", root);
+    return volume;
+}
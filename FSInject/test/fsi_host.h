@@ -0,0 +1,44 @@
+/**
+ * \file fsi_host.h
+ * FSInject.c functions and host helpers used by the tests.
+ */
+
+#ifndef _FSI_HOST_H_
+#define _FSI_HOST_H_
+
+#include "fsinject_posix_base.h"
+
+#include <Protocol/FSInjectProtocol.h>
+
+#include "../FSInject.h"
+
+/* FSInject.c */
+CHAR16 *GetStrLastChar (CHAR16 *String);
+CHAR16 *GetStrLastCharOccurence (CHAR16 *String, CHAR16 Char);
+BOOLEAN StriStartsWithBasic (CHAR16 *String1, CHAR16 *String2);
+BOOLEAN TrieAddString (FSI_TRIE_NODE *Root, CHAR16 *String);
+BOOLEAN TrieStartsWith (FSI_TRIE_NODE *Root, CHAR16 *String);
+VOID TrieFree (FSI_TRIE_NODE *Node);
+BOOLEAN IsForceLoadKext (FSI_STRING_LIST *ForceLoadKexts, CHAR16 *FName);
+CHAR16 *GetNormalizedFName (CHAR16 *Parent, CHAR16 *FName);
+EFI_STATUS FSInjectionInstall (EFI_HANDLE TgtHandle, CHAR16 *TgtDir, EFI_HANDLE SrcHandle, CHAR16 *SrcDir, FSI_STRING_LIST *Blacklist, FSI_STRING_LIST *ForceLoadKexts);
+FSI_STRING_LIST *FSInjectionCreateStringList (VOID);
+FSI_STRING_LIST *FSInjectionAddStringToList (FSI_STRING_LIST *List, CHAR16 *String);
+
+/* fsi_host.c */
+extern EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *host_installed_fs;   // what FSInjectionInstall put on the target handle
+
+/* directory of the host as read only EFI volume, counts the calls it gets */
+typedef struct {
+    EFI_SIMPLE_FILE_SYSTEM_PROTOCOL FS;
+    char Root[512];
+    long Reads;
+    long Opens;
+} HOST_VOLUME;
+
+HOST_VOLUME *host_volume (const char *root);
+
+/* path with / or \ as CHAR16 string with \, from 8 rotating buffers */
+CHAR16 *host_wide (const char *s);
+
+#endif
@@ -0,0 +1,253 @@
+/**
+ * \file fsinject_posix_base.h
+ * Base definitions for building FSInject.c in the POSIX user space environment.
+ *
+ * Only the parts of the EDK2 headers the driver uses are here. Boot and
+ * runtime services, GUIDs and volumes are in fsi_host.c.
+ */
+
+#ifndef _FSINJECT_POSIX_BASE_H_
+#define _FSINJECT_POSIX_BASE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IN
+#define OUT
+#define OPTIONAL
+#define CONST       const
+#define STATIC      static
+#define EFIAPI
+
+typedef uint8_t     BOOLEAN;
+typedef int8_t      INT8;
+typedef uint8_t     UINT8;
+typedef int16_t     INT16;
+typedef uint16_t    UINT16;
+typedef int32_t     INT32;
+typedef uint32_t    UINT32;
+typedef int64_t     INT64;
+typedef uint64_t    UINT64;
+typedef intptr_t    INTN;
+typedef uintptr_t   UINTN;
+typedef char        CHAR8;
+typedef uint16_t    CHAR16;
+typedef void        VOID;
+
+#define TRUE        1
+#define FALSE       0
+#define MAX_UINT64  0xFFFFFFFFFFFFFFFFULL
+
+typedef UINTN       EFI_STATUS;
+typedef VOID        *EFI_HANDLE;
+
+typedef struct {
+  UINT32  Data1;
+  UINT16  Data2;
+  UINT16  Data3;
+  UINT8   Data4[8];
+} EFI_GUID;
+
+typedef struct {
+  UINT16  Year;
+  UINT8   Month;
+  UINT8   Day;
+  UINT8   Hour;
+  UINT8   Minute;
+  UINT8   Second;
+  UINT8   Pad1;
+  UINT32  Nanosecond;
+  INT16   TimeZone;
+  UINT8   Daylight;
+  UINT8   Pad2;
+} EFI_TIME;
+
+#define ENCODE_ERROR(a)             ((EFI_STATUS) ((UINTN) 1 << (sizeof (UINTN) * 8 - 1) | (a)))
+#define ENCODE_WARNING(a)           ((EFI_STATUS) (a))
+#define EFI_ERROR(a)                ((INTN) (EFI_STATUS) (a) < 0)
+
+#define EFI_SUCCESS                 0
+#define EFI_INVALID_PARAMETER       ENCODE_ERROR (2)
+#define EFI_UNSUPPORTED             ENCODE_ERROR (3)
+#define EFI_BUFFER_TOO_SMALL        ENCODE_ERROR (5)
+#define EFI_DEVICE_ERROR            ENCODE_ERROR (7)
+#define EFI_WRITE_PROTECTED         ENCODE_ERROR (8)
+#define EFI_OUT_OF_RESOURCES        ENCODE_ERROR (9)
+#define EFI_NOT_FOUND               ENCODE_ERROR (14)
+#define EFI_ACCESS_DENIED           ENCODE_ERROR (15)
+#define EFI_END_OF_FILE             ENCODE_ERROR (31)
+#define EFI_WARN_DELETE_FAILURE     ENCODE_WARNING (2)
+
+#define SIGNATURE_16(A, B)          ((A) | (B << 8))
+#define SIGNATURE_32(A, B, C, D)    (SIGNATURE_16 (A, B) | (SIGNATURE_16 (C, D) << 16))
+#define CR(Record, TYPE, Field, TestSignature)  ((TYPE *) ((CHAR8 *) (Record) - offsetof (TYPE, Field)))
+
+/* Guid/FileInfo.h */
+typedef struct {
+  UINT64    Size;
+  UINT64    FileSize;
+  UINT64    PhysicalSize;
+  EFI_TIME  CreateTime;
+  EFI_TIME  LastAccessTime;
+  EFI_TIME  ModificationTime;
+  UINT64    Attribute;
+  CHAR16    FileName[1];
+} EFI_FILE_INFO;
+
+#define SIZE_OF_EFI_FILE_INFO       offsetof (EFI_FILE_INFO, FileName)
+
+/* Protocol/SimpleFileSystem.h */
+#define EFI_FILE_MODE_READ          0x0000000000000001ULL
+#define EFI_FILE_MODE_WRITE         0x0000000000000002ULL
+#define EFI_FILE_MODE_CREATE        0x8000000000000000ULL
+#define EFI_FILE_DIRECTORY          0x0000000000000010ULL
+
+typedef struct _EFI_FILE_PROTOCOL EFI_FILE_PROTOCOL;
+struct _EFI_FILE_PROTOCOL {
+  UINT64      Revision;
+  EFI_STATUS  (EFIAPI *Open) (EFI_FILE_PROTOCOL *This, EFI_FILE_PROTOCOL **NewHandle, CHAR16 *FileName, UINT64 OpenMode, UINT64 Attributes);
+  EFI_STATUS  (EFIAPI *Close) (EFI_FILE_PROTOCOL *This);
+  EFI_STATUS  (EFIAPI *Delete) (EFI_FILE_PROTOCOL *This);
+  EFI_STATUS  (EFIAPI *Read) (EFI_FILE_PROTOCOL *This, UINTN *BufferSize, VOID *Buffer);
+  EFI_STATUS  (EFIAPI *Write) (EFI_FILE_PROTOCOL *This, UINTN *BufferSize, VOID *Buffer);
+  EFI_STATUS  (EFIAPI *GetPosition) (EFI_FILE_PROTOCOL *This, UINT64 *Position);
+  EFI_STATUS  (EFIAPI *SetPosition) (EFI_FILE_PROTOCOL *This, UINT64 Position);
+  EFI_STATUS  (EFIAPI *GetInfo) (EFI_FILE_PROTOCOL *This, EFI_GUID *InformationType, UINTN *BufferSize, VOID *Buffer);
+  EFI_STATUS  (EFIAPI *SetInfo) (EFI_FILE_PROTOCOL *This, EFI_GUID *InformationType, UINTN BufferSize, VOID *Buffer);
+  EFI_STATUS  (EFIAPI *Flush) (EFI_FILE_PROTOCOL *This);
+};
+
+#define EFI_FILE_PROTOCOL_REVISION  0x00010000
+
+typedef struct _EFI_SIMPLE_FILE_SYSTEM_PROTOCOL EFI_SIMPLE_FILE_SYSTEM_PROTOCOL;
+struct _EFI_SIMPLE_FILE_SYSTEM_PROTOCOL {
+  UINT64      Revision;
+  EFI_STATUS  (EFIAPI *OpenVolume) (EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *This, EFI_FILE_PROTOCOL **Root);
+};
+
+#define EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_REVISION  0x00010000
+
+/* Library/UefiBootServicesTableLib.h, Library/UefiRuntimeServicesTableLib.h, only what the driver calls */
+#define EFI_OPEN_PROTOCOL_GET_PROTOCOL  0x00000002
+#define EFI_VARIABLE_BOOTSERVICE_ACCESS 0x00000002
+
+typedef VOID EFI_SYSTEM_TABLE;
+
+typedef struct {
+  EFI_STATUS  (EFIAPI *OpenProtocol) (EFI_HANDLE Handle, EFI_GUID *Protocol, VOID **Interface, EFI_HANDLE AgentHandle, EFI_HANDLE ControllerHandle, UINT32 Attributes);
+  EFI_STATUS  (EFIAPI *ReinstallProtocolInterface) (EFI_HANDLE Handle, EFI_GUID *Protocol, VOID *OldInterface, VOID *NewInterface);
+  EFI_STATUS  (EFIAPI *InstallMultipleProtocolInterfaces) (EFI_HANDLE *Handle, ...);
+} EFI_BOOT_SERVICES;
+
+typedef struct {
+  EFI_STATUS  (EFIAPI *SetVariable) (CHAR16 *VariableName, EFI_GUID *VendorGuid, UINT32 Attributes, UINTN DataSize, VOID *Data);
+} EFI_RUNTIME_SERVICES;
+
+extern EFI_BOOT_SERVICES    *gBS;
+extern EFI_RUNTIME_SERVICES *gRT;
+extern EFI_HANDLE           gImageHandle;
+
+extern EFI_GUID gEfiFileInfoGuid;
+extern EFI_GUID gEfiFileSystemInfoGuid;
+extern EFI_GUID gEfiFileSystemVolumeLabelInfoIdGuid;
+extern EFI_GUID gEfiSimpleFileSystemProtocolGuid;
+extern EFI_GUID gEfiGlobalVariableGuid;
+
+/* Library/BaseLib.h */
+typedef struct _LIST_ENTRY LIST_ENTRY;
+struct _LIST_ENTRY {
+  LIST_ENTRY  *ForwardLink;
+  LIST_ENTRY  *BackLink;
+};
+
+static inline LIST_ENTRY *InitializeListHead (LIST_ENTRY *ListHead)
+{
+  ListHead->ForwardLink = ListHead->BackLink = ListHead;
+  return ListHead;
+}
+
+static inline LIST_ENTRY *InsertTailList (LIST_ENTRY *ListHead, LIST_ENTRY *Entry)
+{
+  Entry->BackLink = ListHead->BackLink;
+  Entry->ForwardLink = ListHead;
+  ListHead->BackLink->ForwardLink = Entry;
+  ListHead->BackLink = Entry;
+  return ListHead;
+}
+
+static inline LIST_ENTRY *GetFirstNode (CONST LIST_ENTRY *List) { return List->ForwardLink; }
+static inline LIST_ENTRY *GetNextNode (CONST LIST_ENTRY *List, CONST LIST_ENTRY *Node) { return Node->ForwardLink; }
+static inline BOOLEAN IsNull (CONST LIST_ENTRY *List, CONST LIST_ENTRY *Node) { return List == Node; }
+static inline BOOLEAN IsListEmpty (CONST LIST_ENTRY *ListHead) { return ListHead->ForwardLink == ListHead; }
+
+static inline UINTN StrLen (CONST CHAR16 *String)
+{
+  UINTN Length = 0;
+
+  while (String[Length] != 0) {
+    Length++;
+  }
+  return Length;
+}
+
+static inline UINTN StrSize (CONST CHAR16 *String) { return (StrLen (String) + 1) * sizeof (CHAR16); }
+static inline CHAR16 *StrCpy (CHAR16 *Destination, CONST CHAR16 *Source) { return memcpy (Destination, Source, StrSize (Source)); }
+static inline CHAR16 *StrCat (CHAR16 *Destination, CONST CHAR16 *Source) { StrCpy (Destination + StrLen (Destination), Source); return Destination; }
+
+static inline INTN StrCmp (CONST CHAR16 *FirstString, CONST CHAR16 *SecondString)
+{
+  while (*FirstString != 0 && *FirstString == *SecondString) {
+    FirstString++;
+    SecondString++;
+  }
+  return *FirstString - *SecondString;
+}
+
+static inline CHAR16 *StrStr (CONST CHAR16 *String, CONST CHAR16 *SearchString)
+{
+  UINTN Length = StrLen (SearchString);
+  UINTN Left = StrLen (String);
+
+  for (; Left >= Length; String++, Left--) {
+    if (memcmp (String, SearchString, Length * sizeof (CHAR16)) == 0) {
+      return (CHAR16 *) String;
+    }
+  }
+  return NULL;
+}
+
+#define AsciiStrStr(String, SearchString)   strstr (String, SearchString)
+
+/* Library/BaseMemoryLib.h, Library/MemoryAllocationLib.h */
+#define CopyMem(Destination, Source, Length)  memmove (Destination, Source, Length)
+#define ZeroMem(Buffer, Length)               memset (Buffer, 0, Length)
+#define CompareGuid(Guid1, Guid2)             (memcmp (Guid1, Guid2, sizeof (EFI_GUID)) == 0)
+#define AllocatePool(AllocationSize)          malloc (AllocationSize)
+#define AllocateZeroPool(AllocationSize)      calloc (1, AllocationSize)
+#define FreePool(Buffer)                      free (Buffer)
+
+static inline VOID *AllocateCopyPool (UINTN AllocationSize, CONST VOID *Buffer)
+{
+  VOID *Memory = malloc (AllocationSize);
+
+  if (Memory != NULL) {
+    memcpy (Memory, Buffer, AllocationSize);
+  }
+  return Memory;
+}
+
+/* Library/PrintLib.h, Library/UefiLib.h, Library/MemLogLib.h: no output on the host */
+static inline UINTN UnicodeSPrint (CHAR16 *StartOfBuffer, UINTN BufferSize, CONST CHAR16 *FormatString, ...)
+{
+  StartOfBuffer[0] = 0;
+  return 0;
+}
+
+#define Print(...)                  ((VOID) 0)
+#define AsciiPrint(...)             ((VOID) 0)
+#define DebugPrint(...)             ((VOID) 0)
+#define MemLog(...)                 ((VOID) 0)
+
+#endif
@@ -0,0 +1,393 @@
+/**
+ * \file overlay.c
+ * Test of the injection of SrcDir into TgtDir in the POSIX user space
+ * environment.
+ *
+ * Pseudo random kexts are written to host dirs, src/kexts for SrcDir and
+ * tgt/System/Library/Extensions for TgtDir, and FSInject is installed
+ * on the target volume. Extensions is walked through FSInject: every dir
+ * must list the entries of the dir it comes from, Extensions the entries
+ * of both dirs once each, and every file must read as the file on disk
+ * it comes from, target before source. Blacklisted kexts must not open
+ * and ForceLoadKexts must be patched in target files only. A second walk,
+ * an install sharing the same SrcDir and an install of an empty SrcDir
+ * follow. With the overlay, source volume reads must stop after the
+ * first walk; the reads are printed. Without it, when SrcDir does not fit
+ * into FSI_OVERLAY_MAX_SIZE, a kext of both dirs is listed twice.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <dirent.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fsi_host.h"
+
+#ifndef SEEDS
+#define SEEDS 20
+#endif
+
+#define MAX_ENTRIES 64
+#define MAX_FILE    (64 * 1024)
+
+static int failures = 0;
+static int seed;
+static char base[256];
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: seed %d: failed: %s\n", __FILE__, __LINE__, seed, #cond); failures++; return; } } while (0)
+
+static void write_file (const char *path, const void *data, size_t size)
+{
+    FILE *f = fopen(path, "wb");
+
+    fwrite(data, 1, size, f);
+    fclose(f);
+}
+
+static void make_dir (const char *path)
+{
+    mkdir(path, 0755);
+}
+
+/* dir/name.kext with Info.plist, MacOS binary and sometimes an empty Resources */
+static void make_kext (const char *dir, const char *name, const char *required, int tag)
+{
+    static unsigned char data[MAX_FILE];
+    char path[1024], plist[512];
+    int size, i;
+
+    snprintf(path, sizeof(path), "%s/%s.kext", dir, name);
+    make_dir(path);
+    snprintf(path, sizeof(path), "%s/%s.kext/Contents", dir, name);
+    make_dir(path);
+    snprintf(path, sizeof(path), "%s/%s.kext/Contents/MacOS", dir, name);
+    make_dir(path);
+    if (rand() % 3 == 0) {
+        snprintf(path, sizeof(path), "%s/%s.kext/Contents/Resources", dir, name);
+        make_dir(path);
+    }
+    snprintf(plist, sizeof(plist),
+             "<plist><dict><key>CFBundleIdentifier</key><string>%s.%d</string>"
+             "<key>OSBundleRequired</key><string>%s</string></dict></plist>\n", name, tag, required);
+    snprintf(path, sizeof(path), "%s/%s.kext/Contents/Info.plist", dir, name);
+    write_file(path, plist, strlen(plist));
+    size = rand() % MAX_FILE;
+    for (i = 0; i < size; i++)
+        data[i] = (unsigned char)(i * 7 + tag + size);
+    snprintf(path, sizeof(path), "%s/%s.kext/Contents/MacOS/%s", dir, name, name);
+    write_file(path, data, size);
+}
+
+static int remove_entry (const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    return remove(path);
+}
+
+static int compare_names (const void *a, const void *b)
+{
+    return strcmp(a, b);
+}
+
+/* adds names of host dir to names from count on, -1 if it is not a dir */
+static int host_list (const char *path, char names[][256], int count)
+{
+    DIR *dir = opendir(path);
+    struct dirent *entry;
+
+    if (dir == NULL)
+        return -1;
+    while ((entry = readdir(dir)) != NULL && count < MAX_ENTRIES) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+            snprintf(names[count++], 256, "%s", entry->d_name);
+    }
+    closedir(dir);
+    return count;
+}
+
+/* what FSInject should give for rel under Extensions */
+static const char *src_dir;
+static BOOLEAN dedup;       // only the overlay lists a kext of both dirs once
+
+static void expected_path (const char *rel, char *path, size_t size)
+{
+    struct stat st;
+
+    snprintf(path, size, "%s/tgt/System/Library/Extensions%s", base, rel);
+    if (stat(path, &st) != 0)
+        snprintf(path, size, "%s/src%s%s", base, src_dir, rel);
+}
+
+static int expected_list (const char *rel, char names[][256])
+{
+    char path[1024];
+    int count, i, j;
+
+    if (rel[0] != 0) {
+        expected_path(rel, path, sizeof(path));
+        count = host_list(path, names, 0);
+    } else {
+        snprintf(path, sizeof(path), "%s/tgt/System/Library/Extensions", base);
+        count = host_list(path, names, 0);
+        snprintf(path, sizeof(path), "%s/src%s", base, src_dir);
+        j = host_list(path, names, count);
+        /* kexts of both dirs once with the overlay */
+        for (i = count; i < j; i++) {
+            int k, dup = 0;
+
+            for (k = 0; k < count && dedup; k++)
+                dup |= strcmp(names[k], names[i]) == 0;
+            if (!dup)
+                memmove(names[count++], names[i], 256);
+        }
+    }
+    qsort(names, count, 256, compare_names);
+    return count;
+}
+
+static void to_ascii (char *s, const CHAR16 *w)
+{
+    while (*w != 0)
+        *s++ = (char)*w++;
+    *s = 0;
+}
+
+static int list (EFI_FILE_PROTOCOL *dir, char names[][256])
+{
+    UINT8 buffer[1024];
+    UINTN size;
+    EFI_STATUS status;
+    int count = 0;
+
+    for (;;) {
+        size = 16;
+        status = dir->Read(dir, &size, buffer);
+        if (status == EFI_BUFFER_TOO_SMALL) {
+            size = sizeof(buffer);
+            status = dir->Read(dir, &size, buffer);
+        }
+        if (EFI_ERROR(status) || size == 0 || count == MAX_ENTRIES)
+            break;
+        to_ascii(names[count++], ((EFI_FILE_INFO *)buffer)->FileName);
+    }
+    qsort(names, count, 256, compare_names);
+    return count;
+}
+
+static void check_file (EFI_FILE_PROTOCOL *file, const char *rel)
+{
+    static UINT8 expected[MAX_FILE + 1024], buffer[MAX_FILE + 1024];
+    char path[1024], *s;
+    UINT64 position;
+    UINTN size, done;
+    FILE *f;
+    int force;
+
+    expected_path(rel, path, sizeof(path));
+    memset(expected, 0, sizeof(expected));
+    f = fopen(path, "rb");
+    size = fread(expected, 1, sizeof(expected), f);
+    fclose(f);
+    /* FSInject patches only target files */
+    force = strstr(rel, "Force.kext/Contents/Info.plist") != NULL && strstr(path, "/tgt/") != NULL;
+    if (force && (s = strstr((char *)expected, "<string>Safe Boot</string>")) != NULL)
+        memcpy(s, "<string>Root</string>     ", 26);
+    else if (force && (s = strstr((char *)expected, "<string>Network-Root</string>")) != NULL)
+        memcpy(s, "<string>Root</string>        ", 29);
+
+    /* whole file in one read, like boot.efi */
+    memset(buffer, 0, sizeof(buffer));
+    done = sizeof(buffer);
+    CHECK(file->Read(file, &done, buffer) == EFI_SUCCESS);
+    CHECK(done == size);
+    CHECK(memcmp(buffer, expected, size) == 0);
+    CHECK(file->GetPosition(file, &position) == EFI_SUCCESS && position == size);
+    if (force)
+        return;
+
+    /* in pieces, from the start and from an offset */
+    CHECK(file->SetPosition(file, 0) == EFI_SUCCESS);
+    for (done = 0;; done += size) {
+        size = 777;
+        CHECK(file->Read(file, &size, buffer + done) == EFI_SUCCESS);
+        if (size == 0)
+            break;
+    }
+    CHECK(memcmp(buffer, expected, done) == 0);
+    if (done > 3) {
+        CHECK(file->SetPosition(file, 3) == EFI_SUCCESS);
+        size = 5;
+        CHECK(file->Read(file, &size, buffer) == EFI_SUCCESS);
+        CHECK(size == (done - 3 < 5 ? done - 3 : 5));
+        CHECK(memcmp(buffer, expected + 3, size) == 0);
+    }
+}
+
+static void walk (EFI_FILE_PROTOCOL *dir, const char *rel)
+{
+    static char got[MAX_ENTRIES][256], want[MAX_ENTRIES][256];
+    char names[MAX_ENTRIES][256], child[2048];
+    EFI_FILE_PROTOCOL *file;
+    EFI_FILE_INFO *info;
+    UINT8 buffer[1024];
+    EFI_STATUS status;
+    UINTN size;
+    int count, i;
+
+    count = list(dir, got);
+    CHECK(count == expected_list(rel, want));
+    for (i = 0; i < count; i++)
+        CHECK(strcmp(got[i], want[i]) == 0);
+    memcpy(names, got, sizeof(names));
+
+    /* listing again from the start */
+    CHECK(dir->SetPosition(dir, 0) == EFI_SUCCESS);
+    CHECK(list(dir, got) == count);
+
+    for (i = 0; i < count; i++) {
+        snprintf(child, sizeof(child), "%s/%s", rel, names[i]);
+        status = dir->Open(dir, &file, host_wide(names[i]), EFI_FILE_MODE_READ, 0);
+        if (strcmp(child, "/Blocked.kext") == 0) {
+            CHECK(status == EFI_NOT_FOUND);
+            continue;
+        }
+        CHECK(status == EFI_SUCCESS);
+        size = sizeof(buffer);
+        status = file->GetInfo(file, &gEfiFileInfoGuid, &size, buffer);
+        info = (EFI_FILE_INFO *)buffer;
+        if (status == EFI_SUCCESS && (info->Attribute & EFI_FILE_DIRECTORY))
+            walk(file, child);
+        else if (status == EFI_SUCCESS)
+            check_file(file, child);
+        file->Close(file);
+        CHECK(status == EFI_SUCCESS);
+        if (failures != 0)
+            return;
+    }
+}
+
+static BOOLEAN overlay_loaded (void)
+{
+    return FSI_FROM_SIMPLE_FILE_SYSTEM(host_installed_fs)->Overlay != NULL;
+}
+
+/* walks Extensions of the installed FS, returns source volume reads */
+static long walk_extensions (HOST_VOLUME *src)
+{
+    EFI_FILE_PROTOCOL *root, *sle;
+    long reads = src->Reads;
+
+    if (host_installed_fs->OpenVolume(host_installed_fs, &root) != EFI_SUCCESS)
+        return -1;
+    if (root->Open(root, &sle, host_wide("/System/Library/Extensions"), EFI_FILE_MODE_READ, 0) == EFI_SUCCESS) {
+        // loaded by now if it fits
+        dedup = overlay_loaded();
+        walk(sle, "");
+        sle->Close(sle);
+    } else {
+        failures++;
+    }
+    root->Close(root);
+    return src->Reads - reads;
+}
+
+static long first_reads, second_reads, shared_reads;
+
+static void test_seed (void)
+{
+    static const char *required[] = { "Safe Boot", "Root", "Network-Root", "Console" };
+    char path[1024], name[32];
+    FSI_STRING_LIST *blacklist, *force_load;
+    HOST_VOLUME *tgt, *src;
+    long reads;
+    int count, i;
+
+    srand(seed);
+    snprintf(base, sizeof(base), "/tmp/fsi_overlay.XXXXXX");
+    CHECK(mkdtemp(base) != NULL);
+    snprintf(path, sizeof(path), "%s/tgt", base); make_dir(path);
+    snprintf(path, sizeof(path), "%s/tgt/System", base); make_dir(path);
+    snprintf(path, sizeof(path), "%s/tgt/System/Library", base); make_dir(path);
+    snprintf(path, sizeof(path), "%s/tgt/System/Library/Extensions", base); make_dir(path);
+    snprintf(path, sizeof(path), "%s/src", base); make_dir(path);
+    snprintf(path, sizeof(path), "%s/src/empty", base); make_dir(path);
+    snprintf(path, sizeof(path), "%s/src/kexts", base); make_dir(path);
+
+    snprintf(path, sizeof(path), "%s/tgt/System/Library/Extensions", base);
+    count = 1 + rand() % 12;
+    for (i = 0; i < count; i++) {
+        snprintf(name, sizeof(name), "T%d", i);
+        make_kext(path, name, required[rand() % 4], i);
+    }
+    make_kext(path, "Force", required[rand() % 4], 100);
+    if (rand() % 2)
+        make_kext(path, "Dup", "Root", 101);
+    snprintf(path, sizeof(path), "%s/src/kexts", base);
+    count = rand() % 12;
+    for (i = 0; i < count; i++) {
+        snprintf(name, sizeof(name), "S%d", i);
+        make_kext(path, name, required[rand() % 4], 200 + i);
+    }
+    if (rand() % 2)
+        make_kext(path, "Dup", "Root", 102);
+    if (rand() % 2)
+        make_kext(path, "Blocked", "Root", 103);
+    if (rand() % 2)
+        make_kext(path, "SrcForce", "Safe Boot", 104);
+
+    blacklist = FSInjectionCreateStringList();
+    FSInjectionAddStringToList(blacklist, host_wide("/System/Library/Extensions/Blocked.kext"));
+    force_load = FSInjectionCreateStringList();
+    FSInjectionAddStringToList(force_load, host_wide("/Force.kext/Contents/Info.plist"));
+    FSInjectionAddStringToList(force_load, host_wide("/SrcForce.kext/Contents/Info.plist"));
+
+    /* new volumes for every seed, FSInject keeps overlays by source volume */
+    snprintf(path, sizeof(path), "%s/tgt", base);
+    tgt = host_volume(path);
+    snprintf(path, sizeof(path), "%s/src", base);
+    src = host_volume(path);
+
+    src_dir = "/kexts";
+    CHECK(FSInjectionInstall(&tgt->FS, host_wide("/System/Library/Extensions"), &src->FS, host_wide(src_dir),
+                             blacklist, force_load) == EFI_SUCCESS);
+    CHECK(src->Reads == 0 && src->Opens == 0);
+    reads = walk_extensions(src);
+    first_reads += reads;
+    reads = walk_extensions(src);
+    second_reads += reads;
+    if (overlay_loaded())
+        CHECK(reads == 0);
+
+    /* the second install of SetFSInjection, same SrcDir */
+    CHECK(FSInjectionInstall(&tgt->FS, host_wide("/System/Library/Extensions"), &src->FS, host_wide(src_dir),
+                             blacklist, force_load) == EFI_SUCCESS);
+    reads = walk_extensions(src);
+    shared_reads += reads;
+    if (overlay_loaded())
+        CHECK(reads == 0);
+
+    /* SrcDir without entries */
+    src_dir = "/empty";
+    CHECK(FSInjectionInstall(&tgt->FS, host_wide("/System/Library/Extensions"), &src->FS, host_wide(src_dir),
+                             blacklist, force_load) == EFI_SUCCESS);
+    walk_extensions(src);
+
+    nftw(base, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+int main (void)
+{
+    for (seed = 0; seed < SEEDS; seed++)
+        test_seed();
+    printf("%d seeds: source volume reads %ld in first walks, %ld in second walks, %ld after second install\n",
+           SEEDS, first_reads, second_reads, shared_reads);
+
+    if (failures != 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("all passed\n");
+    return 0;
+}
@@ -128,7 +128,7 @@ Returns:
     //
     ODir->DirCacheTag = OFile->FileCluster;
     InsertHeadList (&Volume->DirCacheList, &ODir->DirCacheLink);
-    if (Volume->DirCacheCount == FAT_MAX_DIR_CACHE_COUNT) {
+    if (Volume->DirCacheCount == Volume->DirCacheMax) {
       //
       // Replace the least recent used directory
       //
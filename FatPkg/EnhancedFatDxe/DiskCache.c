@@ -234,6 +234,100 @@ Returns:
   return Status;
 }
 
+STATIC
+VOID
+FatReadAheadDataCache (
+  IN FAT_VOLUME         *Volume,
+  IN UINTN              PageNo
+  )
+/*++
+
+Routine Description:
+
+  Load PageNo and the pages after it into the Data Cache with one disk read.
+  It is used when the data reads are sequential. The read-ahead stops at the
+  end of the cluster run being read, at the end of the cache buffer, and at
+  the first page which is already cached or is dirty. If less than two pages
+  are left, nothing is read and FatGetCachePage loads the page as usual.
+
+Arguments:
+
+  Volume                - FAT file system volume.
+  PageNo                - The first page to read.
+
+Returns:
+
+  None.
+
+--*/
+{
+  EFI_STATUS  Status;
+  DISK_CACHE  *DiskCache;
+  CACHE_TAG   *CacheTag;
+  UINTN       GroupNo;
+  UINTN       PageCount;
+  UINTN       Index;
+  UINTN       PageSize;
+  UINTN       RealSize;
+  UINT64      EntryPos;
+  UINT64      LimitAddress;
+  UINT8       PageAlignment;
+
+  DiskCache     = &Volume->DiskCache[CACHE_DATA];
+  PageAlignment = DiskCache->PageAlignment;
+  PageSize      = (UINTN)1 << PageAlignment;
+  GroupNo       = PageNo & DiskCache->GroupMask;
+  EntryPos      = DiskCache->BaseAddress + LShiftU64 (PageNo, PageAlignment);
+  LimitAddress  = DiskCache->RunLimit;
+  if (LimitAddress > DiskCache->LimitAddress) {
+    LimitAddress = DiskCache->LimitAddress;
+  }
+  if (LimitAddress <= EntryPos) {
+    return;
+  }
+
+  PageCount = DiskCache->ReadAheadPages;
+  if (PageCount > DiskCache->GroupMask + 1 - GroupNo) {
+    PageCount = DiskCache->GroupMask + 1 - GroupNo;
+  }
+  if (LShiftU64 (PageCount, PageAlignment) > LimitAddress - EntryPos) {
+    PageCount = (UINTN) RShiftU64 (LimitAddress - EntryPos + PageSize - 1, PageAlignment);
+  }
+  for (Index = 0; Index < PageCount; Index++) {
+    CacheTag = &DiskCache->CacheTag[GroupNo + Index];
+    if (CacheTag->RealSize > 0 && (CacheTag->Dirty || CacheTag->PageNo == PageNo + Index)) {
+      break;
+    }
+  }
+  PageCount = Index;
+  if (PageCount < 2) {
+    return;
+  }
+
+  RealSize = PageCount << PageAlignment;
+  if (LShiftU64 (PageCount, PageAlignment) > DiskCache->LimitAddress - EntryPos) {
+    RealSize = (UINTN) (DiskCache->LimitAddress - EntryPos);
+  }
+  Status = FatDiskIo (
+             Volume,
+             READ_DISK,
+             EntryPos,
+             RealSize,
+             DiskCache->CacheBase + (GroupNo << PageAlignment),
+             NULL
+             );
+  for (Index = 0; Index < PageCount; Index++) {
+    CacheTag            = &DiskCache->CacheTag[GroupNo + Index];
+    CacheTag->PageNo    = PageNo + Index;
+    CacheTag->Dirty     = FALSE;
+    CacheTag->RealSize  = 0;
+    if (!EFI_ERROR (Status)) {
+      CacheTag->RealSize = (RealSize > PageSize) ? PageSize : RealSize;
+      RealSize          -= CacheTag->RealSize;
+    }
+  }
+}
+
 STATIC
 EFI_STATUS
 FatAccessUnalignedCachePage (
@@ -278,6 +372,9 @@ Returns:
   DiskCache = &Volume->DiskCache[CacheDataType];
   GroupNo   = PageNo & DiskCache->GroupMask;
   CacheTag  = &DiskCache->CacheTag[GroupNo];
+  if (CacheDataType == CACHE_DATA && IoMode == READ_DISK && DiskCache->SeqCount >= FAT_READAHEAD_MIN_SEQUENTIAL) {
+    FatReadAheadDataCache (Volume, PageNo);
+  }
   Status    = FatGetCachePage (Volume, CacheDataType, PageNo, CacheTag);
   if (!EFI_ERROR (Status)) {
     Source      = DiskCache->CacheBase + (GroupNo << DiskCache->PageAlignment) + Offset;
@@ -321,6 +418,8 @@ Routine Description:
      The access data will be divided into UnderRun data, Aligned data and OverRun data;
      The UnderRun data and OverRun data will be accessed by the Data cache,
      but the Aligned data will be accessed with disk directly.
+     A read which starts where the previous one ended is sequential; then a miss
+     of the Data cache reads ahead the following pages of the cluster run.
 
 Arguments:
 
@@ -362,6 +461,15 @@ Returns:
   PageNo        = (UINTN) RShiftU64 (EntryPos, PageAlignment);
   UnderRun      = ((UINTN) EntryPos) & (PageSize - 1);
 
+  if (CacheDataType == CACHE_DATA) {
+    if (IoMode == READ_DISK && Offset == DiskCache->SeqOffset) {
+      DiskCache->SeqCount++;
+    } else {
+      DiskCache->SeqCount = 0;
+    }
+    DiskCache->SeqOffset = Offset + BufferSize;
+  }
+
   if (UnderRun > 0) {
     Length = PageSize - UnderRun;
     if (Length > BufferSize) {
@@ -476,6 +584,67 @@ Returns:
   return Status;
 }
 
+STATIC
+UINT64
+FatGetFreeMemorySize (
+  VOID
+  )
+/*++
+
+Routine Description:
+
+  Get the size of the free memory from the memory map.
+
+Arguments:
+
+  None.
+
+Returns:
+
+  The size of all EfiConventionalMemory, 0 if the memory map can not be read.
+
+--*/
+{
+  EFI_STATUS            Status;
+  EFI_MEMORY_DESCRIPTOR *MemoryMap;
+  EFI_MEMORY_DESCRIPTOR *Descriptor;
+  UINTN                 MemoryMapSize;
+  UINTN                 MapKey;
+  UINTN                 DescriptorSize;
+  UINT32                DescriptorVersion;
+  UINTN                 Index;
+  UINT64                FreeSize;
+
+  MemoryMapSize = 0;
+  Status = gBS->GetMemoryMap (&MemoryMapSize, NULL, &MapKey, &DescriptorSize, &DescriptorVersion);
+  if (Status != EFI_BUFFER_TOO_SMALL) {
+    return 0;
+  }
+  //
+  // The allocation of the buffer may split a descriptor
+  //
+  MemoryMapSize += 4 * DescriptorSize;
+  MemoryMap = AllocatePool (MemoryMapSize);
+  if (MemoryMap == NULL) {
+    return 0;
+  }
+
+  FreeSize = 0;
+  Status = gBS->GetMemoryMap (&MemoryMapSize, MemoryMap, &MapKey, &DescriptorSize, &DescriptorVersion);
+  if (!EFI_ERROR (Status)) {
+    Descriptor = MemoryMap;
+    for (Index = 0; Index < MemoryMapSize / DescriptorSize; Index++) {
+      if (Descriptor->Type == EfiConventionalMemory) {
+        FreeSize += LShiftU64 (Descriptor->NumberOfPages, EFI_PAGE_SHIFT);
+      }
+      Descriptor = NEXT_MEMORY_DESCRIPTOR (Descriptor, DescriptorSize);
+    }
+  }
+
+  FreePool (MemoryMap);
+  return FreeSize;
+}
+
 EFI_STATUS
 FatInitializeDiskCache (
   IN FAT_VOLUME         *Volume
@@ -485,6 +654,8 @@ FatInitializeDiskCache (
 Routine Description:
 
   Initialize the disk cache according to Volume's FatType.
+  The Data cache grows with the volume size as long as there is enough free
+  memory, and the directory cache keeps more directories if memory allows.
 
 Arguments:
 
@@ -499,9 +670,13 @@ Returns:
 {
   DISK_CACHE  *DiskCache;
   UINTN       FatCacheGroupCount;
+  UINTN       DataCacheGroupCount;
   UINTN       DataCacheSize;
   UINTN       FatCacheSize;
   UINT8       *CacheBuffer;
+  UINT64      VolumeLimit;
+  UINT64      MemoryLimit;
+  UINT64      DirCacheSize;
 
   DiskCache = Volume->DiskCache;
   //
@@ -517,21 +692,55 @@ Returns:
     DiskCache[CACHE_DATA].PageAlignment = FAT_DATACACHE_PAGE_MAX_ALIGNMENT;
   }
 
-  DiskCache[CACHE_DATA].GroupMask     = FAT_DATACACHE_GROUP_COUNT - 1;
-  DiskCache[CACHE_DATA].BaseAddress   = Volume->RootPos;
-  DiskCache[CACHE_DATA].LimitAddress  = Volume->VolumeSize;
+  //
+  // Size the Data cache by the volume size and the free memory
+  //
+  VolumeLimit         = RShiftU64 (Volume->VolumeSize, FAT_DATACACHE_VOLUME_SHIFT);
+  MemoryLimit         = RShiftU64 (FatGetFreeMemorySize (), FAT_DATACACHE_MEMORY_SHIFT);
+  DataCacheGroupCount = FAT_DATACACHE_GROUP_MIN_COUNT;
+  while (DataCacheGroupCount < FAT_DATACACHE_GROUP_MAX_COUNT &&
+         LShiftU64 (DataCacheGroupCount * 2, DiskCache[CACHE_DATA].PageAlignment) <= VolumeLimit &&
+         LShiftU64 (DataCacheGroupCount * 2, DiskCache[CACHE_DATA].PageAlignment) <= MemoryLimit) {
+    DataCacheGroupCount *= 2;
+  }
+
   DiskCache[CACHE_FAT].GroupMask      = FatCacheGroupCount - 1;
   DiskCache[CACHE_FAT].BaseAddress    = Volume->FatPos;
   DiskCache[CACHE_FAT].LimitAddress   = Volume->FatPos + Volume->FatSize;
   FatCacheSize                        = FatCacheGroupCount << DiskCache[CACHE_FAT].PageAlignment;
-  DataCacheSize                       = FAT_DATACACHE_GROUP_COUNT << DiskCache[CACHE_DATA].PageAlignment;
   //
-  // Allocate the Fat Cache buffer
+  // Allocate the Fat Cache buffer, with a smaller Data cache if memory is short
+  //
+  for (;;) {
+    DataCacheSize = DataCacheGroupCount << DiskCache[CACHE_DATA].PageAlignment;
+    CacheBuffer   = AllocateZeroPool (FatCacheSize + DataCacheSize);
+    if (CacheBuffer != NULL) {
+      break;
+    }
+    if (DataCacheGroupCount == FAT_DATACACHE_GROUP_MIN_COUNT) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    DataCacheGroupCount /= 2;
+  }
+
+  DiskCache[CACHE_DATA].GroupMask       = DataCacheGroupCount - 1;
+  DiskCache[CACHE_DATA].BaseAddress     = Volume->RootPos;
+  DiskCache[CACHE_DATA].LimitAddress    = Volume->VolumeSize;
+  DiskCache[CACHE_DATA].ReadAheadPages  = DataCacheGroupCount >> FAT_READAHEAD_GROUP_SHIFT;
+  //
+  // Keep the directories for the whole session if the memory allows. A cached
+  // directory is its FAT_ODIR and the FAT_DIRENT and name of every entry read,
+  // the caches together stay in the share of the free memory
   //
-  CacheBuffer = AllocateZeroPool (FatCacheSize + DataCacheSize);
-  if (CacheBuffer == NULL) {
-    return EFI_OUT_OF_RESOURCES;
+  DirCacheSize = MultU64x32 (
+                   FAT_MAX_DIR_CACHE_COUNT,
+                   (UINT32) (sizeof (FAT_ODIR) + FAT_DIR_CACHE_DIRENT_COUNT * (sizeof (FAT_DIRENT) + (EFI_FILE_STRING_LENGTH + 1) * sizeof (CHAR16)))
+                   );
+  Volume->DirCacheMax = FAT_MIN_DIR_CACHE_COUNT;
+  if (FatCacheSize + DataCacheSize + DirCacheSize <= MemoryLimit) {
+    Volume->DirCacheMax = FAT_MAX_DIR_CACHE_COUNT;
   }
+  DEBUG ((EFI_D_INFO, "FatInitializeDiskCache: %d data cache pages, %d cached directories\n", DataCacheGroupCount, Volume->DirCacheMax));
 
   Volume->CacheBuffer             = CacheBuffer;
   DiskCache[CACHE_FAT].CacheBase  = CacheBuffer;
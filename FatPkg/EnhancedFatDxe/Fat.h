@@ -21,6 +21,9 @@ Revision History
 #ifndef _FAT_H_
 #define _FAT_H_
 
+#ifdef HOST_POSIX
+#include "fat_posix_base.h"
+#else
 #include <Uefi.h>
 
 #include <Guid/FileInfo.h>
@@ -41,6 +44,7 @@ Revision History
 #include <Library/UefiDriverEntryPoint.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiRuntimeServicesTableLib.h>
+#endif
 
 #include "FatFileSystem.h"
 
@@ -92,10 +96,25 @@ Revision History
 #define FAT_FATCACHE_PAGE_MAX_ALIGNMENT   15
 #define FAT_DATACACHE_PAGE_MIN_ALIGNMENT  13
 #define FAT_DATACACHE_PAGE_MAX_ALIGNMENT  16
-#define FAT_DATACACHE_GROUP_COUNT         64
+#define FAT_DATACACHE_GROUP_MIN_COUNT     64
+#define FAT_DATACACHE_GROUP_MAX_COUNT     256
 #define FAT_FATCACHE_GROUP_MIN_COUNT      1
 #define FAT_FATCACHE_GROUP_MAX_COUNT      16
 
+//
+// The data cache grows with the volume up to 1/256 of its size,
+// but takes no more than 1/64 of the free memory
+//
+#define FAT_DATACACHE_VOLUME_SHIFT        8
+#define FAT_DATACACHE_MEMORY_SHIFT        6
+
+//
+// Data reads in a row that continue the previous one before the data cache
+// reads ahead, and the read-ahead window in 1/8 of the data cache
+//
+#define FAT_READAHEAD_MIN_SEQUENTIAL      1
+#define FAT_READAHEAD_GROUP_SHIFT         3
+
 //
 // Used in 8.3 generation algorithm
 //
@@ -116,7 +135,13 @@ Revision History
 #define LC_ISO_639_2_ENTRY_SIZE 3
 #define MAX_LANG_CODE_SIZE      100
 
-#define FAT_MAX_DIR_CACHE_COUNT 8
+#define FAT_MIN_DIR_CACHE_COUNT 8
+#define FAT_MAX_DIR_CACHE_COUNT 64
+//
+// Entries counted for each cached directory when the directory cache is sized,
+// every one with a name of the longest length
+//
+#define FAT_DIR_CACHE_DIRENT_COUNT  128
 #define FAT_MAX_DIRENTRY_COUNT  0xFFFF
 typedef CHAR8                   LC_ISO_639_2;
 
@@ -168,7 +193,11 @@ typedef struct {
   BOOLEAN   Dirty;
   UINT8     PageAlignment;
   UINTN     GroupMask;
-  CACHE_TAG CacheTag[FAT_DATACACHE_GROUP_COUNT];
+  UINTN     ReadAheadPages;   // Pages read at once when the data reads are sequential
+  UINT64    SeqOffset;        // Where the last data read ended
+  UINTN     SeqCount;         // Data reads in a row that continued the previous one
+  UINT64    RunLimit;         // End of the cluster run being read, bounds the read-ahead
+  CACHE_TAG CacheTag[FAT_DATACACHE_GROUP_MAX_COUNT];
 } DISK_CACHE;
 
 //
@@ -375,6 +404,7 @@ typedef struct _FAT_VOLUME {
   //
   LIST_ENTRY                      DirCacheList;
   UINTN                           DirCacheCount;
+  UINTN                           DirCacheMax;    // Directories kept after their OFile is freed
 
   //
   // Disk Cache for this volume
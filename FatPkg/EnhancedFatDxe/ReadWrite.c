@@ -546,10 +546,17 @@ Returns:
     //
     Len = BufferSize > OFile->PosRem ? OFile->PosRem : BufferSize;
 
+    //
+    // The data cache may read ahead up to the end of this cluster run
+    //
+    if (IoMode == READ_DATA) {
+      Volume->DiskCache[CACHE_DATA].RunLimit = OFile->PosDisk + OFile->PosRem;
+    }
     //
     // Write the data
     //
     Status = FatDiskIo (Volume, IoMode, OFile->PosDisk, Len, UserBuffer, Task);
+    Volume->DiskCache[CACHE_DATA].RunLimit = 0;
     if (EFI_ERROR (Status)) {
       break;
     }
@@ -0,0 +1,284 @@
+/**
+ * \file diskcache.c
+ * Test of the disk cache of EnhancedFatDxe in the POSIX user space environment.
+ *
+ * DiskCache.c runs over a memory disk with a shadow copy of it:
+ * - the cache sizes FatInitializeDiskCache chooses for volume sizes and
+ *   free memory, the directory cache counted with its entries;
+ * - the disk reads of a fragmented file and of a directory read in small
+ *   pieces, with and without the read-ahead;
+ * - random reads and writes, which must always match the shadow copy.
+ */
+
+#include <stdio.h>
+
+#include "Fat.h"
+
+#define DISK_SIZE       (64 << 20)
+#define ROOT_POS        (1 << 20)
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: failed: %s\n", __FILE__, __LINE__, #cond); failures++; return; } } while (0)
+
+void fat_assert (const char *file, int line, const char *cond)
+{
+    printf("%s:%d: ASSERT %s\n", file, line, cond);
+    exit(1);
+}
+
+VOID *AllocatePool (UINTN AllocationSize)
+{
+    return malloc(AllocationSize);
+}
+
+VOID *AllocateZeroPool (UINTN AllocationSize)
+{
+    return calloc(1, AllocationSize);
+}
+
+VOID FreePool (VOID *Buffer)
+{
+    free(Buffer);
+}
+
+/* the memory map has one descriptor of free memory */
+static UINT64 free_memory;
+
+static EFI_STATUS EFIAPI get_memory_map (UINTN *MemoryMapSize, EFI_MEMORY_DESCRIPTOR *MemoryMap,
+                                         UINTN *MapKey, UINTN *DescriptorSize, UINT32 *DescriptorVersion)
+{
+    *DescriptorSize = sizeof(EFI_MEMORY_DESCRIPTOR);
+    if (*MemoryMapSize < sizeof(EFI_MEMORY_DESCRIPTOR)) {
+        *MemoryMapSize = sizeof(EFI_MEMORY_DESCRIPTOR);
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    *MemoryMapSize = sizeof(EFI_MEMORY_DESCRIPTOR);
+    memset(MemoryMap, 0, sizeof(EFI_MEMORY_DESCRIPTOR));
+    MemoryMap->Type = EfiConventionalMemory;
+    MemoryMap->NumberOfPages = free_memory >> EFI_PAGE_SHIFT;
+    return EFI_SUCCESS;
+}
+
+static EFI_BOOT_SERVICES boot_services = { get_memory_map };
+EFI_BOOT_SERVICES *gBS = &boot_services;
+
+static EFI_STATUS EFIAPI flush_blocks (EFI_BLOCK_IO_PROTOCOL *This)
+{
+    return EFI_SUCCESS;
+}
+
+static EFI_BLOCK_IO_PROTOCOL block_io = { flush_blocks };
+
+/* memory disk, Misc.c has the driver's FatDiskIo */
+static UINT8 *disk, *shadow;
+static unsigned long disk_reads;
+
+EFI_STATUS FatDiskIo (FAT_VOLUME *Volume, IO_MODE IoMode, UINT64 Offset, UINTN BufferSize, VOID *Buffer, FAT_TASK *Task)
+{
+    if (Offset + BufferSize > Volume->VolumeSize)
+        return EFI_VOLUME_CORRUPTED;
+    if (CACHE_ENABLED(IoMode))
+        return FatAccessCache(Volume, CACHE_TYPE(IoMode), RAW_ACCESS(IoMode), Offset, BufferSize, Buffer, Task);
+    if (IoMode == READ_DISK) {
+        disk_reads++;
+        memcpy(Buffer, disk + Offset, BufferSize);
+    } else {
+        memcpy(disk + Offset, Buffer, BufferSize);
+    }
+    return EFI_SUCCESS;
+}
+
+static FAT_VOLUME volume;
+
+static EFI_STATUS init_volume (UINT64 volume_size, FAT_VOLUME_TYPE fat_type, UINT64 free_size)
+{
+    if (volume.CacheBuffer != NULL)
+        free(volume.CacheBuffer);
+    memset(&volume, 0, sizeof(volume));
+    volume.VolumeSize = volume_size;
+    volume.FatType = fat_type;
+    volume.FatPos = 32768;
+    volume.FatSize = 512 << 10;
+    volume.RootPos = ROOT_POS;
+    volume.BlockIo = &block_io;
+    free_memory = free_size;
+    return FatInitializeDiskCache(&volume);
+}
+
+/* memory a cached directory is counted with */
+#define DIR_SIZE (sizeof(FAT_ODIR) + FAT_DIR_CACHE_DIRENT_COUNT * (sizeof(FAT_DIRENT) + (EFI_FILE_STRING_LENGTH + 1) * sizeof(CHAR16)))
+
+static void check_sizes (UINT64 volume_size, FAT_VOLUME_TYPE fat_type, UINT64 free_size)
+{
+    UINTN groups, fat_size, data_size;
+    UINT64 share;
+
+    CHECK(init_volume(volume_size, fat_type, free_size) == EFI_SUCCESS);
+    groups = volume.DiskCache[CACHE_DATA].GroupMask + 1;
+    fat_size = (volume.DiskCache[CACHE_FAT].GroupMask + 1) << volume.DiskCache[CACHE_FAT].PageAlignment;
+    data_size = groups << volume.DiskCache[CACHE_DATA].PageAlignment;
+    share = free_size >> FAT_DATACACHE_MEMORY_SHIFT;
+
+    CHECK((groups & (groups - 1)) == 0);
+    CHECK(groups >= FAT_DATACACHE_GROUP_MIN_COUNT && groups <= FAT_DATACACHE_GROUP_MAX_COUNT);
+    if (groups > FAT_DATACACHE_GROUP_MIN_COUNT) {
+        CHECK(data_size <= volume_size >> FAT_DATACACHE_VOLUME_SHIFT);
+        CHECK(data_size <= share);
+    }
+    CHECK(volume.DirCacheMax == FAT_MIN_DIR_CACHE_COUNT || volume.DirCacheMax == FAT_MAX_DIR_CACHE_COUNT);
+    if (volume.DirCacheMax == FAT_MAX_DIR_CACHE_COUNT) {
+        CHECK(fat_size + data_size + FAT_MAX_DIR_CACHE_COUNT * DIR_SIZE <= share);
+    } else {
+        CHECK(fat_size + data_size + FAT_MAX_DIR_CACHE_COUNT * DIR_SIZE > share);
+    }
+}
+
+static void test_sizes (void)
+{
+    UINT64 volume_size, free_size;
+    UINT64 share;
+    int fat_type;
+
+    for (fat_type = FAT12; fat_type <= FAT32; fat_type++)
+        for (volume_size = 1 << 20; volume_size <= (1ull << 40); volume_size <<= 1)
+            for (free_size = 0; free_size <= (16ull << 30); free_size = free_size ? free_size * 2 : (1 << 20))
+                check_sizes(volume_size, (FAT_VOLUME_TYPE)fat_type, free_size);
+
+    /* 64 bare FAT_ODIRs and the caches fit in the share, 64 directories with their entries don't */
+    share = (16 << 15) + (64 << 16) + FAT_MAX_DIR_CACHE_COUNT * sizeof(FAT_ODIR);
+    free_size = share << FAT_DATACACHE_MEMORY_SHIFT;
+    CHECK(init_volume(1ull << 30, FAT32, free_size) == EFI_SUCCESS);
+    CHECK(volume.DiskCache[CACHE_DATA].GroupMask + 1 == 64);
+    CHECK(volume.DirCacheMax == FAT_MIN_DIR_CACHE_COUNT);
+    printf("cached directories: 8 up to %llu MB free memory, directory cache %llu KB\n",
+           (unsigned long long)(((16 << 15) + (64 << 16) + FAT_MAX_DIR_CACHE_COUNT * DIR_SIZE) << FAT_DATACACHE_MEMORY_SHIFT >> 20),
+           (unsigned long long)(FAT_MAX_DIR_CACHE_COUNT * DIR_SIZE >> 10));
+}
+
+/* read a file made of runs in pieces, like FatAccessOFile */
+static int file_read (UINT64 *runs, UINT64 run_size, UINT64 pos, UINTN len, UINT8 *out)
+{
+    while (len > 0) {
+        UINT64 run = pos / run_size, offset = pos % run_size;
+        UINTN part = (UINTN)(run_size - offset);
+
+        if (part > len)
+            part = len;
+        volume.DiskCache[CACHE_DATA].RunLimit = runs[run] + run_size;
+        if (FatDiskIo(&volume, READ_DATA, runs[run] + offset, part, out, NULL) != EFI_SUCCESS)
+            return 0;
+        volume.DiskCache[CACHE_DATA].RunLimit = 0;
+        if (memcmp(out, shadow + runs[run] + offset, part) != 0)
+            return 0;
+        pos += part;
+        len -= part;
+        out += part;
+    }
+    return 1;
+}
+
+static unsigned long read_file_in_chunks (int read_ahead)
+{
+    static UINT8 buffer[4096];
+    UINT64 runs[32], pos;
+    int i;
+
+    init_volume(DISK_SIZE, FAT32, 1ull << 30);
+    if (!read_ahead)
+        volume.DiskCache[CACHE_DATA].ReadAheadPages = 0;
+    /* 8 MB file in 32 runs of 256 KB, 4 KB reads */
+    for (i = 0; i < 32; i++)
+        runs[i] = ROOT_POS + (UINT64)((i * 37) % 56) * (1 << 20) + 8192;
+    disk_reads = 0;
+    for (pos = 0; pos < (8 << 20); pos += sizeof(buffer))
+        if (!file_read(runs, 256 << 10, pos, sizeof(buffer), buffer))
+            return ~0UL;
+    return disk_reads;
+}
+
+static unsigned long read_directory (int read_ahead)
+{
+    static UINT8 buffer[32];
+    UINT64 runs[4] = { ROOT_POS + (40 << 20), ROOT_POS + (50 << 20) + 4096, ROOT_POS + (3 << 20), ROOT_POS + (60 << 20) };
+    UINT64 pos;
+
+    init_volume(DISK_SIZE, FAT32, 1ull << 30);
+    if (!read_ahead)
+        volume.DiskCache[CACHE_DATA].ReadAheadPages = 0;
+    /* 512 KB directory in 4 runs of 128 KB, 32 byte entry reads */
+    disk_reads = 0;
+    for (pos = 0; pos < (512 << 10); pos += sizeof(buffer))
+        if (!file_read(runs, 128 << 10, pos, sizeof(buffer), buffer))
+            return ~0UL;
+    return disk_reads;
+}
+
+static void test_read_ahead (void)
+{
+    unsigned long file_plain, file_ahead, dir_plain, dir_ahead;
+
+    file_plain = read_file_in_chunks(0);
+    file_ahead = read_file_in_chunks(1);
+    dir_plain = read_directory(0);
+    dir_ahead = read_directory(1);
+    printf("8 MB file in 4 KB reads: %lu -> %lu disk reads\n", file_plain, file_ahead);
+    printf("512 KB directory in 32 byte reads: %lu -> %lu disk reads\n", dir_plain, dir_ahead);
+    CHECK(file_plain != ~0UL && file_ahead != ~0UL && dir_plain != ~0UL && dir_ahead != ~0UL);
+    CHECK(file_ahead < file_plain);
+    CHECK(dir_ahead <= dir_plain);
+}
+
+static void test_coherency (void)
+{
+    static UINT8 buffer[300000];
+    UINT64 offset;
+    UINTN len, k;
+    int i;
+
+    srand(1);
+    CHECK(init_volume(DISK_SIZE, FAT32, 1ull << 30) == EFI_SUCCESS);
+    for (i = 0; i < 200000; i++) {
+        offset = ROOT_POS + ((UINT64)rand() * 4096 + rand()) % (DISK_SIZE - ROOT_POS - sizeof(buffer));
+        len = rand() % ((rand() & 7) ? 5000 : sizeof(buffer));
+        if (rand() % 5 == 0) {
+            for (k = 0; k < len; k++)
+                buffer[k] = (UINT8)(i + k * 7);
+            memcpy(shadow + offset, buffer, len);
+            CHECK(FatDiskIo(&volume, WRITE_DATA, offset, len, buffer, NULL) == EFI_SUCCESS);
+        } else {
+            /* sometimes the run goes on after the read, so the cache reads ahead */
+            volume.DiskCache[CACHE_DATA].RunLimit = offset + len + ((rand() & 1) ? 200000 : 0);
+            CHECK(FatDiskIo(&volume, READ_DATA, offset, len, buffer, NULL) == EFI_SUCCESS);
+            volume.DiskCache[CACHE_DATA].RunLimit = 0;
+            CHECK(memcmp(buffer, shadow + offset, len) == 0);
+        }
+        if (i % 50000 == 0)
+            CHECK(FatVolumeFlushCache(&volume, NULL) == EFI_SUCCESS);
+    }
+    CHECK(FatVolumeFlushCache(&volume, NULL) == EFI_SUCCESS);
+    CHECK(memcmp(disk, shadow, DISK_SIZE) == 0);
+}
+
+int main (void)
+{
+    UINTN i;
+
+    disk = malloc(DISK_SIZE);
+    shadow = malloc(DISK_SIZE);
+    srand(1);
+    for (i = 0; i < DISK_SIZE; i++)
+        disk[i] = (UINT8)rand();
+    memcpy(shadow, disk, DISK_SIZE);
+
+    test_sizes();
+    test_read_ahead();
+    test_coherency();
+
+    if (failures != 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("all passed\n");
+    return 0;
+}
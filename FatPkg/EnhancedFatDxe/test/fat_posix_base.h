@@ -0,0 +1,184 @@
+/**
+ * \file fat_posix_base.h
+ * Base definitions for building DiskCache.c in the POSIX user space environment.
+ *
+ * Only the parts of the EDK2 headers Fat.h and DiskCache.c use are here.
+ * The protocols are opaque, the memory map and the disk are implemented in
+ * diskcache.c.
+ */
+
+#ifndef _FAT_POSIX_BASE_H_
+#define _FAT_POSIX_BASE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IN
+#define OUT
+#define OPTIONAL
+#define CONST       const
+#define STATIC      static
+#define EFIAPI
+
+typedef uint8_t     BOOLEAN;
+typedef int8_t      INT8;
+typedef uint8_t     UINT8;
+typedef int16_t     INT16;
+typedef uint16_t    UINT16;
+typedef int32_t     INT32;
+typedef uint32_t    UINT32;
+typedef int64_t     INT64;
+typedef uint64_t    UINT64;
+typedef intptr_t    INTN;
+typedef uintptr_t   UINTN;
+typedef char        CHAR8;
+typedef uint16_t    CHAR16;
+typedef void        VOID;
+
+#define TRUE        1
+#define FALSE       0
+
+typedef UINTN       EFI_STATUS;
+typedef UINTN       EFI_TPL;
+typedef VOID        *EFI_HANDLE;
+typedef VOID        *EFI_EVENT;
+typedef UINT64      EFI_LBA;
+typedef UINT64      EFI_PHYSICAL_ADDRESS;
+typedef UINT64      EFI_VIRTUAL_ADDRESS;
+
+typedef struct {
+  UINT32  Data1;
+  UINT16  Data2;
+  UINT16  Data3;
+  UINT8   Data4[8];
+} EFI_GUID;
+
+typedef struct {
+  UINT16  Year;
+  UINT8   Month;
+  UINT8   Day;
+  UINT8   Hour;
+  UINT8   Minute;
+  UINT8   Second;
+  UINT8   Pad1;
+  UINT32  Nanosecond;
+  INT16   TimeZone;
+  UINT8   Daylight;
+  UINT8   Pad2;
+} EFI_TIME;
+
+#define ENCODE_ERROR(a)             ((EFI_STATUS) ((UINTN) 1 << (sizeof (UINTN) * 8 - 1) | (a)))
+#define ENCODE_WARNING(a)           ((EFI_STATUS) (a))
+#define EFI_ERROR(a)                ((INTN) (EFI_STATUS) (a) < 0)
+
+#define EFI_SUCCESS                 0
+#define EFI_INVALID_PARAMETER       ENCODE_ERROR (2)
+#define EFI_UNSUPPORTED             ENCODE_ERROR (3)
+#define EFI_BUFFER_TOO_SMALL        ENCODE_ERROR (5)
+#define EFI_DEVICE_ERROR            ENCODE_ERROR (7)
+#define EFI_WRITE_PROTECTED         ENCODE_ERROR (8)
+#define EFI_OUT_OF_RESOURCES        ENCODE_ERROR (9)
+#define EFI_VOLUME_CORRUPTED        ENCODE_ERROR (10)
+#define EFI_NOT_FOUND               ENCODE_ERROR (14)
+#define EFI_ACCESS_DENIED           ENCODE_ERROR (15)
+#define EFI_WARN_DELETE_FAILURE     ENCODE_WARNING (2)
+
+#define SIGNATURE_16(A, B)          ((A) | (B << 8))
+#define SIGNATURE_32(A, B, C, D)    (SIGNATURE_16 (A, B) | (SIGNATURE_16 (C, D) << 16))
+#define CR(Record, TYPE, Field, TestSignature)  ((TYPE *) ((CHAR8 *) (Record) - offsetof (TYPE, Field)))
+
+/* a failed ASSERT is a failed test */
+void fat_assert (const char *file, int line, const char *cond);
+#define ASSERT(cond)                do { if (!(cond)) fat_assert (__FILE__, __LINE__, #cond); } while (0)
+#define DEBUG(x)
+
+typedef struct _LIST_ENTRY LIST_ENTRY;
+struct _LIST_ENTRY {
+  LIST_ENTRY  *ForwardLink;
+  LIST_ENTRY  *BackLink;
+};
+
+/* the protocols are only pointed to, the file handle and the disk token are
+   members of the FAT structures, FlushBlocks is the only protocol call */
+typedef struct _EFI_DISK_IO_PROTOCOL            EFI_DISK_IO_PROTOCOL;
+typedef struct _EFI_DISK_IO2_PROTOCOL           EFI_DISK_IO2_PROTOCOL;
+typedef struct _EFI_UNICODE_COLLATION_PROTOCOL  EFI_UNICODE_COLLATION_PROTOCOL;
+typedef struct _EFI_DRIVER_BINDING_PROTOCOL     EFI_DRIVER_BINDING_PROTOCOL;
+typedef struct _EFI_COMPONENT_NAME_PROTOCOL     EFI_COMPONENT_NAME_PROTOCOL;
+typedef struct _EFI_COMPONENT_NAME2_PROTOCOL    EFI_COMPONENT_NAME2_PROTOCOL;
+typedef struct _EFI_FILE_INFO                   EFI_FILE_INFO;
+typedef struct _EFI_FILE_IO_TOKEN               EFI_FILE_IO_TOKEN;
+
+typedef struct {
+  UINT64    Revision;
+} EFI_FILE_PROTOCOL;
+
+typedef struct {
+  EFI_EVENT   Event;
+  EFI_STATUS  TransactionStatus;
+} EFI_DISK_IO2_TOKEN;
+
+typedef struct _EFI_BLOCK_IO_PROTOCOL EFI_BLOCK_IO_PROTOCOL;
+struct _EFI_BLOCK_IO_PROTOCOL {
+  EFI_STATUS (EFIAPI *FlushBlocks) (EFI_BLOCK_IO_PROTOCOL *This);
+};
+
+typedef struct {
+  UINT64    Revision;
+  VOID      *OpenVolume;
+} EFI_SIMPLE_FILE_SYSTEM_PROTOCOL;
+
+typedef struct {
+  EFI_TPL   Tpl;
+  EFI_TPL   OwnerTpl;
+  UINTN     Lock;
+} EFI_LOCK;
+
+#define EFI_PAGE_SHIFT              12
+
+/* Uefi/UefiMultiPhase.h, Uefi/UefiSpec.h */
+typedef enum {
+  EfiReservedMemoryType,
+  EfiLoaderCode,
+  EfiLoaderData,
+  EfiBootServicesCode,
+  EfiBootServicesData,
+  EfiRuntimeServicesCode,
+  EfiRuntimeServicesData,
+  EfiConventionalMemory
+} EFI_MEMORY_TYPE;
+
+typedef struct {
+  UINT32                Type;
+  EFI_PHYSICAL_ADDRESS  PhysicalStart;
+  EFI_VIRTUAL_ADDRESS   VirtualStart;
+  UINT64                NumberOfPages;
+  UINT64                Attribute;
+} EFI_MEMORY_DESCRIPTOR;
+
+#define NEXT_MEMORY_DESCRIPTOR(MemoryDescriptor, Size) \
+  ((EFI_MEMORY_DESCRIPTOR *) ((UINT8 *) (MemoryDescriptor) + (Size)))
+
+/* Library/UefiBootServicesTableLib.h, only GetMemoryMap is used */
+typedef struct {
+  EFI_STATUS (EFIAPI *GetMemoryMap) (UINTN *MemoryMapSize, EFI_MEMORY_DESCRIPTOR *MemoryMap,
+                                     UINTN *MapKey, UINTN *DescriptorSize, UINT32 *DescriptorVersion);
+} EFI_BOOT_SERVICES;
+
+extern EFI_BOOT_SERVICES *gBS;
+
+/* Library/BaseLib.h */
+#define LShiftU64(Operand, Count)           ((UINT64) (Operand) << (Count))
+#define RShiftU64(Operand, Count)           ((UINT64) (Operand) >> (Count))
+#define MultU64x32(Multiplicand, Multiplier) ((UINT64) (Multiplicand) * (UINT32) (Multiplier))
+
+/* Library/BaseMemoryLib.h, Library/MemoryAllocationLib.h */
+#define CopyMem(Destination, Source, Length)  memmove (Destination, Source, Length)
+#define ZeroMem(Buffer, Length)               memset (Buffer, 0, Length)
+VOID *AllocatePool (UINTN AllocationSize);
+VOID *AllocateZeroPool (UINTN AllocationSize);
+VOID FreePool (VOID *Buffer);
+
+#endif
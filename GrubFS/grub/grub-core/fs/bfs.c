@@ -882,6 +882,7 @@ grub_bfs_dir_iter (const char *name, grub_uint64_t value,
       return 0;
     }
 
+  grub_memset (&info, 0, sizeof (info));
   info.mtimeset = 1;
 #ifdef MODE_AFS
   info.mtime =
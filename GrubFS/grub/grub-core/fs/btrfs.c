@@ -1590,6 +1590,11 @@ grub_btrfs_dir (grub_device_t device, const char *path,
 	    {
 	      info.mtime = grub_le_to_cpu64 (inode.mtime.sec);
 	      info.mtimeset = 1;
+	      if (cdirel->type == GRUB_BTRFS_DIR_ITEM_TYPE_REGULAR)
+		{
+		  info.sizeset = 1;
+		  info.size = grub_le_to_cpu64 (inode.size);
+		}
 	    }
 	  c = cdirel->name[grub_le_to_cpu16 (cdirel->n)];
 	  cdirel->name[grub_le_to_cpu16 (cdirel->n)] = 0;
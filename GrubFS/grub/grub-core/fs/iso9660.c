@@ -864,6 +864,11 @@ grub_iso9660_dir_iter (const char *filename,
   grub_memset (&info, 0, sizeof (info));
   info.dir = ((filetype & GRUB_FSHELP_TYPE_MASK) == GRUB_FSHELP_DIR);
   info.mtimeset = !!iso9660_to_unixtime2 (&node->dirents[0].mtime, &info.mtime);
+  if ((filetype & GRUB_FSHELP_TYPE_MASK) == GRUB_FSHELP_REG)
+    {
+      info.sizeset = 1;
+      info.size = get_node_size (node);
+    }
 
   grub_free (node);
   return ctx->hook (filename, &info, ctx->hook_data);
@@ -39,8 +39,10 @@ struct grub_dirhook_info
   unsigned mtimeset:1;
   unsigned case_insensitive:1;
   unsigned inodeset:1;
+  unsigned sizeset:1;
   grub_int32_t mtime;
   grub_uint64_t inode;
+  grub_uint64_t size;
 };
 
 typedef int (*grub_fs_dir_hook_t) (const char *filename,
@@ -84,7 +84,7 @@ FreeFsInstance(EFI_FS *Instance) {
 
     if (Instance->RootFile != NULL)
     {
-        FreePool(Instance->RootFile);
+        GrubDestroyFile(Instance->RootFile);
         Instance->RootFile = NULL;
     }
 
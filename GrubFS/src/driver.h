@@ -16,6 +16,9 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifdef HOST_POSIX
+# include "grubfs_posix_base.h"
+#else
 # include <Base.h>
 # include <Uefi.h>
 
@@ -67,6 +70,7 @@
 # define EFI_FILE_SYSTEM_VOLUME_LABEL_INFO EFI_FILE_SYSTEM_VOLUME_LABEL
 # define EFI_SIGNATURE_32(a, b, c, d) SIGNATURE_32(a, b, c, d)
 # define DivU64x32(x,y,z) DivU64x32((x),(y))
+#endif
 
 #pragma once
 
@@ -118,11 +122,22 @@ extern Print_t PrintExtra;
 /* Forward declaration */
 struct _EFI_FS;
 
+/* A directory entry, as listed by the single GRUB dir() call of a directory */
+typedef struct _EFI_GRUB_DIRENT {
+	CHAR8                 *Name;
+	BOOLEAN                SizeSet;
+	EFI_FILE_INFO         *Info;
+} EFI_GRUB_DIRENT;
+
 /* A file instance */
 typedef struct _EFI_GRUB_FILE {
 	EFI_FILE               EfiFile;
 	BOOLEAN                IsDir;
 	INT64                  DirIndex;
+	BOOLEAN                DirListed;
+	INT64                  DirCount;
+	INT64                  DirAlloc;
+	EFI_GRUB_DIRENT       *DirEntries;
 	INT32                  Mtime;
 	CHAR8                 *path;
 	CHAR8                 *basename;
@@ -153,8 +168,10 @@ typedef struct _GRUB_DIRHOOK_INFO {
 	UINT32                 MtimeSet:1;
 	UINT32                 CaseInsensitive:1;
 	UINT32                 InodeSet:1;
+	UINT32                 SizeSet:1;
 	INT32                  Mtime;
 	UINT64                 Inode;
+	UINT64                 Size;
 } GRUB_DIRHOOK_INFO;
 
 typedef INT32 (*GRUB_DIRHOOK) (const CHAR8 *name,
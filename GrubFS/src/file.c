@@ -137,6 +137,7 @@ FileOpen(EFI_FILE_HANDLE This, EFI_FILE_HANDLE *New,
 		PrintInfo(L"  Reopening <ROOT>\n");
 		*New = &File->FileSystem->RootFile->EfiFile;
 		/* Must make sure that DirIndex is reset too (NB: no concurrent access!) */
+		/* The root listing snapshot lives as long as the volume: fine only because GrubFS is read-only */
 		File->FileSystem->RootFile->DirIndex = 0;
 		PrintInfo(L"  RET: %llx\n", (UINTN) *New);
 		return EFI_SUCCESS;
@@ -275,38 +276,53 @@ FileDelete(EFI_FILE_HANDLE This)
 
 /* GRUB uses a callback for each directory entry, whereas EFI uses repeated
  * firmware generated calls to FileReadDir() to get the info for each entry,
- * so we have to reconcile the twos. For now, we'll re-issue a call to GRUB
- * dir(), and run through all the entries (to find the one we
- * are interested in)  multiple times. Maybe later we'll try to optimize this
- * by building a one-off chained list of entries that we can parse...
+ * so we have to reconcile the twos. On the first read of a directory, we
+ * issue a single call to GRUB dir() and keep all the entries it reports,
+ * which FileReadDir() then returns one by one, also after a rewind.
  */
+typedef struct {
+	EFI_GRUB_FILE *File;
+	EFI_STATUS Status;
+} DIR_HOOK_DATA;
+
 static INT32
 DirHook(const CHAR8 *name, const GRUB_DIRHOOK_INFO *DirInfo, VOID *Data)
 {
 	EFI_STATUS Status;
-	EFI_FILE_INFO *Info = (EFI_FILE_INFO *) Data;
-	INT64 *Index = (INT64 *) &Info->FileSize;
-	CHAR8 *filename = (CHAR8 *) ((UINTN)Info->PhysicalSize);
+	DIR_HOOK_DATA *HookData = (DIR_HOOK_DATA *) Data;
+	EFI_GRUB_FILE *File = HookData->File;
+	EFI_GRUB_DIRENT *Entry;
+	EFI_FILE_INFO *Info;
+	CHAR16 FileName[MAX_PATH];
 	EFI_TIME Time = { 1970, 01, 01, 00, 00, 00, 0, 0, 0, 0, 0};
+	INT64 NewAlloc;
 
 	// Eliminate '.' or '..'
 	if ((name[0] ==  '.') && ((name[1] == 0) || ((name[1] == '.') && (name[2] == 0))))
 		return 0;
 
-	/* Ignore any entry that doesn't match our index */
-	if ((*Index)-- != 0)
+	Status = Utf8ToUtf16NoAlloc((CHAR8 *) name, FileName, sizeof(FileName));
+	if (EFI_ERROR(Status)) {
+		PrintStatusError(Status, L"Could not convert directory entry to UTF-8");
 		return 0;
+	}
 
-	strcpya(filename, name);
-
-	Status = Utf8ToUtf16NoAlloc(filename, Info->FileName, Info->Size - sizeof(EFI_FILE_INFO));
-	if (EFI_ERROR(Status)) {
-		if (Status != EFI_BUFFER_TOO_SMALL)
-			PrintStatusError(Status, L"Could not convert directory entry to UTF-8");
-		return Status;
+	if (File->DirCount == File->DirAlloc) {
+		NewAlloc = (File->DirAlloc == 0) ? 32 : 2 * File->DirAlloc;
+		Entry = ReallocatePool((UINTN) File->DirAlloc * sizeof(*Entry),
+				(UINTN) NewAlloc * sizeof(*Entry), File->DirEntries);
+		if (Entry == NULL)
+			goto out_of_resources;
+		File->DirEntries = Entry;
+		File->DirAlloc = NewAlloc;
 	}
+
 	/* The Info struct size already accounts for the extra NUL */
-	Info->Size = sizeof(*Info) + StrLen(Info->FileName) * sizeof(CHAR16);
+	Info = AllocateZeroPool(sizeof(*Info) + StrLen(FileName) * sizeof(CHAR16));
+	if (Info == NULL)
+		goto out_of_resources;
+	Info->Size = sizeof(*Info) + StrLen(FileName) * sizeof(CHAR16);
+	StrCpy(Info->FileName, FileName);
 
 	// Oh, and of course GRUB uses a 32 bit signed mtime value (seriously, wtf guys?!?)
 	if (DirInfo->MtimeSet)
@@ -319,92 +335,136 @@ DirHook(const CHAR8 *name, const GRUB_DIRHOOK_INFO *DirInfo, VOID *Data)
 	if (DirInfo->Dir)
 		Info->Attribute |= EFI_FILE_DIRECTORY;
 
+	/* Use the size if the GRUB driver has it, else FileReadDir() opens the file */
+	if (DirInfo->SizeSet) {
+		Info->FileSize = DirInfo->Size;
+		Info->PhysicalSize = DirInfo->Size;
+	}
+
+	Entry = &File->DirEntries[File->DirCount];
+	Entry->Name = AllocateCopyPool(strlena(name) + 1, name);
+	if (Entry->Name == NULL) {
+		FreePool(Info);
+		goto out_of_resources;
+	}
+	Entry->Info = Info;
+	Entry->SizeSet = DirInfo->Dir || DirInfo->SizeSet;
+	File->DirCount++;
+
 	return 0;
+
+out_of_resources:
+	HookData->Status = EFI_OUT_OF_RESOURCES;
+	return 1;
 }
 
 /**
- * Read directory entry
+ * Fill the size of a regular file directory entry, by opening the file
  *
- * @v file			EFI file
- * @v Len			Length to read
- * @v Data			Data buffer
- * @ret Status		EFI status code
+ * @v File			EFI directory
+ * @v Entry			Directory entry
  */
-static EFI_STATUS
-FileReadDir(EFI_GRUB_FILE *File, UINTN *Len, VOID *Data)
+static VOID
+DirEntrySize(EFI_GRUB_FILE *File, EFI_GRUB_DIRENT *Entry)
 {
-	EFI_FILE_INFO *Info = (EFI_FILE_INFO *) Data;
 	EFI_STATUS Status;
-	/* We temporarily repurpose the FileSize as a *signed* entry index */
-	INT64 *Index = (INT64 *) &Info->FileSize;
-	/* And PhysicalSize as a pointer to our filename */
-	CHAR8 **basename = (CHAR8 **) &Info->PhysicalSize;
 	CHAR8 path[MAX_PATH];
 	EFI_GRUB_FILE *TmpFile = NULL;
 	INTN len;
 
-	/* Unless we can fit our maximum size, forget it */
-	if (*Len < MINIMUM_INFO_LENGTH) {
-		*Len = MINIMUM_INFO_LENGTH;
-		return EFI_BUFFER_TOO_SMALL;
-	}
+	/* Only try once, failures are not fatal */
+	Entry->SizeSet = TRUE;
 
-	/* Populate our Info template */
-	ZeroMem(Data, *Len);
-	Info->Size = *Len;
-	*Index = File->DirIndex;
 	strcpya(path, File->path);
 	len = strlena(path);
 	if (path[len-1] != '/')
 		path[len++] = '/';
-	*basename = &path[len];
+	if (len + strlena(Entry->Name) >= MAX_PATH) {
+		PrintError(L"Path of '%s' is too long to obtain its size\n", Entry->Info->FileName);
+		return;
+	}
+	strcpya(&path[len], Entry->Name);
 
-	/* Invoke GRUB's directory listing */
-	Status = GrubDir(File, File->path, DirHook, Data);
-	if (*Index >= 0) {
-		/* No more entries */
-		*Len = 0;
-		return EFI_SUCCESS;
+	/* Open the file and read its size */
+	Status = GrubCreateFile(&TmpFile, File->FileSystem);
+	if (EFI_ERROR(Status)) {
+		PrintStatusError(Status, L"Unable to create temporary file");
+		return;
 	}
+	TmpFile->path = path;
 
+	Status = GrubOpen(TmpFile);
 	if (EFI_ERROR(Status)) {
-		PrintStatusError(Status, L"Directory listing failed");
-		return Status;
+		// TODO: EFI_NO_MAPPING is returned for links...
+		PrintStatusError(Status, L"Unable to obtain the size of '%s'", Entry->Info->FileName);
+		/* Non fatal error */
+	} else {
+		Entry->Info->FileSize = GrubGetFileSize(TmpFile);
+		Entry->Info->PhysicalSize = GrubGetFileSize(TmpFile);
+		GrubClose(TmpFile);
 	}
+	GrubDestroyFile(TmpFile);
+}
+
+/**
+ * Read directory entry
+ *
+ * @v file			EFI file
+ * @v Len			Length to read
+ * @v Data			Data buffer
+ * @ret Status		EFI status code
+ */
+static EFI_STATUS
+FileReadDir(EFI_GRUB_FILE *File, UINTN *Len, VOID *Data)
+{
+	EFI_STATUS Status;
+	EFI_GRUB_DIRENT *Entry;
+	DIR_HOOK_DATA HookData = { File, EFI_SUCCESS };
+	INT64 i;
 
-	/* Our Index/FileSize must be reset */
-	Info->FileSize = 0;
-	Info->PhysicalSize = 0;
+	/* Unless we can fit our maximum size, forget it */
+	if (*Len < MINIMUM_INFO_LENGTH) {
+		*Len = MINIMUM_INFO_LENGTH;
+		return EFI_BUFFER_TOO_SMALL;
+	}
 
-	/* For regular files, we still need to fill the size */
-	if (!(Info->Attribute & EFI_FILE_DIRECTORY)) {
-		/* Open the file and read its size */
-		Status = GrubCreateFile(&TmpFile, File->FileSystem);
+	/* Invoke GRUB's directory listing, once per directory */
+	if (!File->DirListed) {
+		Status = GrubDir(File, File->path, DirHook, (VOID *) &HookData);
+		if (!EFI_ERROR(Status))
+			Status = HookData.Status;
 		if (EFI_ERROR(Status)) {
-			PrintStatusError(Status, L"Unable to create temporary file");
+			PrintStatusError(Status, L"Directory listing failed");
+			/* Drop any partial listing, so that we can retry */
+			for (i = 0; i < File->DirCount; i++) {
+				FreePool(File->DirEntries[i].Name);
+				FreePool(File->DirEntries[i].Info);
+			}
+			File->DirCount = 0;
 			return Status;
 		}
-		TmpFile->path = path;
+		File->DirListed = TRUE;
+	}
 
-		Status = GrubOpen(TmpFile);
-		if (EFI_ERROR(Status)) {
-			// TODO: EFI_NO_MAPPING is returned for links...
-			PrintStatusError(Status, L"Unable to obtain the size of '%s'", Info->FileName);
-			/* Non fatal error */
-		} else {
-			Info->FileSize = GrubGetFileSize(TmpFile);
-			Info->PhysicalSize = GrubGetFileSize(TmpFile);
-			GrubClose(TmpFile);
-		}
-		GrubDestroyFile(TmpFile);
+	if (File->DirIndex >= File->DirCount) {
+		/* No more entries */
+		*Len = 0;
+		return EFI_SUCCESS;
 	}
 
-	*Len = (UINTN) Info->Size;
+	/* For regular files, we may still need to fill the size */
+	Entry = &File->DirEntries[File->DirIndex];
+	if (!Entry->SizeSet)
+		DirEntrySize(File, Entry);
+
+	ZeroMem(Data, *Len);
+	CopyMem(Data, Entry->Info, (UINTN) Entry->Info->Size);
+	*Len = (UINTN) Entry->Info->Size;
 	/* Advance to the next entry */
 	File->DirIndex++;
 
-//	PrintInfo(L"  Entry[%d]: '%s' %s\n", File->DirIndex-1, Info->FileName,
-//			(Info->Attribute&EFI_FILE_DIRECTORY)?L"<DIR>":L"");
+//	PrintInfo(L"  Entry[%d]: '%s' %s\n", File->DirIndex-1, Entry->Info->FileName,
+//			(Entry->Info->Attribute&EFI_FILE_DIRECTORY)?L"<DIR>":L"");
 
 	return EFI_SUCCESS;
 }
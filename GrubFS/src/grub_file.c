@@ -331,6 +331,15 @@ GrubCreateFile(EFI_GRUB_FILE **File, EFI_FS *FileSystem)
 VOID
 GrubDestroyFile(EFI_GRUB_FILE *File)
 {
+	INT64 i;
+
+	for (i = 0; i < File->DirCount; i++) {
+		FreePool(File->DirEntries[i].Name);
+		FreePool(File->DirEntries[i].Info);
+	}
+	if (File->DirEntries != NULL)
+		FreePool(File->DirEntries);
+
     if (File->GrubFile != NULL)
     {
         FreePool(File->GrubFile);
@@ -0,0 +1,246 @@
+/**
+ * \file grubfs_posix_base.h
+ * Base definitions for building the EFI side of GrubFS (file.c, path.c,
+ * utf8.c) in the POSIX user space environment.
+ *
+ * Only the parts of the EDK2 headers these files use are here. The GRUB
+ * side and the logging are in the test.
+ */
+
+#ifndef _GRUBFS_POSIX_BASE_H_
+#define _GRUBFS_POSIX_BASE_H_
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IN
+#define OUT
+#define OPTIONAL
+#define CONST       const
+#define EFIAPI
+#define ASSERT(Expression)  assert (Expression)
+
+typedef uint8_t     BOOLEAN;
+typedef int8_t      INT8;
+typedef uint8_t     UINT8;
+typedef int16_t     INT16;
+typedef uint16_t    UINT16;
+typedef int32_t     INT32;
+typedef uint32_t    UINT32;
+typedef int64_t     INT64;
+typedef uint64_t    UINT64;
+typedef intptr_t    INTN;
+typedef uintptr_t   UINTN;
+typedef char        CHAR8;
+typedef uint16_t    CHAR16;
+typedef void        VOID;
+
+#define TRUE        1
+#define FALSE       0
+
+typedef UINTN       EFI_STATUS;
+typedef VOID        *EFI_HANDLE;
+typedef VOID        *EFI_EVENT;
+typedef UINT64      EFI_LBA;
+
+typedef struct {
+  UINT32  Data1;
+  UINT16  Data2;
+  UINT16  Data3;
+  UINT8   Data4[8];
+} EFI_GUID;
+
+typedef struct {
+  UINT16  Year;
+  UINT8   Month;
+  UINT8   Day;
+  UINT8   Hour;
+  UINT8   Minute;
+  UINT8   Second;
+  UINT8   Pad1;
+  UINT32  Nanosecond;
+  INT16   TimeZone;
+  UINT8   Daylight;
+  UINT8   Pad2;
+} EFI_TIME;
+
+#define ENCODE_ERROR(a)             ((EFI_STATUS) ((UINTN) 1 << (sizeof (UINTN) * 8 - 1) | (a)))
+#define ENCODE_WARNING(a)           ((EFI_STATUS) (a))
+#define EFI_ERROR(a)                ((INTN) (EFI_STATUS) (a) < 0)
+
+#define EFI_SUCCESS                 0
+#define EFI_INVALID_PARAMETER       ENCODE_ERROR (2)
+#define EFI_UNSUPPORTED             ENCODE_ERROR (3)
+#define EFI_BUFFER_TOO_SMALL        ENCODE_ERROR (5)
+#define EFI_DEVICE_ERROR            ENCODE_ERROR (7)
+#define EFI_WRITE_PROTECTED         ENCODE_ERROR (8)
+#define EFI_OUT_OF_RESOURCES        ENCODE_ERROR (9)
+#define EFI_NOT_FOUND               ENCODE_ERROR (14)
+#define EFI_NO_MAPPING              ENCODE_ERROR (17)
+#define EFI_WARN_DELETE_FAILURE     ENCODE_WARNING (2)
+
+#define BASE_CR(Record, TYPE, Field)  ((TYPE *) ((CHAR8 *) (Record) - offsetof (TYPE, Field)))
+
+/* Guid/FileInfo.h, Guid/FileSystemInfo.h */
+typedef struct {
+  UINT64    Size;
+  UINT64    FileSize;
+  UINT64    PhysicalSize;
+  EFI_TIME  CreateTime;
+  EFI_TIME  LastAccessTime;
+  EFI_TIME  ModificationTime;
+  UINT64    Attribute;
+  CHAR16    FileName[1];
+} EFI_FILE_INFO;
+
+typedef struct {
+  UINT64    Size;
+  BOOLEAN   ReadOnly;
+  UINT64    VolumeSize;
+  UINT64    FreeSpace;
+  UINT32    BlockSize;
+  CHAR16    VolumeLabel[1];
+} EFI_FILE_SYSTEM_INFO;
+
+extern EFI_GUID gEfiFileInfoGuid;
+extern EFI_GUID gEfiFileSystemInfoGuid;
+extern EFI_GUID gEfiSimpleFileSystemProtocolGuid;
+
+/* Protocol/SimpleFileSystem.h */
+#define EFI_FILE_MODE_READ          0x0000000000000001ULL
+#define EFI_FILE_READ_ONLY          0x0000000000000001ULL
+#define EFI_FILE_DIRECTORY          0x0000000000000010ULL
+
+typedef struct {
+  EFI_EVENT   Event;
+  EFI_STATUS  Status;
+  UINTN       BufferSize;
+  VOID        *Buffer;
+} EFI_FILE_IO_TOKEN;
+
+typedef struct _EFI_FILE_PROTOCOL EFI_FILE_PROTOCOL, EFI_FILE, *EFI_FILE_HANDLE;
+struct _EFI_FILE_PROTOCOL {
+  UINT64      Revision;
+  EFI_STATUS  (EFIAPI *Open) (EFI_FILE_PROTOCOL *This, EFI_FILE_PROTOCOL **NewHandle, CHAR16 *FileName, UINT64 OpenMode, UINT64 Attributes);
+  EFI_STATUS  (EFIAPI *Close) (EFI_FILE_PROTOCOL *This);
+  EFI_STATUS  (EFIAPI *Delete) (EFI_FILE_PROTOCOL *This);
+  EFI_STATUS  (EFIAPI *Read) (EFI_FILE_PROTOCOL *This, UINTN *BufferSize, VOID *Buffer);
+  EFI_STATUS  (EFIAPI *Write) (EFI_FILE_PROTOCOL *This, UINTN *BufferSize, VOID *Buffer);
+  EFI_STATUS  (EFIAPI *GetPosition) (EFI_FILE_PROTOCOL *This, UINT64 *Position);
+  EFI_STATUS  (EFIAPI *SetPosition) (EFI_FILE_PROTOCOL *This, UINT64 Position);
+  EFI_STATUS  (EFIAPI *GetInfo) (EFI_FILE_PROTOCOL *This, EFI_GUID *InformationType, UINTN *BufferSize, VOID *Buffer);
+  EFI_STATUS  (EFIAPI *SetInfo) (EFI_FILE_PROTOCOL *This, EFI_GUID *InformationType, UINTN BufferSize, VOID *Buffer);
+  EFI_STATUS  (EFIAPI *Flush) (EFI_FILE_PROTOCOL *This);
+  EFI_STATUS  (EFIAPI *OpenEx) (EFI_FILE_PROTOCOL *This, EFI_FILE_PROTOCOL **NewHandle, CHAR16 *FileName, UINT64 OpenMode, UINT64 Attributes, EFI_FILE_IO_TOKEN *Token);
+  EFI_STATUS  (EFIAPI *ReadEx) (EFI_FILE_PROTOCOL *This, EFI_FILE_IO_TOKEN *Token);
+  EFI_STATUS  (EFIAPI *WriteEx) (EFI_FILE_PROTOCOL *This, EFI_FILE_IO_TOKEN *Token);
+  EFI_STATUS  (EFIAPI *FlushEx) (EFI_FILE_PROTOCOL *This, EFI_FILE_IO_TOKEN *Token);
+};
+
+#define EFI_FILE_PROTOCOL_REVISION  0x00020000
+
+typedef struct _EFI_SIMPLE_FILE_SYSTEM_PROTOCOL EFI_SIMPLE_FILE_SYSTEM_PROTOCOL;
+struct _EFI_SIMPLE_FILE_SYSTEM_PROTOCOL {
+  UINT64      Revision;
+  EFI_STATUS  (EFIAPI *OpenVolume) (EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *This, EFI_FILE_PROTOCOL **Root);
+};
+
+#define EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_REVISION  0x00010000
+
+/* Protocol/BlockIo.h, BlockIo2.h, DiskIo.h, DiskIo2.h, only what EFI_FS holds */
+typedef struct {
+  UINT32    MediaId;
+  BOOLEAN   RemovableMedia;
+  BOOLEAN   MediaPresent;
+  BOOLEAN   LogicalPartition;
+  BOOLEAN   ReadOnly;
+  BOOLEAN   WriteCaching;
+  UINT32    BlockSize;
+  UINT32    IoAlign;
+  EFI_LBA   LastBlock;
+} EFI_BLOCK_IO_MEDIA;
+
+typedef struct {
+  UINT64              Revision;
+  EFI_BLOCK_IO_MEDIA  *Media;
+} EFI_BLOCK_IO_PROTOCOL, EFI_BLOCK_IO2_PROTOCOL;
+
+typedef struct {
+  EFI_EVENT   Event;
+  EFI_STATUS  TransactionStatus;
+} EFI_BLOCK_IO2_TOKEN, EFI_DISK_IO2_TOKEN;
+
+typedef struct {
+  UINT64      Revision;
+} EFI_DISK_IO_PROTOCOL, EFI_DISK_IO2_PROTOCOL;
+
+/* Library/UefiBootServicesTableLib.h, only what file.c calls */
+typedef struct {
+  EFI_STATUS  (EFIAPI *InstallMultipleProtocolInterfaces) (EFI_HANDLE *Handle, ...);
+  EFI_STATUS  (EFIAPI *UninstallMultipleProtocolInterfaces) (EFI_HANDLE Handle, ...);
+} EFI_BOOT_SERVICES;
+
+extern EFI_BOOT_SERVICES    *gBS;
+
+/* Library/BaseLib.h */
+typedef struct _LIST_ENTRY LIST_ENTRY;
+struct _LIST_ENTRY {
+  LIST_ENTRY  *ForwardLink;
+  LIST_ENTRY  *BackLink;
+};
+
+static inline UINTN StrLen (CONST CHAR16 *String)
+{
+  UINTN Length;
+
+  for (Length = 0; String[Length] != 0; Length++);
+  return Length;
+}
+
+static inline CHAR16 *StrCpy (CHAR16 *Destination, CONST CHAR16 *Source)
+{
+  return memcpy (Destination, Source, (StrLen (Source) + 1) * sizeof (CHAR16));
+}
+
+static inline INTN StrCmp (CONST CHAR16 *FirstString, CONST CHAR16 *SecondString)
+{
+  while (*FirstString != 0 && *FirstString == *SecondString) {
+    FirstString++;
+    SecondString++;
+  }
+  return *FirstString - *SecondString;
+}
+
+/* Library/BaseMemoryLib.h, Library/MemoryAllocationLib.h */
+#define CopyMem(Destination, Source, Length)  memmove (Destination, Source, Length)
+#define ZeroMem(Buffer, Length)               memset (Buffer, 0, Length)
+#define CompareMem(Buffer1, Buffer2, Length)  memcmp (Buffer1, Buffer2, Length)
+#define AllocatePool(AllocationSize)          malloc (AllocationSize)
+#define AllocateZeroPool(AllocationSize)      calloc (1, AllocationSize)
+#define FreePool(Buffer)                      free (Buffer)
+
+static inline VOID *AllocateCopyPool (UINTN AllocationSize, CONST VOID *Buffer)
+{
+  VOID *Memory = malloc (AllocationSize);
+
+  if (Memory != NULL)
+    memcpy (Memory, Buffer, AllocationSize);
+  return Memory;
+}
+
+static inline VOID *ReallocatePool (UINTN OldSize, UINTN NewSize, VOID *OldBuffer)
+{
+  return realloc (OldBuffer, NewSize);
+}
+
+/* the aliases driver.h makes for the EDK2 build */
+#define strlena                     strlen
+#define strcmpa                     strcmp
+#define BS                          gBS
+#define EFI_FILE_HANDLE_REVISION    EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_REVISION
+
+#endif
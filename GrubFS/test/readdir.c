@@ -0,0 +1,399 @@
+/**
+ * \file readdir.c
+ * Test of the directory reads of GrubFS in the POSIX user space
+ * environment.
+ *
+ * file.c, path.c and utf8.c are built with HOST_POSIX on top of a fake
+ * GRUB volume: a table of dirs and files GrubDir() reports, with or
+ * without size and mtime, like the GRUB drivers do. Directories are read
+ * through EFI_FILE_PROTOCOL twice, with a rewind in between; every entry
+ * must be listed once with its attributes, size and time. A handle must
+ * call dir() once for its listing, and open only the files GRUB did not
+ * give a size for, once each. A listing that fails in the middle must
+ * work when it is read again.
+ */
+
+#include <stdio.h>
+
+#include "driver.h"
+
+#define BIG_ENTRIES 1000
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: failed: %s\n", __FILE__, __LINE__, #cond); failures++; return; } } while (0)
+
+EFI_GUID gEfiFileInfoGuid                   = { 1 };
+EFI_GUID gEfiFileSystemInfoGuid             = { 2 };
+EFI_GUID gEfiSimpleFileSystemProtocolGuid   = { 3 };
+
+static EFI_STATUS EFIAPI install_protocols (EFI_HANDLE *Handle, ...)
+{
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI uninstall_protocols (EFI_HANDLE Handle, ...)
+{
+    return EFI_SUCCESS;
+}
+
+static EFI_BOOT_SERVICES boot_services = { install_protocols, uninstall_protocols };
+EFI_BOOT_SERVICES *gBS = &boot_services;
+
+/* logging.c */
+static UINTN print_none (IN CHAR16 *fmt, ...)
+{
+    return 0;
+}
+
+Print_t PrintError = print_none;
+Print_t PrintWarning = print_none;
+Print_t PrintInfo = print_none;
+Print_t PrintDebug = print_none;
+Print_t PrintExtra = print_none;
+
+VOID PrintStatusError (EFI_STATUS Status, const CHAR16 *Format, ...)
+{
+}
+
+/* missing.c, grub.c */
+VOID strcpya (CHAR8 *dst, CONST CHAR8 *src)
+{
+    strcpy(dst, src);
+}
+
+CHAR8 *strchra (const CHAR8 *s, INTN c)
+{
+    return strchr(s, (int)c);
+}
+
+CHAR8 *strrchra (const CHAR8 *s, INTN c)
+{
+    return strrchr(s, (int)c);
+}
+
+VOID GrubTimeToEfiTime (const INT32 t, EFI_TIME *tp)
+{
+    memset(tp, 0, sizeof(*tp));
+    tp->Year = (UINT16)(2000 + t % 50);
+    tp->Month = 1;
+    tp->Day = 1;
+}
+
+/*
+ * The fake GRUB volume
+ */
+typedef struct {
+    char parent[64];
+    char name[32];
+    int dir;
+    int size_set;
+    UINT64 size;
+    int mtime_set;
+    INT32 mtime;
+} FAKE_ENTRY;
+
+typedef struct {
+    FAKE_ENTRY *entry;
+    UINT64 offset;
+} FAKE_FILE;
+
+static FAKE_ENTRY entries[BIG_ENTRIES + 64];
+static int entry_count;
+
+static int list_calls;      // dir() calls of listings
+static int info_calls;      // dir() calls of FileOpen
+static int opens;
+static const char *fail_path;   // dir() of it fails once, after half of the entries
+
+static void add_entry (const char *parent, const char *name, int dir)
+{
+    FAKE_ENTRY *e = &entries[entry_count++];
+
+    snprintf(e->parent, sizeof(e->parent), "%s", parent);
+    snprintf(e->name, sizeof(e->name), "%s", name);
+    e->dir = dir;
+    e->size = dir ? 0 : (UINT64)(rand() % 100000);
+    e->size_set = !dir && rand() % 3 != 0;
+    e->mtime_set = rand() % 4 != 0;
+    e->mtime = rand();
+}
+
+static FAKE_ENTRY *find_entry (const char *path)
+{
+    char parent[MAX_PATH];
+    const char *name;
+    int i;
+
+    name = strrchr(path, '/');
+    if (name == NULL)
+        return NULL;
+    snprintf(parent, sizeof(parent), "%.*s", (int)(name == path ? 1 : name - path), path);
+    for (i = 0; i < entry_count; i++) {
+        if (strcmp(entries[i].parent, parent) == 0 && strcmp(entries[i].name, name + 1) == 0)
+            return &entries[i];
+    }
+    return NULL;
+}
+
+BOOLEAN GrubFSProbe (EFI_FS *This)
+{
+    return TRUE;
+}
+
+EFI_STATUS GrubDir (EFI_GRUB_FILE *File, const CHAR8 *path, GRUB_DIRHOOK Hook, VOID *HookData)
+{
+    GRUB_DIRHOOK_INFO info;
+    FAKE_ENTRY *e;
+    int i, count = 0, reported = 0;
+
+    if (strcmp(path, "/") != 0 && ((e = find_entry(path)) == NULL || !e->dir))
+        return EFI_NOT_FOUND;
+    if (HookData == (VOID *)File)
+        info_calls++;
+    else
+        list_calls++;
+    for (i = 0; i < entry_count; i++)
+        count += strcmp(entries[i].parent, path) == 0;
+
+    memset(&info, 0, sizeof(info));
+    info.Dir = 1;
+    if (Hook(".", &info, HookData) || Hook("..", &info, HookData))
+        return EFI_SUCCESS;
+    for (i = 0; i < entry_count; i++) {
+        e = &entries[i];
+        if (strcmp(e->parent, path) != 0)
+            continue;
+        if (fail_path != NULL && strcmp(fail_path, path) == 0 && reported == count / 2) {
+            fail_path = NULL;
+            return EFI_DEVICE_ERROR;
+        }
+        memset(&info, 0, sizeof(info));
+        info.Dir = e->dir;
+        info.MtimeSet = e->mtime_set;
+        info.Mtime = e->mtime;
+        info.SizeSet = e->size_set;
+        info.Size = e->size_set ? e->size : 0;
+        reported++;
+        if (Hook(e->name, &info, HookData))
+            break;
+    }
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS GrubCreateFile (EFI_GRUB_FILE **File, EFI_FS *FileSystem)
+{
+    EFI_GRUB_FILE *NewFile = calloc(1, sizeof(*NewFile));
+
+    NewFile->GrubFile = calloc(1, sizeof(FAKE_FILE));
+    NewFile->FileSystem = FileSystem;
+    if (FileSystem->RootFile != NULL)
+        memcpy(&NewFile->EfiFile, &FileSystem->RootFile->EfiFile, sizeof(EFI_FILE));
+    *File = NewFile;
+    return EFI_SUCCESS;
+}
+
+/* as in grub_file.c, it releases the listing of the handle */
+VOID GrubDestroyFile (EFI_GRUB_FILE *File)
+{
+    INT64 i;
+
+    for (i = 0; i < File->DirCount; i++) {
+        free(File->DirEntries[i].Name);
+        free(File->DirEntries[i].Info);
+    }
+    free(File->DirEntries);
+    free(File->GrubFile);
+    free(File);
+}
+
+EFI_STATUS GrubOpen (EFI_GRUB_FILE *File)
+{
+    FAKE_FILE *f = File->GrubFile;
+
+    opens++;
+    f->entry = find_entry(File->path);
+    if (f->entry == NULL || f->entry->dir)
+        return EFI_NOT_FOUND;
+    f->offset = 0;
+    return EFI_SUCCESS;
+}
+
+VOID GrubClose (EFI_GRUB_FILE *File)
+{
+}
+
+EFI_STATUS GrubRead (EFI_GRUB_FILE *File, VOID *Data, UINTN *Len)
+{
+    *Len = 0;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS GrubLabel (EFI_GRUB_FILE *File, CHAR8 **label)
+{
+    *label = "fake";
+    return EFI_SUCCESS;
+}
+
+UINT64 GrubGetFileSize (EFI_GRUB_FILE *File)
+{
+    return ((FAKE_FILE *)File->GrubFile)->entry->size;
+}
+
+UINT64 GrubGetFileOffset (EFI_GRUB_FILE *File)
+{
+    return ((FAKE_FILE *)File->GrubFile)->offset;
+}
+
+VOID GrubSetFileOffset (EFI_GRUB_FILE *File, UINT64 Offset)
+{
+    ((FAKE_FILE *)File->GrubFile)->offset = Offset;
+}
+
+/*
+ * The tests
+ */
+static CHAR16 *wide (const char *s)
+{
+    static CHAR16 buffer[MAX_PATH];
+    int i;
+
+    for (i = 0; s[i] != 0; i++)
+        buffer[i] = s[i] == '/' ? L'\\' : (unsigned char)s[i];
+    buffer[i] = 0;
+    return buffer;
+}
+
+/* UTF-16 of name, the names here have 1 and 2 byte UTF-8 chars only */
+static CHAR16 *name16 (const char *name)
+{
+    static CHAR16 buffer[MAX_PATH];
+    const unsigned char *p = (const unsigned char *)name;
+    int i;
+
+    for (i = 0; *p != 0; i++) {
+        if (*p < 0x80) {
+            buffer[i] = *p++;
+        } else {
+            buffer[i] = (CHAR16)(((p[0] & 0x1F) << 6) | (p[1] & 0x3F));
+            p += 2;
+        }
+    }
+    buffer[i] = 0;
+    return buffer;
+}
+
+/* reads the listing of Dir twice and checks it against the entries of path, listed tells Dir was read before */
+static void check_listing (EFI_FILE_PROTOCOL *Dir, const char *path, int listed)
+{
+    UINT8 buffer[MINIMUM_INFO_LENGTH];
+    EFI_FILE_INFO *info = (EFI_FILE_INFO *)buffer;
+    FAKE_ENTRY *e;
+    UINT64 position;
+    UINTN size;
+    int pass, i, files_without_size = 0, opens_before = opens, calls_before = list_calls;
+
+    for (i = 0; i < entry_count; i++)
+        files_without_size += strcmp(entries[i].parent, path) == 0 && !entries[i].dir && !entries[i].size_set;
+
+    for (pass = 0; pass < 2; pass++) {
+        CHECK(Dir->SetPosition(Dir, 0) == EFI_SUCCESS);
+
+        /* too small a buffer does not lose the entry */
+        size = 10;
+        CHECK(Dir->Read(Dir, &size, buffer) == EFI_BUFFER_TOO_SMALL);
+        CHECK(size == MINIMUM_INFO_LENGTH);
+
+        for (i = 0; i < entry_count; i++) {
+            e = &entries[i];
+            if (strcmp(e->parent, path) != 0)
+                continue;
+            size = sizeof(buffer);
+            CHECK(Dir->Read(Dir, &size, buffer) == EFI_SUCCESS);
+            CHECK(size == info->Size);
+            CHECK(size == sizeof(EFI_FILE_INFO) + StrLen(info->FileName) * sizeof(CHAR16));
+            CHECK(StrCmp(info->FileName, name16(e->name)) == 0);
+            CHECK(!!(info->Attribute & EFI_FILE_DIRECTORY) == e->dir);
+            CHECK(info->Attribute & EFI_FILE_READ_ONLY);
+            CHECK(info->FileSize == e->size);
+            CHECK(info->PhysicalSize == e->size);
+            CHECK(info->ModificationTime.Year == (e->mtime_set ? 2000 + e->mtime % 50 : 1970));
+        }
+        size = sizeof(buffer);
+        CHECK(Dir->Read(Dir, &size, buffer) == EFI_SUCCESS);
+        CHECK(size == 0);
+        CHECK(Dir->GetPosition(Dir, &position) == EFI_SUCCESS);
+    }
+    CHECK(list_calls - calls_before == (listed ? 0 : 1));
+    CHECK(opens - opens_before == (listed ? 0 : files_without_size));
+}
+
+static void test_volume (void)
+{
+    static EFI_FS fs;
+    EFI_FILE_PROTOCOL *root, *dir, *again;
+    UINT8 buffer[MINIMUM_INFO_LENGTH];
+    UINTN size;
+
+    CHECK(FSInstall(&fs, NULL) == EFI_SUCCESS);
+    CHECK(FileOpenVolume(&fs.FileIoInterface, &root) == EFI_SUCCESS);
+
+    check_listing(root, "/", 0);
+
+    /* 1000 entries, dir() once for both passes */
+    CHECK(root->Open(root, &dir, wide("big"), EFI_FILE_MODE_READ, 0) == EFI_SUCCESS);
+    check_listing(dir, "/big", 0);
+    CHECK(dir->Close(dir) == EFI_SUCCESS);
+
+    /* a listing that failed is read again from the start */
+    CHECK(root->Open(root, &dir, wide("/small"), EFI_FILE_MODE_READ, 0) == EFI_SUCCESS);
+    fail_path = "/small";
+    size = sizeof(buffer);
+    CHECK(dir->Read(dir, &size, buffer) == EFI_DEVICE_ERROR);
+    check_listing(dir, "/small", 0);
+    CHECK(dir->Open(dir, &again, wide("empty"), EFI_FILE_MODE_READ, 0) == EFI_SUCCESS);
+    check_listing(again, "/small/empty", 0);
+    CHECK(again->Close(again) == EFI_SUCCESS);
+    CHECK(dir->Close(dir) == EFI_SUCCESS);
+
+    /* the root keeps its listing, reopening it starts from the first entry */
+    CHECK(root->Open(root, &again, wide("/"), EFI_FILE_MODE_READ, 0) == EFI_SUCCESS);
+    CHECK(again == root);
+    check_listing(root, "/", 1);
+
+    GrubDestroyFile(fs.RootFile);
+}
+
+int main (void)
+{
+    char name[32];
+    int i;
+
+    srand(1);
+    for (i = 0; i < 20; i++) {
+        snprintf(name, sizeof(name), i % 4 == 0 ? "dir%d" : "file%d.efi", i);
+        add_entry("/", name, i % 4 == 0);
+    }
+    add_entry("/", "caf\xc3\xa9", 0);
+    add_entry("/", "big", 1);
+    add_entry("/", "small", 1);
+    for (i = 0; i < BIG_ENTRIES; i++) {
+        snprintf(name, sizeof(name), "f%d", i);
+        add_entry("/big", name, i % 10 == 0);
+    }
+    for (i = 0; i < 9; i++) {
+        snprintf(name, sizeof(name), "s%d", i);
+        add_entry("/small", name, 0);
+    }
+    add_entry("/small", "empty", 1);
+
+    test_volume();
+    printf("dir() calls: %d for listings, %d for opens; %d files opened for their size\n", list_calls, info_calls, opens);
+
+    if (failures != 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("all passed\n");
+    return 0;
+}
@@ -13,6 +13,13 @@
 #define MEM_LOG_MAX_SIZE        (2 * 1024 * 1024)
 #define MEM_LOG_MAX_LINE_SIZE   1024
 
+//
+// Boot phase spans
+//
+#define MEM_LOG_MAX_SPANS       32
+#define MEM_LOG_SPAN_NAME_SIZE  32
+#define MEM_LOG_SPAN_SUMMARY_SIZE ((MEM_LOG_MAX_SPANS + 2) * 64)
+
 
 /** Callback that can be installed to be called when some message is printed with MemLog() or MemLogVA(). **/
 typedef VOID (EFIAPI *MEM_LOG_CALLBACK) (IN INTN DebugMode, IN CHAR8 *LastMessage);
@@ -96,4 +103,47 @@ EFIAPI
 GetMemLogTscTicksPerSecond (VOID);
 
 
+/**
+  Starts timing of boot phase Name. Spans are shared by all modules using MemLog.
+ **/
+VOID
+EFIAPI
+MemLogSpanBegin (
+  IN  CONST CHAR8   *Name
+  );
+
+
+/**
+  Stops timing of boot phase Name and adds the time to its total.
+ **/
+VOID
+EFIAPI
+MemLogSpanEnd (
+  IN  CONST CHAR8   *Name
+  );
+
+
+/**
+  Returns time of all finished runs of boot phase Name in milliseconds.
+ **/
+UINT64
+EFIAPI
+GetMemLogSpanMs (
+  IN  CONST CHAR8   *Name
+  );
+
+
+/**
+  Prints table with totals of all boot phase spans into Buffer.
+  
+  @return Number of chars written, without the terminating null.
+ **/
+UINTN
+EFIAPI
+MemLogSpanSummary (
+  OUT CHAR8         *Buffer,
+  IN  UINTN         BufferSize
+  );
+
+
 #endif // __MEMLOG_LIB_H__
@@ -0,0 +1,62 @@
+/** @file
+
+Module Name:
+
+  EmuVariableImport.h
+
+  Protocol for importing a batch of variables into EmuVariableUefi store
+  with a single store rebuild (used for nvram.plist on CloverEFI).
+
+**/
+
+#ifndef __EmuVariableImport_H__
+#define __EmuVariableImport_H__
+
+typedef struct _EMU_VARIABLE_IMPORT_PROTOCOL EMU_VARIABLE_IMPORT_PROTOCOL;
+
+/**
+ * One variable to import.
+ */
+typedef struct {
+    CHAR16      *Name;
+    EFI_GUID    *Guid;
+    UINT32      Attributes;
+    UINTN       DataSize;
+    VOID        *Data;
+} EMU_VARIABLE_IMPORT_ENTRY;
+
+/**
+ * EMU_VARIABLE_IMPORT_PROTOCOL.ImportVariables() type definition
+ *
+ * Sets all given variables as if SetVariable() was called for each of them in order,
+ * but existing copies are dropped and the store is compacted only once.
+ * Returns EFI_NOT_READY if emulation is not installed; nothing is imported then.
+ */
+typedef EFI_STATUS (EFIAPI * EMU_VARIABLE_IMPORT_VARIABLES) (
+    IN  EMU_VARIABLE_IMPORT_PROTOCOL      *This,
+    IN  UINTN                             Count,
+    IN  EMU_VARIABLE_IMPORT_ENTRY         *Entries
+);
+
+
+/**
+ * EMU_VARIABLE_IMPORT_PROTOCOL
+ */
+struct _EMU_VARIABLE_IMPORT_PROTOCOL {
+    ///
+    /// Imports a batch of variables into the emulated store.
+    ///
+	EMU_VARIABLE_IMPORT_VARIABLES		ImportVariables;
+};
+
+
+#define EMU_VARIABLE_IMPORT_PROTOCOL_GUID \
+  { \
+    0x2e3cbb27, 0x60b0, 0x47c0, {0xaa, 0xb7, 0xed, 0xa0, 0x39, 0x42, 0x75, 0x0e } \
+  }
+
+/** EMU_VARIABLE_IMPORT_PROTOCOL GUID */
+extern EFI_GUID gEmuVariableImportProtocolGuid;
+
+
+#endif
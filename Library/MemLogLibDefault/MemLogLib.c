@@ -8,12 +8,26 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
 #include <Library/MemLogLib.h>
 #include <Library/DebugLib.h>
 
 #include <Library/IoLib.h>
 #include <Library/PciLib.h>
 #include "GenericIch.h"
+#include "TscCalibration.h"
+
+//
+// Struct for timing a named boot phase.
+//
+typedef struct {
+  CHAR8             Name[MEM_LOG_SPAN_NAME_SIZE];
+  /// TSC at last MemLogSpanBegin(), 0 when span is not running.
+  UINT64            TscBegin;
+  /// Sum of TSC ticks of all finished runs.
+  UINT64            TscTotal;
+  UINT32            Count;
+} MEM_LOG_SPAN;
 
 //
 // Struct for holding mem buffer.
@@ -32,17 +46,38 @@ typedef struct {
   UINT64            TscFreqSec;
 } MEM_LOG;
 
+//
+// Struct for holding boot phase spans. It is published with its own guid,
+// so MEM_LOG keeps the layout that modules built before spans existed expect.
+//
+typedef struct {
+  /// sizeof (MEM_LOG_SPANS) of the module that published it.
+  UINT32            Size;
+  UINT32            SpanCount;
+  MEM_LOG_SPAN      Spans[MEM_LOG_MAX_SPANS];
+} MEM_LOG_SPANS;
+
 
 //
 // Guid for internal protocol for publishing mem log buffer.
 //
 EFI_GUID  mMemLogProtocolGuid = { 0x74B91DA4, 0x2B4C, 0x11E2, {0x99, 0x03, 0x22, 0xF0, 0x61, 0x88, 0x70, 0x9B } };
 
+//
+// Guid for internal protocol for publishing boot phase spans.
+//
+EFI_GUID  mMemLogSpansProtocolGuid = { 0x45B5D46B, 0xCFE0, 0x4FF7, {0x96, 0xC9, 0x0F, 0xF6, 0x2B, 0xED, 0x34, 0x4C } };
+
 //
 // Pointer to mem log buffer.
 //
 MEM_LOG   *mMemLog = NULL;
 
+//
+// Pointer to boot phase spans.
+//
+MEM_LOG_SPANS *mMemLogSpans = NULL;
+
 //
 // Buffer for debug time.
 //
@@ -86,6 +121,250 @@ GetTiming(VOID)
 
 
 
+//
+// TSC frequency of this CPU from the last boot, kept in NVRAM under mMemLogProtocolGuid.
+//
+#define MEM_LOG_TSC_VAR             L"MemLogTscFreq"
+
+typedef struct {
+  /// CPUID(1).EAX of the CPU the frequency was measured on.
+  UINT32            CpuSignature;
+  UINT32            Reserved;
+  UINT64            TscFreqSec;
+} MEM_LOG_TSC_CALIBRATION;
+
+//
+// Quick measurement: median of 3 samples of 3ms of ACPI PM timer. A sample starts at
+// a timer edge, so it is off by at most 1 tick (1/10738) plus one IoRead32 (~1us),
+// together less than 0.1%. Without the timer gBS->Stall(10ms) is used.
+// Tolerances are in TscCalibration.h.
+//
+#define MEM_LOG_QUICK_SAMPLES       3
+#define MEM_LOG_QUICK_TICKS         (V_ACPI_TMR_FREQUENCY / 1000 * 3)
+
+
+/**
+  Returns I/O address of ACPI PM timer or 0 with the reason in InitError.
+**/
+UINT32
+GetAcpiPmTimerAddr (
+  OUT CHAR8       *InitError,
+  IN  UINTN       InitErrorSize
+  )
+{
+  UINT32          TimerAddr = 0;
+  UINT32          AcpiTick0, AcpiTick1;
+  
+  // Check if we can use the timer - we need to be on Intel ICH, get ACPI PM Timer Address from PCI, and check that it's sane
+  if ((PciRead16 (PCI_ICH_LPC_ADDRESS (0))) != 0x8086) { // Intel ICH device was not found
+    AsciiSPrint(InitError, InitErrorSize, "Intel ICH device was not found.");
+  } else if ((PciRead8 (PCI_ICH_LPC_ADDRESS (R_ICH_LPC_ACPI_CNT)) & B_ICH_LPC_ACPI_CNT_ACPI_EN) == 0) { // ACPI I/O space is not enabled
+    AsciiSPrint(InitError, InitErrorSize, "ACPI I/O space is not enabled.");
+  } else if ((TimerAddr = ((PciRead16 (PCI_ICH_LPC_ADDRESS (R_ICH_LPC_ACPI_BASE))) & B_ICH_LPC_ACPI_BASE_BAR) + R_ACPI_PM1_TMR) == 0) { // Timer address can't be obtained
+    AsciiSPrint(InitError, InitErrorSize, "Timer address can't be obtained.");
+  } else {
+    // Check that Timer is advancing
+    AcpiTick0 = IoRead32 (TimerAddr);
+    gBS->Stall(1000); // 1ms
+    AcpiTick1 = IoRead32(TimerAddr);
+    if (AcpiTick0 == AcpiTick1) { // Timer is not advancing
+      TimerAddr = 0; // Flag it as not working
+      AsciiSPrint(InitError, InitErrorSize, "Timer is not advancing.");
+    }
+  }
+  return TimerAddr;
+}
+
+/**
+  Measures TSC frequency against AcpiTicksTarget clocks of ACPI PM timer.
+  TSC at the start of measurement is returned in TscStart.
+**/
+UINT64
+MeasureTscFreqAcpi (
+  IN  UINT32      TimerAddr,
+  IN  UINT32      AcpiTicksTarget,
+  OUT UINT64      *TscStart
+  )
+{
+  UINT64          Tsc0, Tsc1;
+  UINT32          AcpiTick0, AcpiTick1, AcpiTicks;
+  
+  // start right after the timer ticks, so the start is not off by a part of tick
+  AcpiTick1 = IoRead32 (TimerAddr);
+  do {
+    AcpiTick0 = IoRead32 (TimerAddr); // read ACPI tick
+  } while (AcpiTick0 == AcpiTick1);
+  Tsc0 = AsmReadTsc(); // read TSC
+  do {
+    CpuPause();
+    // check how many AcpiTicks passed since we started
+    AcpiTick1 = IoRead32 (TimerAddr);
+    AcpiTicks = AcpiTicksDelta (AcpiTick0, AcpiTick1);
+  } while (AcpiTicks < AcpiTicksTarget); // keep checking Acpi ticks until target is reached
+  Tsc1 = AsmReadTsc(); // we're done, get another TSC
+  *TscStart = Tsc0;
+  return TscFreqFromAcpiTicks (Tsc1 - Tsc0, AcpiTicks);
+}
+
+/**
+  Short measurement of TSC frequency used to check the known frequencies.
+**/
+UINT64
+MeasureTscFreqQuick (
+  IN  UINT32      TimerAddr,
+  OUT UINT64      *TscStart
+  )
+{
+  UINT64          Sample[MEM_LOG_QUICK_SAMPLES];
+  UINT64          Tsc0;
+  UINTN           Index;
+  
+  if (TimerAddr == 0) {
+    *TscStart = AsmReadTsc();
+    gBS->Stall(10000); // 10ms
+    return MultU64x32((AsmReadTsc() - *TscStart), 100);
+  }
+  for (Index = 0; Index < MEM_LOG_QUICK_SAMPLES; Index++) {
+    Sample[Index] = MeasureTscFreqAcpi (TimerAddr, MEM_LOG_QUICK_TICKS, &Tsc0);
+    if (Index == 0) {
+      *TscStart = Tsc0;
+    }
+  }
+  return MedianTscFreq (Sample, MEM_LOG_QUICK_SAMPLES);
+}
+
+/**
+  TSC frequency from CPUID leaf 0x15 (and 0x16 if crystal clock is not reported), 0 if not known.
+**/
+UINT64
+GetTscFreqFromCpuid (
+  VOID
+  )
+{
+  UINT32          MaxLeaf;
+  UINT32          Vendor;
+  UINT32          Denominator;
+  UINT32          Numerator;
+  UINT32          CrystalHz;
+  UINT32          BaseMhz = 0;
+  
+  AsmCpuid (0, &MaxLeaf, &Vendor, NULL, NULL);
+  if (Vendor != 0x756E6547 || MaxLeaf < 0x15) { // "Genu"
+    return 0;
+  }
+  AsmCpuid (0x15, &Denominator, &Numerator, &CrystalHz, NULL);
+  if (MaxLeaf >= 0x16) {
+    AsmCpuid (0x16, &BaseMhz, NULL, NULL, NULL);
+  }
+  return TscFreqFromCpuidLeaves (Denominator, Numerator, CrystalHz, BaseMhz);
+}
+
+/**
+  TSC frequency as max non-turbo ratio from MSR_PLATFORM_INFO times bus clock, the way
+  GetCPUProperties() gets it. Only for Intel CPUs with invariant TSC, 0 if not known.
+**/
+UINT64
+GetTscFreqFromMsr (
+  VOID
+  )
+{
+  UINT32          MaxLeaf;
+  UINT32          Vendor;
+  UINT32          Signature;
+  UINT32          Model;
+  UINT32          RegEcx;
+  UINT32          RegEdx;
+  UINT64          BusHz;
+  
+  AsmCpuid (0, &MaxLeaf, &Vendor, NULL, NULL);
+  if (Vendor != 0x756E6547) { // "Genu"
+    return 0;
+  }
+  AsmCpuid (0x80000000, &MaxLeaf, NULL, NULL, NULL);
+  if (MaxLeaf < 0x80000007) {
+    return 0;
+  }
+  AsmCpuid (0x80000007, NULL, NULL, NULL, &RegEdx);
+  if ((RegEdx & BIT8) == 0) { // TSC is not invariant
+    return 0;
+  }
+  AsmCpuid (1, &Signature, NULL, &RegEcx, NULL);
+  if (((Signature >> 8) & 0x0F) != 6 || (RegEcx & BIT31) != 0) { // not family 6 or under hypervisor
+    return 0;
+  }
+  Model = ((Signature >> 4) & 0x0F) | ((Signature >> 12) & 0xF0);
+  switch (Model) {
+    case 0x1A: // Nehalem
+    case 0x1E: // Lynnfield, Clarksfield
+    case 0x1F: // Havendale, Auburndale
+    case 0x25: // Clarkdale, Arrandale
+    case 0x2C: // Westmere
+    case 0x2E: // Nehalem-EX
+    case 0x2F: // Westmere-EX
+      BusHz = 133333333;
+      break;
+    case 0x2A: // Sandy Bridge
+    case 0x2D: // Jaketown
+    case 0x3A: // Ivy Bridge
+    case 0x3E: // Ivy Bridge-E5
+    case 0x3C: // Haswell
+    case 0x3F: // Haswell-E
+    case 0x45: // Haswell ULT
+    case 0x46: // Crystalwell
+    case 0x3D: // Broadwell
+    case 0x47: // Broadwell HQ
+    case 0x4E: // Skylake U
+    case 0x5E: // Skylake S
+      BusHz = 100000000;
+      break;
+    default:
+      return 0;
+  }
+  return MultU64x32 (BusHz, (UINT32)RShiftU64 (AsmReadMsr64 (0xCE), 8) & 0xFF); // MSR_PLATFORM_INFO
+}
+
+/**
+  TSC frequency from the last full calibration on this CPU, 0 if not saved.
+**/
+UINT64
+GetSavedTscFreq (
+  VOID
+  )
+{
+  EFI_STATUS                Status;
+  MEM_LOG_TSC_CALIBRATION   Saved;
+  UINTN                     Size;
+  UINT32                    Signature;
+  
+  Size = sizeof (Saved);
+  Status = gRT->GetVariable (MEM_LOG_TSC_VAR, &mMemLogProtocolGuid, NULL, &Size, &Saved);
+  if (EFI_ERROR (Status) || Size != sizeof (Saved)) {
+    return 0;
+  }
+  AsmCpuid (1, &Signature, NULL, NULL, NULL);
+  return (Saved.CpuSignature == Signature) ? Saved.TscFreqSec : 0;
+}
+
+/**
+  Saves TSC frequency for the next boots.
+**/
+VOID
+SaveTscFreq (
+  IN  UINT64      TscFreqSec
+  )
+{
+  MEM_LOG_TSC_CALIBRATION   Saved;
+  
+  ZeroMem (&Saved, sizeof (Saved));
+  AsmCpuid (1, &Saved.CpuSignature, NULL, NULL, NULL);
+  Saved.TscFreqSec = TscFreqSec;
+  gRT->SetVariable (MEM_LOG_TSC_VAR, &mMemLogProtocolGuid,
+                    EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+                    sizeof (Saved), &Saved);
+}
+
+
+
 /**
   Inits mem log.
 
@@ -101,7 +380,10 @@ MemLogInit (
   EFI_STATUS      Status;
   UINT32          TimerAddr = 0;
   UINT64          Tsc0, Tsc1;
-  UINT32          AcpiTick0, AcpiTick1, AcpiTicksDelta, AcpiTicksTarget;
+  UINT64          Measured;
+  UINT64          Saved;
+  UINT32          Tolerance;
+  CONST CHAR8     *Source;
   CHAR8           InitError[50];
   
   if (mMemLog != NULL) {
@@ -138,57 +420,43 @@ MemLogInit (
 
   // We will try to calibrate TSC frequency according to the ACPI Power Management Timer.
   // The ACPI PM Timer is running at a universal known frequency of 3579545Hz.
-  // So, we wait 357954 clocks of the ACPI timer (100ms), and compare with how much TSC advanced.
   // This seems to provide a much more accurate calibration than using gBS->Stall(), especially on UEFI machines, and is important as this value is used later to calculate FSBFrequency.
-
-  // Check if we can use the timer - we need to be on Intel ICH, get ACPI PM Timer Address from PCI, and check that it's sane
-  if ((PciRead16 (PCI_ICH_LPC_ADDRESS (0))) != 0x8086) { // Intel ICH device was not found
-    AsciiSPrint(InitError, sizeof(InitError), "Intel ICH device was not found.");
-  } else if ((PciRead8 (PCI_ICH_LPC_ADDRESS (R_ICH_LPC_ACPI_CNT)) & B_ICH_LPC_ACPI_CNT_ACPI_EN) == 0) { // ACPI I/O space is not enabled
-    AsciiSPrint(InitError, sizeof(InitError), "ACPI I/O space is not enabled.");
-  } else if ((TimerAddr = ((PciRead16 (PCI_ICH_LPC_ADDRESS (R_ICH_LPC_ACPI_BASE))) & B_ICH_LPC_ACPI_BASE_BAR) + R_ACPI_PM1_TMR) == 0) { // Timer address can't be obtained
-    AsciiSPrint(InitError, sizeof(InitError), "Timer address can't be obtained.");
-  } else {
-    // Check that Timer is advancing
-    AcpiTick0 = IoRead32 (TimerAddr);
-    gBS->Stall(1000); // 1ms
-    AcpiTick1 = IoRead32(TimerAddr);
-    if (AcpiTick0 == AcpiTick1) { // Timer is not advancing
-      TimerAddr = 0; // Flag it as not working
-      AsciiSPrint(InitError, sizeof(InitError), "Timer is not advancing.");
+  // A full calibration takes 100ms, so first a quick measurement checks the frequency
+  // reported by CPUID, saved by previous boot or computed from MSRs, and the full one
+  // is done only if none of them is close enough.
+  TimerAddr = GetAcpiPmTimerAddr (InitError, sizeof(InitError));
+  Measured = MeasureTscFreqQuick (TimerAddr, &Tsc0);
+  Tolerance = (TimerAddr != 0) ? MEM_LOG_QUICK_TOLERANCE : MEM_LOG_STALL_TOLERANCE;
+
+  Saved = GetSavedTscFreq ();
+  Source = "CPUID";
+  mMemLog->TscFreqSec = GetTscFreqFromCpuid ();
+  if (!IsTscFreqClose (mMemLog->TscFreqSec, Measured, Tolerance)) {
+    Source = "NVRAM";
+    mMemLog->TscFreqSec = Saved;
+  }
+  if (!IsTscFreqClose (mMemLog->TscFreqSec, Measured, Tolerance)) {
+    Source = "MSR";
+    mMemLog->TscFreqSec = GetTscFreqFromMsr ();
+  }
+  if (!IsTscFreqClose (mMemLog->TscFreqSec, Measured, Tolerance)) {
+    // We prefer to use the ACPI PM Timer when possible. If it is not available we fallback to old method.
+    if (TimerAddr != 0) { // ACPI PM Timer seems to be working
+      Source = "ACPI PM Timer";
+      // we wait 357954 clocks of the ACPI timer (100ms), and compare with how much TSC advanced.
+      mMemLog->TscFreqSec = MeasureTscFreqAcpi (TimerAddr, V_ACPI_TMR_FREQUENCY/10, &Tsc1);
+    } else { 
+      // ACPI PM Timer is not working, fallback to old method
+      Source = "Stall";
+      Tsc1 = AsmReadTsc();
+      gBS->Stall(100000); // 100ms
+      mMemLog->TscFreqSec = MultU64x32((AsmReadTsc() - Tsc1), 10);
     }
   }
-
-  // We prefer to use the ACPI PM Timer when possible. If it is not available we fallback to old method.
-  if (TimerAddr != 0) { // ACPI PM Timer seems to be working
-
-    // ACPI PM timers are usually of 24-bit length, but there are some less common cases of 32-bit length also. When the maximal number is reached, it overflows.
-    // The code below can handle overflow with AcpiTicksTarget of up to 24-bit size, on both available sizes of ACPI PM Timers (24-bit and 32-bit).
-
-    AcpiTicksTarget = V_ACPI_TMR_FREQUENCY/10; // 357954 clocks of ACPI timer (100ms)
-
-    AcpiTick0 = IoRead32 (TimerAddr); // read ACPI tick
-    Tsc0 = AsmReadTsc(); // read TSC
-    do {
-      CpuPause();
-      // check how many AcpiTicks passed since we started
-      AcpiTick1 = IoRead32 (TimerAddr);
-      if (AcpiTick0 <= AcpiTick1) { // no overflow
-        AcpiTicksDelta = AcpiTick1 - AcpiTick0;
-      } else if (AcpiTick0 - AcpiTick1 <= 0x00FFFFFF) { // overflow, 24-bit timer
-        AcpiTicksDelta = (0x00FFFFFF - AcpiTick0) + AcpiTick1;
-      } else { // overflow, 32-bit timer
-        AcpiTicksDelta = (0xFFFFFFFF - AcpiTick0) + AcpiTick1;
-      }
-    } while (AcpiTicksDelta < AcpiTicksTarget); // keep checking Acpi ticks until target is reached
-    Tsc1 = AsmReadTsc(); // we're done, get another TSC
-    mMemLog->TscFreqSec = DivU64x32(MultU64x32((Tsc1 - Tsc0), V_ACPI_TMR_FREQUENCY), AcpiTicksDelta);
-  } else { 
-    // ACPI PM Timer is not working, fallback to old method
-    Tsc0 = AsmReadTsc();
-    gBS->Stall(100000); // 100ms
-    Tsc1 = AsmReadTsc();
-    mMemLog->TscFreqSec = MultU64x32((Tsc1 - Tsc0), 10);
+  // whatever the source, the next boot can skip the full calibration;
+  // small differences between boots don't wear the flash
+  if (!IsTscFreqClose (Saved, mMemLog->TscFreqSec, MEM_LOG_SAVE_TOLERANCE)) {
+    SaveTscFreq (mMemLog->TscFreqSec);
   }
   mMemLog->TscStart = Tsc0;
   mMemLog->TscLast = Tsc0;
@@ -202,7 +470,8 @@ MemLogInit (
                                                    mMemLog,
                                                    NULL
                                                    );
-  MemLog(TRUE, 1, "MemLog inited, TSC freq: %ld\n", mMemLog->TscFreqSec);
+  MemLog(TRUE, 1, "MemLog inited, TSC freq: %ld from %a, quick measurement %ld (+-%a)\n",
+         mMemLog->TscFreqSec, Source, Measured, (TimerAddr != 0) ? "0.1%" : "2%");
   if (InitError[0] != '\0') {
     MemLog(TRUE, 1, "MemLog was calibrated without ACPI PM Timer: %a\n", InitError);
   }
@@ -411,3 +680,168 @@ GetMemLogTscTicksPerSecond (VOID)
   }
   return mMemLog->TscFreqSec;
 }
+
+/**
+  Returns boot phase spans shared by all modules, publishes them if this module is first.
+  Spans published with another layout are not used.
+ **/
+MEM_LOG_SPANS*
+GetMemLogSpans (
+  VOID
+  )
+{
+  EFI_STATUS        Status;
+  
+  if (mMemLogSpans != NULL) {
+    return mMemLogSpans;
+  }
+  Status = gBS->LocateProtocol (&mMemLogSpansProtocolGuid, NULL, (VOID **) &mMemLogSpans);
+  if (Status == EFI_SUCCESS && mMemLogSpans != NULL) {
+    if (mMemLogSpans->Size != sizeof (MEM_LOG_SPANS)) {
+      mMemLogSpans = NULL;
+    }
+    return mMemLogSpans;
+  }
+  mMemLogSpans = AllocateZeroPool (sizeof (MEM_LOG_SPANS));
+  if (mMemLogSpans == NULL) {
+    return NULL;
+  }
+  mMemLogSpans->Size = sizeof (MEM_LOG_SPANS);
+  Status = gBS->InstallMultipleProtocolInterfaces (
+                                                   &gImageHandle,
+                                                   &mMemLogSpansProtocolGuid,
+                                                   mMemLogSpans,
+                                                   NULL
+                                                   );
+  return mMemLogSpans;
+}
+
+/**
+  Finds span with given Name, adds it if not found.
+ **/
+MEM_LOG_SPAN*
+FindMemLogSpan (
+  IN  CONST CHAR8   *Name
+  )
+{
+  UINTN             Index;
+  MEM_LOG_SPANS     *Spans;
+  
+  if (Name == NULL || (mMemLog == NULL && EFI_ERROR (MemLogInit ()))) {
+    return NULL;
+  }
+  Spans = GetMemLogSpans ();
+  if (Spans == NULL) {
+    return NULL;
+  }
+  for (Index = 0; Index < Spans->SpanCount; Index++) {
+    if (AsciiStrnCmp (Spans->Spans[Index].Name, Name, MEM_LOG_SPAN_NAME_SIZE - 1) == 0) {
+      return &Spans->Spans[Index];
+    }
+  }
+  if (Spans->SpanCount >= MEM_LOG_MAX_SPANS) {
+    return NULL;
+  }
+  AsciiStrnCpy (Spans->Spans[Index].Name, Name, MEM_LOG_SPAN_NAME_SIZE - 1);
+  Spans->SpanCount++;
+  return &Spans->Spans[Index];
+}
+
+/**
+  Starts timing of boot phase Name.
+ **/
+VOID
+EFIAPI
+MemLogSpanBegin (
+  IN  CONST CHAR8   *Name
+  )
+{
+  MEM_LOG_SPAN      *Span;
+  
+  Span = FindMemLogSpan (Name);
+  if (Span != NULL) {
+    Span->TscBegin = AsmReadTsc ();
+  }
+}
+
+/**
+  Stops timing of boot phase Name and adds the time to its total.
+ **/
+VOID
+EFIAPI
+MemLogSpanEnd (
+  IN  CONST CHAR8   *Name
+  )
+{
+  UINT64            CurrentTsc;
+  MEM_LOG_SPAN      *Span;
+  
+  CurrentTsc = AsmReadTsc ();
+  Span = FindMemLogSpan (Name);
+  if (Span == NULL || Span->TscBegin == 0) {
+    return;
+  }
+  Span->TscTotal += CurrentTsc - Span->TscBegin;
+  Span->TscBegin = 0;
+  Span->Count++;
+}
+
+/**
+  Returns time of all finished runs of boot phase Name in milliseconds.
+ **/
+UINT64
+EFIAPI
+GetMemLogSpanMs (
+  IN  CONST CHAR8   *Name
+  )
+{
+  MEM_LOG_SPAN      *Span;
+  
+  Span = FindMemLogSpan (Name);
+  if (Span == NULL || mMemLog->TscFreqSec == 0) {
+    return 0;
+  }
+  return DivU64x64Remainder (MultU64x32 (Span->TscTotal, 1000), mMemLog->TscFreqSec, NULL);
+}
+
+/**
+  Prints table with totals of all boot phase spans into Buffer.
+  
+  @return Number of chars written, without the terminating null.
+ **/
+UINTN
+EFIAPI
+MemLogSpanSummary (
+  OUT CHAR8         *Buffer,
+  IN  UINTN         BufferSize
+  )
+{
+  UINTN             Index;
+  UINTN             Len;
+  UINT64            TotalMs;
+  UINT64            TotalUs;
+  MEM_LOG_SPANS     *Spans;
+  MEM_LOG_SPAN      *Span;
+  
+  if (Buffer == NULL || BufferSize == 0) {
+    return 0;
+  }
+  Buffer[0] = '\0';
+  if (mMemLog == NULL || mMemLog->TscFreqSec == 0) {
+    return 0;
+  }
+  Spans = GetMemLogSpans ();
+  if (Spans == NULL || Spans->SpanCount == 0) {
+    return 0;
+  }
+  Len = AsciiSPrint (Buffer, BufferSize, "\n=== Boot phases ===\n%-28a %5a %10a\n", "phase", "runs", "ms");
+  for (Index = 0; Index < Spans->SpanCount; Index++) {
+    Span = &Spans->Spans[Index];
+    TotalUs = DivU64x64Remainder (MultU64x32 (Span->TscTotal, 1000000), mMemLog->TscFreqSec, NULL);
+    TotalMs = DivU64x64Remainder (TotalUs, 1000, &TotalUs);
+    Len += AsciiSPrint (Buffer + Len, BufferSize - Len, "%-28a %5d %6ld.%03ld%a\n",
+                        Span->Name, Span->Count, TotalMs, TotalUs,
+                        (Span->TscBegin != 0) ? " (running)" : "");
+  }
+  return Len;
+}
@@ -0,0 +1,111 @@
+/** @file
+  Arithmetic of MemLog TSC calibration.
+**/
+
+#include "TscCalibration.h"
+#include "GenericIch.h"
+
+
+/**
+  Number of ACPI PM timer ticks from AcpiTick0 to AcpiTick1, with 24 or 32-bit overflow.
+**/
+UINT32
+AcpiTicksDelta (
+  IN  UINT32      AcpiTick0,
+  IN  UINT32      AcpiTick1
+  )
+{
+  // ACPI PM timers are usually of 24-bit length, but there are some less common cases of 32-bit length also. When the maximal number is reached, it overflows.
+  // This can handle overflow with deltas of up to 24-bit size, on both available sizes of ACPI PM Timers (24-bit and 32-bit).
+  if (AcpiTick0 <= AcpiTick1) { // no overflow
+    return AcpiTick1 - AcpiTick0;
+  } else if (AcpiTick0 - AcpiTick1 <= 0x00FFFFFF) { // overflow, 24-bit timer
+    return (0x00FFFFFF - AcpiTick0) + AcpiTick1;
+  }
+  return (0xFFFFFFFF - AcpiTick0) + AcpiTick1; // overflow, 32-bit timer
+}
+
+/**
+  TSC ticks per second from TscDelta ticks counted during AcpiTicks ACPI PM timer ticks.
+**/
+UINT64
+TscFreqFromAcpiTicks (
+  IN  UINT64      TscDelta,
+  IN  UINT32      AcpiTicks
+  )
+{
+  if (AcpiTicks == 0) {
+    return 0;
+  }
+  return DivU64x32 (MultU64x32 (TscDelta, V_ACPI_TMR_FREQUENCY), AcpiTicks);
+}
+
+/**
+  TSC ticks per second from CPUID leaf 0x15 registers and leaf 0x16 base frequency
+  (BaseMhz, used only if the crystal clock is not reported), 0 if not known.
+**/
+UINT64
+TscFreqFromCpuidLeaves (
+  IN  UINT32      Denominator,
+  IN  UINT32      Numerator,
+  IN  UINT32      CrystalHz,
+  IN  UINT32      BaseMhz
+  )
+{
+  if (Denominator == 0 || Numerator == 0) {
+    return 0;
+  }
+  if (CrystalHz == 0) {
+    // crystal clock is not enumerated, get it from processor base frequency
+    CrystalHz = (UINT32)DivU64x32 (MultU64x32 (MultU64x32 (BaseMhz, 1000000), Denominator), Numerator);
+  }
+  if (CrystalHz == 0) {
+    return 0;
+  }
+  return DivU64x32 (MultU64x32 (CrystalHz, Numerator), Denominator);
+}
+
+/**
+  Sorts Count samples and returns the median.
+**/
+UINT64
+MedianTscFreq (
+  IN OUT UINT64   *Sample,
+  IN     UINTN    Count
+  )
+{
+  UINT64          Temp;
+  UINTN           Index;
+  UINTN           Index2;
+  
+  if (Count == 0) {
+    return 0;
+  }
+  for (Index = 1; Index < Count; Index++) {
+    for (Index2 = Index; Index2 > 0 && Sample[Index2 - 1] > Sample[Index2]; Index2--) {
+      Temp = Sample[Index2 - 1];
+      Sample[Index2 - 1] = Sample[Index2];
+      Sample[Index2] = Temp;
+    }
+  }
+  return Sample[Count / 2];
+}
+
+/**
+  TRUE if Known frequency is within 1/Tolerance of Measured.
+**/
+BOOLEAN
+IsTscFreqClose (
+  IN  UINT64      Known,
+  IN  UINT64      Measured,
+  IN  UINT32      Tolerance
+  )
+{
+  UINT64          Diff;
+  
+  if (Known == 0 || Measured == 0) {
+    return FALSE;
+  }
+  Diff = (Known > Measured) ? Known - Measured : Measured - Known;
+  return Diff <= DivU64x32 (Measured, Tolerance);
+}
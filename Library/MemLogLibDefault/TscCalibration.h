@@ -0,0 +1,75 @@
+/** @file
+  Arithmetic of MemLog TSC calibration. It does not touch the hardware,
+  so it is also built on the host by the test in the test folder.
+**/
+
+#ifndef __MEM_LOG_TSC_CALIBRATION_H__
+#define __MEM_LOG_TSC_CALIBRATION_H__
+
+#ifdef HOST_POSIX
+#include "tsc_posix_base.h"
+#else
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#endif
+
+//
+// A known frequency is used if it is within 1/MEM_LOG_QUICK_TOLERANCE (0.25%) of the
+// quick ACPI PM timer measurement, or 1/MEM_LOG_STALL_TOLERANCE (2%) of the Stall one.
+// The saved frequency is rewritten only if the new one is off by more than
+// 1/MEM_LOG_SAVE_TOLERANCE (0.5%).
+//
+#define MEM_LOG_QUICK_TOLERANCE     400
+#define MEM_LOG_STALL_TOLERANCE     50
+#define MEM_LOG_SAVE_TOLERANCE      200
+
+/**
+  Number of ACPI PM timer ticks from AcpiTick0 to AcpiTick1, with 24 or 32-bit overflow.
+**/
+UINT32
+AcpiTicksDelta (
+  IN  UINT32      AcpiTick0,
+  IN  UINT32      AcpiTick1
+  );
+
+/**
+  TSC ticks per second from TscDelta ticks counted during AcpiTicks ACPI PM timer ticks.
+**/
+UINT64
+TscFreqFromAcpiTicks (
+  IN  UINT64      TscDelta,
+  IN  UINT32      AcpiTicks
+  );
+
+/**
+  TSC ticks per second from CPUID leaf 0x15 registers and leaf 0x16 base frequency
+  (BaseMhz, used only if the crystal clock is not reported), 0 if not known.
+**/
+UINT64
+TscFreqFromCpuidLeaves (
+  IN  UINT32      Denominator,
+  IN  UINT32      Numerator,
+  IN  UINT32      CrystalHz,
+  IN  UINT32      BaseMhz
+  );
+
+/**
+  Sorts Count samples and returns the median.
+**/
+UINT64
+MedianTscFreq (
+  IN OUT UINT64   *Sample,
+  IN     UINTN    Count
+  );
+
+/**
+  TRUE if Known frequency is within 1/Tolerance of Measured.
+**/
+BOOLEAN
+IsTscFreqClose (
+  IN  UINT64      Known,
+  IN  UINT64      Measured,
+  IN  UINT32      Tolerance
+  );
+
+#endif // __MEM_LOG_TSC_CALIBRATION_H__
@@ -0,0 +1,32 @@
+/**
+ * \file tsc_posix_base.h
+ * Base definitions for building TscCalibration.c in the POSIX user space environment.
+ */
+
+#ifndef _TSC_POSIX_BASE_H_
+#define _TSC_POSIX_BASE_H_
+
+#include <stdint.h>
+
+#define IN
+#define OUT
+
+typedef uint8_t     BOOLEAN;
+typedef uint32_t    UINT32;
+typedef uint64_t    UINT64;
+typedef uintptr_t   UINTN;
+
+#define TRUE        1
+#define FALSE       0
+
+static inline UINT64 MultU64x32 (UINT64 Multiplicand, UINT32 Multiplier)
+{
+    return Multiplicand * Multiplier;
+}
+
+static inline UINT64 DivU64x32 (UINT64 Dividend, UINT32 Divisor)
+{
+    return Dividend / Divisor;
+}
+
+#endif
@@ -0,0 +1,123 @@
+/**
+ * \file tsccalc.c
+ * Test of the MemLog TSC calibration arithmetic in the POSIX user space environment.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "TscCalibration.h"
+#include "GenericIch.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: failed: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+/* relative error of value against expected, in parts per million */
+static double ppm(UINT64 value, UINT64 expected)
+{
+    return ((double)value - (double)expected) * 1e6 / (double)expected;
+}
+
+static void test_acpi_ticks_delta(void)
+{
+    CHECK(AcpiTicksDelta(100, 100) == 0);
+    CHECK(AcpiTicksDelta(100, 10838) == 10738);
+    /* 24-bit timer wraps at 0xFFFFFF */
+    CHECK(AcpiTicksDelta(0x00FFFF00, 0x00000010) == 0x10F);
+    /* 32-bit timer wraps at 0xFFFFFFFF */
+    CHECK(AcpiTicksDelta(0xFFFFFF00, 0x00000010) == 0x10F);
+}
+
+/*
+ * Simulates a measurement of AcpiTicks timer ticks on a CPU with TSC frequency Freq:
+ * both ends are on a timer edge, the end is noticed up to LateNs late.
+ */
+static UINT64 simulate_acpi(UINT64 Freq, UINT32 AcpiTicks, UINT32 LateNs)
+{
+    double seconds = (double)AcpiTicks / V_ACPI_TMR_FREQUENCY;
+    UINT64 tsc = (UINT64)(seconds * Freq) + (UINT64)((double)LateNs * Freq / 1e9);
+
+    return TscFreqFromAcpiTicks(tsc, AcpiTicks);
+}
+
+static void test_acpi_measurement(void)
+{
+    static const UINT64 freqs[] = { 800000000ULL, 1995000000ULL, 2400000000ULL, 3500000000ULL, 5200000000ULL };
+    UINT64 sample[3];
+    UINTN i;
+    double worst_quick = 0, worst_full = 0, e;
+
+    for (i = 0; i < sizeof(freqs) / sizeof(freqs[0]); i++) {
+        /* quick: 3ms, late by up to one IoRead32 (~1us) */
+        e = ppm(simulate_acpi(freqs[i], V_ACPI_TMR_FREQUENCY / 1000 * 3, 1000), freqs[i]);
+        if (e > worst_quick)
+            worst_quick = e;
+        /* full: 100ms */
+        e = ppm(simulate_acpi(freqs[i], V_ACPI_TMR_FREQUENCY / 10, 1000), freqs[i]);
+        if (e > worst_full)
+            worst_full = e;
+    }
+    printf("ACPI PM timer: worst error %.0fppm in 3ms, %.0fppm in 100ms\n", worst_quick, worst_full);
+    /* stated bound of the quick measurement is 0.1% */
+    CHECK(worst_quick < 1000);
+    CHECK(worst_full < 100);
+    /* the quick result must accept the exact frequency within MEM_LOG_QUICK_TOLERANCE */
+    CHECK(worst_quick * MEM_LOG_QUICK_TOLERANCE < 1e6);
+
+    CHECK(TscFreqFromAcpiTicks(12345, 0) == 0);
+
+    /* median ignores one disturbed sample (an SMI in the middle of it) */
+    sample[0] = 3000000000ULL;
+    sample[1] = 3400000000ULL;
+    sample[2] = 3000300000ULL;
+    CHECK(MedianTscFreq(sample, 3) == 3000300000ULL);
+    sample[0] = 2000000000ULL;
+    sample[1] = 3000000000ULL;
+    sample[2] = 3000100000ULL;
+    CHECK(MedianTscFreq(sample, 3) == 3000000000ULL);
+    CHECK(MedianTscFreq(sample, 0) == 0);
+}
+
+static void test_cpuid(void)
+{
+    UINT64 f;
+
+    /* crystal clock reported (Goldmont, 19.2MHz crystal) */
+    CHECK(TscFreqFromCpuidLeaves(1, 104, 19200000, 0) == 1996800000ULL);
+    /* Skylake: no crystal clock, base frequency 4000MHz from leaf 0x16 */
+    f = TscFreqFromCpuidLeaves(2, 334, 0, 4000);
+    printf("CPUID 0x15 2/334 with base 4000MHz: %llu\n", (unsigned long long)f);
+    CHECK(f != 0 && ppm(f, 4000000000ULL) > -10 && ppm(f, 4000000000ULL) < 10);
+    /* nothing reported */
+    CHECK(TscFreqFromCpuidLeaves(0, 334, 24000000, 4000) == 0);
+    CHECK(TscFreqFromCpuidLeaves(2, 0, 24000000, 4000) == 0);
+    CHECK(TscFreqFromCpuidLeaves(2, 334, 0, 0) == 0);
+}
+
+static void test_tolerance(void)
+{
+    /* quick ACPI check: 0.25% */
+    CHECK(IsTscFreqClose(3007000000ULL, 3000000000ULL, MEM_LOG_QUICK_TOLERANCE));
+    CHECK(!IsTscFreqClose(3008000000ULL, 3000000000ULL, MEM_LOG_QUICK_TOLERANCE));
+    CHECK(IsTscFreqClose(2993000000ULL, 3000000000ULL, MEM_LOG_QUICK_TOLERANCE));
+    /* quick Stall check: 2% */
+    CHECK(IsTscFreqClose(3059000000ULL, 3000000000ULL, MEM_LOG_STALL_TOLERANCE));
+    CHECK(!IsTscFreqClose(3061000000ULL, 3000000000ULL, MEM_LOG_STALL_TOLERANCE));
+    /* saved value is rewritten only when off by more than 0.5% */
+    CHECK(IsTscFreqClose(3000000000ULL, 3014000000ULL, MEM_LOG_SAVE_TOLERANCE));
+    CHECK(!IsTscFreqClose(3000000000ULL, 3016000000ULL, MEM_LOG_SAVE_TOLERANCE));
+    /* nothing saved or not measured */
+    CHECK(!IsTscFreqClose(0, 3000000000ULL, MEM_LOG_SAVE_TOLERANCE));
+    CHECK(!IsTscFreqClose(3000000000ULL, 0, MEM_LOG_SAVE_TOLERANCE));
+}
+
+int main(void)
+{
+    test_acpi_ticks_delta();
+    test_acpi_measurement();
+    test_cpuid();
+    test_tolerance();
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
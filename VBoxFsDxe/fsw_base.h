@@ -52,6 +52,7 @@
 #ifndef _FSW_BASE_H_
 #define _FSW_BASE_H_
 //#define HOST_EFI 1
+#ifndef HOST_POSIX
 #define VBOX
 
 #ifdef VBOX
@@ -59,6 +60,7 @@
 #endif
 
 #include <Protocol/MsgLog.h> 
+#endif
 
 #ifndef FSW_DEBUG_LEVEL
 /**
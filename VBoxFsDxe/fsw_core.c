@@ -62,6 +62,9 @@ const char* fsw_errors[] = {
 // functions
 
 static void fsw_blockcache_free(struct fsw_volume *vol);
+#if FSW_LOOKUP_CACHE_SIZE > 0
+static void fsw_lookup_cache_free(struct fsw_volume *vol);
+#endif
 
 #define MAX_CACHE_LEVEL (5)
 
@@ -130,6 +133,10 @@ void fsw_unmount(struct fsw_volume *vol)
   if (!vol) {
     return;
   }
+#if FSW_LOOKUP_CACHE_SIZE > 0
+  // cached dnodes hold references up to the root
+  fsw_lookup_cache_free(vol);
+#endif
   if (vol->root)
     fsw_dnode_release(vol->root);
   // TODO: check that no other dnodes are still around
@@ -203,7 +210,7 @@ void fsw_set_blocksize(struct fsw_volume *vol, fsw_u32 phys_blocksize, fsw_u32 l
  * caller calls fsw_block_release.
  */
 
-fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32 cache_level, void **buffer_out)
+fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u64 phys_bno, fsw_u32 cache_level, void **buffer_out)
 {
   fsw_status_t    status;
   fsw_u32         i, discard_level, new_bcache_size;
@@ -229,7 +236,7 @@ fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32
   
   // find a free entry in the cache table
   for (i = 0; i < vol->bcache_size; i++) {
-    if (vol->bcache[i].phys_bno == (fsw_u32)FSW_INVALID_BNO)
+    if (vol->bcache[i].phys_bno == (fsw_u64)FSW_INVALID_BNO)
       break;
   }
   if (i >= vol->bcache_size) {
@@ -261,7 +268,7 @@ fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32
     for (i = vol->bcache_size; i < new_bcache_size; i++) {
       new_bcache[i].refcount = 0;
       new_bcache[i].cache_level = 0;
-      new_bcache[i].phys_bno = (fsw_u32)FSW_INVALID_BNO;
+      new_bcache[i].phys_bno = (fsw_u64)FSW_INVALID_BNO;
       new_bcache[i].data = NULL;
     }
     i = vol->bcache_size;
@@ -272,7 +279,7 @@ fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32
     vol->bcache = new_bcache;
     vol->bcache_size = new_bcache_size;
   }
-  vol->bcache[i].phys_bno = (fsw_u32)FSW_INVALID_BNO;
+  vol->bcache[i].phys_bno = (fsw_u64)FSW_INVALID_BNO;
   
   // read the data
   if (vol->bcache[i].data == NULL) {
@@ -296,7 +303,7 @@ fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32
  * from fsw_block_get.
  */
 
-void fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, void *buffer)
+void fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u64 phys_bno, void *buffer)
 {
   fsw_u32 i;
   if (!vol) {
@@ -562,10 +569,124 @@ fsw_status_t fsw_dnode_stat(struct fsw_dnode *dno, struct fsw_dnode_stat_str *sb
   return status;
 }
 
+#if FSW_LOOKUP_CACHE_SIZE > 0
+
+/**
+ * Get a character of a name as the lookup cache sees it, folded to lower case
+ * if the volume ignores case in lookups.
+ */
+
+static fsw_u16 fsw_lookup_cache_char(struct fsw_volume *vol, struct fsw_string *s, int i)
+{
+  fsw_u16 ch;
+
+  if (s->type == FSW_STRING_TYPE_UTF16)
+    ch = ((fsw_u16 *)s->data)[i];
+  else
+    ch = ((fsw_u8 *)s->data)[i];
+  return vol->lookup_fold ? fsw_to_lower(ch) : ch;
+}
+
+/**
+ * Find the slot of the volume's name lookup cache for a name in a directory. The
+ * cache is direct-mapped on a FNV-1a hash of the directory's dnode_id and the name.
+ * Returns NULL if the name can not be cached. Otherwise *hash_out is the hash of the
+ * name and *hit is set if the slot holds an entry for the same name. Names must be of
+ * the same string type to match, because the fs drivers compare them differently.
+ */
+
+static struct fsw_lookup_cache_entry *fsw_lookup_cache_slot(struct fsw_dnode *dno, struct fsw_string *lookup_name,
+                                                             fsw_u32 *hash_out, int *hit)
+{
+  struct fsw_volume *vol = dno->vol;
+  struct fsw_lookup_cache_entry *entry;
+  fsw_u32 hash;
+  int i;
+
+  *hit = 0;
+  if (lookup_name->type != FSW_STRING_TYPE_ISO88591 && lookup_name->type != FSW_STRING_TYPE_UTF16)
+    return NULL;
+  if (vol->lcache == NULL &&
+      fsw_alloc_zero(sizeof(struct fsw_lookup_cache_entry) * FSW_LOOKUP_CACHE_SIZE, (void **)&vol->lcache))
+    return NULL;
+
+  hash = (2166136261U ^ dno->dnode_id) * 16777619U;
+  for (i = 0; i < lookup_name->len; i++)
+    hash = (hash ^ fsw_lookup_cache_char(vol, lookup_name, i)) * 16777619U;
+  entry = &vol->lcache[(hash ^ (hash >> 16)) & (FSW_LOOKUP_CACHE_SIZE - 1)];
+  *hash_out = hash;
+
+  if (!entry->valid || entry->hash != hash || entry->parent_id != dno->dnode_id ||
+      entry->name.type != lookup_name->type || entry->name.len != lookup_name->len)
+    return entry;
+  for (i = 0; i < lookup_name->len; i++) {
+    if (fsw_lookup_cache_char(vol, &entry->name, i) != fsw_lookup_cache_char(vol, lookup_name, i))
+      return entry;
+  }
+  *hit = 1;
+  return entry;
+}
+
+/**
+ * Drop an entry of the name lookup cache, releasing the dnode it holds.
+ */
+
+static void fsw_lookup_cache_clear(struct fsw_lookup_cache_entry *entry)
+{
+  struct fsw_dnode *child_dno = entry->dno;
+
+  if (!entry->valid)
+    return;
+  entry->valid = 0;
+  entry->dno = NULL;
+  fsw_strfree(&entry->name);
+  if (child_dno != NULL)
+    fsw_dnode_release(child_dno);
+}
+
+/**
+ * Remember the result of a directory lookup in a slot of the name lookup cache.
+ * child_dno is NULL if the name was not found.
+ */
+
+static void fsw_lookup_cache_set(struct fsw_lookup_cache_entry *entry, fsw_u32 hash, struct fsw_dnode *dno,
+                                 struct fsw_string *lookup_name, struct fsw_dnode *child_dno)
+{
+  fsw_lookup_cache_clear(entry);
+  if (fsw_strdup_coerce(&entry->name, lookup_name->type, lookup_name))
+    return;
+  entry->valid = 1;
+  entry->hash = hash;
+  entry->parent_id = dno->dnode_id;
+  entry->dno = child_dno;
+  if (child_dno != NULL)
+    fsw_dnode_retain(child_dno);
+}
+
+/**
+ * Free the name lookup cache of a volume and release all dnodes it holds.
+ */
+
+static void fsw_lookup_cache_free(struct fsw_volume *vol)
+{
+  int i;
+
+  if (vol->lcache == NULL)
+    return;
+  for (i = 0; i < FSW_LOOKUP_CACHE_SIZE; i++)
+    fsw_lookup_cache_clear(&vol->lcache[i]);
+  fsw_free(vol->lcache);
+  vol->lcache = NULL;
+}
+
+#endif
+
 /**
  * Lookup a directory entry by name in directory cache.
  * Given a directory dnode and a file name, it looks up the named entry in the
  * directory cache. If miss, the function calls fstype lookup and cache positive results.
+ * The volume's name lookup cache also remembers names which do not exist in the
+ * directory, it is shared by all directories of the volume.
  *
  * If the dnode is not a directory, the call will fail.
  *
@@ -579,6 +700,11 @@ fsw_status_t fsw_dnode_lookup_cache(struct fsw_dnode *dno,
   fsw_status_t    status;
   struct fsw_volume *vol = dno->vol;
   struct fsw_dnode *cache_dno = NULL;
+#if FSW_LOOKUP_CACHE_SIZE > 0
+  struct fsw_lookup_cache_entry *lcache_entry;
+  fsw_u32         lcache_hash = 0;
+  int             lcache_hit;
+#endif
 #if defined(FSW_DNODE_CACHE_SIZE) && FSW_DNODE_CACHE_SIZE > 0
   int i;
 #endif
@@ -619,10 +745,28 @@ fsw_status_t fsw_dnode_lookup_cache(struct fsw_dnode *dno,
   }
 #endif
   
+#if FSW_LOOKUP_CACHE_SIZE > 0
+  lcache_entry = fsw_lookup_cache_slot(dno, lookup_name, &lcache_hash, &lcache_hit);
+  if (lcache_hit) {
+    if (lcache_entry->dno == NULL) {
+      status = FSW_NOT_FOUND;
+      goto errorexit;
+    }
+    cache_dno = lcache_entry->dno;
+    fsw_dnode_retain(cache_dno);
+  }
+#endif
+
   // Cache miss (or no cache at all). Do real lookup
-  status = vol->fstype_table->dir_lookup(vol, dno, lookup_name, &cache_dno);
-  if (status)
-    goto errorexit;
+  if (cache_dno == NULL) {
+    status = vol->fstype_table->dir_lookup(vol, dno, lookup_name, &cache_dno);
+#if FSW_LOOKUP_CACHE_SIZE > 0
+    if (lcache_entry != NULL && (status == FSW_SUCCESS || status == FSW_NOT_FOUND))
+      fsw_lookup_cache_set(lcache_entry, lcache_hash, dno, lookup_name, status ? NULL : cache_dno);
+#endif
+    if (status)
+      goto errorexit;
+  }
   
 #if defined(FSW_DNODE_CACHE_SIZE) && FSW_DNODE_CACHE_SIZE > 0
     // release dnode pushed out of cache
@@ -1052,7 +1196,8 @@ fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_in
   struct fsw_volume *vol = dno->vol;
   fsw_u8          *buffer, *block_buffer;
   fsw_u32         buflen, copylen, pos;
-  fsw_u32         log_bno, pos_in_extent, phys_bno, pos_in_physblock;
+  fsw_u32         log_bno, pos_in_extent, pos_in_physblock;
+  fsw_u64         phys_bno, extent_len;
   fsw_u32         cache_level;
   
   if (shand->pos >= dno->size) {   // already at EOF
@@ -1109,15 +1254,14 @@ fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_in
       fsw_block_release(vol, phys_bno, block_buffer);
       
     } else if (shand->extent.type == FSW_EXTENT_TYPE_BUFFER) {
-      copylen = shand->extent.log_count * vol->log_blocksize - pos_in_extent;
-      if (copylen > buflen)
-        copylen = buflen;
+      extent_len = (fsw_u64)shand->extent.log_count * vol->log_blocksize - pos_in_extent;
+      copylen = (extent_len > buflen) ? buflen : (fsw_u32)extent_len;
       fsw_memcpy(buffer, (fsw_u8 *)shand->extent.buffer + pos_in_extent, copylen);
       
     } else {   // _SPARSE or _INVALID
-      copylen = shand->extent.log_count * vol->log_blocksize - pos_in_extent;
-      if (copylen > buflen)
-        copylen = buflen;
+      // a sparse extent may cover 4 GB and more
+      extent_len = (fsw_u64)shand->extent.log_count * vol->log_blocksize - pos_in_extent;
+      copylen = (extent_len > buflen) ? buflen : (fsw_u32)extent_len;
       fsw_memzero(buffer, copylen);
       
     }
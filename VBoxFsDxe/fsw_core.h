@@ -62,6 +62,11 @@ extern const char* fsw_errors[];
 #define FSW_DNODE_CACHE_SIZE (0)
 #endif
 
+/** Number of entries in the per-volume name lookup cache, a power of two. Zero disables it. */
+#ifndef FSW_LOOKUP_CACHE_SIZE
+#define FSW_LOOKUP_CACHE_SIZE (256)
+#endif
+
 /** Maximum size for a path, specifically symlink target paths. */
 #ifndef VBOX
 #define FSW_PATH_MAX (4096)
@@ -76,7 +81,7 @@ extern const char* fsw_errors[];
 #define FSW_FSTYPE_TABLE_NAME(t) FSW_CONCAT3(fsw_,t,_table)
 
 /** Indicates that the block cache entry is empty. */
-#define FSW_INVALID_BNO (~0UL)
+#define FSW_INVALID_BNO (~0ULL)
 
 #define USE_FULL_LOWERCASE 0
 //
@@ -254,10 +259,23 @@ struct fsw_fstype_table;
 struct fsw_blockcache {
     fsw_u32     refcount;           //!< Reference count
     fsw_u32     cache_level;        //!< Level of importance of this block
-    fsw_u32     phys_bno;           //!< Physical block number
+    fsw_u64     phys_bno;           //!< Physical block number
     void        *data;              //!< Block data buffer
 };
 
+/**
+ * Core: An entry of the per-volume name lookup cache. It maps a name in a directory
+ * to the dnode found there, or records that the directory has no such name.
+ */
+
+struct fsw_lookup_cache_entry {
+    int         valid;              //!< Entry is in use
+    fsw_u32     hash;               //!< Hash of parent_id and the name
+    fsw_u32     parent_id;          //!< dnode_id of the directory
+    struct fsw_string name;         //!< Name as it was looked up
+    struct fsw_dnode *dno;          //!< Retained dnode found, NULL if the name does not exist
+};
+
 /**
  * Core: Represents a mounted volume.
  */
@@ -274,6 +292,9 @@ struct fsw_volume {
     struct fsw_blockcache *bcache;  //!< Array of block cache entries
     fsw_u32     bcache_size;        //!< Number of entries in the block cache array
 
+    struct fsw_lookup_cache_entry *lcache;  //!< Name lookup cache, allocated on first lookup
+    int         lookup_fold;        //!< Set by the fs driver if name lookups ignore case
+
     void        *host_data;         //!< Hook for a host-specific data structure
     struct fsw_host_table *host_table;      //!< Dispatch table for host-specific functions
     struct fsw_fstype_table *fstype_table;  //!< Dispatch table for file system specific functions
@@ -324,7 +345,7 @@ struct fsw_extent {
     int         type;               //!< Type of extent specification
     fsw_u32     log_start;          //!< Starting logical block number
     fsw_u32     log_count;          //!< Logical block count
-    fsw_u32     phys_start;         //!< Starting physical block number (for FSW_EXTENT_TYPE_PHYSBLOCK only)
+    fsw_u64     phys_start;         //!< Starting physical block number (for FSW_EXTENT_TYPE_PHYSBLOCK only)
     void        *buffer;            //!< Allocated buffer pointer (for FSW_EXTENT_TYPE_BUFFER only)
 };
 
@@ -391,7 +412,7 @@ struct fsw_host_table
     void         (*change_blocksize)(struct fsw_volume *vol,
                                      fsw_u32 old_phys_blocksize, fsw_u32 old_log_blocksize,
                                      fsw_u32 new_phys_blocksize, fsw_u32 new_log_blocksize);
-    fsw_status_t (*read_block)(struct fsw_volume *vol, fsw_u32 phys_bno, void *buffer);
+    fsw_status_t (*read_block)(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer);
 };
 
 /**
@@ -437,8 +458,8 @@ void         fsw_unmount(struct fsw_volume *vol);
 fsw_status_t fsw_volume_stat(struct fsw_volume *vol, struct fsw_volume_stat *sb);
 
 void         fsw_set_blocksize(struct VOLSTRUCTNAME *vol, fsw_u32 phys_blocksize, fsw_u32 log_blocksize);
-fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32 cache_level, void **buffer_out);
-void         fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, void *buffer);
+fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u64 phys_bno, fsw_u32 cache_level, void **buffer_out);
+void         fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u64 phys_bno, void *buffer);
 
 /*@}*/
 
@@ -41,12 +41,16 @@ static fsw_status_t fsw_ext4_get_by_blkaddr(struct fsw_ext4_volume *vol, struct
                                         struct fsw_extent *extent);
 static fsw_status_t fsw_ext4_get_by_extent(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
                                         struct fsw_extent *extent);
+static fsw_status_t fsw_ext4_load_leaf(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
+                                       fsw_u32 bno);
 
 static fsw_status_t fsw_ext4_dir_lookup(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
                                         struct fsw_string *lookup_name, struct fsw_ext4_dnode **child_dno);
 static fsw_status_t fsw_ext4_dir_read(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
                                       struct fsw_shandle *shand, struct fsw_ext4_dnode **child_dno);
 static fsw_status_t fsw_ext4_read_dentry(struct fsw_shandle *shand, struct ext4_dir_entry *entry);
+static fsw_status_t fsw_ext4_dx_lookup(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
+                                       struct fsw_string *lookup_name, struct ext4_dir_entry *entry);
 
 static fsw_status_t fsw_ext4_readlink(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
                                       struct fsw_string *link);
@@ -93,10 +97,10 @@ static int fsw_ext4_group_sparse(fsw_u32 group)
 }
 
 /* calculate the first block number of the group */
-static __inline fsw_u32
+static __inline fsw_u64
 fsw_ext4_group_first_block_no(struct ext4_super_block *sb, fsw_u32 group_no)
 {
-        return group_no * (fsw_u32)EXT4_BLOCKS_PER_GROUP(sb) +
+        return (fsw_u64)group_no * EXT4_BLOCKS_PER_GROUP(sb) +
                 sb->s_first_data_block;
 }
 
@@ -110,7 +114,8 @@ static fsw_status_t fsw_ext4_volume_mount(struct fsw_ext4_volume *vol)
     fsw_status_t    status;
     void            *buffer;
     fsw_u32         blocksize;
-    fsw_u32         groupcnt, groupno, gdesc_per_block, gdesc_bno, gdesc_index, metabg_of_gdesc;
+    fsw_u32         groupcnt, groupno, gdesc_per_block, gdesc_index, metabg_of_gdesc;
+    fsw_u64         blockcnt, gdesc_bno;
     struct ext4_group_desc *gdesc;
     int             i;
     struct fsw_string s;
@@ -140,7 +145,7 @@ static fsw_status_t fsw_ext4_volume_mount(struct fsw_ext4_volume *vol)
     if (vol->sb->s_rev_level == EXT4_DYNAMIC_REV &&
         (vol->sb->s_feature_incompat & ~(EXT4_FEATURE_INCOMPAT_FILETYPE | EXT4_FEATURE_INCOMPAT_RECOVER |
                                          EXT4_FEATURE_INCOMPAT_EXTENTS | EXT4_FEATURE_INCOMPAT_FLEX_BG |
-                                         EXT4_FEATURE_INCOMPAT_META_BG)))
+                                         EXT4_FEATURE_INCOMPAT_META_BG | EXT4_FEATURE_INCOMPAT_64BIT)))
         return FSW_UNSUPPORTED;
 
 
@@ -174,21 +179,28 @@ static fsw_status_t fsw_ext4_volume_mount(struct fsw_ext4_volume *vol)
         return status;
 
     // size of group descriptor depends on feature....
+    blockcnt = vol->sb->s_blocks_count_lo;
     if (!(vol->sb->s_feature_incompat & EXT4_FEATURE_INCOMPAT_64BIT)) {
         // Default minimal group descriptor size... (this might not be set in old ext2 filesystems, therefor set it!)
         vol->sb->s_desc_size = EXT4_MIN_DESC_SIZE;
+    } else {
+        if (vol->sb->s_desc_size < EXT4_MIN_DESC_SIZE_64BIT || vol->sb->s_desc_size > EXT4_MAX_DESC_SIZE)
+            return FSW_VOLUME_CORRUPTED;
+        blockcnt |= (fsw_u64)vol->sb->s_blocks_count_hi << 32;
     }
+    if (vol->sb->s_blocks_per_group == 0 || blockcnt <= vol->sb->s_first_data_block)
+        return FSW_VOLUME_CORRUPTED;
 
     // Calculate group descriptor count the way the kernel does it...
-    groupcnt = (vol->sb->s_blocks_count_lo - vol->sb->s_first_data_block + 
-                vol->sb->s_blocks_per_group - 1) / vol->sb->s_blocks_per_group;
+    groupcnt = (fsw_u32)((blockcnt - vol->sb->s_first_data_block +
+                vol->sb->s_blocks_per_group - 1) / vol->sb->s_blocks_per_group);
 
     // Descriptors in one block... s_desc_size needs to be set! (Usually 128 since normal block 
     // descriptors are 32 byte and block size is 4096)
     gdesc_per_block = EXT4_DESC_PER_BLOCK(vol->sb);
     
     // Read the group descriptors to get inode table offsets
-    status = fsw_alloc(sizeof(fsw_u32) * groupcnt, &vol->inotab_bno);
+    status = fsw_alloc(sizeof(fsw_u64) * groupcnt, &vol->inotab_bno);
     if (status)
         return status;
 
@@ -221,6 +233,8 @@ static fsw_status_t fsw_ext4_volume_mount(struct fsw_ext4_volume *vol)
         // Get group descriptor table and block number of inode table...
         gdesc = (struct ext4_group_desc *)((char *)buffer + gdesc_index * vol->sb->s_desc_size);
         vol->inotab_bno[groupno] = gdesc->bg_inode_table_lo;
+        if (vol->sb->s_desc_size >= EXT4_MIN_DESC_SIZE_64BIT)
+            vol->inotab_bno[groupno] |= (fsw_u64)gdesc->bg_inode_table_hi << 32;
 
         fsw_block_release(vol, gdesc_bno, buffer);
     }
@@ -255,8 +269,14 @@ static void fsw_ext4_volume_free(struct fsw_ext4_volume *vol)
 
 static fsw_status_t fsw_ext4_volume_stat(struct fsw_ext4_volume *vol, struct fsw_volume_stat *sb)
 {
-    sb->total_bytes = (fsw_u64)vol->sb->s_blocks_count_lo * vol->g.log_blocksize;
-    sb->free_bytes  = (fsw_u64)vol->sb->s_free_blocks_count_lo * vol->g.log_blocksize;
+    fsw_u64 total_bcnt = vol->sb->s_blocks_count_lo, free_bcnt = vol->sb->s_free_blocks_count_lo;
+
+    if (vol->sb->s_feature_incompat & EXT4_FEATURE_INCOMPAT_64BIT) {
+        total_bcnt |= (fsw_u64)vol->sb->s_blocks_count_hi << 32;
+        free_bcnt |= (fsw_u64)vol->sb->s_free_blocks_count_hi << 32;
+    }
+    sb->total_bytes = total_bcnt * vol->g.log_blocksize;
+    sb->free_bytes  = free_bcnt * vol->g.log_blocksize;
     return FSW_SUCCESS;
 }
 
@@ -271,12 +291,16 @@ static fsw_status_t fsw_ext4_volume_stat(struct fsw_ext4_volume *vol, struct fsw
 static fsw_status_t fsw_ext4_dnode_fill(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno)
 {
     fsw_status_t    status;
-    fsw_u32         groupno, ino_in_group, ino_bno, ino_index;
+    fsw_u32         groupno, ino_in_group, ino_index;
+    fsw_u64         ino_bno;
     fsw_u8          *buffer;
 
     if (dno->raw)
         return FSW_SUCCESS;
 
+    // inode numbers come from directory entries, check them before use
+    if (dno->g.dnode_id == 0 || dno->g.dnode_id > vol->sb->s_inodes_count)
+        return FSW_VOLUME_CORRUPTED;
 
     // read the inode block
     groupno = (dno->g.dnode_id - 1) / vol->sb->s_inodes_per_group;
@@ -296,7 +320,9 @@ static fsw_status_t fsw_ext4_dnode_fill(struct fsw_ext4_volume *vol, struct fsw_
         return status;
 
     // get info from the inode
-    dno->g.size = dno->raw->i_size_lo; // TODO: check docs for 64-bit sized files
+    dno->g.size = dno->raw->i_size_lo;
+    if (S_ISREG(dno->raw->i_mode))
+        dno->g.size |= (fsw_u64)dno->raw->i_size_high << 32;
 
     if (S_ISREG(dno->raw->i_mode))
         dno->g.type = FSW_DNODE_TYPE_FILE;
@@ -322,6 +348,8 @@ static void fsw_ext4_dnode_free(struct fsw_ext4_volume *vol, struct fsw_ext4_dno
 {
     if (dno->raw)
         fsw_free(dno->raw);
+    if (dno->leaf_runs)
+        fsw_free(dno->leaf_runs);
 }
 
 /**
@@ -379,77 +407,195 @@ static fsw_status_t fsw_ext4_get_extent(struct fsw_ext4_volume *vol, struct fsw_
 }
 
 /**
- * New ext4 extents...
+ * Decode the leaf of the extent tree which covers logical block bno into the
+ * dnode's run cache. Index nodes are searched by binary search for the last entry
+ * starting at or before bno, as the Linux kernel does. The range of logical blocks
+ * the leaf is responsible for is remembered, so that later requests within it need
+ * no disk access at all.
  */
-static fsw_status_t fsw_ext4_get_by_extent(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
-                                        struct fsw_extent *extent)
+static fsw_status_t fsw_ext4_load_leaf(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
+                                       fsw_u32 bno)
 {
   fsw_status_t  status;
-  fsw_u32       bno;
-  //, release_bno,
-  fsw_u32       buf_offset;
-  //, file_bcnt;
-  int           ext_cnt;
-  void          *buffer;
+  struct ext4_extent_header  *header;
+  struct ext4_extent_idx     *idx;
+  struct ext4_extent         *ext;
+  struct fsw_ext4_extent_run *run;
+  void          *buffer = NULL;
+  fsw_u64       buf_bno = 0, phys;
+  fsw_u32       first, last, max_entries, len, i, lo, hi, size;
+  int           depth;
   
-  struct ext4_extent_header  *ext4_extent_header;
-  struct ext4_extent_idx     *ext4_extent_idx;
-  struct ext4_extent         *ext4_extent;
+  dno->leaf_valid = 0;
+  first = 0;
+  last = 0xFFFFFFFF;
   
-  // Logical block requested by core...
-  bno = extent->log_start;
+  // First node is the i_block field from inode...
+  header = (struct ext4_extent_header *)dno->raw->i_block;
+  max_entries = (sizeof(dno->raw->i_block) - sizeof(struct ext4_extent_header)) / sizeof(struct ext4_extent);
+  depth = header->eh_depth;
+  if (depth > EXT4_MAX_EXTENT_DEPTH)
+    return FSW_VOLUME_CORRUPTED;
   
-  // First buffer is the i_block field from inode...
-  buffer = (void *)dno->raw->i_block;
-  buf_offset = 0;
-  while(1) {
-    ext4_extent_header = (struct ext4_extent_header *)((char *)buffer + buf_offset);
-    buf_offset += sizeof(struct ext4_extent_header);
- //   FSW_MSG_DEBUG((FSW_MSGSTR("fsw_ext4_get_by_extent: extent header with %d entries\n"),
- //                  ext4_extent_header->eh_entries));
-    if(ext4_extent_header->eh_magic != EXT4_EXT_MAGIC)
-      return FSW_VOLUME_CORRUPTED;
+  while (1) {
+    if (header->eh_magic != EXT4_EXT_MAGIC || header->eh_depth != depth ||
+        header->eh_entries > max_entries) {
+      status = FSW_VOLUME_CORRUPTED;
+      goto done;
+    }
+    if (depth == 0)
+      break;
     
-    for(ext_cnt = 0;ext_cnt < ext4_extent_header->eh_entries;ext_cnt++)
-    {
-      if(ext4_extent_header->eh_depth == 0)
-      {
-        // Leaf node, the header follows actual extents
-        ext4_extent = (struct ext4_extent *)((char *)buffer + buf_offset);
-        buf_offset += sizeof(struct ext4_extent);
- //       FSW_MSG_DEBUG((FSW_MSGSTR("fsw_ext4_get_by_extent: extent node cover %d...\n"), ext4_extent->ee_block));
-        
-        // Is the requested block in this extent?
-        if(bno >= ext4_extent->ee_block && bno < ext4_extent->ee_block + ext4_extent->ee_len)
-        {
-          extent->phys_start = ext4_extent->ee_start_lo + (bno - ext4_extent->ee_block);
-          extent->log_count = ext4_extent->ee_len - (bno - ext4_extent->ee_block);
-          return FSW_SUCCESS;
-        }
-      }
+    // Index node, follow the last entry starting at or before bno
+    idx = (struct ext4_extent_idx *)(header + 1);
+    if (header->eh_entries == 0) {
+      status = FSW_VOLUME_CORRUPTED;
+      goto done;
+    }
+    lo = 1;
+    hi = header->eh_entries;
+    while (lo < hi) {
+      i = (lo + hi) / 2;
+      if (idx[i].ei_block <= bno)
+        lo = i + 1;
       else
-      {
-  //      FSW_MSG_DEBUG((FSW_MSGSTR("fsw_ext4_get_by_extent: index extents, depth %d\n"),
-  //                     ext4_extent_header->eh_depth));
-        ext4_extent_idx = (struct ext4_extent_idx *)((char *)buffer + buf_offset);
-        buf_offset += sizeof(struct ext4_extent_idx);
-        
- //       FSW_MSG_DEBUG((FSW_MSGSTR("fsw_ext4_get_by_extent: index node covers block %d...\n"),
- //                      ext4_extent_idx->ei_block));
-        if(bno >= ext4_extent_idx->ei_block)
-        {
-          // Follow extent tree...
-          status = fsw_block_get(vol, ext4_extent_idx->ei_leaf_lo, 1, (void **)&buffer);
-          if (status)
-            return status;
-          buf_offset = 0;
-          break;
-        }
+        hi = i;
+    }
+    i = lo - 1;
+    if (i + 1 < header->eh_entries) {
+      if (idx[i + 1].ei_block <= idx[i].ei_block || idx[i + 1].ei_block <= first) {
+        status = FSW_VOLUME_CORRUPTED;
+        goto done;
       }
+      last = idx[i + 1].ei_block - 1;
+    }
+    if (i > 0)
+      first = idx[i].ei_block;
+    phys = ((fsw_u64)idx[i].ei_leaf_hi << 32) | idx[i].ei_leaf_lo;
+    
+    if (buffer)
+      fsw_block_release(vol, buf_bno, buffer);
+    status = fsw_block_get(vol, phys, 1, &buffer);
+    if (status) {
+      buffer = NULL;
+      goto done;
+    }
+    buf_bno = phys;
+    header = (struct ext4_extent_header *)buffer;
+    max_entries = (vol->g.phys_blocksize - sizeof(struct ext4_extent_header)) / sizeof(struct ext4_extent);
+    depth--;
+  }
+  
+  // Leaf node, make room for all of its extents
+  if (dno->leaf_size < header->eh_entries) {
+    if (dno->leaf_runs)
+      fsw_free(dno->leaf_runs);
+    dno->leaf_runs = NULL;
+    dno->leaf_size = 0;
+    size = (vol->g.phys_blocksize - sizeof(struct ext4_extent_header)) / sizeof(struct ext4_extent);
+    if (size < header->eh_entries)
+      size = header->eh_entries;
+    status = fsw_alloc(size * sizeof(struct fsw_ext4_extent_run), &dno->leaf_runs);
+    if (status)
+      goto done;
+    dno->leaf_size = size;
+  }
+  
+  // Decode the extents, merging the ones which continue each other on disk
+  ext = (struct ext4_extent *)(header + 1);
+  run = NULL;
+  dno->leaf_count = 0;
+  for (i = 0; i < header->eh_entries; i++) {
+    len = ext[i].ee_len;
+    if (len > EXT_INIT_MAX_LEN)
+      len -= EXT_INIT_MAX_LEN;
+    phys = ((fsw_u64)ext[i].ee_start_hi << 32) | ext[i].ee_start_lo;
+    if (len == 0 || ext[i].ee_block + (len - 1) < ext[i].ee_block ||
+        (run && ext[i].ee_block < run->log_start + run->count)) {
+      status = FSW_VOLUME_CORRUPTED;
+      goto done;
+    }
+    if (run && run->log_start + run->count == ext[i].ee_block &&
+        run->uninit == (ext[i].ee_len > EXT_INIT_MAX_LEN) &&
+        (run->uninit || run->phys_start + run->count == phys)) {
+      run->count += len;
+      continue;
     }
+    run = &dno->leaf_runs[dno->leaf_count++];
+    run->log_start = ext[i].ee_block;
+    run->count = len;
+    run->phys_start = phys;
+    run->uninit = (ext[i].ee_len > EXT_INIT_MAX_LEN);
   }
+  dno->leaf_first = first;
+  dno->leaf_last = last;
+  dno->leaf_valid = 1;
+  status = FSW_SUCCESS;
   
-  return FSW_NOT_FOUND;
+done:
+  if (buffer)
+    fsw_block_release(vol, buf_bno, buffer);
+  return status;
+}
+
+/**
+ * New ext4 extents. The leaf covering the requested block is decoded once and kept
+ * with the dnode, the run holding the block is then found by binary search. The
+ * returned extent reaches up to the end of that run; blocks not covered by any
+ * extent, as well as uninitialized extents, are returned as sparse.
+ */
+static fsw_status_t fsw_ext4_get_by_extent(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
+                                        struct fsw_extent *extent)
+{
+  fsw_status_t  status;
+  fsw_u32       bno, lo, hi, mid;
+  fsw_u64       count, file_bcnt;
+  struct fsw_ext4_extent_run *run;
+  
+  // Logical block requested by core...
+  bno = extent->log_start;
+  
+  if (!dno->leaf_valid || bno < dno->leaf_first || bno > dno->leaf_last) {
+    status = fsw_ext4_load_leaf(vol, dno, bno);
+    if (status)
+      return status;
+  }
+  
+  // Find the first run starting after bno, the one before may hold it
+  lo = 0;
+  hi = dno->leaf_count;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (dno->leaf_runs[mid].log_start <= bno)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  run = (lo > 0) ? &dno->leaf_runs[lo - 1] : NULL;
+  
+  if (run && bno - run->log_start < run->count) {
+    count = run->count - (bno - run->log_start);
+    if (run->uninit)
+      extent->type = FSW_EXTENT_TYPE_SPARSE;
+    else
+      extent->phys_start = run->phys_start + (bno - run->log_start);
+  } else {
+    // A hole up to the next extent or the end of the leaf
+    if (lo < dno->leaf_count)
+      count = dno->leaf_runs[lo].log_start - bno;
+    else
+      count = (fsw_u64)dno->leaf_last - bno + 1;
+    extent->type = FSW_EXTENT_TYPE_SPARSE;
+  }
+  
+  // The core fills sparse extents as a whole, keep them within the file
+  if (extent->type == FSW_EXTENT_TYPE_SPARSE) {
+    file_bcnt = (dno->g.size + vol->g.log_blocksize - 1) / vol->g.log_blocksize;
+    if (file_bcnt > bno && count > file_bcnt - bno)
+      count = file_bcnt - bno;
+  }
+  extent->log_count = (fsw_u32)count;
+  return FSW_SUCCESS;
 }
 
 /**
@@ -541,6 +687,359 @@ static fsw_status_t fsw_ext4_get_by_blkaddr(struct fsw_ext4_volume *vol, struct
   return FSW_SUCCESS;
 }
 
+/*
+ * Directory index hashes, as in the Linux kernel's fs/ext4/hash.c. The signed
+ * variants treat name bytes as signed char, which is what file systems created
+ * on x86 use; the superblock tells which kind a volume has.
+ */
+
+#define DX_DELTA 0x9E3779B9
+
+static void fsw_ext4_tea_transform(fsw_u32 buf[4], fsw_u32 const in[])
+{
+  fsw_u32 sum = 0;
+  fsw_u32 b0 = buf[0], b1 = buf[1];
+  fsw_u32 a = in[0], b = in[1], c = in[2], d = in[3];
+  int     n = 16;
+  
+  do {
+    sum += DX_DELTA;
+    b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+    b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+  } while (--n);
+  
+  buf[0] += b0;
+  buf[1] += b1;
+}
+
+#define DX_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define DX_G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define DX_H(x, y, z) ((x) ^ (y) ^ (z))
+#define DX_ROUND(f, a, b, c, d, x, s) \
+  (a += f(b, c, d) + (x), a = (a << (s)) | (a >> (32 - (s))))
+#define DX_K1 0
+#define DX_K2 013240474631UL
+#define DX_K3 015666365641UL
+
+static void fsw_ext4_half_md4_transform(fsw_u32 buf[4], fsw_u32 const in[8])
+{
+  fsw_u32 a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+  
+  // Round 1
+  DX_ROUND(DX_F, a, b, c, d, in[0] + DX_K1,  3);
+  DX_ROUND(DX_F, d, a, b, c, in[1] + DX_K1,  7);
+  DX_ROUND(DX_F, c, d, a, b, in[2] + DX_K1, 11);
+  DX_ROUND(DX_F, b, c, d, a, in[3] + DX_K1, 19);
+  DX_ROUND(DX_F, a, b, c, d, in[4] + DX_K1,  3);
+  DX_ROUND(DX_F, d, a, b, c, in[5] + DX_K1,  7);
+  DX_ROUND(DX_F, c, d, a, b, in[6] + DX_K1, 11);
+  DX_ROUND(DX_F, b, c, d, a, in[7] + DX_K1, 19);
+  
+  // Round 2
+  DX_ROUND(DX_G, a, b, c, d, in[1] + DX_K2,  3);
+  DX_ROUND(DX_G, d, a, b, c, in[3] + DX_K2,  5);
+  DX_ROUND(DX_G, c, d, a, b, in[5] + DX_K2,  9);
+  DX_ROUND(DX_G, b, c, d, a, in[7] + DX_K2, 13);
+  DX_ROUND(DX_G, a, b, c, d, in[0] + DX_K2,  3);
+  DX_ROUND(DX_G, d, a, b, c, in[2] + DX_K2,  5);
+  DX_ROUND(DX_G, c, d, a, b, in[4] + DX_K2,  9);
+  DX_ROUND(DX_G, b, c, d, a, in[6] + DX_K2, 13);
+  
+  // Round 3
+  DX_ROUND(DX_H, a, b, c, d, in[3] + DX_K3,  3);
+  DX_ROUND(DX_H, d, a, b, c, in[7] + DX_K3,  9);
+  DX_ROUND(DX_H, c, d, a, b, in[2] + DX_K3, 11);
+  DX_ROUND(DX_H, b, c, d, a, in[6] + DX_K3, 15);
+  DX_ROUND(DX_H, a, b, c, d, in[1] + DX_K3,  3);
+  DX_ROUND(DX_H, d, a, b, c, in[5] + DX_K3,  9);
+  DX_ROUND(DX_H, c, d, a, b, in[0] + DX_K3, 11);
+  DX_ROUND(DX_H, b, c, d, a, in[4] + DX_K3, 15);
+  
+  buf[0] += a;
+  buf[1] += b;
+  buf[2] += c;
+  buf[3] += d;
+}
+
+// The old legacy hash
+static fsw_u32 fsw_ext4_dx_hack_hash(const fsw_u8 *name, int len, int is_signed)
+{
+  fsw_u32 hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+  int     c;
+  
+  while (len--) {
+    c = is_signed ? (int)(fsw_s8)*name++ : (int)*name++;
+    hash = hash1 + (hash0 ^ (fsw_u32)(c * 7152373));
+    if (hash & 0x80000000)
+      hash -= 0x7fffffff;
+    hash1 = hash0;
+    hash0 = hash;
+  }
+  return hash0 << 1;
+}
+
+static void fsw_ext4_str2hashbuf(const fsw_u8 *msg, int len, fsw_u32 *buf, int num, int is_signed)
+{
+  fsw_u32 pad, val;
+  int     i, c;
+  
+  pad = (fsw_u32)len | ((fsw_u32)len << 8);
+  pad |= pad << 16;
+  
+  val = pad;
+  if (len > num * 4)
+    len = num * 4;
+  for (i = 0; i < len; i++) {
+    c = is_signed ? (int)(fsw_s8)msg[i] : (int)msg[i];
+    val = (fsw_u32)c + (val << 8);
+    if ((i % 4) == 3) {
+      *buf++ = val;
+      val = pad;
+      num--;
+    }
+  }
+  if (--num >= 0)
+    *buf++ = val;
+  while (--num >= 0)
+    *buf++ = pad;
+}
+
+/**
+ * Compute the major hash of a name the way it is stored in a directory index.
+ */
+static fsw_u32 fsw_ext4_dx_hash(int hash_version, fsw_u32 *seed, const fsw_u8 *name, int len)
+{
+  fsw_u32 hash = 0, buf[4], in[8];
+  int     i, is_signed;
+  
+  buf[0] = 0x67452301;
+  buf[1] = 0xefcdab89;
+  buf[2] = 0x98badcfe;
+  buf[3] = 0x10325476;
+  for (i = 0; i < 4; i++) {
+    if (seed[i]) {
+      fsw_memcpy(buf, seed, sizeof(buf));
+      break;
+    }
+  }
+  
+  is_signed = (hash_version < DX_HASH_LEGACY_UNSIGNED);
+  switch (hash_version) {
+    case DX_HASH_LEGACY:
+    case DX_HASH_LEGACY_UNSIGNED:
+      hash = fsw_ext4_dx_hack_hash(name, len, is_signed);
+      break;
+    case DX_HASH_HALF_MD4:
+    case DX_HASH_HALF_MD4_UNSIGNED:
+      for (; len > 0; len -= 32, name += 32) {
+        fsw_ext4_str2hashbuf(name, len, in, 8, is_signed);
+        fsw_ext4_half_md4_transform(buf, in);
+      }
+      hash = buf[1];
+      break;
+    case DX_HASH_TEA:
+    case DX_HASH_TEA_UNSIGNED:
+      for (; len > 0; len -= 16, name += 16) {
+        fsw_ext4_str2hashbuf(name, len, in, 4, is_signed);
+        fsw_ext4_tea_transform(buf, in);
+      }
+      hash = buf[0];
+      break;
+  }
+  
+  hash &= ~1;
+  if (hash == (EXT4_HTREE_EOF_32BIT << 1))
+    hash = (EXT4_HTREE_EOF_32BIT - 1) << 1;
+  return hash;
+}
+
+/**
+ * Find the index entry of a dx node covering hash: the last one whose hash is not
+ * above it. The first entry holds the count and limit and covers everything below
+ * the second one. Returns the number of entries, or zero if the node is damaged.
+ */
+static fsw_u32 fsw_ext4_dx_probe_node(fsw_u8 *buffer, fsw_u32 offset, fsw_u32 blocksize,
+                                      fsw_u32 hash, fsw_u32 *at)
+{
+  struct dx_countlimit *countlimit = (struct dx_countlimit *)(buffer + offset);
+  struct dx_entry      *entries = (struct dx_entry *)(buffer + offset);
+  fsw_u32              lo, hi, mid;
+  
+  if (offset >= blocksize || countlimit->count == 0 || countlimit->count > countlimit->limit ||
+      countlimit->limit > (blocksize - offset) / sizeof(struct dx_entry))
+    return 0;
+  
+  lo = 1;
+  hi = countlimit->count;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (entries[mid].hash <= hash)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  *at = lo - 1;
+  return countlimit->count;
+}
+
+/**
+ * Read a logical block of the directory into buffer.
+ */
+static fsw_status_t fsw_ext4_dx_read_block(struct fsw_ext4_volume *vol, struct fsw_shandle *shand,
+                                          fsw_u32 block, fsw_u8 *buffer)
+{
+  fsw_status_t  status;
+  fsw_u32       buffer_size = vol->g.log_blocksize;
+  
+  if ((fsw_u64)(block + 1) * vol->g.log_blocksize > shand->dnode->size)
+    return FSW_UNSUPPORTED;
+  shand->pos = (fsw_u64)block * vol->g.log_blocksize;
+  status = fsw_shandle_read(shand, &buffer_size, buffer);
+  if (status)
+    return status;
+  if (buffer_size != vol->g.log_blocksize)
+    return FSW_VOLUME_CORRUPTED;
+  return FSW_SUCCESS;
+}
+
+/**
+ * Look up a name in a hash-indexed directory. The index is walked down to the leaf
+ * block whose hash range holds the name, and only that block is searched; the
+ * following ones are searched too while their hash continues the same value after
+ * a collision. Names are compared byte by byte. Returns FSW_UNSUPPORTED or
+ * FSW_VOLUME_CORRUPTED if the index cannot be used, the caller then scans the
+ * directory linearly.
+ */
+static fsw_status_t fsw_ext4_dx_lookup(struct fsw_ext4_volume *vol, struct fsw_ext4_dnode *dno,
+                                       struct fsw_string *lookup_name, struct ext4_dir_entry *entry)
+{
+  fsw_status_t        status;
+  struct fsw_shandle  shand;
+  struct fsw_string   name;
+  struct dx_root_info *info;
+  struct dx_entry     *entries;
+  struct ext4_dir_entry *dirent;
+  fsw_u8              *buffer, *node[EXT4_HTREE_LEVEL_COMPAT + 1], *leaf;
+  fsw_u32             offset[EXT4_HTREE_LEVEL_COMPAT], count[EXT4_HTREE_LEVEL_COMPAT], at[EXT4_HTREE_LEVEL_COMPAT];
+  fsw_u32             blocksize = vol->g.log_blocksize;
+  fsw_u32             hash, block, pos;
+  int                 hash_version, levels, level;
+  
+  status = fsw_strdup_coerce(&name, FSW_STRING_TYPE_ISO88591, lookup_name);
+  if (status)
+    return status;
+  if (name.len == 0 || name.len > EXT4_NAME_LEN) {
+    fsw_strfree(&name);
+    return FSW_NOT_FOUND;
+  }
+  
+  status = fsw_alloc(blocksize * (EXT4_HTREE_LEVEL_COMPAT + 1), &buffer);
+  if (status) {
+    fsw_strfree(&name);
+    return status;
+  }
+  for (level = 0; level <= EXT4_HTREE_LEVEL_COMPAT; level++)
+    node[level] = buffer + level * blocksize;
+  
+  shand.dnode = NULL;
+  status = fsw_shandle_open(dno, &shand);
+  if (status)
+    goto errorexit;
+  
+  // dx_root follows "." and ".." in block 0
+  status = fsw_ext4_dx_read_block(vol, &shand, 0, node[0]);
+  if (status)
+    goto errorexit;
+  info = (struct dx_root_info *)(node[0] + EXT4_DX_ROOT_INFO_OFFSET);
+  hash_version = info->hash_version;
+  levels = info->indirect_levels + 1;
+  if (info->reserved_zero != 0 || (info->unused_flags & 1) || hash_version > DX_HASH_TEA ||
+      levels > EXT4_HTREE_LEVEL_COMPAT) {
+    status = FSW_UNSUPPORTED;
+    goto errorexit;
+  }
+  if (vol->sb->s_flags & EXT2_FLAGS_UNSIGNED_HASH)
+    hash_version += DX_HASH_LEGACY_UNSIGNED;
+  hash = fsw_ext4_dx_hash(hash_version, vol->sb->s_hash_seed, name.data, name.len);
+  
+  // walk down the index
+  offset[0] = EXT4_DX_ROOT_INFO_OFFSET + info->info_length;
+  for (level = 0; level < levels; level++) {
+    if (level > 0) {
+      entries = (struct dx_entry *)(node[level - 1] + offset[level - 1]);
+      status = fsw_ext4_dx_read_block(vol, &shand, entries[at[level - 1]].block & 0x0fffffff, node[level]);
+      if (status)
+        goto errorexit;
+      offset[level] = EXT4_DX_NODE_OFFSET;
+    }
+    count[level] = fsw_ext4_dx_probe_node(node[level], offset[level], blocksize, hash, &at[level]);
+    if (count[level] == 0) {
+      status = FSW_UNSUPPORTED;
+      goto errorexit;
+    }
+  }
+  
+  leaf = node[levels];
+  while (1) {
+    // search the leaf block
+    entries = (struct dx_entry *)(node[levels - 1] + offset[levels - 1]);
+    block = entries[at[levels - 1]].block & 0x0fffffff;
+    status = fsw_ext4_dx_read_block(vol, &shand, block, leaf);
+    if (status)
+      goto errorexit;
+    for (pos = 0; pos + 8 <= blocksize; pos += dirent->rec_len) {
+      dirent = (struct ext4_dir_entry *)(leaf + pos);
+      if (dirent->rec_len < 8 || dirent->rec_len > blocksize - pos ||
+          dirent->rec_len < 8 + dirent->name_len) {
+        status = FSW_VOLUME_CORRUPTED;
+        goto errorexit;
+      }
+      if (dirent->inode != 0 && dirent->name_len == name.len &&
+          fsw_memeq(dirent->name, name.data, name.len)) {
+        fsw_memcpy(entry, dirent, 8 + dirent->name_len);
+        status = FSW_SUCCESS;
+        goto errorexit;
+      }
+    }
+    
+    // a name whose hash collides may continue in the next leaf, which then
+    // starts with the same hash and the low bit set
+    for (level = levels - 1; level >= 0; level--) {
+      if (at[level] + 1 < count[level])
+        break;
+    }
+    if (level < 0) {
+      status = FSW_NOT_FOUND;
+      goto errorexit;
+    }
+    at[level]++;
+    entries = (struct dx_entry *)(node[level] + offset[level]);
+    if ((entries[at[level]].hash & ~1) != hash) {
+      status = FSW_NOT_FOUND;
+      goto errorexit;
+    }
+    for (level++; level < levels; level++) {
+      entries = (struct dx_entry *)(node[level - 1] + offset[level - 1]);
+      status = fsw_ext4_dx_read_block(vol, &shand, entries[at[level - 1]].block & 0x0fffffff, node[level]);
+      if (status)
+        goto errorexit;
+      offset[level] = EXT4_DX_NODE_OFFSET;
+      count[level] = fsw_ext4_dx_probe_node(node[level], offset[level], blocksize, 0, &at[level]);
+      if (count[level] == 0) {
+        status = FSW_UNSUPPORTED;
+        goto errorexit;
+      }
+    }
+  }
+  
+errorexit:
+  if (shand.dnode)
+    fsw_shandle_close(&shand);
+  fsw_free(buffer);
+  fsw_strfree(&name);
+  return status;
+}
+
 /**
  * Lookup a directory's child dnode by name. This function is called on a directory
  * to retrieve the directory entry with the given name. A dnode is constructed for
@@ -561,6 +1060,21 @@ static fsw_status_t fsw_ext4_dir_lookup(struct fsw_ext4_volume *vol, struct fsw_
 
     entry_name.type = FSW_STRING_TYPE_ISO88591;
 
+    // hash-indexed directories lead straight to the leaf block holding the name
+    if ((dno->raw->i_flags & EXT4_INDEX_FL) &&
+        (vol->sb->s_feature_compat & EXT4_FEATURE_COMPAT_DIR_INDEX)) {
+        status = fsw_ext4_dx_lookup(vol, dno, lookup_name, &entry);
+        if (status == FSW_SUCCESS) {
+            entry_name.len = entry_name.size = entry.name_len;
+            entry_name.data = entry.name;
+            return fsw_dnode_create(dno, entry.inode, FSW_DNODE_TYPE_UNKNOWN, &entry_name, child_dno_out);
+        }
+        // the index is trusted for names it does not hold, ext4 names are case
+        // sensitive, only a damaged or unknown index is scanned below
+        if (status != FSW_UNSUPPORTED && status != FSW_VOLUME_CORRUPTED)
+            return status;
+    }
+
     // setup handle to read the directory
     status = fsw_shandle_open(dno, &shand);
     if (status)
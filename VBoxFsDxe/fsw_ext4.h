@@ -46,12 +46,24 @@ struct fsw_ext4_volume {
     struct fsw_volume g;            //!< Generic volume structure
     
     struct ext4_super_block *sb;    //!< Full raw ext2 superblock structure
-    fsw_u32     *inotab_bno;        //!< Block numbers of the inode tables
+    fsw_u64     *inotab_bno;        //!< Block numbers of the inode tables
     fsw_u32     ind_bcnt;           //!< Number of blocks addressable through an indirect block
     fsw_u32     dind_bcnt;          //!< Number of blocks addressable through a double-indirect block
     fsw_u32     inode_size;         //!< Size of inode structure in bytes
 };
 
+/**
+ * ext4: Run of file blocks decoded from a leaf of the extent tree. Adjacent
+ * extents which are contiguous on disk are merged into one run.
+ */
+
+struct fsw_ext4_extent_run {
+    fsw_u32     log_start;          //!< First logical block of the run
+    fsw_u32     count;              //!< Number of blocks in the run
+    fsw_u64     phys_start;         //!< First physical block of the run
+    int         uninit;             //!< Blocks are allocated but not written, they read as zeros
+};
+
 /**
  * ext2: Dnode structure with ext2-specific data.
  */
@@ -60,6 +72,13 @@ struct fsw_ext4_dnode {
     struct fsw_dnode g;             //!< Generic dnode structure
     
     struct ext4_inode *raw;         //!< Full raw inode structure
+
+    struct fsw_ext4_extent_run *leaf_runs;  //!< Runs of the extent tree leaf used last
+    fsw_u32     leaf_count;         //!< Number of runs in leaf_runs
+    fsw_u32     leaf_size;          //!< Allocated size of leaf_runs
+    fsw_u32     leaf_first;         //!< First logical block covered by that leaf
+    fsw_u32     leaf_last;          //!< Last logical block covered by that leaf
+    int         leaf_valid;         //!< leaf_runs holds a decoded leaf
 };
 
 
@@ -381,9 +381,17 @@ struct ext4_super_block {
 
 #define EXT4_GOOD_OLD_INODE_SIZE 128
 
+/*
+ * Misc. filesystem flags (s_flags)
+ */
+#define EXT2_FLAGS_SIGNED_HASH          0x0001  /* Signed dirhash in use */
+#define EXT2_FLAGS_UNSIGNED_HASH        0x0002  /* Unsigned dirhash in use */
+
 /*
  * Feature set definitions (only the once we need for read support)
  */
+#define EXT4_FEATURE_COMPAT_DIR_INDEX           0x0020
+
 #define EXT4_FEATURE_RO_COMPAT_SPARSE_SUPER     0x0001
 
 #define EXT4_FEATURE_INCOMPAT_COMPRESSION	0x0001
@@ -424,6 +432,44 @@ struct ext4_dir_entry {
 // NOTE: The original Linux kernel header defines ext4_dir_entry with the original
 //  layout and ext4_dir_entry_2 with the revised layout. We simply use the revised one.
 
+/*
+ * Hash tree (htree) of an EXT4_INDEX_FL directory. Block 0 of the directory
+ * starts with the "." and ".." entries, followed by dx_root_info and the
+ * dx_entry array of the root. Interior nodes are blocks with a single empty
+ * entry spanning the block, followed by their dx_entry array. The first
+ * dx_entry of every node holds a dx_countlimit in place of its hash.
+ */
+#define DX_HASH_LEGACY              0
+#define DX_HASH_HALF_MD4            1
+#define DX_HASH_TEA                 2
+#define DX_HASH_LEGACY_UNSIGNED     3
+#define DX_HASH_HALF_MD4_UNSIGNED   4
+#define DX_HASH_TEA_UNSIGNED        5
+
+#define EXT4_HTREE_EOF_32BIT        0x7fffffff
+#define EXT4_HTREE_LEVEL_COMPAT     2       /* index levels without large_dir */
+
+struct dx_root_info {
+    __le32  reserved_zero;
+    __u8    hash_version;
+    __u8    info_length;            /* 8 */
+    __u8    indirect_levels;
+    __u8    unused_flags;
+};
+
+struct dx_countlimit {
+    __le16  limit;
+    __le16  count;
+};
+
+struct dx_entry {
+    __le32  hash;
+    __le32  block;
+};
+
+#define EXT4_DX_ROOT_INFO_OFFSET    24      /* after the "." and ".." entries */
+#define EXT4_DX_NODE_OFFSET         8       /* after the empty entry */
+
 /*
  * Ext2 directory file types.  Only the low 3 bits are used.  The
  * other bits are reserved for now.
@@ -496,5 +542,12 @@ struct ext4_extent_header {
 
 #define EXT4_EXT_MAGIC		(0xf30a)
 
+/*
+ * ee_len above EXT_INIT_MAX_LEN marks an allocated but uninitialized extent
+ * of (ee_len - EXT_INIT_MAX_LEN) blocks, which reads as zeros.
+ */
+#define EXT_INIT_MAX_LEN	(1UL << 15)
+#define EXT4_MAX_EXTENT_DEPTH	5
+
 
 #endif
@@ -27,11 +27,12 @@
 
 #include "fsw_hfs.h"
 
+#ifndef HOST_POSIX
 #include <Library/MemLogLib.h>
 #include <Library/PrintLib.h>
+#endif
 
 
-#define VBOXHFS_BTREE_BINSEARCH 0
 #define DEBUG_HFS 0
 
 #if DEBUG_HFS==2
@@ -81,6 +82,7 @@ static fsw_status_t fsw_hfs_read_dirrec(struct fsw_shandle *shand, struct hfs_di
 static fsw_status_t fsw_hfs_readlink(struct fsw_hfs_volume *vol,
                                      struct fsw_hfs_dnode *dno,
                                      struct fsw_string *link);
+static void         fsw_hfs_btree_free_cache(struct fsw_hfs_btree *btree);
 
 //
 // Dispatch Table
@@ -95,7 +97,7 @@ struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(hfs) = {
     fsw_hfs_volume_free,  // volume close
     fsw_hfs_volume_stat,  // volume info: total_bytes, free_bytes
     fsw_hfs_dnode_fill,   //return FSW_SUCCESS;
-    fsw_hfs_dnode_free,	  // empty
+    fsw_hfs_dnode_free,	  // free the extent map
     fsw_hfs_dnode_stat,	 //size and times
     fsw_hfs_get_extent,	 // get the physical disk block number for the requested logical block number
     fsw_hfs_dir_lookup,  //retrieve the directory entry with the given name
@@ -112,7 +114,7 @@ fsw_hfs_read_block (struct fsw_hfs_dnode    *dno,
 {
   fsw_status_t          status;
   struct fsw_extent     extent;
-  fsw_u32               phys_bno;
+  fsw_u64               phys_bno;
   fsw_u8                *buffer;
   
   extent.log_start = log_bno;
@@ -315,6 +317,7 @@ static fsw_status_t fsw_hfs_volume_mount(struct fsw_hfs_volume *vol)
     vol->case_sensitive =
     (signature == kHFSXSigWord) &&
     (tree_header.keyCompareType == kHFSBinaryCompare);
+    vol->g.lookup_fold = !vol->case_sensitive;
     vol->catalog_tree.root_node = be32_to_cpu (tree_header.rootNode);
     vol->catalog_tree.node_size = be16_to_cpu (tree_header.nodeSize);
     //nms42
@@ -402,6 +405,8 @@ static void fsw_hfs_volume_free(struct fsw_hfs_volume *vol)
     fsw_dnode_release((struct fsw_dnode*)(vol->extents_tree.file));
     vol->extents_tree.file = NULL;
   }
+  fsw_hfs_btree_free_cache(&vol->catalog_tree);
+  fsw_hfs_btree_free_cache(&vol->extents_tree);
 }
 
 /**
@@ -435,6 +440,10 @@ static fsw_status_t fsw_hfs_dnode_fill(struct fsw_hfs_volume *vol, struct fsw_hf
 
 static void fsw_hfs_dnode_free(struct fsw_hfs_volume *vol, struct fsw_hfs_dnode *dno)
 {
+  if (dno->ext_map) {
+    fsw_free(dno->ext_map);
+    dno->ext_map = NULL;
+  }
 }
 
 static fsw_u32 mac_to_posix(fsw_u32 mac_time)
@@ -464,31 +473,6 @@ static fsw_status_t fsw_hfs_dnode_stat(struct fsw_hfs_volume *vol,
   return FSW_SUCCESS;
 }
 
-static int
-fsw_hfs_find_block(HFSPlusExtentRecord *exts,
-                   fsw_u32             *lbno,
-                   fsw_u32             *pbno)
-{
-  int i;
-  fsw_u32 cur_lbno = *lbno;
-//  DBG("search for lbno=%d\n", *lbno);
-  
-  for (i = 0; i < 8; i++) {
-    fsw_u32 start = be32_to_cpu ((*exts)[i].startBlock);
-    fsw_u32 count = be32_to_cpu ((*exts)[i].blockCount);
-    
-    if (cur_lbno < count) {
-      *pbno = start + cur_lbno;
-//      DBG("found block %d in segment %d\n", *pbno, i);
-      return 1;
-    }
-    cur_lbno -= count;
-  }
-  
-  *lbno = cur_lbno;
-  return 0;
-}
-
 //
 // Find record offset, numbering starts from the end
 //
@@ -520,10 +504,15 @@ fsw_hfs_btree_rec (struct fsw_hfs_btree   *btree,
   fsw_u8 *cnode = (fsw_u8 *)node;
   fsw_u32 offset;
   offset = fsw_hfs_btree_recoffset(btree, node, index);
-  if (offset < sizeof(BTNodeDescriptor) || offset > btree->node_size) {
+  if (offset < sizeof(BTNodeDescriptor) || offset + 2 > btree->node_size) {
     DBG(" wrong offset %d\n", offset);
     return NULL;
   }
+  // the key must fit into the node too
+  if (offset + 2 + be16_to_cpu(((BTreeKey *)(cnode + offset))->length16) > btree->node_size) {
+    DBG(" wrong key length at offset %d\n", offset);
+    return NULL;
+  }
   return (BTreeKey *)(cnode + offset);
 }
 
@@ -539,6 +528,192 @@ fsw_hfs_btree_next_node (BTreeKey *currkey)
   return be32_to_cpu_ua(pointer);
 }
 
+//
+// Check the record offsets of a node just read: the first record follows
+// the descriptor, the records go up and end before the offsets table
+//
+static int
+fsw_hfs_btree_node_valid (struct fsw_hfs_btree *btree,
+                          BTNodeDescriptor     *node)
+{
+  fsw_u8  *cnode = (fsw_u8 *)node;
+  fsw_u32 count = be16_to_cpu (node->numRecords);
+  fsw_u32 offset, prev, i;
+
+  if (sizeof (BTNodeDescriptor) + (count + 1) * 2 > btree->node_size) {
+    return 0;
+  }
+  prev = 0;
+  for (i = 0; i <= count; i++) { //offset of the free space is the last one
+    offset = be16_to_cpu (*(fsw_u16 *) (cnode + btree->node_size - i * 2 - 2));
+    if ((i == 0 && offset != sizeof (BTNodeDescriptor)) ||
+        (i > 0 && offset <= prev) ||
+        offset > btree->node_size - (count + 1) * 2) {
+      return 0;
+    }
+    prev = offset;
+  }
+  return 1;
+}
+
+//
+// Get the node from the B-tree node cache, reading it if needed.
+// Must be given back by fsw_hfs_btree_release.
+//
+static fsw_status_t
+fsw_hfs_btree_get_node (struct fsw_hfs_btree *btree,
+                        fsw_u32              node_no,
+                        BTNodeDescriptor   **node_out)
+{
+  fsw_status_t         status;
+  struct fsw_hfs_bnode *bn;
+  struct fsw_hfs_bnode *leaf = NULL;
+  struct fsw_hfs_bnode *index = NULL;
+  struct fsw_hfs_bnode *victim = NULL;
+  fsw_u32              pinned = 0;
+  int                  i;
+
+  btree->clock++;
+  for (i = 0; i < FSW_HFS_BNODE_CACHE; i++) {
+    bn = &btree->cache[i];
+    if (bn->data == NULL) {
+      if (victim == NULL) {
+        victim = bn;
+      }
+      continue;
+    }
+    if (bn->node_no == node_no && node_no != FSW_HFS_BNODE_NONE) {
+      bn->refs++;
+      bn->stamp = btree->clock;
+      *node_out = (BTNodeDescriptor *) bn->data;
+      return FSW_SUCCESS;
+    }
+    if (bn->node_no != FSW_HFS_BNODE_NONE &&
+        ((BTNodeDescriptor *) bn->data)->kind == kBTIndexNode) {
+      pinned++;
+      if (bn->refs == 0 && (index == NULL || bn->stamp < index->stamp)) {
+        index = bn;
+      }
+    } else if (bn->refs == 0 && (leaf == NULL || bn->stamp < leaf->stamp)) {
+      leaf = bn;
+    }
+  }
+
+  // empty slot, else the oldest leaf; index nodes only over the pinned limit
+  if (victim == NULL) {
+    if (index != NULL && (leaf == NULL || pinned >= FSW_HFS_BNODE_PINNED)) {
+      victim = index;
+    } else {
+      victim = leaf;
+    }
+  }
+  if (victim == NULL) {
+    DBG("btree node cache: all nodes in use\n");
+    return FSW_OUT_OF_MEMORY;
+  }
+  if (victim->data == NULL) {
+    status = fsw_alloc(btree->node_size, &victim->data);
+    if (status) {
+      victim->data = NULL;
+      return status;
+    }
+  }
+  // keep the slot for us while reading
+  victim->node_no = FSW_HFS_BNODE_NONE;
+  victim->refs = 1;
+  victim->stamp = btree->clock;
+
+  if ((fsw_u32)fsw_hfs_read_file(btree->file,
+                                 MultU64x32(node_no, btree->node_size),
+                                 btree->node_size, victim->data) != btree->node_size) {
+    DBG("differ node size while read file\n");
+    victim->refs = 0;
+    return FSW_VOLUME_CORRUPTED;
+  }
+  if (!fsw_hfs_btree_node_valid(btree, (BTNodeDescriptor *) victim->data)) {
+    DBG("bad record offsets in node %d\n", node_no);
+    victim->refs = 0;
+    return FSW_VOLUME_CORRUPTED;
+  }
+  victim->node_no = node_no;
+  *node_out = (BTNodeDescriptor *) victim->data;
+  return FSW_SUCCESS;
+}
+
+static void
+fsw_hfs_btree_release (struct fsw_hfs_btree *btree,
+                       BTNodeDescriptor     *node)
+{
+  int i;
+
+  for (i = 0; i < FSW_HFS_BNODE_CACHE; i++) {
+    if (btree->cache[i].data == (fsw_u8 *) node) {
+      if (btree->cache[i].refs > 0) {
+        btree->cache[i].refs--;
+      }
+      return;
+    }
+  }
+}
+
+static void
+fsw_hfs_btree_free_cache (struct fsw_hfs_btree *btree)
+{
+  int i;
+
+  for (i = 0; i < FSW_HFS_BNODE_CACHE; i++) {
+    if (btree->cache[i].data != NULL) {
+      fsw_free(btree->cache[i].data);
+      btree->cache[i].data = NULL;
+    }
+  }
+  btree->last_leaf = 0;
+}
+
+//
+// Binary search inside the node. *recnum is the last record with the key
+// less or equal to the searched one, -1 if all are greater.
+//
+static fsw_status_t
+fsw_hfs_btree_find_rec (struct fsw_hfs_btree *btree,
+                        BTNodeDescriptor     *node,
+                        BTreeKey             *key,
+                        int (*compare_keys) (BTreeKey *key1, BTreeKey *key2),
+                        fsw_s32              *recnum,
+                        int                  *match)
+{
+  fsw_u32  lower = 0;
+  fsw_u32  upper = be16_to_cpu (node->numRecords);
+  fsw_u32  middle;
+  fsw_s32  cmp;
+  BTreeKey *currkey;
+
+  *match = 0;
+  while (lower < upper) {
+    middle = (lower + upper) / 2;
+    currkey = fsw_hfs_btree_rec (btree, node, middle);
+    if (currkey == NULL) {
+      return FSW_VOLUME_CORRUPTED;
+    }
+    cmp = compare_keys (currkey, key);  //fsw_hfs_cmpi_catkey
+    if (cmp == 0) {
+      *recnum = (fsw_s32)middle;
+      *match = 1;
+      return FSW_SUCCESS;
+    }
+    if (cmp < 0) {
+      lower = middle + 1;
+    } else {
+      upper = middle;
+    }
+  }
+  *recnum = (fsw_s32)lower - 1;
+  return FSW_SUCCESS;
+}
+
+//
+// The node is taken from the B-tree node cache, give it back by fsw_hfs_btree_release
+//
 static fsw_status_t
 fsw_hfs_btree_search (struct fsw_hfs_btree *btree,
                       BTreeKey             *key,
@@ -547,157 +722,82 @@ fsw_hfs_btree_search (struct fsw_hfs_btree *btree,
                       fsw_u32              *key_offset)
 {
   fsw_status_t status;
-  fsw_u8 *buffer = NULL;
   BTNodeDescriptor *node;
+  BTreeKey *currkey;
   fsw_u32 currnode;
-  fsw_u32 recnum;
-#ifdef VBOXHFS_BTREE_BINSEARCH
-  fsw_u32 lower, upper;
-#endif
-
-  currnode = btree->root_node; //always from root?
-  status = fsw_alloc(btree->node_size, &buffer);
-  if (status != FSW_SUCCESS) {
-    fsw_free(buffer);
-    return status;
-  }
-  node = (BTNodeDescriptor *) buffer;
-
-  for (;;) { //node cycle
-    fsw_s32 cmp = 0;
-    int match;
-    fsw_u32 count;
-    BTreeKey *currkey;
-
-    match = 0;
-    /* Read a node */
-    if ((fsw_u32)fsw_hfs_read_file(btree->file,
-                                   MultU64x32(currnode, btree->node_size),
-                                   btree->node_size, buffer) !=
-        btree->node_size) {
-          status = FSW_VOLUME_CORRUPTED;
-          DBG("differ node size while read file\n");
-          break;
-        }
-//check record0 pointing to end of descriptor
-    if (be16_to_cpu (*(fsw_u16 *) (buffer + btree->node_size - 2)) !=
-        sizeof (BTNodeDescriptor)) {
-      status = FSW_VOLUME_CORRUPTED;
-      DBG("differ BTNodeDescriptor\n");
-      break;
-    }
+  fsw_u32 count;
+  fsw_u32 depth;
+  fsw_s32 recnum;
+  int match;
+
+  /* Most lookups go to the same leaf as the last one, check it first */
+  if (btree->last_leaf != 0 &&
+      fsw_hfs_btree_get_node (btree, btree->last_leaf, &node) == FSW_SUCCESS) {
     count = be16_to_cpu (node->numRecords);
-
-#ifndef VBOXHFS_BTREE_BINSEARCH
-    //preliminary test for last record. May be not needed look all for this node
-    currkey = fsw_hfs_btree_rec (btree, node, count - 1);
-    cmp = compare_keys (currkey, key);
-    if ((cmp == 0) && (node->kind == kBTLeafNode)) {
-      /* Found!  */
-      *result = node;
-      *key_offset = recnum;
-      hardlink = 0;
-      return FSW_SUCCESS;
-    } else if (cmp < 0) { //all records has key less than searched
-      if (node->kind == kBTIndexNode) {
-        currnode = fsw_hfs_btree_next_node (currkey);
-      } else if (node->fLink) {
-        currnode = be32_to_cpu (node->fLink);
-      } else {
-        status = FSW_NOT_FOUND;
-        break;
+    if (node->kind == kBTLeafNode && count > 0 &&
+        fsw_hfs_btree_find_rec (btree, node, key, compare_keys, &recnum, &match) == FSW_SUCCESS) {
+      if (match) {
+        *result = node;
+        *key_offset = (fsw_u32)recnum;
+        hardlink = 0;
+        return FSW_SUCCESS;
       }
-      continue;
-    } //else search for all records
-    
-    for (recnum = 0; recnum < count; recnum++) {
-      currkey = fsw_hfs_btree_rec (btree, node, recnum);
-      cmp = compare_keys (currkey, key);  //fsw_hfs_cmpi_catkey
- //     DBG(": currnode %d rec=%d count %d cmp=%d kind=%d\n",
- //         currnode, recnum, count, cmp, node->kind);
-
-      /* Leaf node. */
-      if (node->kind == kBTLeafNode) {
-        if (cmp == 0) {
-          /* Found!  */
-          *result = node;
-          *key_offset = recnum;
-          hardlink = 0;
-          return FSW_SUCCESS;
-        }
-      } else if (node->kind == kBTIndexNode) {
-        if (cmp > 0)
-          break;
-        currnode = fsw_hfs_btree_next_node (currkey); //largest that <= search
+      // inside this leaf but not present
+      if (recnum >= 0 && (fsw_u32)recnum < count - 1) {
+        fsw_hfs_btree_release (btree, node);
+        return FSW_NOT_FOUND;
       }
     }
-    if (node->kind == kBTLeafNode) {
-      status = FSW_NOT_FOUND;
-      break;
-    }
+    fsw_hfs_btree_release (btree, node);
+  }
 
-    if (cmp <= 0 && node->fLink) {
-      currnode = be32_to_cpu (node->fLink);
+  currnode = btree->root_node;
+  for (depth = 0; depth < 16; depth++) { //HFS+ trees are at most 8 levels high
+    status = fsw_hfs_btree_get_node (btree, currnode, &node);
+    if (status) {
+      return status;
     }
-#else
-    /* Perform binary search */
-    lower = 0;
-    upper = count - 1;
-    currkey = NULL;
-
-    if (count == 0) {
-      status = FSW_NOT_FOUND;
-      goto done;
+    status = fsw_hfs_btree_find_rec (btree, node, key, compare_keys, &recnum, &match);
+    if (status) {
+      fsw_hfs_btree_release (btree, node);
+      return status;
     }
 
-    while (lower <= upper) {
-      recnum = (lower + upper) / 2;
-
-      currkey = fsw_hfs_btree_rec (btree, node, recnum);
-
-      cmp = compare_keys (currkey, key);  //fsw_hfs_cmpi_catkey
- //     DBG(": currnode %d lower/recnum/upper %d/%d/%d (%d) cmp=%d kind=%d\n",
- //         currnode, lower, recnum, upper, count, cmp, node->kind);
-      if (cmp > 0) {
-        upper = recnum - 1;
-      } else if (cmp < 0) {
-        lower = recnum + 1;
-      } else if (cmp == 0) {
-        if (node->kind == kBTLeafNode) {
-          // Found!
-          *result = node;
-          *key_offset = recnum;
-          return FSW_SUCCESS;
-
-        } else if (node->kind == kBTIndexNode) {
-          currnode = fsw_hfs_btree_next_node (currkey);
-          break;
-        }
+    if (node->kind == kBTLeafNode) {
+      if (!match) {
+        fsw_hfs_btree_release (btree, node);
+        return FSW_NOT_FOUND;
       }
+      /* Found!  */
+      btree->last_leaf = currnode;
+      *result = node;
+      *key_offset = (fsw_u32)recnum;
+      hardlink = 0;
+      return FSW_SUCCESS;
     }
 
-    if (cmp > 0) {
-      currkey = fsw_hfs_btree_rec (btree, node, upper);
+    if (node->kind != kBTIndexNode) {
+      DBG("unexpected node kind %d\n", node->kind);
+      fsw_hfs_btree_release (btree, node);
+      return FSW_VOLUME_CORRUPTED;
     }
-
-    if (node->kind == kBTIndexNode && currkey != NULL) {
-      currnode = fsw_hfs_btree_next_node (currkey);
- //     DBG(": candidate for the next currnode is %d\n", currnode);
+    if (recnum < 0) { //less than the first key of the tree
+      fsw_hfs_btree_release (btree, node);
+      return FSW_NOT_FOUND;
     }
-    else {
-      status = FSW_NOT_FOUND;
-      break;
+    // largest that <= search, the node pointer follows its key
+    currkey = fsw_hfs_btree_rec (btree, node, (fsw_u32)recnum);
+    if ((fsw_u8 *) currkey + be16_to_cpu (currkey->length16) + 2 + sizeof (fsw_u32) >
+        (fsw_u8 *) node + btree->node_size) {
+      fsw_hfs_btree_release (btree, node);
+      return FSW_VOLUME_CORRUPTED;
     }
-#endif
+    currnode = fsw_hfs_btree_next_node (currkey);
+    fsw_hfs_btree_release (btree, node);
   }
 
-#ifdef VBOXHFS_BTREE_BINSEARCH
-done:
-#endif
-  if (buffer != NULL && status != FSW_SUCCESS)
-    fsw_free(buffer);
-  
-  return status;
+  DBG("btree is too deep\n");
+  return FSW_VOLUME_CORRUPTED;
 }
 
 static void
@@ -908,27 +1008,29 @@ fsw_hfs_btree_visit_node(BTreeKey *record, void *param)
   return 1;
 }
 
+//
+// Call back for the records starting from *node_no / *rec and going on with
+// the next nodes. When the callback accepts a record *node_no / *rec tell where it is.
+//
 static fsw_status_t
 fsw_hfs_btree_iterate_node (struct fsw_hfs_btree *btree,
-                            BTNodeDescriptor     *first_node,
-                            fsw_u32              first_rec,
+                            fsw_u32              *node_no,
+                            fsw_u32              *rec,
                             int                  (*callback) (BTreeKey *record, void* param),
                             void                 *param)
 {
   fsw_status_t status;
-  /* We modify node, so make a copy */
-  BTNodeDescriptor *node = first_node;
-  fsw_u8 *buffer = NULL;
+  BTNodeDescriptor *node;
+  fsw_u32 currnode = *node_no;
+  fsw_u32 first_rec = *rec;
 
   if (!btree || !btree->node_size) {
     DBG("no node_size\n");
     return FSW_NOT_FOUND;
   }
   
-  status = fsw_alloc (btree->node_size, &buffer);
+  status = fsw_hfs_btree_get_node (btree, currnode, &node);
   if (status) {
-    if (buffer != NULL)
-      fsw_free(buffer);
     return status;
   }
   
@@ -942,10 +1044,18 @@ fsw_hfs_btree_iterate_node (struct fsw_hfs_btree *btree,
     // Iterate over all records in this node.
     i = first_rec;
     while (i < count) {
-      int rv = callback (fsw_hfs_btree_rec (btree, node, i), param); //fsw_hfs_btree_visit_node
+      BTreeKey *record = fsw_hfs_btree_rec (btree, node, i);
+      int rv;
+      if (record == NULL) {
+        status = FSW_VOLUME_CORRUPTED;
+        goto done;
+      }
+      rv = callback (record, param); //fsw_hfs_btree_visit_node
 //      DBG("test record %d, status=%d\n", i, rv);
       if (rv == 1) {
         status = FSW_SUCCESS;
+        *node_no = currnode;
+        *rec = i;
         goto done;
       } else if (rv == -1) {
 //        DBG("tested record %d, status=%d\n", i, rv);
@@ -966,18 +1076,16 @@ fsw_hfs_btree_iterate_node (struct fsw_hfs_btree *btree,
       break;
     }
 
-    if ((fsw_u32) fsw_hfs_read_file(btree->file, next_node * btree->node_size,
-                                    btree->node_size, buffer) != btree->node_size) {
-      status = FSW_VOLUME_CORRUPTED;
-//      DBG("differ node size btree->node_size=%d\n", btree->node_size);
-      break;
+    fsw_hfs_btree_release (btree, node);
+    status = fsw_hfs_btree_get_node (btree, next_node, &node);
+    if (status) {
+      return status;
     }
-    node = (BTNodeDescriptor *) buffer;
+    currnode = next_node;
     first_rec = 0;
   }
 done:
-  if (buffer)
-    fsw_free(buffer);
+  fsw_hfs_btree_release (btree, node);
   
   return status;
 }
@@ -1159,67 +1267,200 @@ fsw_hfs_cmp_id (BTreeKey *key1, void *param)
   return 1;
 }
 
+//
+// Append a run of blocks to the extent map of the dnode, joined with
+// the last run if it continues it on the disk
+//
+static fsw_status_t
+fsw_hfs_extent_map_add (struct fsw_hfs_dnode *dno,
+                        fsw_u32              phys_start,
+                        fsw_u32              count)
+{
+  fsw_status_t              status;
+  struct fsw_hfs_extent_run *run;
+  struct fsw_hfs_extent_run *new_map;
+
+  if (dno->ext_map_count > 0) {
+    run = &dno->ext_map[dno->ext_map_count - 1];
+    if (run->phys_start + run->count == phys_start) {
+      run->count += count;
+      dno->ext_map_blocks += count;
+      return FSW_SUCCESS;
+    }
+  }
+  if (dno->ext_map_count == dno->ext_map_size) {
+    status = fsw_alloc(sizeof(struct fsw_hfs_extent_run) * (dno->ext_map_size + 8) * 2, &new_map);
+    if (status) {
+      return status;
+    }
+    if (dno->ext_map != NULL) {
+      fsw_memcpy(new_map, dno->ext_map, sizeof(struct fsw_hfs_extent_run) * dno->ext_map_count);
+      fsw_free(dno->ext_map);
+    }
+    dno->ext_map = new_map;
+    dno->ext_map_size = (dno->ext_map_size + 8) * 2;
+  }
+  run = &dno->ext_map[dno->ext_map_count++];
+  run->log_start = dno->ext_map_blocks;
+  run->phys_start = phys_start;
+  run->count = count;
+  dno->ext_map_blocks += count;
+  return FSW_SUCCESS;
+}
+
+static fsw_status_t
+fsw_hfs_extent_map_add_record (struct fsw_hfs_dnode *dno,
+                               HFSPlusExtentRecord  *exts)
+{
+  fsw_status_t status;
+  fsw_u32      count;
+  int          i;
+
+  for (i = 0; i < 8; i++) {
+    count = be32_to_cpu ((*exts)[i].blockCount);
+    if (count == 0) {
+      break;
+    }
+    status = fsw_hfs_extent_map_add(dno, be32_to_cpu ((*exts)[i].startBlock), count);
+    if (status) {
+      return status;
+    }
+  }
+  return FSW_SUCCESS;
+}
+
+typedef struct {
+  struct fsw_hfs_dnode  *dno;
+  fsw_status_t          status;
+} extent_map_param_t;
+
+//
+// Callback for the records of the extents overflow file: takes the records
+// of the data fork of the dnode, they follow each other in the order of startBlock
+//
+static int
+fsw_hfs_extent_map_visit (BTreeKey *record, void *param)
+{
+  extent_map_param_t *mp  = (extent_map_param_t*)param;
+  HFSPlusExtentKey   *key = (HFSPlusExtentKey*)record;
+
+  if (be16_to_cpu(key->keyLength) != sizeof(HFSPlusExtentKey) - 2 ||
+      key->forkType != 0 ||
+      be32_to_cpu(key->fileID) != mp->dno->g.dnode_id ||
+      be32_to_cpu(key->startBlock) != mp->dno->ext_map_blocks) {
+    return -1; //records of the next fork
+  }
+  mp->status = fsw_hfs_extent_map_add_record(mp->dno, (HFSPlusExtentRecord*)(key + 1));
+  return mp->status ? 1 : 0;
+}
+
+//
+// Take all overflow extents of the data fork in one walk over the extents file
+//
+static fsw_status_t
+fsw_hfs_extent_map_overflow (struct fsw_hfs_volume *vol,
+                             struct fsw_hfs_dnode  *dno)
+{
+  fsw_status_t            status;
+  BTNodeDescriptor        *node = NULL;
+  struct HFSPlusExtentKey overflowkey;
+  fsw_u32                 currnode;
+  fsw_u32                 ptr;
+  extent_map_param_t      param;
+
+  overflowkey.forkType = 0;  //data fork
+  overflowkey.fileID = dno->g.dnode_id;
+  overflowkey.startBlock = dno->ext_map_blocks;
+
+  status = fsw_hfs_btree_search (&vol->extents_tree,
+                                 (BTreeKey*)&overflowkey,
+                                 fsw_hfs_cmp_extkey,
+                                 &node, &ptr);
+  if (status) {
+    return status;
+  }
+  currnode = vol->extents_tree.last_leaf;
+  param.dno = dno;
+  param.status = FSW_SUCCESS;
+  status = fsw_hfs_btree_iterate_node (&vol->extents_tree,
+                                       &currnode,
+                                       &ptr,
+                                       fsw_hfs_extent_map_visit,
+                                       &param);
+  fsw_hfs_btree_release(&vol->extents_tree, node);
+  if (param.status) {
+    return param.status;
+  }
+  // the walk ends at the first record of another fork or at the end of the tree
+  return (status == FSW_NOT_FOUND) ? FSW_SUCCESS : status;
+}
+
 /**
  * Retrieve file data mapping information. This function is called by the core when
  * fsw_shandle_read needs to know where on the disk the required piece of the file's
  * data can be found. The core makes sure that fsw_hfs_dnode_fill has been called
  * on the dnode before. Our task here is to get the physical disk block number for
  * the requested logical block number.
+ *
+ * The extents of the fork are gathered in dno->ext_map on first use, joined where
+ * they follow each other on the disk, so the extent returned covers all blocks up
+ * to the next gap.
  */
 
 static fsw_status_t fsw_hfs_get_extent(struct fsw_hfs_volume * vol,
                                        struct fsw_hfs_dnode  * dno,
                                        struct fsw_extent     * extent)
 {
-  fsw_status_t         status;
-  fsw_u32              lbno;
-  HFSPlusExtentRecord  *exts;
-  BTNodeDescriptor     *node = NULL;
-  struct HFSPlusExtentKey* key;
-  struct HFSPlusExtentKey  overflowkey;
-  fsw_u32                  ptr;
-  fsw_u32                  phys_bno;
-  
-  extent->type = FSW_EXTENT_TYPE_PHYSBLOCK;
-  extent->log_count = 1;
-  lbno = extent->log_start;
+  fsw_status_t              status;
+  fsw_u32                   lbno = extent->log_start;
+  fsw_u32                   lower, upper, middle;
+  struct fsw_hfs_extent_run *run;
   
-  /* we only care about data forks atm, do we? */
-  exts = &dno->extents;
+  if (!dno->ext_map_loaded) {
+    /* we only care about data forks atm, do we? */
+    status = fsw_hfs_extent_map_add_record(dno, &dno->extents);
+    if (status) {
+      return status;
+    }
+    dno->ext_map_loaded = 1;
+  }
   
-  while (1) {
-    if (fsw_hfs_find_block(exts, &lbno, &phys_bno)) {
-      extent->phys_start = phys_bno + vol->emb_block_off;
-      status = FSW_SUCCESS;
-      break;
+  if (lbno >= dno->ext_map_blocks) {
+    // the extents file has no overflow records of its own
+    if (dno->ext_map_overflow || dno->g.dnode_id == kHFSExtentsFileID) {
+      return FSW_NOT_FOUND;
     }
-    
-    /* Find appropriate overflow record */
-    overflowkey.forkType = 0;  //data fork
-    overflowkey.fileID = dno->g.dnode_id;
-    overflowkey.startBlock = extent->log_start - lbno;
-    
-    if (node != NULL) {
-      fsw_free(node);
-      node = NULL;
+    status = fsw_hfs_extent_map_overflow(vol, dno);
+    // a failure to read the extents file is retried on the next call, it
+    // resumes at ext_map_blocks after the records taken so far
+    if (status == FSW_SUCCESS || status == FSW_NOT_FOUND) {
+      dno->ext_map_overflow = 1;
     }
-    
-    status = fsw_hfs_btree_search (&vol->extents_tree,
-                                   (BTreeKey*)&overflowkey,
-                                   fsw_hfs_cmp_extkey,
-                                   &node, &ptr);
     if (status) {
-      break;
+      return status;
+    }
+    if (lbno >= dno->ext_map_blocks) {
+      return FSW_NOT_FOUND;
     }
-    
-    key = (struct HFSPlusExtentKey *) fsw_hfs_btree_rec (&vol->extents_tree, node, ptr);
-    exts = (HFSPlusExtentRecord*) (key + 1);
   }
   
-  if (node != NULL)
-    fsw_free(node);
+  /* Binary search for the run with lbno */
+  lower = 0;
+  upper = dno->ext_map_count;
+  while (upper - lower > 1) {
+    middle = (lower + upper) / 2;
+    if (dno->ext_map[middle].log_start <= lbno) {
+      lower = middle;
+    } else {
+      upper = middle;
+    }
+  }
+  run = &dno->ext_map[lower];
   
-  return status;
+  extent->type = FSW_EXTENT_TYPE_PHYSBLOCK;
+  extent->phys_start = run->phys_start + (lbno - run->log_start) + vol->emb_block_off;
+  extent->log_count = run->count - (lbno - run->log_start);
+  return FSW_SUCCESS;
 }
 
 static fsw_status_t
@@ -1324,7 +1565,7 @@ static fsw_status_t fsw_hfs_dir_lookup(struct fsw_hfs_volume * vol,
 done:
   
   if (node != NULL)
-    fsw_free(node);
+    fsw_hfs_btree_release(&vol->catalog_tree, node);
   
   if (free_data)
     fsw_strfree(&rec_name);
@@ -1343,34 +1584,17 @@ static fsw_status_t fsw_hfs_dir_lookup_id(struct fsw_hfs_volume *vol,
                                           file_info_t           *file_info)
 {
   fsw_status_t            status;
-  fsw_u8                  *buffer = NULL;
   fsw_u32                 ptr = 0;
   visitor_parameter_t     param;
-  BTNodeDescriptor *      node = NULL; //root
   fsw_u32                 currnode = vol->catalog_tree.root_node;
-  fsw_u32                 nodeSize = vol->catalog_tree.node_size;
 //  DBG("...lookup for fileID=%d\n", lookup_id);
-  status = fsw_alloc(nodeSize, &buffer);
-  if (status != FSW_SUCCESS) {
-    fsw_free(buffer);
-    goto done;
-  }
-  node = (BTNodeDescriptor *) buffer;
-  /* Read a node */
-  if ((fsw_u32)fsw_hfs_read_file(vol->catalog_tree.file,
-                                 MultU64x32(currnode, nodeSize),
-                                 nodeSize, buffer) != nodeSize) {
-    status = FSW_VOLUME_CORRUPTED;
-//    DBG("differ node size while read file\n");
-    return status;
-  }
   
   fsw_memzero(&param, sizeof(visitor_parameter_t));
   param.parent = lookup_id;
 
   status = fsw_hfs_btree_iterate_node (&vol->catalog_tree,
-                                       node,
-                                       ptr,
+                                       &currnode,
+                                       &ptr,
                                        fsw_hfs_cmp_id,
                                        &param);
 
@@ -1385,8 +1609,6 @@ static fsw_status_t fsw_hfs_dir_lookup_id(struct fsw_hfs_volume *vol,
 //  }
 done:
 
-  if (node != NULL)
-    fsw_free(node);
 //  DBG("fsw_hfs_dir_lookup_id return status %a\n", fsw_errors[status]);
   return status;
 }
@@ -1406,8 +1628,11 @@ static fsw_status_t fsw_hfs_dir_read(struct fsw_hfs_volume *vol,
 {
   BTNodeDescriptor          *node = NULL;
   fsw_u32                   ptr;
+  fsw_u32                   currnode;
   HFSPlusCatalogKey         catkey;
   fsw_status_t              status;
+  struct fsw_hfs_dirpos     *dirpos;
+  int                       i;
   
   visitor_parameter_t       param;
   struct fsw_string         rec_name;
@@ -1420,43 +1645,74 @@ static fsw_status_t fsw_hfs_dir_read(struct fsw_hfs_volume *vol,
   rec_name.type = FSW_STRING_TYPE_EMPTY;
   param.file_info.name = &rec_name;
   param.file_info.id = 0;
-  // we are searching a node with name=0 and parentID?
-  status = fsw_hfs_btree_search (&vol->catalog_tree,
-                                 (BTreeKey*)&catkey,
-                                 vol->case_sensitive ?
-                                 fsw_hfs_cmp_catkey : fsw_hfs_cmpi_catkey,
-                                 &node, &ptr);
-  if (status) {
-//    DBG("fsw_hfs_btree_search dir read  status %a\n", fsw_errors[status]);
-    goto done;
+  param.parent = dno->g.dnode_id;
+  if (dno->ilink != 0) {
+    param.parent = 0;
+  }
+  
+  dirpos = &vol->dir_read[0];
+  for (i = 0; i < FSW_HFS_DIRPOS_MAX; i++) {
+    if (vol->dir_read[i].pos != 0 && vol->dir_read[i].dnode_id == dno->g.dnode_id &&
+        vol->dir_read[i].parent == param.parent) {
+      dirpos = &vol->dir_read[i];
+      break;
+    }
+    if (vol->dir_read[i].stamp < dirpos->stamp) {
+      dirpos = &vol->dir_read[i];
+    }
+  }
+  if (i == FSW_HFS_DIRPOS_MAX) {
+    dirpos->pos = 0;
+  }
+  dirpos->stamp = ++vol->dir_read_clock;
+  
+  if (dirpos->pos != 0 && dirpos->pos == shand->pos) {
+    /* Next entry of the directory, go on after the record of the last call */
+    currnode = dirpos->node;
+    ptr = dirpos->rec + 1;
+    param.cur_pos = dirpos->pos;
+  } else {
+    // we are searching a node with name=0 and parentID?
+    status = fsw_hfs_btree_search (&vol->catalog_tree,
+                                   (BTreeKey*)&catkey,
+                                   vol->case_sensitive ?
+                                   fsw_hfs_cmp_catkey : fsw_hfs_cmpi_catkey,
+                                   &node, &ptr);
+    if (status) {
+//      DBG("fsw_hfs_btree_search dir read  status %a\n", fsw_errors[status]);
+      goto done;
+    }
+    currnode = vol->catalog_tree.last_leaf;
+    param.cur_pos = 0;
   }
   
   /* Iterator updates shand state */
   param.vol = vol;
   param.shandle = shand;
-  param.parent = dno->g.dnode_id;
-  if (dno->ilink != 0) {
-    param.parent = 0;
-  }
-  param.cur_pos = 0;
   status = fsw_hfs_btree_iterate_node (&vol->catalog_tree,
-                                       node,
-                                       ptr,
+                                       &currnode,
+                                       &ptr,
                                        fsw_hfs_btree_visit_node,
                                        &param);
   if (!status) {  
+    dirpos->dnode_id = dno->g.dnode_id;
+    dirpos->parent = param.parent;
+    dirpos->pos = (fsw_u32)shand->pos;
+    dirpos->node = currnode;
+    dirpos->rec = ptr;
     status = create_hfs_dnode(dno, &param.file_info, child_dno_out);
 //    if (status) {
 //never      DBG("create_hfs_dnode  status %a\n", fsw_errors[status]);
 //    }
   } else {
+    dirpos->pos = 0;
 //    DBG("fsw_hfs_btree_iterate_node  status %a\n", fsw_errors[status]);
   }
 
 
 done:
   if (node)
-    fsw_free(node);
+    fsw_hfs_btree_release(&vol->catalog_tree, node);
   fsw_strfree(&rec_name);
   
   return status;
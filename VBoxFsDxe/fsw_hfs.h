@@ -88,6 +88,17 @@ typedef enum {
     FSW_HFS_PLUS_EMB
 } fsw_hfs_kind;
 
+/**
+ * HFS: Run of blocks of a fork which follow each other on the disk.
+ */
+
+struct fsw_hfs_extent_run
+{
+    fsw_u32                  log_start;
+    fsw_u32                  phys_start;
+    fsw_u32                  count;
+};
+
 /**
  * HFS: Dnode structure with HFS-specific data.
  */
@@ -105,6 +116,29 @@ struct fsw_hfs_dnode
   /* hardlinks stuff */
   fsw_u32 ilink;
   fsw_u32 isDirLink;
+  /* extents of the data fork with the overflow ones, sorted by log_start */
+  struct fsw_hfs_extent_run *ext_map;
+  fsw_u32 ext_map_count;
+  fsw_u32 ext_map_size;
+  fsw_u32 ext_map_blocks;       // blocks covered by the map
+  fsw_u32 ext_map_loaded;
+  fsw_u32 ext_map_overflow;     // the extents file was looked up
+};
+
+/**
+ * HFS: Cached B-tree node. Index nodes stay in the cache, leaf nodes are
+ * replaced least recently used first.
+ */
+#define FSW_HFS_BNODE_CACHE      32   /* nodes cached per B-tree */
+#define FSW_HFS_BNODE_PINNED     24   /* at most so many of them index nodes */
+#define FSW_HFS_BNODE_NONE       0xFFFFFFFF
+
+struct fsw_hfs_bnode
+{
+    fsw_u32                  node_no;   //!< FSW_HFS_BNODE_NONE if the slot holds nothing
+    fsw_u32                  refs;      //!< users of data, not replaced while > 0
+    fsw_u32                  stamp;     //!< value of the B-tree clock at the last use
+    fsw_u8                  *data;
 };
 
 /**
@@ -115,9 +149,29 @@ struct fsw_hfs_btree
     fsw_u32                  root_node;
     fsw_u32                  node_size;
     struct fsw_hfs_dnode*    file;
+    struct fsw_hfs_bnode     cache[FSW_HFS_BNODE_CACHE];
+    fsw_u32                  clock;
+    fsw_u32                  last_leaf;     // leaf of the last successful search
 };
 
 
+/**
+ * HFS: Where fsw_hfs_dir_read stopped in a directory, so the next entry
+ * is found without a new search. Directories listed one inside the other
+ * have a slot each.
+ */
+#define FSW_HFS_DIRPOS_MAX       8
+
+struct fsw_hfs_dirpos
+{
+    fsw_u32                  dnode_id;
+    fsw_u32                  parent;
+    fsw_u32                  pos;       //!< shandle pos after the entry, 0 = slot not used
+    fsw_u32                  node;      //!< leaf and record of the entry
+    fsw_u32                  rec;
+    fsw_u32                  stamp;     //!< the least recently used slot is taken for a new directory
+};
+
 /**
  * HFS: In-memory volume structure with HFS-specific data.
  */
@@ -134,6 +188,8 @@ struct fsw_hfs_volume
     fsw_u32                       block_size_shift;
     fsw_hfs_kind                  hfs_kind;
     fsw_u32                       emb_block_off;
+    struct fsw_hfs_dirpos         dir_read[FSW_HFS_DIRPOS_MAX];
+    fsw_u32                       dir_read_clock;
 };
 
 
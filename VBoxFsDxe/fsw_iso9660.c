@@ -60,11 +60,17 @@
  */
 
 #include "fsw_iso9660.h"
+#ifndef HOST_POSIX
 #include <Protocol/MsgLog.h>
+#endif
 
 #ifndef DEBUG_ISO
+#ifdef HOST_POSIX
+#define DEBUG_ISO 0
+#else
 #define DEBUG_ISO 1
 #endif
+#endif
 
 #if DEBUG_ISO == 2
 #define DBG(...)	AsciiPrint(__VA_ARGS__)
@@ -76,8 +82,10 @@
 
 //#define MsgLog(x...) if(msgCursor){AsciiSPrint(msgCursor, BOOTER_LOG_SIZE, x); while(*msgCursor){msgCursor++;}}
 
+#ifndef HOST_POSIX
 extern CHAR8     *msgCursor;
 extern MESSAGE_LOG_PROTOCOL *Msg;
+#endif
 // functions
 
 static fsw_status_t fsw_iso9660_volume_mount(struct fsw_iso9660_volume *vol);
@@ -96,13 +104,19 @@ static fsw_status_t fsw_iso9660_dir_lookup(struct fsw_iso9660_volume *vol, struc
 static fsw_status_t fsw_iso9660_dir_read(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno,
                                          struct fsw_shandle *shand, struct fsw_iso9660_dnode **child_dno);
 static fsw_status_t fsw_iso9660_read_dirrec(struct fsw_iso9660_volume *vol, struct fsw_shandle *shand, struct iso9660_dirrec_buffer *dirrec_buffer);
+static fsw_status_t fsw_iso9660_dirrec_name(struct fsw_iso9660_volume *vol, struct iso9660_dirrec *dirrec, struct fsw_string *name);
+static fsw_u32      fsw_iso9660_dirrec_ino(struct fsw_iso9660_dnode *dno, fsw_u32 pos, struct iso9660_dirrec *dirrec);
+
+static fsw_status_t fsw_iso9660_read_path_table(struct fsw_iso9660_volume *vol, struct iso9660_primary_volume_descriptor *pvoldesc);
+static fsw_status_t fsw_iso9660_path_lookup(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno,
+                                            struct fsw_string *lookup_name, struct fsw_iso9660_dnode **child_dno_out);
+static fsw_status_t fsw_iso9660_dirents_parse(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno);
+static void         fsw_iso9660_dirents_free(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno);
 
 static fsw_status_t fsw_iso9660_readlink(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno,
                                          struct fsw_string *link);
 
-static fsw_status_t rr_find_sp(struct iso9660_dirrec *dirrec, struct fsw_rock_ridge_susp_sp **psp);
 static fsw_status_t rr_find_nm(struct fsw_iso9660_volume *vol, struct iso9660_dirrec *dirrec, int off, struct fsw_string *str);
-static fsw_status_t rr_read_ce(struct fsw_iso9660_volume *vol, union fsw_rock_ridge_susp_ce *ce, fsw_u8 *begin);
 //static void dump_dirrec(struct iso9660_dirrec *dirrec);
 //
 // Dispatch Table
@@ -125,134 +139,120 @@ struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(iso9660) = {
     fsw_iso9660_readlink,
 };
 
-static fsw_status_t rr_find_sp(struct iso9660_dirrec *dirrec, struct fsw_rock_ridge_susp_sp **psp)
-{
-    fsw_u8 *r;
-    int off = 0;
-    struct fsw_rock_ridge_susp_sp *sp;
-    r = (fsw_u8 *)((fsw_u8 *)dirrec + sizeof(*dirrec) + dirrec->file_identifier_length);
-    off = (int)(r - (fsw_u8 *)dirrec);
-    while(off < dirrec->dirrec_length)
-    {
-        if (*r == 'S')
-        {
-            sp = (struct fsw_rock_ridge_susp_sp *)r;
-            if(    sp->e.sig[0] == 'S'
-                && sp->e.sig[1] == 'P'
-                && sp->magic[0] == 0xbe
-                && sp->magic[1] == 0xef)
-            {
-                *psp = sp;
-                return FSW_SUCCESS;
-            }
-        }
-        r++;
-        off = (int)(r - (fsw_u8 *)dirrec);
-    }
-    *psp = NULL;
-    return FSW_NOT_FOUND;
-}
+/**
+ * Get the Rock Ridge name of a directory record. The System Use entries are walked
+ * from offset off of the record, following a Continuation Area through the block cache.
+ * The name is allocated and must be freed by the caller.
+ */
 
 static fsw_status_t rr_find_nm(struct fsw_iso9660_volume *vol, struct iso9660_dirrec *dirrec, int off, struct fsw_string *str)
 {
-    fsw_u8 *r, *begin;
+    fsw_status_t status;
+    fsw_u8 *r;
+    int limit;
+    int entry_len;
     int fCe = 0;
+    int ce_count = 0;
+    fsw_u32 ce_block = 0, ce_offset = 0, ce_len = 0;
+    void *ce_buffer = NULL;
+    fsw_u32 ce_buffer_block = 0;
     struct fsw_rock_ridge_susp_nm *nm;
-    int limit = dirrec->dirrec_length;
-    begin = (fsw_u8 *)dirrec;
+    union fsw_rock_ridge_susp_ce *ce;
     r = (fsw_u8 *)dirrec + off;
+    limit = dirrec->dirrec_length - off;
     str->data = NULL;
     str->len = 0;
     str->size = 0;
     str->type = 0;
-    while(off < limit)
+    status = FSW_NOT_FOUND;
+    while (1)
     {
-        if (r[0] == 'C' && r[1] == 'E' && r[2] == 28)
+        while (limit >= 4)
         {
-            int rc;
-            int ce_off;
-            union fsw_rock_ridge_susp_ce *ce;
-            if (fCe == 0)
-                fsw_alloc_zero(ISO9660_BLOCKSIZE, (void *)&begin);
-            fCe = 1;
-        //    DEBUG((DEBUG_WARN, "%a:%d we found CE before NM or its continuation\n", __FILE__, __LINE__));
-            ce = (union fsw_rock_ridge_susp_ce *)r;
-            limit = ISOINT(ce->X.len);
-            ce_off = ISOINT(ce->X.offset);
-            rc = rr_read_ce(vol, ce, begin);
-            if (rc != FSW_SUCCESS)
+            entry_len = r[2];
+            if (entry_len < 4 || entry_len > limit)
+                break;
+            if (r[0] == 'S' && r[1] == 'T')
+                break;
+            if (r[0] == 'C' && r[1] == 'E' && entry_len >= 28)
             {
-                fsw_free(begin);
-                return rc;
+                ce = (union fsw_rock_ridge_susp_ce *)r;
+                ce_block = ISOINT(ce->X.block_loc);
+                ce_offset = ISOINT(ce->X.offset);
+                ce_len = ISOINT(ce->X.len);
+                fCe = 1;
             }
-            begin += ce_off;
-            r = begin;
-        }
-        if (r[0] == 'N' && r[1] == 'M')
-        {
-            nm = (struct fsw_rock_ridge_susp_nm *)r;
-            if(    nm->e.sig[0] == 'N'
-                && nm->e.sig[1] == 'M')
+            else if (r[0] == 'N' && r[1] == 'M' && entry_len >= 5)
             {
                 int len = 0;
                 fsw_u8 *tmp = NULL;
-                if (nm->flags & RR_NM_CURR)
-                {
-                     fsw_memdup(&str->data, ".", 1);
-                     str->len = 1;
-                     goto done;
-                }
-                if (nm->flags & RR_NM_PARE)
+                nm = (struct fsw_rock_ridge_susp_nm *)r;
+                if (nm->flags & (RR_NM_CURR | RR_NM_PARE))
                 {
-                     fsw_memdup(&str->data, "..", 2);
-                     str->len = 2;
-                     goto done;
+                    if (str->data != NULL)
+                        fsw_free(str->data);
+                    str->len = (nm->flags & RR_NM_CURR) ? 1 : 2;
+                    status = fsw_memdup(&str->data, "..", str->len);
+                    if (status)
+                        goto errorexit;
+                    goto done;
                 }
-                len = nm->e.len - sizeof(struct fsw_rock_ridge_susp_nm) + 1;
-                fsw_alloc_zero(str->len + len, (void **)&tmp);
-                if (str->data != NULL)
+                len = entry_len - sizeof(struct fsw_rock_ridge_susp_nm) + 1;
+                if (len > 0)
                 {
-                    fsw_memcpy(tmp, str->data, str->len);
-                    fsw_free(str->data);
+                    status = fsw_alloc_zero(str->len + len, (void **)&tmp);
+                    if (status)
+                        goto errorexit;
+                    if (str->data != NULL)
+                    {
+                        fsw_memcpy(tmp, str->data, str->len);
+                        fsw_free(str->data);
+                    }
+                    fsw_memcpy(tmp + str->len, &nm->name[0], len);
+                    str->data = tmp;
+                    str->len += len;
                 }
-           //     DEBUG((DEBUG_INFO, "dst:%p src:%p len:%d\n", tmp + str->len, &nm->name[0], len));
-                fsw_memcpy(tmp + str->len, &nm->name[0], len);
-                str->data = tmp;
-                str->len += len;
 
-                if ((nm->flags & RR_NM_CONT) == 0)  //; -- as nms42 noted
+                if ((nm->flags & RR_NM_CONT) == 0 && str->len > 0)
                     goto done;
             }
+            r += entry_len;
+            limit -= entry_len;
         }
-        r++;
-        off = (int)(r - (fsw_u8 *)begin);
+
+        // go on in the Continuation Area, all the names of a directory usually share its block
+        if (fCe == 0 || ++ce_count > 16)
+            break;
+        fCe = 0;
+        if (ce_offset >= ISO9660_BLOCKSIZE || ce_len > ISO9660_BLOCKSIZE - ce_offset)
+            break;
+        if (ce_buffer != NULL)
+            fsw_block_release(vol, ce_buffer_block, ce_buffer);
+        ce_buffer = NULL;
+        status = fsw_block_get(vol, ce_block, 1, &ce_buffer);
+        if (status)
+            goto errorexit;
+        ce_buffer_block = ce_block;
+        r = (fsw_u8 *)ce_buffer + ce_offset;
+        limit = (int)ce_len;
     }
-    if(fCe == 1)
-        fsw_free(begin);
-    return FSW_NOT_FOUND;
+    status = FSW_NOT_FOUND;
+errorexit:
+    if (str->data != NULL)
+        fsw_free(str->data);
+    str->data = NULL;
+    str->len = 0;
+    if (ce_buffer != NULL)
+        fsw_block_release(vol, ce_buffer_block, ce_buffer);
+    return status;
 done:
     str->type = FSW_STRING_TYPE_ISO88591;
     str->size = str->len;
-    if(fCe == 1)
-        fsw_free(begin);
+    if (ce_buffer != NULL)
+        fsw_block_release(vol, ce_buffer_block, ce_buffer);
     return FSW_SUCCESS;
 }
 
-static fsw_status_t rr_read_ce(struct fsw_iso9660_volume *vol, union fsw_rock_ridge_susp_ce *ce, fsw_u8 *begin)
-{
-    int rc;
-//    int i;
-//    fsw_u8 *r = begin + ISOINT(ce->X.offset);
-//    int len = ISOINT(ce->X.len);
-    rc = vol->g.host_table->read_block(&vol->g, ISOINT(ce->X.block_loc), begin);
-    if (rc != FSW_SUCCESS)
-        return rc;
-/*    for (i = 0; i < len; ++i)
-    {
-        DEBUG((DEBUG_INFO, "%d: (%d:%x)%c ", i, r[i], r[i], r[i]));
-    }*/
-    return FSW_SUCCESS;
-}
 /*
 static void dump_dirrec(struct iso9660_dirrec *dirrec)
 {
@@ -364,22 +364,32 @@ static fsw_status_t fsw_iso9660_volume_mount(struct fsw_iso9660_volume *vol)
     //FSW_MSG_DEBUG((FSW_MSGSTR("fsw_iso9660_volume_mount: success (SUA(pos:%x, sz:%d)!!!)\n"), sua_pos, sua_size));
 
 #if 1
-    /*status = */fsw_block_get(vol, ISOINT(rootdir_p->extent_location), 0, &buffer);
-    sig = (char *)buffer + sua_pos;
-//    skip = 0;
-    entry = (struct fsw_rock_ridge_susp_entry *)sig;
-    if (   entry->sig[0] == 'S'
-        && entry->sig[1] == 'P') {
-        struct fsw_rock_ridge_susp_sp *sp = (struct fsw_rock_ridge_susp_sp *)entry;
-        if (sp->magic[0] == 0xbe && sp->magic[1] == 0xef) {
-            vol->fRockRidge = 1;
-        } else {
- //           FSW_MSG_DEBUG((FSW_MSGSTR("fsw_iso9660_volume_mount: SP magic isn't valid\n")));
-          DBG("fsw_iso9660_volume_mount: SP magic isn't valid\n");
+    status = fsw_block_get(vol, ISOINT(rootdir_p->extent_location), 0, &buffer);
+    if (status == FSW_SUCCESS) {
+        sig = (char *)buffer + sua_pos;
+        entry = (struct fsw_rock_ridge_susp_entry *)sig;
+        if (   entry->sig[0] == 'S'
+            && entry->sig[1] == 'P') {
+            struct fsw_rock_ridge_susp_sp *sp = (struct fsw_rock_ridge_susp_sp *)entry;
+            if (sp->magic[0] == 0xbe && sp->magic[1] == 0xef) {
+                vol->fRockRidge = 1;
+                vol->rr_susp_skip = sp->skip;
+            } else {
+     //           FSW_MSG_DEBUG((FSW_MSGSTR("fsw_iso9660_volume_mount: SP magic isn't valid\n")));
+              DBG("fsw_iso9660_volume_mount: SP magic isn't valid\n");
+            }
         }
-//        skip = sp->skip;
+        fsw_block_release(vol, ISOINT(rootdir_p->extent_location), buffer);
     }
 #endif
+
+    // the path table locates directories without reading their parents, lookups
+    // work without it
+    if (fsw_iso9660_read_path_table(vol, pvoldesc) == FSW_SUCCESS)
+        vol->g.root->path_number = 1;
+    else
+        vol->g.root->path_number = -1;
+
     // release volume descriptors
     fsw_free(vol->primary_voldesc);
     vol->primary_voldesc = NULL;
@@ -401,6 +411,10 @@ static void fsw_iso9660_volume_free(struct fsw_iso9660_volume *vol)
 {
     if (vol->primary_voldesc)
         fsw_free(vol->primary_voldesc);
+    if (vol->path_entries)
+        fsw_free(vol->path_entries);
+    if (vol->path_table)
+        fsw_free(vol->path_table);
 }
 
 /**
@@ -442,6 +456,7 @@ static fsw_status_t fsw_iso9660_dnode_fill(struct fsw_iso9660_volume *vol, struc
 
 static void fsw_iso9660_dnode_free(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno)
 {
+    fsw_iso9660_dirents_free(vol, dno);
 }
 
 /**
@@ -492,6 +507,10 @@ static fsw_status_t fsw_iso9660_get_extent(struct fsw_iso9660_volume *vol, struc
  * to retrieve the directory entry with the given name. A dnode is constructed for
  * this entry and returned. The core makes sure that fsw_iso9660_dnode_fill has been called
  * and the dnode is actually a directory.
+ *
+ * Subdirectories are found in the path table if there is one, other names in the parsed
+ * directory records of the dnode. The directory is only scanned record by record when
+ * it can not be kept parsed.
  */
 
 static fsw_status_t fsw_iso9660_dir_lookup(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno,
@@ -501,9 +520,36 @@ static fsw_status_t fsw_iso9660_dir_lookup(struct fsw_iso9660_volume *vol, struc
     struct fsw_shandle shand;
     struct iso9660_dirrec_buffer dirrec_buffer;
     struct iso9660_dirrec *dirrec = &dirrec_buffer.dirrec;
+    struct iso9660_dirent *dirent;
+    fsw_u32         i;
 
     // Preconditions: The caller has checked that dno is a directory node.
 
+    status = fsw_iso9660_path_lookup(vol, dno, lookup_name, child_dno_out);
+    if (status != FSW_NOT_FOUND)
+        return status;
+
+    // search the parsed records, parse the next block if the name is not there yet
+    i = 0;
+    while (1) {
+        for (; i < dno->dirent_count; i++) {
+            dirent = &dno->dirents[i];
+            if (fsw_streq(lookup_name, &dirent->name)) {  // TODO: compare case-insensitively
+                status = fsw_dnode_create(dno, dirent->ino, FSW_DNODE_TYPE_UNKNOWN, &dirent->name, child_dno_out);
+                if (status == FSW_SUCCESS)
+                    fsw_memcpy(&(*child_dno_out)->dirrec, &dirent->dirrec, sizeof(struct iso9660_dirrec));
+                return status;
+            }
+        }
+        if (dno->dirents_state != 0)
+            break;
+        status = fsw_iso9660_dirents_parse(vol, dno);
+        if (status)
+            return status;
+    }
+    if (dno->dirents_state > 0)
+        return FSW_NOT_FOUND;
+
     // setup handle to read the directory
     status = fsw_shandle_open(dno, &shand);
     if (status)
@@ -512,29 +558,41 @@ static fsw_status_t fsw_iso9660_dir_lookup(struct fsw_iso9660_volume *vol, struc
     // scan the directory for the file
     while (1) {
         // read next entry
+        if (shand.pos >= dno->g.size) {
+            // end of directory reached
+            status = FSW_NOT_FOUND;
+            goto errorexit;
+        }
         status = fsw_iso9660_read_dirrec(vol, &shand, &dirrec_buffer);
         if (status)
             goto errorexit;
         if (dirrec->dirrec_length == 0) {
-            // end of directory reached
-            status = FSW_NOT_FOUND;
-            goto errorexit;
+            // try the next block
+            shand.pos = (shand.pos & ~(vol->g.log_blocksize - 1)) + vol->g.log_blocksize;
+            continue;
         }
 
         // skip . and ..
         if (dirrec->file_identifier_length == 1 &&
-            (dirrec->file_identifier[0] == 0 || dirrec->file_identifier[0] == 1))
+            (dirrec->file_identifier[0] == 0 || dirrec->file_identifier[0] == 1)) {
+            if (dirrec_buffer.name.data != dirrec->file_identifier)
+                fsw_strfree(&dirrec_buffer.name);
             continue;
+        }
 
         // compare name
         if (fsw_streq(lookup_name, &dirrec_buffer.name))  // TODO: compare case-insensitively
             break;
+        if (dirrec_buffer.name.data != dirrec->file_identifier)
+            fsw_strfree(&dirrec_buffer.name);
     }
 
     // setup a dnode for the child item
     status = fsw_dnode_create(dno, dirrec_buffer.ino, FSW_DNODE_TYPE_UNKNOWN, &dirrec_buffer.name, child_dno_out);
     if (status == FSW_SUCCESS)
         fsw_memcpy(&(*child_dno_out)->dirrec, dirrec, sizeof(struct iso9660_dirrec));
+    if (dirrec_buffer.name.data != dirrec->file_identifier)
+        fsw_strfree(&dirrec_buffer.name);
 
 errorexit:
     fsw_shandle_close(&shand);
@@ -555,6 +613,8 @@ static fsw_status_t fsw_iso9660_dir_read(struct fsw_iso9660_volume *vol, struct
     fsw_status_t    status;
     struct iso9660_dirrec_buffer dirrec_buffer;
     struct iso9660_dirrec *dirrec = &dirrec_buffer.dirrec;
+    struct iso9660_dirent *dirent;
+    fsw_u32         lo, hi, mid;
 
     // Preconditions: The caller has checked that dno is a directory node. The caller
     //  has opened a storage handle to the directory's storage and keeps it around between
@@ -563,6 +623,37 @@ static fsw_status_t fsw_iso9660_dir_read(struct fsw_iso9660_volume *vol, struct
      * should read both blocks.
      */
 
+    while (1) {
+        // first parsed record at or after the position of the handle
+        lo = 0;
+        hi = dno->dirent_count;
+        while (lo < hi) {
+            mid = (lo + hi) / 2;
+            if (dno->dirents[mid].pos < shand->pos)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo < dno->dirent_count) {
+            dirent = &dno->dirents[lo];
+            shand->pos = dirent->next_pos;
+
+            status = fsw_dnode_create(dno, dirent->ino, FSW_DNODE_TYPE_UNKNOWN, &dirent->name, child_dno_out);
+            if (status == FSW_SUCCESS)
+                fsw_memcpy(&(*child_dno_out)->dirrec, &dirent->dirrec, sizeof(struct iso9660_dirrec));
+            return status;
+        }
+        if (dno->dirents_state != 0)
+            break;
+        status = fsw_iso9660_dirents_parse(vol, dno);
+        if (status)
+            return status;
+    }
+    if (dno->dirents_state > 0) {
+        shand->pos = dno->g.size;
+        return FSW_NOT_FOUND; // end of directory
+    }
+
     while (1) {
         // read next entry
         if (shand->pos >= dno->g.size)
@@ -579,8 +670,11 @@ static fsw_status_t fsw_iso9660_dir_read(struct fsw_iso9660_volume *vol, struct
 
         // skip . and ..
         if (dirrec->file_identifier_length == 1 &&
-            (dirrec->file_identifier[0] == 0 || dirrec->file_identifier[0] == 1))
+            (dirrec->file_identifier[0] == 0 || dirrec->file_identifier[0] == 1)) {
+            if (dirrec_buffer.name.data != dirrec->file_identifier)
+                fsw_strfree(&dirrec_buffer.name);
             continue;
+        }
         break;
     }
 
@@ -588,6 +682,8 @@ static fsw_status_t fsw_iso9660_dir_read(struct fsw_iso9660_volume *vol, struct
     status = fsw_dnode_create(dno, dirrec_buffer.ino, FSW_DNODE_TYPE_UNKNOWN, &dirrec_buffer.name, child_dno_out);
     if (status == FSW_SUCCESS)
         fsw_memcpy(&(*child_dno_out)->dirrec, dirrec, sizeof(struct iso9660_dirrec));
+    if (dirrec_buffer.name.data != dirrec->file_identifier)
+        fsw_strfree(&dirrec_buffer.name);
 
     return status;
 }
@@ -601,15 +697,10 @@ static fsw_status_t fsw_iso9660_dir_read(struct fsw_iso9660_volume *vol, struct
 static fsw_status_t fsw_iso9660_read_dirrec(struct fsw_iso9660_volume *vol, struct fsw_shandle *shand, struct iso9660_dirrec_buffer *dirrec_buffer)
 {
     fsw_status_t    status;
-    fsw_u32         i, buffer_size, remaining_size, name_len;
-    struct fsw_rock_ridge_susp_sp *sp = NULL;
+    fsw_u32         i, buffer_size, remaining_size, pos;
     struct iso9660_dirrec *dirrec = &dirrec_buffer->dirrec;
-    int sp_off;
-    int rc;
 
-    dirrec_buffer->ino = (ISOINT(((struct fsw_iso9660_dnode *)shand->dnode)->dirrec.extent_location)
-                          << ISO9660_BLOCKSIZE_BITS)
-        + (fsw_u32)shand->pos;
+    pos = (fsw_u32)shand->pos;
 
     // read fixed size part of directory record
     buffer_size = 33;
@@ -630,10 +721,13 @@ static fsw_status_t fsw_iso9660_read_dirrec(struct fsw_iso9660_volume *vol, stru
             DEBUG((DEBUG_INFO, "r[%d]:%c", i, r[i]));
         }
         dirrec->dirrec_length = 0;
+        // the caller goes on with the next block, counted from the start of this record
+        shand->pos = pos;
         return FSW_SUCCESS;
     }
     if (dirrec->dirrec_length < 33 ||
-        dirrec->dirrec_length < 33 + dirrec->file_identifier_length)
+        dirrec->dirrec_length < 33 + dirrec->file_identifier_length ||
+        dirrec->file_identifier_length == 0)
         return FSW_VOLUME_CORRUPTED;
 
 //    DEBUG((DEBUG_INFO, "%a:%d, dirrec_length: %d\n", __FILE__, __LINE__, dirrec->dirrec_length));
@@ -647,16 +741,30 @@ static fsw_status_t fsw_iso9660_read_dirrec(struct fsw_iso9660_volume *vol, stru
         return FSW_VOLUME_CORRUPTED;
 
 //     dump_dirrec(dirrec);
-     if (vol->fRockRidge) {
-         sp_off = sizeof(*dirrec) + dirrec->file_identifier_length;
-         rc = rr_find_sp(dirrec, &sp);
-         if (   rc == FSW_SUCCESS
-             && sp != NULL) {
-            sp_off = (int)((fsw_u8 *)&sp[1] - (fsw_u8*)dirrec + sp->skip);
-         }
-         rc = rr_find_nm(vol, dirrec, sp_off,  &dirrec_buffer->name);
-         if (rc == FSW_SUCCESS)
+    dirrec_buffer->ino = fsw_iso9660_dirrec_ino((struct fsw_iso9660_dnode *)shand->dnode, pos, dirrec);
+    return fsw_iso9660_dirrec_name(vol, dirrec, &dirrec_buffer->name);
+}
+
+/**
+ * Get the name of a complete directory record in memory. The Rock Ridge name is allocated
+ * and must be freed by the caller, else the name points to the file identifier of the record.
+ */
+
+static fsw_status_t fsw_iso9660_dirrec_name(struct fsw_iso9660_volume *vol, struct iso9660_dirrec *dirrec, struct fsw_string *name)
+{
+    fsw_u32         i, name_len;
+    int             sua_off;
+    fsw_status_t    rc;
+
+    if (vol->fRockRidge) {
+        // the System Use Area follows the identifier and its padding byte
+        sua_off = 33 + dirrec->file_identifier_length + ((dirrec->file_identifier_length & 1) ? 0 : 1)
+            + vol->rr_susp_skip;
+        rc = rr_find_nm(vol, dirrec, sua_off, name);
+        if (rc == FSW_SUCCESS)
             return FSW_SUCCESS;
+        if (rc != FSW_NOT_FOUND)
+            return rc;
     }
 
     // setup name
@@ -669,13 +777,301 @@ static fsw_status_t fsw_iso9660_read_dirrec(struct fsw_iso9660_volume *vol, stru
     }
     if (name_len > 0 && dirrec->file_identifier[name_len-1] == '.')
         name_len--;   // also cut the extension separator if the extension is empty
-    dirrec_buffer->name.type = FSW_STRING_TYPE_ISO88591;
-    dirrec_buffer->name.len = dirrec_buffer->name.size = name_len;
-    dirrec_buffer->name.data = dirrec->file_identifier;
-//    DEBUG((DEBUG_INFO, "%a:%d: dirrec_buffer->name.data:%a\n", __FILE__, __LINE__, dirrec_buffer->name.data));
+    name->type = FSW_STRING_TYPE_ISO88591;
+    name->len = name->size = name_len;
+    name->data = dirrec->file_identifier;
+//    DEBUG((DEBUG_INFO, "%a:%d: name->data:%a\n", __FILE__, __LINE__, name->data));
     return FSW_SUCCESS;
 }
 
+/**
+ * Get the dnode_id of a directory record found at offset pos of directory dno. Directories
+ * use their own extent, so that they get the same dnode when found through the path table.
+ */
+
+static fsw_u32 fsw_iso9660_dirrec_ino(struct fsw_iso9660_dnode *dno, fsw_u32 pos, struct iso9660_dirrec *dirrec)
+{
+    if (dirrec->file_flags & 0x02)
+        return ISOINT(dirrec->extent_location) << ISO9660_BLOCKSIZE_BITS;
+    return (ISOINT(dno->dirrec.extent_location) << ISO9660_BLOCKSIZE_BITS) + pos;
+}
+
+/**
+ * Read the type L path table of the volume. It lists all directories with the extent
+ * and the directory number of their parent, sorted by parent.
+ */
+
+static fsw_status_t fsw_iso9660_read_path_table(struct fsw_iso9660_volume *vol, struct iso9660_primary_volume_descriptor *pvoldesc)
+{
+    fsw_status_t    status;
+    fsw_u32         size, location, off, count, i, chunk;
+    void            *buffer;
+    struct iso9660_path_table_record *rec;
+    struct iso9660_path_entry *entry;
+
+    size = ISOINT(pvoldesc->path_table_size);
+    location = pvoldesc->location_type_l_path_table;
+    if (size < 10 || size > ISO9660_PATH_TABLE_MAX)
+        return FSW_UNSUPPORTED;
+
+    status = fsw_alloc(size, &vol->path_table);
+    if (status)
+        return status;
+    for (off = 0; off < size; off += chunk) {
+        status = fsw_block_get(vol, location + (off >> ISO9660_BLOCKSIZE_BITS), 0, &buffer);
+        if (status)
+            goto errorexit;
+        chunk = (size - off < ISO9660_BLOCKSIZE) ? size - off : ISO9660_BLOCKSIZE;
+        fsw_memcpy((fsw_u8 *)vol->path_table + off, buffer, chunk);
+        fsw_block_release(vol, location + (off >> ISO9660_BLOCKSIZE_BITS), buffer);
+    }
+
+    // count the directories
+    status = FSW_VOLUME_CORRUPTED;
+    count = 0;
+    for (off = 0; off + 8 < size; off += 8 + rec->dirid_length + (rec->dirid_length & 1)) {
+        rec = (struct iso9660_path_table_record *)((fsw_u8 *)vol->path_table + off);
+        if (rec->dirid_length == 0 || off + 8 + rec->dirid_length > size)
+            goto errorexit;
+        count++;
+    }
+    // directory numbers are 16 bit
+    if (count == 0 || count > 0xffff)
+        goto errorexit;
+
+    status = fsw_alloc(count * sizeof(struct iso9660_path_entry), &vol->path_entries);
+    if (status)
+        goto errorexit;
+    status = FSW_VOLUME_CORRUPTED;
+    for (off = 0, i = 0; i < count; i++, off += 8 + rec->dirid_length + (rec->dirid_length & 1)) {
+        rec = (struct iso9660_path_table_record *)((fsw_u8 *)vol->path_table + off);
+        entry = &vol->path_entries[i];
+        entry->extent_location = rec->extent_location;
+        entry->parent_number = rec->parent_number;
+        entry->name.type = FSW_STRING_TYPE_ISO88591;
+        entry->name.len = entry->name.size = rec->dirid_length;
+        entry->name.data = rec->dirid;
+        // the root comes first, parents come before their children
+        if (i == 0) {
+            if (entry->parent_number != 1 || entry->extent_location != ISOINT(pvoldesc->root_directory.extent_location))
+                goto errorexit;
+        } else if (entry->parent_number < vol->path_entries[i-1].parent_number || entry->parent_number > i) {
+            goto errorexit;
+        }
+    }
+    vol->path_count = count;
+    DBG("iso9660: path table with %d directories\n", count);
+    return FSW_SUCCESS;
+
+errorexit:
+    if (vol->path_entries)
+        fsw_free(vol->path_entries);
+    vol->path_entries = NULL;
+    fsw_free(vol->path_table);
+    vol->path_table = NULL;
+    return status;
+}
+
+/**
+ * Lookup a subdirectory in the path table. The directory record of the child is its
+ * "." entry, so only the first block of the child is read, never the parent directory.
+ * Returns FSW_NOT_FOUND if the name must be looked up in the directory itself.
+ */
+
+static fsw_status_t fsw_iso9660_path_lookup(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno,
+                                            struct fsw_string *lookup_name, struct fsw_iso9660_dnode **child_dno_out)
+{
+    fsw_status_t    status;
+    fsw_u32         number, extent, lo, hi, mid, i;
+    void            *buffer;
+    struct iso9660_dirrec *dirrec;
+
+    // the path table only has the ISO9660 names
+    if (vol->path_entries == NULL || vol->fRockRidge)
+        return FSW_NOT_FOUND;
+
+    if (dno->path_number == 0) {
+        dno->path_number = -1;
+        for (i = 0; i < vol->path_count; i++) {
+            if (vol->path_entries[i].extent_location == ISOINT(dno->dirrec.extent_location)) {
+                dno->path_number = (int)(i + 1);
+                break;
+            }
+        }
+    }
+    if (dno->path_number < 0)
+        return FSW_NOT_FOUND;
+    number = (fsw_u32)dno->path_number;
+
+    // children have higher numbers than their parent and are sorted by parent
+    lo = number;
+    hi = vol->path_count;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (vol->path_entries[mid].parent_number < number)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (i = lo; i < vol->path_count && vol->path_entries[i].parent_number == number; i++) {
+        if (fsw_streq(lookup_name, &vol->path_entries[i].name))
+            break;
+    }
+    if (i == vol->path_count || vol->path_entries[i].parent_number != number)
+        return FSW_NOT_FOUND;
+
+    extent = vol->path_entries[i].extent_location;
+    status = fsw_block_get(vol, extent, 1, &buffer);
+    if (status)
+        return status;
+    dirrec = (struct iso9660_dirrec *)buffer;
+    if (   dirrec->dirrec_length < 34
+        || dirrec->file_identifier_length != 1
+        || dirrec->file_identifier[0] != 0
+        || (dirrec->file_flags & 0x02) == 0
+        || ISOINT(dirrec->extent_location) != extent) {
+        // does not match the directory, scan the parent
+        fsw_block_release(vol, extent, buffer);
+        return FSW_NOT_FOUND;
+    }
+
+    status = fsw_dnode_create(dno, extent << ISO9660_BLOCKSIZE_BITS, FSW_DNODE_TYPE_UNKNOWN, lookup_name, child_dno_out);
+    if (status == FSW_SUCCESS) {
+        fsw_memcpy(&(*child_dno_out)->dirrec, dirrec, sizeof(struct iso9660_dirrec));
+        (*child_dno_out)->path_number = (int)(i + 1);
+    }
+    fsw_block_release(vol, extent, buffer);
+    return status;
+}
+
+/**
+ * Parse the next block of a directory and keep its records with their final names in
+ * the dnode, so each block is decoded only once. Parsing stops when the directory is
+ * complete, or for good when the volume already has ISO9660_DIRENT_CACHE_MAX records
+ * parsed; the directory is then scanned on each access.
+ */
+
+static fsw_status_t fsw_iso9660_dirents_parse(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno)
+{
+    fsw_status_t    status;
+    fsw_u32         size, block, off, pos, alloc;
+    void            *buffer;
+    struct iso9660_dirrec *dirrec;
+    struct iso9660_dirent *dirent, *new_dirents;
+    struct fsw_string name;
+
+    if (ISO9660_DIRENT_CACHE_MAX == 0) {
+        dno->dirents_state = -1;
+        return FSW_SUCCESS;
+    }
+
+    size = ISOINT(dno->dirrec.data_length);
+    block = ISOINT(dno->dirrec.extent_location) + (dno->dirents_end >> ISO9660_BLOCKSIZE_BITS);
+    status = fsw_block_get(vol, block, 1, &buffer);
+    if (status)
+        return status;
+    for (off = 0; off + 33 <= ISO9660_BLOCKSIZE; off += dirrec->dirrec_length) {
+        pos = dno->dirents_end + off;
+        if (pos >= size)
+            break;
+        dirrec = (struct iso9660_dirrec *)((fsw_u8 *)buffer + off);
+        if (dirrec->dirrec_length == 0)
+            break;  // rest of the block is unused
+        if (   dirrec->dirrec_length < 33
+            || dirrec->dirrec_length < 33 + dirrec->file_identifier_length
+            || dirrec->file_identifier_length == 0
+            || off + dirrec->dirrec_length > ISO9660_BLOCKSIZE) {
+            status = FSW_VOLUME_CORRUPTED;
+            goto errorexit;
+        }
+
+        // skip . and ..
+        if (dirrec->file_identifier_length == 1 &&
+            (dirrec->file_identifier[0] == 0 || dirrec->file_identifier[0] == 1))
+            continue;
+
+        if (vol->dirent_count >= ISO9660_DIRENT_CACHE_MAX) {
+            fsw_block_release(vol, block, buffer);
+            fsw_iso9660_dirents_free(vol, dno);
+            dno->dirents_state = -1;
+            return FSW_SUCCESS;
+        }
+        if (dno->dirent_count == dno->dirent_alloc) {
+            alloc = dno->dirent_alloc ? dno->dirent_alloc * 2 : 32;
+            status = fsw_alloc(alloc * sizeof(struct iso9660_dirent), &new_dirents);
+            if (status)
+                goto errorexit;
+            if (dno->dirents) {
+                fsw_memcpy(new_dirents, dno->dirents, dno->dirent_count * sizeof(struct iso9660_dirent));
+                fsw_free(dno->dirents);
+            }
+            dno->dirents = new_dirents;
+            dno->dirent_alloc = alloc;
+        }
+
+        status = fsw_iso9660_dirrec_name(vol, dirrec, &name);
+        if (status)
+            goto errorexit;
+        if (name.data == dirrec->file_identifier) {
+            // keep a copy of the ISO9660 name, Rock Ridge names are allocated already
+            if (name.len > 0) {
+                status = fsw_memdup(&name.data, dirrec->file_identifier, name.len);
+                if (status)
+                    goto errorexit;
+            } else {
+                name.data = NULL;
+            }
+        }
+        dirent = &dno->dirents[dno->dirent_count];
+        dirent->name = name;
+        dirent->ino = fsw_iso9660_dirrec_ino(dno, pos, dirrec);
+        dirent->pos = pos;
+        dirent->next_pos = pos + dirrec->dirrec_length;
+        fsw_memcpy(&dirent->dirrec, dirrec, sizeof(struct iso9660_dirrec));
+        dno->dirent_count++;
+        vol->dirent_count++;
+    }
+    fsw_block_release(vol, block, buffer);
+
+    dno->dirents_end += ISO9660_BLOCKSIZE;
+    if (dno->dirents_end >= size)
+        dno->dirents_state = 1;
+    return FSW_SUCCESS;
+
+errorexit:
+    // records of this block may be parsed again
+    fsw_block_release(vol, block, buffer);
+    while (dno->dirent_count > 0 && dno->dirents[dno->dirent_count-1].pos >= dno->dirents_end) {
+        dno->dirent_count--;
+        vol->dirent_count--;
+        if (dno->dirents[dno->dirent_count].name.data)
+            fsw_free(dno->dirents[dno->dirent_count].name.data);
+    }
+    return status;
+}
+
+/**
+ * Free the parsed directory records of a dnode.
+ */
+
+static void fsw_iso9660_dirents_free(struct fsw_iso9660_volume *vol, struct fsw_iso9660_dnode *dno)
+{
+    fsw_u32         i;
+
+    for (i = 0; i < dno->dirent_count; i++) {
+        if (dno->dirents[i].name.data)
+            fsw_free(dno->dirents[i].name.data);
+    }
+    if (dno->dirents)
+        fsw_free(dno->dirents);
+    vol->dirent_count -= dno->dirent_count;
+    dno->dirents = NULL;
+    dno->dirent_count = 0;
+    dno->dirent_alloc = 0;
+    dno->dirents_end = 0;
+    dno->dirents_state = 0;
+}
+
 /**
  * Get the target path of a symbolic link. This function is called when a symbolic
  * link needs to be resolved. The core makes sure that the fsw_iso9660_dnode_fill has been
@@ -48,6 +48,14 @@
 #define ISO9660_BLOCKSIZE_BITS       11
 //! Block number where the ISO9660 superblock resides.
 #define ISO9660_SUPERBLOCK_BLOCKNO   16
+//! Largest path table that is read at mount, bigger ones are not used.
+#ifndef ISO9660_PATH_TABLE_MAX
+#define ISO9660_PATH_TABLE_MAX       (1024 * 1024)
+#endif
+//! Maximum number of parsed directory entries kept per volume, 0 disables the cache.
+#ifndef ISO9660_DIRENT_CACHE_MAX
+#define ISO9660_DIRENT_CACHE_MAX     16384
+#endif
 //Slice - we already have shifted blockIO by 16
 //but we should use ParentBlockIo
 //#define ISO9660_SUPERBLOCK_BLOCKNO   0
@@ -130,6 +138,14 @@ struct iso9660_primary_volume_descriptor {
 //#fail Structure fsw_iso9660_volume_descriptor has wrong size
 //#endif
 
+struct iso9660_path_table_record {
+    fsw_u8      dirid_length;
+    fsw_u8      ear_length;
+    fsw_u32     extent_location;
+    fsw_u16     parent_number;
+    char        dirid[1];
+};
+
 #pragma pack()
 
 struct iso9660_dirrec_buffer {
@@ -139,6 +155,28 @@ struct iso9660_dirrec_buffer {
     char        dirrec_buffer[222];
 };
 
+/**
+ * ISO9660: Directory of the path table, in path table order. Entry i has directory number i+1.
+ */
+
+struct iso9660_path_entry {
+    fsw_u32     extent_location;
+    fsw_u32     parent_number;
+    struct fsw_string name;         //!< Directory identifier, points into the path table copy
+};
+
+/**
+ * ISO9660: A directory record parsed once, with its final (Rock Ridge) name.
+ */
+
+struct iso9660_dirent {
+    fsw_u32     ino;
+    fsw_u32     pos;                //!< Offset of the record in the directory
+    fsw_u32     next_pos;           //!< Offset right after the record
+    struct fsw_string name;         //!< Owned copy of the name
+    struct iso9660_dirrec dirrec;   //!< Fixed part of the directory record
+};
+
 
 /**
  * ISO9660: Volume structure with ISO9660-specific data.
@@ -154,6 +192,11 @@ struct fsw_iso9660_volume {
     int rr_susp_skip;
 
     struct iso9660_primary_volume_descriptor *primary_voldesc;  //!< Full Primary Volume Descriptor
+
+    void        *path_table;        //!< Copy of the type L path table
+    struct iso9660_path_entry *path_entries;    //!< Parsed path table, NULL if not used
+    fsw_u32     path_count;         //!< Number of directories in the path table
+    fsw_u32     dirent_count;       //!< Parsed directory entries kept by all dnodes
 };
 
 /**
@@ -164,6 +207,13 @@ struct fsw_iso9660_dnode {
     struct fsw_dnode g;             //!< Generic dnode structure
 
     struct iso9660_dirrec dirrec;   //!< Fixed part of the directory record (i.e. w/o name)
+
+    int         path_number;        //!< Directory number in the path table, 0 unknown, -1 not there
+    int         dirents_state;      //!< 0 being parsed, 1 completely parsed, -1 not cached
+    struct iso9660_dirent *dirents; //!< Parsed directory records
+    fsw_u32     dirent_count;       //!< Number of parsed directory records
+    fsw_u32     dirent_alloc;       //!< Number of records dirents has room for
+    fsw_u32     dirents_end;        //!< Offset in the directory up to which it is parsed
 };
 
 
@@ -0,0 +1,226 @@
+/**
+ * \file bootidx.c
+ * Test of the Linux \boot index of rEFIt_UEFI/entry_scan/linuxboot.c
+ * against a file system image.
+ *
+ * The index is built from the directory as loader.c builds it. Every
+ * initrd name that loader.c may try for the kernels found, and every
+ * name of the directory with its case changed, must be found in the
+ * index exactly when the file system driver can open it.
+ */
+
+#include <time.h>
+#include <wchar.h>
+
+#include "fsw_posix.h"
+#include "linuxboot.h"
+
+
+extern struct fsw_fstype_table FSW_FSTYPE_TABLE_NAME(FSTYPE);
+
+// the same as LinuxInitImagePath of loader.c
+static const char *initrd_names[] = {
+    "initrd%s",
+    "initrd.img%s",
+    "initrd%s.img",
+    "initramfs%s",
+    "initramfs.img%s",
+    "initramfs%s.img",
+};
+
+static int failures = 0;
+
+static CHAR16 *to_char16(const char *s)
+{
+    size_t i, n = strlen(s);
+    CHAR16 *r = malloc((n + 1) * sizeof(CHAR16));
+    for (i = 0; i <= n; i++)
+        r[i] = (unsigned char)s[i];
+    return r;
+}
+
+static void to_ascii(const CHAR16 *s, char *buf, size_t size)
+{
+    size_t i;
+    for (i = 0; (i + 1 < size) && (s[i] != 0); i++)
+        buf[i] = (char)s[i];
+    buf[i] = 0;
+}
+
+static void store_time_posix(struct fsw_dnode_stat_str *sb, int which, fsw_u32 posix_time)
+{
+    EFI_TIME *t = (EFI_TIME *)sb->host_data;
+    time_t    tt = posix_time;
+    struct tm tm;
+
+    if (which != FSW_DNODE_STAT_MTIME)
+        return;
+    gmtime_r(&tt, &tm);
+    memset(t, 0, sizeof(*t));
+    t->Year = tm.tm_year + 1900;
+    t->Month = tm.tm_mon + 1;
+    t->Day = tm.tm_mday;
+    t->Hour = tm.tm_hour;
+    t->Minute = tm.tm_min;
+    t->Second = tm.tm_sec;
+}
+
+static void store_attr_posix(struct fsw_dnode_stat_str *sb, fsw_u16 posix_mode)
+{
+}
+
+static int fs_has_file(struct fsw_posix_volume *vol, const char *dir, const char *name)
+{
+    char path[4096];
+    struct fsw_posix_file *file;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    file = fsw_posix_open(vol, path, 0, 0);
+    if (file == NULL)
+        return 0;
+    fsw_posix_close(file);
+    return 1;
+}
+
+static void check(struct fsw_posix_volume *vol, const char *dir, LINUX_BOOT_INDEX *index, const char *name)
+{
+    CHAR16 *name16 = to_char16(name);
+    int     in_index = LinuxBootFileExists(index, name16);
+    int     on_disk = fs_has_file(vol, dir, name);
+
+    if (in_index != on_disk) {
+        printf("FAIL %s: index %d, file system %d\n", name, in_index, on_disk);
+        failures++;
+    }
+    free(name16);
+}
+
+static void build_index(struct fsw_posix_volume *vol, const char *dir, LINUX_BOOT_INDEX *index)
+{
+    struct fsw_posix_dir *pdir;
+    struct dirent *dent;
+    size_t capacity = 0;
+
+    memset(index, 0, sizeof(*index));
+    pdir = fsw_posix_opendir(vol, dir);
+    if (pdir == NULL) {
+        printf("opendir %s failed.\n", dir);
+        exit(1);
+    }
+    while ((dent = fsw_posix_readdir(pdir)) != NULL) {
+        char path[4096];
+        struct fsw_posix_file *file;
+        struct fsw_dnode_stat_str sb;
+        LINUX_BOOT_FILE *f;
+
+        // files only, as DirIterNext(..., 2, ...) of loader.c
+        if (dent->d_type == DT_DIR)
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, dent->d_name);
+        file = fsw_posix_open(vol, path, 0, 0);
+        if (file == NULL)
+            continue;
+        if (index->Count == capacity) {
+            capacity += 32;
+            index->Files = realloc(index->Files, capacity * sizeof(LINUX_BOOT_FILE));
+        }
+        f = &index->Files[index->Count++];
+        memset(f, 0, sizeof(*f));
+        f->FileName = to_char16(dent->d_name);
+        f->FileSize = file->shand.dnode->size;
+        sb.store_time_posix = store_time_posix;
+        sb.store_attr_posix = store_attr_posix;
+        sb.host_data = &f->ModificationTime;
+        fsw_dnode_stat(file->shand.dnode, &sb);
+        fsw_posix_close(file);
+    }
+    fsw_posix_closedir(pdir);
+    if (index->Count > 0) {
+        index->Sorted = malloc(index->Count * sizeof(LINUX_BOOT_FILE *));
+        LinuxBootIndexSort(index);
+    }
+}
+
+static void swap_case(char *s)
+{
+    for (; *s; s++) {
+        if (*s >= 'a' && *s <= 'z')
+            *s -= 'a' - 'A';
+        else if (*s >= 'A' && *s <= 'Z')
+            *s += 'a' - 'A';
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static const struct { int scan; const char *name; } scans[] = {
+        { KERNEL_SCAN_FIRST,      "first" },
+        { KERNEL_SCAN_LAST,       "last" },
+        { KERNEL_SCAN_NEWEST,     "newest" },
+        { KERNEL_SCAN_OLDEST,     "oldest" },
+        { KERNEL_SCAN_MOSTRECENT, "mostrecent" },
+        { KERNEL_SCAN_EARLIEST,   "earliest" },
+    };
+    struct fsw_posix_volume *vol;
+    const char *dir;
+    LINUX_BOOT_INDEX index;
+    LINUX_BOOT_FILE *kernel;
+    UINTN position = 0;
+    size_t i, j;
+    char name[4096], version[4096];
+
+    if (argc < 2 || argc > 3) {
+        printf("Usage: bootidx <file/device> [/boot]\n");
+        return 1;
+    }
+    dir = (argc == 3) ? argv[2] : "/boot";
+
+    vol = fsw_posix_mount(argv[1], &FSW_FSTYPE_TABLE_NAME(FSTYPE));
+    if (vol == NULL) {
+        printf("Mounting failed.\n");
+        return 1;
+    }
+    build_index(vol, dir, &index);
+    printf("%d files in %s\n", (int)index.Count, dir);
+
+    for (i = 1; i < index.Count; i++) {
+        if (StrCmp(index.Sorted[i - 1]->FileName, index.Sorted[i]->FileName) >= 0) {
+            printf("FAIL sorted order at %d\n", (int)i);
+            failures++;
+        }
+    }
+    for (i = 0; i < index.Count; i++) {
+        to_ascii(index.Files[i].FileName, name, sizeof(name));
+        check(vol, dir, &index, name);
+        swap_case(name);
+        check(vol, dir, &index, name);
+    }
+    while ((kernel = LinuxBootNextKernel(&index, &position)) != NULL) {
+        to_ascii(kernel->FileName, name, sizeof(name));
+        strcpy(version, name + strlen("vmlinuz"));
+        printf("kernel %s\n", name);
+        for (j = 0; j < sizeof(initrd_names) / sizeof(initrd_names[0]); j++) {
+            snprintf(name, sizeof(name), initrd_names[j], version);
+            check(vol, dir, &index, name);
+            swap_case(name);
+            check(vol, dir, &index, name);
+        }
+    }
+    for (i = 0; i < sizeof(scans) / sizeof(scans[0]); i++) {
+        kernel = LinuxBootFindKernel(&index, scans[i].scan);
+        if (kernel != NULL)
+            to_ascii(kernel->FileName, name, sizeof(name));
+        printf("%-10s %s\n", scans[i].name, (kernel != NULL) ? name : "-");
+    }
+    if (LinuxBootFindKernel(&index, KERNEL_SCAN_ALL) != NULL ||
+        LinuxBootFindKernel(&index, KERNEL_SCAN_NONE) != NULL) {
+        printf("FAIL all/none must not choose a kernel\n");
+        failures++;
+    }
+
+    fsw_posix_unmount(vol);
+    printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
+
+// EOF
@@ -0,0 +1,37 @@
+#!/usr/bin/env python3
+# Moves the data and extent index blocks of one file on an ext4 image with
+# 1K blocks above block 2^32 and rewrites the extent pointers, so that the
+# 48-bit block numbers are read by the driver. The block bitmaps are not
+# updated, the image is only good for reading. The image must be large
+# enough (4400G sparse), needs debugfs from e2fsprogs.
+# Usage: ext4reloc.py <image> <path>
+import struct, sys, re, subprocess
+img, path = sys.argv[1], sys.argv[2]
+BS = 1024; D = 2**32 + 12345
+out = subprocess.run(['debugfs','-R','imap '+path,img],capture_output=True,text=True).stdout
+blk = int(re.search(r'located at block (\d+), offset (0x[0-9a-f]+)', out).group(1)); off = int(re.search(r'offset (0x[0-9a-f]+)', out).group(1),16)
+f = open(img,'r+b')
+def rd(b): f.seek(b*BS); return f.read(BS)
+def wr(b, d): f.seek(b*BS); f.write(d)
+def node(buf, base):
+    magic, ent, mx, depth = struct.unpack_from('<HHHH', buf, base)
+    assert magic == 0xf30a
+    buf = bytearray(buf)
+    for i in range(ent):
+        o = base + 12 + 12*i
+        if depth == 0:
+            lb, ln, hi, lo = struct.unpack_from('<IHHI', buf, o)
+            p = (hi << 32) | lo; n = ln - 32768 if ln > 32768 else ln
+            for k in range(n): wr(p + k + D, rd(p + k))
+            p += D; struct.pack_into('<IHHI', buf, o, lb, ln, p >> 32, p & 0xffffffff)
+        else:
+            lb, lo, hi, _ = struct.unpack_from('<IIHH', buf, o)
+            p = (hi << 32) | lo
+            child = node(rd(p), 0)
+            wr(p + D, child); p += D
+            struct.pack_into('<IIHH', buf, o, lb, p & 0xffffffff, p >> 32, 0)
+    return bytes(buf)
+f.seek(blk*BS + off + 0x28); ib = f.read(60)
+nb = node(ib, 0)
+f.seek(blk*BS + off + 0x28); f.write(nb)
+print('relocated', path)
@@ -37,6 +37,8 @@
 
 #include "fsw_posix.h"
 
+#include <stdarg.h>
+
 
 #ifndef FSTYPE
 /** The file system type name to use. */
@@ -52,7 +54,7 @@ fsw_status_t fsw_posix_open_dno(struct fsw_posix_volume *pvol, const char *path,
 void fsw_posix_change_blocksize(struct fsw_volume *vol,
                               fsw_u32 old_phys_blocksize, fsw_u32 old_log_blocksize,
                               fsw_u32 new_phys_blocksize, fsw_u32 new_log_blocksize);
-fsw_status_t fsw_posix_read_block(struct fsw_volume *vol, fsw_u32 phys_bno, void *buffer);
+fsw_status_t fsw_posix_read_block(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer);
 
 /**
  * Dispatch table for our FSW host driver.
@@ -67,6 +69,26 @@ struct fsw_host_table   fsw_posix_host_table = {
 
 extern struct fsw_fstype_table   FSW_FSTYPE_TABLE_NAME(FSTYPE);
 
+unsigned long fsw_posix_block_reads = 0;
+unsigned long fsw_posix_fail_read = 0;
+int fsw_posix_utf16_names = 0;
+unsigned long fsw_posix_dir_lookups = 0;
+
+/** The fs driver's table with dir_lookup counted, for the mounted volumes */
+static struct fsw_fstype_table fsw_posix_counted_table;
+static struct fsw_fstype_table *fsw_posix_counted_driver;
+
+/**
+ * Count a name lookup which reaches the fs driver.
+ */
+
+static fsw_status_t fsw_posix_dir_lookup(struct fsw_volume *vol, struct fsw_dnode *dno,
+                                         struct fsw_string *lookup_name, struct fsw_dnode **child_dno)
+{
+    fsw_posix_dir_lookups++;
+    return fsw_posix_counted_driver->dir_lookup(vol, dno, lookup_name, child_dno);
+}
+
 
 /**
  * Mount function.
@@ -94,7 +116,10 @@ struct fsw_posix_volume * fsw_posix_mount(const char *path, struct fsw_fstype_ta
     // mount the filesystem
     if (fstype_table == NULL)
         fstype_table = &FSW_FSTYPE_TABLE_NAME(FSTYPE);
-    status = fsw_mount(pvol, &fsw_posix_host_table, fstype_table, &pvol->vol);
+    fsw_posix_counted_driver = fstype_table;
+    fsw_posix_counted_table = *fstype_table;
+    fsw_posix_counted_table.dir_lookup = fsw_posix_dir_lookup;
+    status = fsw_mount(pvol, &fsw_posix_host_table, &fsw_posix_counted_table, &pvol->vol);
     if (status) {
         fprintf(stderr, "fsw_posix_mount: fsw_mount returned %d\n", status);
         fsw_free(pvol);
@@ -301,11 +326,21 @@ fsw_status_t fsw_posix_open_dno(struct fsw_posix_volume *pvol, const char *path,
     struct fsw_dnode    *dno;
     struct fsw_dnode    *target_dno;
     struct fsw_string   lookup_path;
+    fsw_u16             path16[4096];
+    int                 i;
 
     lookup_path.type = FSW_STRING_TYPE_ISO88591;
     lookup_path.len  = strlen(path);
     lookup_path.size = lookup_path.len;
     lookup_path.data = (void *)path;
+    if (fsw_posix_utf16_names && lookup_path.len < 4096) {
+        // the EFI host looks up UTF-16 names
+        for (i = 0; i < lookup_path.len; i++)
+            path16[i] = (fsw_u8)path[i];
+        lookup_path.type = FSW_STRING_TYPE_UTF16;
+        lookup_path.size = lookup_path.len * sizeof(fsw_u16);
+        lookup_path.data = path16;
+    }
 
     // resolve the path (symlinks along the way are automatically resolved)
     status = fsw_dnode_lookup_path(pvol->vol->root, &lookup_path, '/', &dno);
@@ -362,13 +397,16 @@ void fsw_posix_change_blocksize(struct fsw_volume *vol,
  * to read a block of data from the device. The buffer is allocated by the core code.
  */
 
-fsw_status_t fsw_posix_read_block(struct fsw_volume *vol, fsw_u32 phys_bno, void *buffer)
+fsw_status_t fsw_posix_read_block(struct fsw_volume *vol, fsw_u64 phys_bno, void *buffer)
 {
     struct fsw_posix_volume *pvol = (struct fsw_posix_volume *)vol->host_data;
     off_t           block_offset, seek_result;
     ssize_t         read_result;
 
-    FSW_MSG_DEBUGV((FSW_MSGSTR("fsw_posix_read_block: %d  (%d)\n"), phys_bno, vol->phys_blocksize));
+    FSW_MSG_DEBUGV((FSW_MSGSTR("fsw_posix_read_block: %d  (%d)\n"), (int)phys_bno, vol->phys_blocksize));
+
+    if (++fsw_posix_block_reads == fsw_posix_fail_read)
+        return FSW_IO_ERROR;
 
     // read from disk
     block_offset = (off_t)phys_bno * vol->phys_blocksize;
@@ -476,4 +514,37 @@ EFI_STATUS fsw_posix_dnode_fill_FileInfo(IN FSW_VOLUME_DATA *Volume,
 }
 */
 
+/**
+ * PrintLib replacements for the drivers, formats as printf.
+ */
+
+UINTN AsciiSPrint(CHAR8 *buf, UINTN size, const CHAR8 *format, ...)
+{
+    va_list args;
+    int     len;
+
+    va_start(args, format);
+    len = vsnprintf(buf, size, format, args);
+    va_end(args);
+    return (len < 0) ? 0 : (len >= (int)size ? size - 1 : len);
+}
+
+UINTN UnicodeSPrint(CHAR16 *buf, UINTN size, const CHAR16 *format, ...)
+{
+    char    fmt[256], out[256];
+    va_list args;
+    UINTN   i, len;
+
+    for (i = 0; format[i] != 0 && i + 1 < sizeof(fmt); i++)
+        fmt[i] = (char)format[i];
+    fmt[i] = 0;
+    va_start(args, format);
+    vsnprintf(out, sizeof(out), fmt, args);
+    va_end(args);
+    for (len = 0; out[len] != 0 && (len + 1) * sizeof(CHAR16) < size; len++)
+        buf[len] = (unsigned char)out[len];
+    buf[len] = 0;
+    return len;
+}
+
 // EOF
@@ -79,6 +79,14 @@ struct fsw_posix_dir {
 };
 
 
+/* counters and fault injection for the tests */
+
+extern unsigned long fsw_posix_block_reads;     //!< Number of blocks read from the image
+extern unsigned long fsw_posix_fail_read;       //!< Read number fsw_posix_block_reads which fails, 0 for none
+extern unsigned long fsw_posix_dir_lookups;     //!< Number of name lookups passed to the fs driver
+extern int fsw_posix_utf16_names;               //!< Look up paths as UTF-16 names like the EFI host
+
+
 /* functions */
 
 struct fsw_posix_volume * fsw_posix_mount(const char *path, struct fsw_fstype_table *fstype_table);
@@ -44,6 +44,8 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdint.h>
+#include <stddef.h>
 
 #define FSW_LITTLE_ENDIAN (1)
 // TODO: use info from the headers to define FSW_LITTLE_ENDIAN or FSW_BIG_ENDIAN
@@ -51,14 +53,14 @@
 
 // types
 
-typedef signed char         fsw_s8;
-typedef unsigned char       fsw_u8;
-typedef short               fsw_s16;
-typedef unsigned short      fsw_u16;
-typedef long                fsw_s32;
-typedef unsigned long       fsw_u32;
-typedef long long           fsw_s64;
-typedef unsigned long long  fsw_u64;
+typedef int8_t              fsw_s8;
+typedef uint8_t             fsw_u8;
+typedef int16_t             fsw_s16;
+typedef uint16_t            fsw_u16;
+typedef int32_t             fsw_s32;
+typedef uint32_t            fsw_u32;
+typedef int64_t             fsw_s64;
+typedef uint64_t            fsw_u64;
 
 
 // allocation functions
@@ -86,4 +88,36 @@ typedef unsigned long long  fsw_u64;
 #define RShiftU64(val, shift) ((val) >> (shift))
 #define LShiftU64(val, shift) ((val) << (shift))
 
+// EDK2 types and BaseLib/PrintLib functions used by the file system drivers,
+// the same types as linuxboot_posix_base.h so both can be included
+
+typedef unsigned char       UINT8;
+typedef unsigned short      UINT16;
+typedef unsigned short      CHAR16;
+typedef unsigned int        UINT32;
+typedef unsigned long long  UINT64;
+typedef long long           INTN;
+typedef unsigned long long  UINTN;
+typedef char                CHAR8;
+
+typedef struct {
+    UINT32  Data1;
+    UINT16  Data2;
+    UINT16  Data3;
+    UINT8   Data4[8];
+} EFI_GUID;
+
+#define OFFSET_OF(type, field) offsetof(type, field)
+#define SwapBytes16(val) __builtin_bswap16(val)
+#define SwapBytes32(val) __builtin_bswap32(val)
+#define SwapBytes64(val) __builtin_bswap64(val)
+#define MultU64x32(val, mul) ((UINT64)(val) * (mul))
+
+static inline UINT32 ReadUnaligned32(const void *p) { UINT32 v; memcpy(&v, p, sizeof(v)); return v; }
+static inline UINT64 ReadUnaligned64(const void *p) { UINT64 v; memcpy(&v, p, sizeof(v)); return v; }
+
+// in fsw_posix.c, for %d and %s only; CHAR16 strings need -fshort-wchar
+UINTN AsciiSPrint(CHAR8 *buf, UINTN size, const CHAR8 *format, ...);
+UINTN UnicodeSPrint(CHAR16 *buf, UINTN size, const CHAR16 *format, ...);
+
 #endif
@@ -0,0 +1,118 @@
+/**
+ * \file linuxboot_posix_base.h
+ * Base definitions for building rEFIt_UEFI/entry_scan/linuxboot.c in the
+ * POSIX user space environment. Compile with -fshort-wchar, like the
+ * EFI build, so that L"" literals are CHAR16 strings.
+ */
+
+#ifndef _LINUXBOOT_POSIX_BASE_H_
+#define _LINUXBOOT_POSIX_BASE_H_
+
+#include <string.h>
+#include <wctype.h>
+
+// types, the same as ProcessorBind.h of X64
+
+typedef unsigned char       UINT8;
+typedef unsigned char       BOOLEAN;
+typedef unsigned short      UINT16;
+typedef unsigned short      CHAR16;
+typedef unsigned int        UINT32;
+typedef unsigned long long  UINT64;
+typedef long long           INTN;
+typedef unsigned long long  UINTN;
+
+#ifndef IN
+#define IN
+#define OUT
+#define OPTIONAL
+#endif
+#ifndef VOID
+#define VOID void
+#endif
+#ifndef STATIC
+#define STATIC static
+#endif
+#ifndef TRUE
+#define TRUE  ((BOOLEAN)(1==1))
+#define FALSE ((BOOLEAN)(0==1))
+#endif
+#ifndef NULL
+#define NULL ((VOID *) 0)
+#endif
+
+typedef struct {
+  UINT16  Year;
+  UINT8   Month;
+  UINT8   Day;
+  UINT8   Hour;
+  UINT8   Minute;
+  UINT8   Second;
+  UINT8   Pad1;
+  UINT32  Nanosecond;
+  UINT16  TimeZone;
+  UINT8   Daylight;
+  UINT8   Pad2;
+} EFI_TIME;
+
+// from rEFIt_UEFI/Platform/Platform.h
+
+#define KERNEL_SCAN_ALL        (0)
+#define KERNEL_SCAN_NEWEST     (1)
+#define KERNEL_SCAN_OLDEST     (2)
+#define KERNEL_SCAN_FIRST      (3)
+#define KERNEL_SCAN_LAST       (4)
+#define KERNEL_SCAN_MOSTRECENT (5)
+#define KERNEL_SCAN_EARLIEST   (6)
+#define KERNEL_SCAN_NONE       (100)
+
+// from rEFIt_UEFI/refit/lib.h
+
+typedef struct {
+  CHAR16              *FileName;
+  UINT64              FileSize;
+  EFI_TIME            ModificationTime;
+} LINUX_BOOT_FILE;
+
+typedef struct {
+  UINTN               Count;
+  LINUX_BOOT_FILE     *Files;     // in directory order
+  LINUX_BOOT_FILE     **Sorted;   // by name, exact
+} LINUX_BOOT_INDEX;
+
+// library functions
+
+static inline INTN StrCmp(const CHAR16 *FirstString, const CHAR16 *SecondString)
+{
+    while ((*FirstString != 0) && (*FirstString == *SecondString)) {
+        FirstString++;
+        SecondString++;
+    }
+    return *FirstString - *SecondString;
+}
+
+static inline VOID *CopyMem(VOID *Destination, const VOID *Source, UINTN Length)
+{
+    return memmove(Destination, Source, Length);
+}
+
+// case insensitive, '*' and '?' only, like the English UnicodeCollation
+static inline BOOLEAN MetaiMatch(const CHAR16 *String, const CHAR16 *Pattern)
+{
+    if (*Pattern == 0)
+        return *String == 0;
+    if (*Pattern == '*') {
+        do {
+            if (MetaiMatch(String, Pattern + 1))
+                return TRUE;
+        } while (*String++ != 0);
+        return FALSE;
+    }
+    if (*String == 0)
+        return FALSE;
+    if ((*Pattern != '?') && (towupper(*Pattern) != towupper(*String)))
+        return FALSE;
+    return MetaiMatch(String + 1, Pattern + 1);
+}
+
+#endif
@@ -1,6 +1,12 @@
 /**
  * \file lslr.c
  * Test program for the POSIX user space environment.
+ *
+ * Without a manifest it lists the volume. With -m it checks the volume
+ * against the manifest written by the image generator: one line
+ * "path size [hole_start hole_end [hole_period]]" per file, where byte n of
+ * the file is (sum of the bytes of path + 7 * n) & 0xFF, or zero inside the
+ * hole. With a period the hole repeats every hole_period bytes.
  */
 
 /*-
@@ -37,6 +43,8 @@
 
 #include "fsw_posix.h"
 
+#include <ctype.h>
+
 
 //extern struct fsw_fstype_table FSW_FSTYPE_TABLE_NAME(ext2);
 //extern struct fsw_fstype_table FSW_FSTYPE_TABLE_NAME(reiserfs);
@@ -49,26 +57,195 @@ static struct fsw_fstype_table *fstypes[] = {
     NULL
 };
 
-static int listdir(struct fsw_posix_volume *vol, char *path, int level)
+/** Files are compared up to this size, the pos of fsw_shandle is 32 bit anyway */
+#define CHECK_MAX_SIZE (16 * 1024 * 1024)
+
+struct manifest_entry {
+    char        *path;
+    long long   size;
+    long long   hole_start, hole_end, hole_period;
+    int         listed;
+};
+
+static struct manifest_entry *manifest;
+static int manifest_count;
+static int failures;
+static long listed_entries;
+static unsigned char buf[1 << 16];
+
+static int entry_cmp(const void *a, const void *b)
+{
+    return strcmp(((const struct manifest_entry *)a)->path, ((const struct manifest_entry *)b)->path);
+}
+
+static void load_manifest(const char *path)
+{
+    FILE *f;
+    char line[4200], name[4096];
+    int capacity = 0;
+    struct manifest_entry *e;
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        printf("can not open %s\n", path);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (manifest_count == capacity) {
+            capacity += 1024;
+            manifest = realloc(manifest, capacity * sizeof(struct manifest_entry));
+        }
+        e = &manifest[manifest_count];
+        memset(e, 0, sizeof(*e));
+        if (sscanf(line, "%4095s %lld %lld %lld %lld", name, &e->size, &e->hole_start, &e->hole_end, &e->hole_period) < 2)
+            continue;
+        e->path = strdup(name);
+        manifest_count++;
+    }
+    fclose(f);
+    qsort(manifest, manifest_count, sizeof(struct manifest_entry), entry_cmp);
+}
+
+static struct manifest_entry *find_entry(const char *path)
+{
+    struct manifest_entry key;
+
+    key.path = (char *)path;
+    return bsearch(&key, manifest, manifest_count, sizeof(struct manifest_entry), entry_cmp);
+}
+
+static unsigned char expected_byte(struct manifest_entry *e, long long offset)
+{
+    long long in_period = (e->hole_period > 0) ? offset % e->hole_period : offset;
+    unsigned seed = 0;
+    const char *p;
+
+    if (in_period >= e->hole_start && in_period < e->hole_end)
+        return 0;
+    for (p = e->path; *p; p++)
+        seed += (unsigned char)*p;
+    return (unsigned char)((seed + offset * 7) & 0xFF);
+}
+
+/** Reads the open file from the start and compares it, returns 0 if it matches */
+static int compare_file(struct fsw_posix_file *file, struct manifest_entry *e)
+{
+    long long done = 0, limit = e->size < CHECK_MAX_SIZE ? e->size : CHECK_MAX_SIZE;
+    ssize_t r;
+    int i;
+
+    fsw_posix_lseek(file, 0, SEEK_SET);
+    while (done < limit) {
+        r = fsw_posix_read(file, buf, (limit - done) < (long long)sizeof(buf) ? (size_t)(limit - done) : sizeof(buf));
+        if (r <= 0)
+            return 1;
+        for (i = 0; i < r; i++) {
+            if (buf[i] != expected_byte(e, done + i))
+                return 1;
+        }
+        done += r;
+    }
+    return 0;
+}
+
+static void check_file(struct fsw_posix_volume *vol, struct manifest_entry *e, const char *path)
+{
+    struct fsw_posix_file *file;
+
+    file = fsw_posix_open(vol, path, 0, 0);
+    if (file == NULL) {
+        printf("FAIL open %s\n", path);
+        failures++;
+        return;
+    }
+    if (fsw_posix_lseek(file, 0, SEEK_END) != e->size) {
+        printf("FAIL size of %s\n", path);
+        failures++;
+    } else if (compare_file(file, e)) {
+        printf("FAIL content of %s\n", path);
+        failures++;
+    }
+    fsw_posix_close(file);
+}
+
+/** On a fresh mount the n-th block read after open fails, then the same handle must read the file right */
+static void check_read_errors(const char *image, struct manifest_entry *e, unsigned long max_fail)
+{
+    struct fsw_posix_volume *vol;
+    struct fsw_posix_file *file;
+    unsigned long n;
+
+    for (n = 1; n <= max_fail; n++) {
+        vol = fsw_posix_mount(image, fstypes[0]);
+        if (vol == NULL) {
+            printf("FAIL mount\n");
+            failures++;
+            return;
+        }
+        file = fsw_posix_open(vol, e->path, 0, 0);
+        if (file == NULL) {
+            printf("FAIL open %s\n", e->path);
+            failures++;
+        } else {
+            fsw_posix_fail_read = fsw_posix_block_reads + n;
+            compare_file(file, e);
+            fsw_posix_fail_read = 0;
+            if (compare_file(file, e)) {
+                printf("FAIL %s after a failed block read %lu\n", e->path, n);
+                failures++;
+            }
+            fsw_posix_close(file);
+        }
+        fsw_posix_unmount(vol);
+    }
+}
+
+static void check_missing(struct fsw_posix_volume *vol, const char *path)
+{
+    struct fsw_posix_file *file;
+
+    if (find_entry(path) != NULL)
+        return;
+    file = fsw_posix_open(vol, path, 0, 0);
+    if (file != NULL) {
+        printf("FAIL %s found\n", path);
+        failures++;
+        fsw_posix_close(file);
+    }
+}
+
+static int listdir(struct fsw_posix_volume *vol, char *path, int level, int check)
 {
     struct fsw_posix_dir *dir;
     struct dirent *dent;
+    struct manifest_entry *e;
     int i;
     char subpath[4096];
 
     dir = fsw_posix_opendir(vol, path);
     if (dir == NULL) {
         printf("opendir(%s) call failed.\n", path);
+        failures++;
         return 1;
     }
     while ((dent = fsw_posix_readdir(dir)) != NULL) {
-        for (i = 0; i < level*2; i++)
-            fputc(' ', stdout);
-        printf("%d  %s\n", dent->d_type, dent->d_name);
+        listed_entries++;
+        if (!check) {
+            for (i = 0; i < level*2; i++)
+                fputc(' ', stdout);
+            printf("%d  %s\n", dent->d_type, dent->d_name);
+        }
 
+        snprintf(subpath, 4095, "%s%s", path, dent->d_name);
         if (dent->d_type == DT_DIR) {
-            snprintf(subpath, 4095, "%s%s/", path, dent->d_name);
-            listdir(vol, subpath, level + 1);
+            strcat(subpath, "/");
+            listdir(vol, subpath, level + 1, check);
+        } else if (check) {
+            e = find_entry(subpath);
+            if (e != NULL && e->listed++) {
+                printf("FAIL %s listed twice\n", subpath);
+                failures++;
+            }
         }
     }
     fsw_posix_closedir(dir);
@@ -76,44 +253,60 @@ static int listdir(struct fsw_posix_volume *vol, char *path, int level)
     return 0;
 }
 
-static int catfile(struct fsw_posix_volume *vol, char *path)
+static void swap_case(char *s)
 {
-    struct fsw_posix_file *file;
-    int r;
-    char buf[256];
-
-    file = fsw_posix_open(vol, path, 0, 0);
-    if (file == NULL) {
-        printf("open(%s) call failed.\n", path);
-        return 1;
+    for (; *s; s++) {
+        if (islower((unsigned char)*s))
+            *s = toupper((unsigned char)*s);
+        else if (isupper((unsigned char)*s))
+            *s = tolower((unsigned char)*s);
     }
-    while ((r=fsw_posix_read(file, buf, sizeof(buf))) > 0)
-    {
-        int i;
-        for (i=0; i<r; i++)
-        {
-           printf("%c", buf[i]);
-        }
-    }
-    fsw_posix_close(file);
+}
 
-    return 0;
+static void usage(void)
+{
+    printf("Usage: lslr [-u] [-m manifest [-i] [-n] [-f reads] [-L reads] [-C lookups] [-R reads]] <file/device>\n"
+           "  -u  look up UTF-16 names like the EFI host\n"
+           "  -m  check files and listing against the manifest\n"
+           "  -i  names are case insensitive, open them with case swapped too\n"
+           "  -n  names not in the manifest must not be found\n"
+           "  -f  on a new mount fail read n after open, for n up to reads, then read again\n"
+           "  -L  fail if the first pass over the manifest needs more block reads\n"
+           "  -C  fail if the second pass passes more name lookups to the driver\n"
+           "  -R  fail if listing the volume needs more block reads\n");
+    exit(1);
 }
 
 int main(int argc, char **argv)
 {
     struct fsw_posix_volume *vol;
-    int i;
+    const char *manifest_path = NULL;
+    int case_insensitive = 0, check_negative = 0;
+    unsigned long max_fail = 0, max_pass_reads = 0, max_pass_lookups = ~0UL, max_list_reads = 0;
+    unsigned long reads, lookups;
+    int i, opt, pass;
+    char path[4200];
 
-    if (argc != 2) {
-        printf("Usage: lslr <file/device>\n");
-        return 1;
+    while ((opt = getopt(argc, argv, "um:inf:L:C:R:")) != -1) {
+        switch (opt) {
+            case 'u': fsw_posix_utf16_names = 1; break;
+            case 'm': manifest_path = optarg; break;
+            case 'i': case_insensitive = 1; break;
+            case 'n': check_negative = 1; break;
+            case 'f': max_fail = strtoul(optarg, NULL, 0); break;
+            case 'L': max_pass_reads = strtoul(optarg, NULL, 0); break;
+            case 'C': max_pass_lookups = strtoul(optarg, NULL, 0); break;
+            case 'R': max_list_reads = strtoul(optarg, NULL, 0); break;
+            default: usage();
+        }
     }
+    if (optind + 1 != argc)
+        usage();
 
     for (i = 0; fstypes[i]; i++) {
-        vol = fsw_posix_mount(argv[1], fstypes[i]);
+        vol = fsw_posix_mount(argv[optind], fstypes[i]);
         if (vol != NULL) {
-            printf("Mounted as '%s'.\n", fstypes[i]->name.data);
+            printf("Mounted as '%s'.\n", (char *)fstypes[i]->name.data);
             break;
         }
     }
@@ -122,15 +315,62 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    //listdir(vol, "/System/Library/Extensions/udf.kext/", 0);
-    //listdir(vol, "/System/Library/Extensions/AppleACPIPlatform.kext/", 0);
-    //listdir(vol, "/System/Library/Extensions/", 0);
-    catfile(vol, "/System/Library/Extensions/AppleHPET.kext/Contents/Info.plist");
-    //listdir(vol, "/", 0);
+    if (manifest_path == NULL) {
+        listdir(vol, "/", 0, 0);
+        fsw_posix_unmount(vol);
+        return 0;
+    }
 
-    fsw_posix_unmount(vol);
+    load_manifest(manifest_path);
+    // the second pass shows what the caches of the driver save
+    for (pass = 0; pass < 2; pass++) {
+        reads = fsw_posix_block_reads;
+        lookups = fsw_posix_dir_lookups;
+        for (i = 0; i < manifest_count; i++) {
+            check_file(vol, &manifest[i], manifest[i].path);
+            if (case_insensitive) {
+                strcpy(path, manifest[i].path);
+                swap_case(path);
+                check_file(vol, &manifest[i], path);
+            }
+            if (check_negative) {
+                snprintf(path, sizeof(path), "%s~", manifest[i].path);
+                check_missing(vol, path);
+            }
+        }
+        reads = fsw_posix_block_reads - reads;
+        lookups = fsw_posix_dir_lookups - lookups;
+        printf("pass %d: %d files, %lu block reads, %lu lookups\n", pass, manifest_count, reads, lookups);
+        if (pass == 0 && max_pass_reads > 0 && reads > max_pass_reads) {
+            printf("FAIL the files need more than %lu block reads\n", max_pass_reads);
+            failures++;
+        }
+        if (pass == 1 && lookups > max_pass_lookups) {
+            printf("FAIL the driver got more than %lu name lookups\n", max_pass_lookups);
+            failures++;
+        }
+    }
+    for (i = 0; i < manifest_count && max_fail > 0; i++)
+        check_read_errors(argv[optind], &manifest[i], max_fail);
 
-    return 0;
+    reads = fsw_posix_block_reads;
+    listdir(vol, "/", 0, 1);
+    reads = fsw_posix_block_reads - reads;
+    printf("listing: %ld entries, %lu block reads\n", listed_entries, reads);
+    for (i = 0; i < manifest_count; i++) {
+        if (!manifest[i].listed) {
+            printf("FAIL %s not listed\n", manifest[i].path);
+            failures++;
+        }
+    }
+    if (max_list_reads > 0 && reads > max_list_reads) {
+        printf("FAIL listing needs more than %lu block reads\n", max_list_reads);
+        failures++;
+    }
+
+    fsw_posix_unmount(vol);
+    printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
 }
 
 // EOF
@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+# Source tree for mkfs.ext4 -d, for lslr: files with holes and with extent
+# trees of depth 2 when the file system has 1K blocks.
+# Usage: mkext4tree.py <dir> <manifest> [big|htree]
+# With "big" only the files relocated by ext4reloc.py are written, with
+# "htree" only a directory large enough for a hash index of two levels.
+import os, sys
+
+root, manifest = sys.argv[1], sys.argv[2]
+mode = sys.argv[3] if len(sys.argv) > 3 else ''
+lines = []
+
+def content(path, offset, n):
+    seed = sum(path.encode())
+    return bytes(((seed + (offset + i) * 7) & 0xFF) for i in range(n))
+
+def add_file(path, size, hole_start=0, hole_end=0, hole_period=0):
+    """Writes the file, the hole [hole_start, hole_end) repeats every hole_period bytes"""
+    full = root + path
+    os.makedirs(os.path.dirname(full), exist_ok=True)
+    period = hole_period or size
+    with open(full, 'wb') as f:
+        for base in range(0, size, period):
+            for start, end in ((base, base + hole_start), (base + hole_end, base + period)):
+                end = min(end, size)
+                if start < end:
+                    f.seek(start)
+                    f.write(content(path, start, end - start))
+        f.truncate(size)
+    if hole_end > hole_start:
+        lines.append('%s %d %d %d %d' % (path, size, hole_start, hole_end, hole_period))
+    else:
+        lines.append('%s %d' % (path, size))
+
+if mode == 'htree':
+    # mixed case names, more leaf blocks than the dx_root of a 1K block holds
+    for k in range(8000):
+        add_file('/htree/File%04d.Img' % k, 16 + k % 50)
+else:
+    # one extent
+    add_file('/boot/vmlinuz', 1000000)
+    # 1K of data every 2K: 1500 extents, 19 leaves below an index block with 1K blocks
+    add_file('/frag', 3000 * 1024 + 100, 1024, 2048, 2048)
+if mode == '':
+    # sparse extents of 4 GB and more in front of the data
+    add_file('/hole4g', (4 << 30) + 4096, 0, 4 << 30)
+    add_file('/hole5g', (5 << 30) + 100, 0, 5 << 30)
+    add_file('/tail', 100000, 50000, 100000)
+    for k in range(200):
+        add_file('/dir/f%03d' % k, 1000 + k)
+
+with open(manifest, 'w') as f:
+    f.write('\n'.join(lines) + '\n')
@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+# Synthetic HFS+ image for lslr: a deep tree of kext dirs, one big directory
+# and a fragmented file with extents overflow records.
+# Usage: mkhfs.py <image> [files [seed]], writes <image>.manifest for lslr -m.
+import struct, sys, random
+BS = 4096          # allocation block
+NS = 4096          # b-tree node size
+random.seed(int(sys.argv[3]) if len(sys.argv) > 3 else 1)
+out = sys.argv[1]
+nfiles = int(sys.argv[2]) if len(sys.argv) > 2 else 3000
+
+def catkey(parent, name):
+    u = name.encode('utf-16-be')
+    return struct.pack('>HIH', 6 + len(u), parent, len(name)) + u
+
+def extkey(fileid, start):
+    return struct.pack('>HBBII', 10, 0, 0, fileid, start)
+
+def fork(size, exts):
+    e = b''.join(struct.pack('>II', s, c) for s, c in exts[:8])
+    e += b'\0' * (64 - len(e))
+    return struct.pack('>QII', size, 0, sum(c for _, c in exts)) + e
+
+def folder(cnid, valence):
+    return struct.pack('>hHII', 1, 0, valence, cnid) + b'\0' * 20 + struct.pack('>IIBBHI', 0, 0, 0, 0, 0o40755, 0) + b'\0' * 40
+
+def filerec(cnid, size, exts):
+    return (struct.pack('>hHII', 2, 0, 0, cnid) + b'\0' * 20 + struct.pack('>IIBBHI', 0, 0, 0, 0, 0o100644, 0)
+            + b'\0' * 16 + b'\0' * 16 + b'\0' * 8 + fork(size, exts) + fork(0, []))
+
+def thread(kind, parent, name):
+    u = name.encode('utf-16-be')
+    return struct.pack('>hhIH', kind, 0, parent, len(name)) + u
+
+def pack_nodes(recs, kind, height, first_no):
+    nodes = []
+    cur = []
+    used = 14 + 2
+    for k, d in recs:
+        r = k + d
+        if cur and used + len(r) + 2 > NS:
+            nodes.append(cur); cur = []; used = 14 + 2
+        cur.append(r); used += len(r) + 2
+    if cur:
+        nodes.append(cur)
+    out = []
+    for i, rs in enumerate(nodes):
+        no = first_no + i
+        flink = no + 1 if i + 1 < len(nodes) else 0
+        blink = no - 1 if i > 0 else 0
+        buf = bytearray(NS)
+        struct.pack_into('>IIbBHH', buf, 0, flink, blink, kind, height, len(rs), 0)
+        off = 14; offs = []
+        for r in rs:
+            offs.append(off); buf[off:off + len(r)] = r; off += len(r)
+        offs.append(off)
+        for j, o in enumerate(offs):
+            struct.pack_into('>H', buf, NS - 2 * j - 2, o)
+        out.append((no, bytes(buf), rs))
+    return out
+
+def build_tree(recs, keylen_of, btype, cmptype):
+    # returns list of node buffers (node 0 = header)
+    nodes = {}
+    level = pack_nodes(recs, -1, 1, 1)
+    first_leaf, last_leaf = level[0][0], level[-1][0]
+    nextno = level[-1][0] + 1
+    height = 1
+    for no, buf, rs in level:
+        nodes[no] = buf
+    while len(level) > 1:
+        height += 1
+        irecs = []
+        for no, buf, rs in level:
+            k = rs[0][:keylen_of(rs[0]) + 2]
+            irecs.append((k, struct.pack('>I', no)))
+        level = pack_nodes(irecs, 0, height, nextno)
+        nextno = level[-1][0] + 1
+        for no, buf, rs in level:
+            nodes[no] = buf
+    root = level[0][0] if recs else 0
+    total = nextno
+    hdr = bytearray(NS)
+    struct.pack_into('>IIbBHH', hdr, 0, 0, 0, 1, 0, 3, 0)
+    hr = struct.pack('>HIIIIHHIIHIBBI', height if recs else 0, root, len(recs), first_leaf if recs else 0,
+                     last_leaf if recs else 0, NS, 516 if btype == 0 else 10, total, 0, 0, NS, btype, cmptype, 6) + b'\0' * 64
+    hdr[14:14 + len(hr)] = hr
+    for j, o in enumerate([14, 14 + 106, 14 + 106 + 128, NS - 8]):
+        struct.pack_into('>H', hdr, NS - 2 * j - 2, o)
+    nodes[0] = bytes(hdr)
+    return [nodes[i] for i in range(total)]
+
+# ---- layout of the file system
+cnid = [16]
+def newid():
+    cnid[0] += 1; return cnid[0]
+
+blocks = {}       # block number -> data
+nextblock = [64]  # data starts here, metadata below
+def alloc(n, gap=0):
+    s = nextblock[0]; nextblock[0] += n + gap; return s
+
+cat = []          # (key, data)
+ext = []
+manifest = []     # path, size, checksum/contents
+dirs = {2: []}
+
+def add_dir(parent, name):
+    i = newid()
+    cat.append((catkey(parent, name), folder(i, 0)))
+    cat.append((catkey(i, ''), thread(3, parent, name)))
+    return i
+
+def add_file(parent, name, path, data, fragments=None):
+    i = newid()
+    nblk = (len(data) + BS - 1) // BS
+    exts = []
+    if fragments:
+        # fragments: list of run lengths; gaps between runs except where 0-gap to test coalescing
+        lb = 0
+        for run, gap in fragments:
+            s = alloc(run, gap); exts.append((s, run)); lb += run
+        assert lb == nblk, (lb, nblk)
+    elif nblk:
+        exts.append((alloc(nblk), nblk))
+    lb = 0
+    for s, c in exts:
+        for b in range(c):
+            blocks[s + b] = data[(lb + b) * BS:(lb + b + 1) * BS]
+        lb += c
+    cat.append((catkey(parent, name), filerec(i, len(data), exts)))
+    if len(exts) > 8:
+        lb = sum(c for _, c in exts[:8])
+        rest = exts[8:]
+        while rest:
+            grp = rest[:8]; rest = rest[8:]
+            ext.append((extkey(i, lb), b''.join(struct.pack('>II', s, c) for s, c in grp) + b'\0' * (64 - 8 * len(grp))))
+            lb += sum(c for _, c in grp)
+    manifest.append((path, len(data)))
+    return i
+
+cat.append((catkey(1, 'Test'), folder(2, 0)))
+cat.append((catkey(2, ''), thread(3, 1, 'Test')))
+sysd = add_dir(2, 'System')
+lib = add_dir(sysd, 'Library')
+cs = add_dir(lib, 'CoreServices')
+exts_dir = add_dir(lib, 'Extensions')
+def content(path, n):
+    seed = sum(path.encode())
+    b = bytes(((seed + i * 7) & 0xFF) for i in range(n))
+    return b
+p = '/System/Library/CoreServices/boot.efi'
+add_file(cs, 'boot.efi', p, content(p, 300000))
+p = '/System/Library/CoreServices/SystemVersion.plist'
+add_file(cs, 'SystemVersion.plist', p, content(p, 500))
+for k in range(nfiles):
+    name = 'Kext%05d.kext' % k
+    d = add_dir(exts_dir, name)
+    c = add_dir(d, 'Contents')
+    p = '/System/Library/Extensions/%s/Contents/Info.plist' % name
+    add_file(c, 'Info.plist', p, content(p, 700 + k % 300))
+big = add_dir(2, 'Big')
+for k in range(nfiles):
+    p = '/Big/f%06d' % k
+    add_file(big, 'f%06d' % k, p, content(p, 10))
+# fragmented file: 100 runs, some of them adjacent
+runs = []
+for k in range(100):
+    runs.append((1 + k % 3, 0 if k % 4 == 0 else 1 + k % 5))
+n = sum(r for r, _ in runs)
+p = '/kernelcache'
+add_file(2, 'kernelcache', p, content(p, n * BS - 123), runs)
+
+cat.sort(key=lambda r: (struct.unpack('>I', r[0][2:6])[0], r[0][8:].decode('utf-16-be').lower()))
+ext.sort(key=lambda r: (struct.unpack('>I', r[0][4:8])[0], struct.unpack('>I', r[0][8:12])[0]))
+catnodes = build_tree(cat, lambda r: struct.unpack('>H', r[:2])[0], 0, 0xCF)
+extnodes = build_tree(ext, lambda r: 10, 0, 0)
+
+# metadata after data
+cat_start = alloc(len(catnodes))
+ext_start = alloc(len(extnodes))
+for i, b in enumerate(catnodes): blocks[cat_start + i] = b
+for i, b in enumerate(extnodes): blocks[ext_start + i] = b
+total = nextblock[0] + 16
+
+vh = struct.pack('>HHIIIIIIIIIIIIIIIIIQ32s', 0x482B, 4, 0, 0, 0, 0, 0, 0, 0, len(manifest), 0, BS, total, 0, 0, BS, BS, cnid[0] + 1, 0, 1, b'')
+vh += fork(0, [])                                                  # allocation
+vh += fork(len(extnodes) * NS, [(ext_start, len(extnodes))])       # extents
+vh += fork(len(catnodes) * NS, [(cat_start, len(catnodes))])       # catalog
+vh += fork(0, []) + fork(0, [])
+assert len(vh) == 512
+with open(out, 'wb') as f:
+    f.truncate(total * BS)
+    f.seek(1024); f.write(vh)
+    for b, d in blocks.items():
+        f.seek(b * BS); f.write(d)
+with open(out + '.manifest', 'w') as f:
+    for path, size in manifest:
+        f.write('%s %d\n' % (path, size))
+print('catalog nodes', len(catnodes), 'extents nodes', len(extnodes), 'files', len(manifest), 'blocks', total)
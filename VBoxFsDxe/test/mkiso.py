@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+# ISO9660 image for lslr: path tables, directories of many blocks with gaps at
+# the block ends, optional Rock Ridge names (SP, PX, NM, long names through CE).
+# Usage: mkiso.py <image> rr|plain <depth> <fanout> <files> <bigdir>
+# A tree of <depth> levels with <fanout> subdirectories and <files> files in
+# each directory, and /BIG with <bigdir> files. Writes <image>.manifest.
+import struct, sys, random
+
+B = 2048
+def both16(v): return struct.pack('<H', v) + struct.pack('>H', v)
+def both32(v): return struct.pack('<I', v) + struct.pack('>I', v)
+
+class Node:
+    def __init__(self, name, isdir, parent=None, size=0):
+        self.name, self.isdir, self.parent, self.size = name, isdir, parent, size
+        self.children = []
+        self.extent = 0
+        self.isoname = None
+
+def build_tree(depth, fanout, files, bigdir, rr):
+    root = Node('', True)
+    rnd = random.Random(1)
+    def fill(d, level, path):
+        nfiles = files
+        for i in range(nfiles):
+            n = ('file_%d_%s.plist' % (i, 'x' * rnd.randint(0, 90))) if rr else ('F%d.TXT' % i)
+            d.children.append(Node(n, False, d, rnd.randint(0, 5000)))
+        if level < depth:
+            for i in range(fanout):
+                n = ('Dir.%d.level%d' % (i, level)) if rr else ('D%d_L%d' % (i, level))
+                c = Node(n, True, d)
+                d.children.append(c)
+                fill(c, level + 1, path + '/' + n)
+    fill(root, 0, '')
+    big = Node('Big' if rr else 'BIG', True, root)
+    root.children.append(big)
+    for i in range(bigdir):
+        n = ('kext_%05d.kext' % i) if rr else ('K%05d.KXT' % i)
+        big.children.append(Node(n, False, big, rnd.randint(0, 300)))
+    sub = Node('zz_sub' if rr else 'ZZSUB', True, big)
+    big.children.append(sub)
+    sub.children.append(Node('last.txt' if rr else 'LAST.TXT', False, sub, 100))
+    return root
+
+def iso_ident(node, idx):
+    if not node.rr:
+        return (node.name if node.isdir else node.name + ';1').encode()
+    # mangled 8.3 style ISO names for Rock Ridge images
+    return (('D%06d' % idx) if node.isdir else ('F%06d.DAT;1' % idx)).encode()
+
+def main():
+    out = sys.argv[1]
+    rr = sys.argv[2] == 'rr'
+    depth, fanout, files, bigdir = map(int, sys.argv[3:7])
+    root = build_tree(depth, fanout, files, bigdir, rr)
+    # number everything
+    allnodes = []
+    def walk(n):
+        n.rr = rr
+        allnodes.append(n)
+        for c in n.children: walk(c)
+    walk(root)
+    for i, n in enumerate(allnodes):
+        n.isoname = iso_ident(n, i) if n is not root else b'\x00'
+    for n in allnodes:
+        n.children.sort(key=lambda c: c.isoname)
+    # path table order: by level, parent number, name
+    dirs = [root]
+    root.number = 1
+    level = [root]
+    while level:
+        nxt = []
+        for d in level:
+            for c in d.children:
+                if c.isdir:
+                    nxt.append(c)
+        for c in nxt:
+            dirs.append(c)
+            c.number = len(dirs)
+        level = nxt
+    # path table
+    def pt(le):
+        b = b''
+        for d in dirs:
+            name = d.isoname
+            par = d.parent.number if d.parent else 1
+            b += bytes([len(name), 0]) + (struct.pack('<I', d.extent) if le else struct.pack('>I', d.extent)) \
+                + (struct.pack('<H', par) if le else struct.pack('>H', par)) + name + (b'\x00' if len(name) & 1 else b'')
+        return b
+    ptsize = len(pt(True))
+    ptblocks = (ptsize + B - 1) // B
+    # directory records
+    def sua(n, dot=False, first=False):
+        s = b''
+        if first and n is root and rr:
+            s += b'SP' + bytes([7, 1, 0xBE, 0xEF, 0])
+        if not rr:
+            return s, None
+        s += b'PX' + bytes([36, 1]) + both32(0o40755 if n.isdir else 0o100644) + both32(1) + both32(0) + both32(0)
+        if dot:
+            s += b'NM' + bytes([5, 1, 2])
+            return s, None
+        nm = b'NM' + bytes([5 + len(n.name), 1, 0]) + n.name.encode()
+        if len(n.name) > 60:
+            return s, nm  # goes to the continuation area
+        return s + nm, None
+    def rec(n, ident, extent, size, isdir, s):
+        l = 33 + len(ident) + (0 if len(ident) & 1 else 1) + len(s)
+        l += l & 1
+        r = bytes([l, 0]) + both32(extent) + both32(size) + bytes(7) + bytes([2 if isdir else 0, 0, 0]) + both16(1) \
+            + bytes([len(ident)]) + ident + (b'' if len(ident) & 1 else b'\x00') + s
+        return r + bytes(l - len(r))
+    # pass 1: sizes (CE entry adds 28 bytes)
+    def dir_layout(d):
+        recs = []
+        ce_data = b''
+        items = [(d, b'\x00', True), (d.parent or d, b'\x01', True)] + [(c, c.isoname, False) for c in d.children]
+        for (n, ident, dot) in items:
+            s, cont = sua(n, dot, d is root and ident == b'\x00')
+            if cont is not None:
+                s += b'CE' + bytes([28, 1]) + both32(0) + both32(len(ce_data)) + both32(len(cont))
+                ce_data += cont
+            recs.append((n, ident, s, cont))
+        return recs, ce_data
+    next_block = 18 + 2 * ptblocks
+    for d in dirs:
+        recs, ce_data = dir_layout(d)
+        size = 0
+        for (n, ident, s, cont) in recs:
+            l = 33 + len(ident) + (0 if len(ident) & 1 else 1) + len(s); l += l & 1
+            if size % B + l > B:
+                size = (size // B + 1) * B
+            size += l
+        d.size = (size + B - 1) // B * B
+        d.extent = next_block
+        next_block += d.size // B
+        d.ce_block = 0
+        if ce_data:
+            assert len(ce_data) <= B, len(ce_data)
+            d.ce_block = next_block
+            next_block += 1
+    for n in allnodes:
+        if not n.isdir:
+            n.extent = next_block if n.size else 0
+            next_block += (n.size + B - 1) // B
+    total = next_block
+    img = bytearray(total * B)
+    # directories
+    for d in dirs:
+        recs, ce_data = dir_layout(d)
+        buf = bytearray()
+        for (n, ident, s, cont) in recs:
+            if cont is not None:
+                s = s[:-28] + b'CE' + bytes([28, 1]) + both32(d.ce_block) + s[-16:]
+            r = rec(n, ident, n.extent, n.size, n.isdir, s)
+            if len(buf) % B + len(r) > B:
+                buf += bytes(B - len(buf) % B)
+            buf += r
+        assert len(buf) <= d.size
+        img[d.extent * B:d.extent * B + len(buf)] = buf
+        if ce_data:
+            img[d.ce_block * B:d.ce_block * B + len(ce_data)] = ce_data
+    # files
+    manifest = []
+    def path_of(n):
+        p = []
+        while n.parent:
+            p.append(n.name if rr else n.name)
+            n = n.parent
+        return '/' + '/'.join(reversed(p))
+    for n in allnodes:
+        if not n.isdir:
+            pth = path_of(n)
+            seed = sum(pth.encode())
+            data = bytes(((seed + i * 7) & 0xFF) for i in range(n.size))
+            img[n.extent * B:n.extent * B + n.size] = data
+            manifest.append('%s %d' % (pth, n.size))
+    # path tables
+    img[18 * B:18 * B + ptsize] = pt(True)
+    img[(18 + ptblocks) * B:(18 + ptblocks) * B + ptsize] = pt(False)
+    # PVD
+    pvd = bytearray(B)
+    pvd[0] = 1; pvd[1:6] = b'CD001'; pvd[6] = 1
+    pvd[40:72] = b'HARNESS'.ljust(32)
+    pvd[80:88] = both32(total)
+    pvd[120:124] = both16(1); pvd[124:128] = both16(1); pvd[128:132] = both16(B)
+    pvd[132:140] = both32(ptsize)
+    pvd[140:144] = struct.pack('<I', 18)
+    pvd[148:152] = struct.pack('>I', 18 + ptblocks)
+    rootrec = rec(root, b'\x00', root.extent, root.size, True, b'')
+    pvd[156:156 + 34] = rootrec[:34]
+    pvd[881] = 1
+    img[16 * B:17 * B] = pvd
+    term = bytearray(B); term[0] = 255; term[1:6] = b'CD001'; term[6] = 1
+    img[17 * B:18 * B] = term
+    open(out, 'wb').write(img)
+    open(out + '.manifest', 'w').write('\n'.join(manifest) + '\n')
+    print('%s: %d blocks, %d dirs, %d files' % (out, total, len(dirs), len(manifest)))
+
+main()
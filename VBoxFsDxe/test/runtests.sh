@@ -0,0 +1,74 @@
+#!/bin/sh
+# Builds lslr for the drivers and checks them against generated images.
+# Usage: runtests.sh [build dir], needs cc and python3.
+set -e
+T=$(cd "$(dirname "$0")" && pwd)
+B=${1:-/tmp/vboxfs-test}
+mkdir -p "$B"
+
+build() {
+    cc -O2 -fshort-wchar -DHOST_POSIX -DFSTYPE=$1 -I"$T" -I"$T/.." -o "$B/lslr_$1" \
+       "$T/lslr.c" "$T/fsw_posix.c" "$T/../fsw_core.c" "$T/../fsw_lib.c" "$T/../fsw_$1.c" 2>"$B/build_$1.log"
+}
+
+# run <fstype> <image> <lslr options>, messages of the driver go to <image>.log
+run() {
+    fs=$1; img=$2; shift 2
+    echo "== $fs $(basename "$img") $*"
+    "$B/lslr_$fs" -m "$img.manifest" "$@" "$img" 2>"$img.log"
+}
+
+# HFS+: the B-tree node cache and resumed directory reads, listing the
+# volume reads every catalog node about once (678 nodes)
+build hfs
+python3 "$T/mkhfs.py" "$B/hfs.img" 3000 >/dev/null
+run hfs "$B/hfs.img" -R 700
+# a failed read of the extents file, here on the 16th read of the fragmented
+# file, must not hide its overflow extents from the next read
+grep kernelcache "$B/hfs.img.manifest" >"$B/kernelcache.manifest"
+run hfs "$B/hfs.img" -m "$B/kernelcache.manifest" -f 40
+# the name lookup cache of fsw_core: HFS+ folds case, so the names with case
+# swapped and the second pass are answered from the cache, up to a few slots
+# shared by two names. The 10 files take 168 driver lookups without it
+head -10 "$B/hfs.img.manifest" >"$B/lookup.manifest"
+run hfs "$B/hfs.img" -m "$B/lookup.manifest" -i -n -C 8
+
+# ISO9660: subdirectories through the path table, directory blocks parsed
+# once, a directory of 3000 files; Rock Ridge names, some in continuation areas
+build iso9660
+python3 "$T/mkiso.py" "$B/plain.iso" plain 4 3 6 3000 >/dev/null
+run iso9660 "$B/plain.iso" -n -L 6000 -R 400
+python3 "$T/mkiso.py" "$B/rr.iso" rr 4 3 6 3000 >/dev/null
+run iso9660 "$B/rr.iso" -n -L 6000 -R 400
+
+# ext4 with 1K blocks: extent trees of depth 2 (/frag has 19 leaves) and
+# sparse extents of 4 GB and more (/hole4g, /hole5g)
+build ext4
+rm -rf "$B/e4src" "$B/e4.img"
+python3 "$T/mkext4tree.py" "$B/e4src" "$B/e4.img.manifest"
+truncate -s 64M "$B/e4.img"
+mkfs.ext4 -q -F -b 1024 -d "$B/e4src" "$B/e4.img"
+run ext4 "$B/e4.img"
+# a directory with a hash index of two levels, e2fsck -D builds it: UTF-16
+# names as from the EFI host, the names with "~" appended are missing. Every
+# lookup reads about six blocks, a linear scan of the directory on each miss
+# needed 1703609 reads
+rm -rf "$B/htsrc" "$B/ht.img"
+python3 "$T/mkext4tree.py" "$B/htsrc" "$B/ht.img.manifest" htree
+truncate -s 32M "$B/ht.img"
+mkfs.ext4 -q -F -b 1024 -d "$B/htsrc" "$B/ht.img"
+e2fsck -fyD "$B/ht.img" >/dev/null || [ $? -lt 4 ]
+run ext4 "$B/ht.img" -u -n -L 200000
+# 48-bit block numbers: the blocks of both files are moved above 2^32 on a
+# sparse 4400G image, about 420M are written
+rm -rf "$B/e48src" "$B/e48.img"
+python3 "$T/mkext4tree.py" "$B/e48src" "$B/e48.img.manifest" big
+truncate -s 4400G "$B/e48.img"
+mkfs.ext4 -q -F -b 1024 -O 64bit,^has_journal,^resize_inode -E lazy_itable_init=1,nodiscard \
+          -i 67108864 -d "$B/e48src" "$B/e48.img"
+python3 "$T/ext4reloc.py" "$B/e48.img" /frag
+python3 "$T/ext4reloc.py" "$B/e48.img" /boot/vmlinuz
+run ext4 "$B/e48.img"
+rm -f "$B/e48.img"
+
+echo "all passed"
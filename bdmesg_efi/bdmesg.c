@@ -9,6 +9,7 @@ BdmesgMain(IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable)
 	static CHAR16 const NoMemLog[] = L"%EUnsuccessful getting memory log%N\n";
 	static CHAR16 const Usage[] = L"%HUsage: bdmesg [-b]\n  -b: paginate%N\n";
 	CHAR8 const* log;
+	CHAR8 summary[MEM_LOG_SPAN_SUMMARY_SIZE];
 	LIST_ENTRY* Package;
 	UINTN logLength, numPrinted;
 	EFI_STATUS Status;
@@ -44,6 +45,9 @@ BdmesgMain(IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable)
 		logLength -= numPrinted;
 		log += numPrinted;
 	}
+	if (!EFI_ERROR(Status) && MemLogSpanSummary(&summary[0], sizeof(summary))) {
+		Print(L"%a", &summary[0]);
+	}
 	ShellSetPageBreakMode(FALSE);
 	if (SkipLn)
 		Print(L"\n");
@@ -111,39 +111,143 @@ EFI_FILE_PROTOCOL* GetDebugLogFile()
 }
 
 
+// debug.log is kept open and written in chunks: opening, stat and close
+// for every line made boots with Debug=true very slow on FAT.
+// Chunks are kept small, the last lines before a hang are the ones that matter.
+#define DEBUG_LOG_BUFFER_SIZE   (32 * 1024)
+#ifndef DEBUG_LOG_FLUSH_LINES
+#define DEBUG_LOG_FLUSH_LINES   8
+#endif
+#ifndef DEBUG_LOG_FLUSH_MS
+#define DEBUG_LOG_FLUSH_MS      100
+#endif
+
+EFI_FILE_PROTOCOL       *mDebugLogFile = NULL;
+CHAR8                   *mDebugLogBuffer = NULL;
+UINTN                   mDebugLogUsed = 0;
+UINTN                   mDebugLogLines = 0;
+UINT64                  mDebugLogFirstTsc = 0;  //when the oldest buffered line came
+UINTN                   mDebugLogWrites = 0;
+UINT64                  mDebugLogWriteTsc = 0;  //time spent in file writes
+BOOLEAN                 mDebugLogDirect = FALSE; //write each line and close, another image runs
+
+/** Writes Text at the end of debug.log, opening the file if needed */
+EFI_STATUS WriteDebugLogFile(IN CHAR8 *Text, IN UINTN TextLen)
+{
+  EFI_STATUS              Status = EFI_NOT_FOUND;
+  EFI_FILE_INFO           *Info;
+  UINTN                   Len;
+  UINTN                   Retry;
+  UINT64                  Start;
+
+  Start = AsmReadTsc();
+  for (Retry = 0; Retry < 2; Retry++) {
+    if (mDebugLogFile == NULL) {
+      mDebugLogFile = GetDebugLogFile();
+      if (mDebugLogFile == NULL) {
+        Status = EFI_NOT_FOUND;
+        break;
+      }
+      // Advance to the EOF so we append
+      Info = EfiLibFileInfo(mDebugLogFile);
+      if (Info == NULL) {
+        mDebugLogFile->Close(mDebugLogFile);
+        mDebugLogFile = NULL;
+        Status = EFI_NOT_FOUND;
+        break;
+      }
+      mDebugLogFile->SetPosition(mDebugLogFile, Info->FileSize);
+      FreePool(Info);
+    }
+    Len = TextLen;
+    Status = mDebugLogFile->Write(mDebugLogFile, &Len, Text);
+    mDebugLogWrites++;
+    if (!EFI_ERROR(Status)) {
+      break;
+    }
+    // the volume could be reconnected by a driver, reopen and try once more
+    mDebugLogFile->Close(mDebugLogFile);
+    mDebugLogFile = NULL;
+  }
+  mDebugLogWriteTsc += AsmReadTsc() - Start;
+  return Status;
+}
+
+/** Writes buffered messages to debug.log. With Close the file is closed,
+ *  which must be done before starting another image; until the next flush
+ *  without Close every message is then written and the file closed again,
+ *  so nothing logged while the other image runs stays in the buffer. */
+VOID FlushDebugLog(IN BOOLEAN Close)
+{
+  UINT64 TicksPerMs;
+
+  if (Close && (mDebugLogFile != NULL)) {
+    TicksPerMs = DivU64x32(GetMemLogTscTicksPerSecond(), 1000);
+    MsgLog("debug.log: %d writes, %ldms so far\n", mDebugLogWrites + 1,
+           (TicksPerMs != 0) ? DivU64x64Remainder(mDebugLogWriteTsc, TicksPerMs, NULL) : 0);
+  }
+  if (mDebugLogUsed != 0) {
+    WriteDebugLogFile(mDebugLogBuffer, mDebugLogUsed);
+    mDebugLogUsed = 0;
+    mDebugLogLines = 0;
+  }
+  if (Close && (mDebugLogFile != NULL)) {
+    mDebugLogFile->Close(mDebugLogFile);
+    mDebugLogFile = NULL;
+  }
+  mDebugLogDirect = Close;
+}
+
 VOID SaveMessageToDebugLogFile(IN CHAR8 *LastMessage)
 {
   STATIC BOOLEAN          FirstTimeSave = TRUE;
-//  STATIC UINTN            Position = 0;
-  CHAR8                   *MemLogBuffer;
-  UINTN                   MemLogLen;
   CHAR8                   *Text;
   UINTN                   TextLen;
-  EFI_FILE_HANDLE         LogFile;
   
-  MemLogBuffer = GetMemLogBuffer();
-  MemLogLen = GetMemLogLen();
   Text = LastMessage;
   TextLen = AsciiStrLen(LastMessage);
 
-  LogFile = GetDebugLogFile();
-  
-  // Write to the log file
-  if (LogFile != NULL) {
-    // Advance to the EOF so we append
-    EFI_FILE_INFO *Info = EfiLibFileInfo(LogFile);
-    if (Info) {
-      LogFile->SetPosition(LogFile, Info->FileSize);
-      // If we haven't had root before this write out whole log
-      if (FirstTimeSave) {
-        Text = MemLogBuffer;
-        TextLen = MemLogLen;
-        FirstTimeSave = FALSE;
-      }
-      // Write out this message
-      LogFile->Write(LogFile, &TextLen, Text);
+  // If we haven't had root before this write out whole log
+  if (FirstTimeSave) {
+    if (!EFI_ERROR(WriteDebugLogFile(GetMemLogBuffer(), GetMemLogLen()))) {
+      FirstTimeSave = FALSE;
+      mDebugLogBuffer = AllocatePool(DEBUG_LOG_BUFFER_SIZE);
+    }
+    return;
+  }
+
+  if (mDebugLogDirect) {
+    WriteDebugLogFile(Text, TextLen);
+    if (mDebugLogFile != NULL) {
+      mDebugLogFile->Close(mDebugLogFile);
+      mDebugLogFile = NULL;
     }
-    LogFile->Close(LogFile);
+    return;
+  }
+  if (mDebugLogBuffer == NULL) {
+    WriteDebugLogFile(Text, TextLen);
+    return;
+  }
+  if (mDebugLogUsed + TextLen > DEBUG_LOG_BUFFER_SIZE) {
+    FlushDebugLog(FALSE);
+    if (TextLen > DEBUG_LOG_BUFFER_SIZE) {
+      WriteDebugLogFile(Text, TextLen);
+      return;
+    }
+  }
+  if (mDebugLogUsed == 0) {
+    mDebugLogFirstTsc = AsmReadTsc();
+  }
+  CopyMem(mDebugLogBuffer + mDebugLogUsed, Text, TextLen);
+  mDebugLogUsed += TextLen;
+  for (; *Text != '\0'; Text++) {
+    if (*Text == '\n') {
+      mDebugLogLines++;
+    }
+  }
+  if ((mDebugLogLines >= DEBUG_LOG_FLUSH_LINES) ||
+      (AsmReadTsc() - mDebugLogFirstTsc >= DivU64x32(MultU64x32(GetMemLogTscTicksPerSecond(), DEBUG_LOG_FLUSH_MS), 1000))) {
+    FlushDebugLog(FALSE);
   }
 }
 
@@ -185,11 +289,44 @@ VOID InitBooterLog(VOID)
   SetMemLogCallback(MemLogCallback);
 }
 
+/** Returns a copy of the msg log with the boot phase summary at the end.
+ *  With MaxSize != 0 the log is cut so that the result with the terminating
+ *  null fits into MaxSize. Caller frees the result. */
+CHAR8 *GetBooterLogWithSummary(IN UINTN MaxSize, OUT UINTN *Size)
+{
+  CHAR8                   *MemLogBuffer;
+  UINTN                   MemLogLen;
+  CHAR8                   Summary[MEM_LOG_SPAN_SUMMARY_SIZE];
+  UINTN                   SummaryLen;
+  CHAR8                   *Log;
+  
+  MemLogBuffer = GetMemLogBuffer();
+  MemLogLen = GetMemLogLen();
+  if (MemLogBuffer == NULL || MemLogLen == 0) {
+    return NULL;
+  }
+  SummaryLen = MemLogSpanSummary(Summary, sizeof(Summary));
+  if (MaxSize != 0 && MemLogLen + SummaryLen >= MaxSize) {
+    MemLogLen = MaxSize - SummaryLen - 1;
+  }
+  Log = AllocatePool(MemLogLen + SummaryLen + 1);
+  if (Log == NULL) {
+    return NULL;
+  }
+  CopyMem(Log, MemLogBuffer, MemLogLen);
+  CopyMem(Log + MemLogLen, Summary, SummaryLen);
+  Log[MemLogLen + SummaryLen] = '\0';
+  *Size = MemLogLen + SummaryLen;
+  return Log;
+}
+
 EFI_STATUS SetupBooterLog(BOOLEAN AllowGrownSize)
 {
   EFI_STATUS              Status = EFI_SUCCESS;
   CHAR8                   *MemLogBuffer;
   UINTN                   MemLogLen;
+  CHAR8                   *Log;
+  UINTN                   LogLen;
   
   MemLogBuffer = GetMemLogBuffer();
   MemLogLen = GetMemLogLen();
@@ -198,7 +335,14 @@ EFI_STATUS SetupBooterLog(BOOLEAN AllowGrownSize)
 		return EFI_NOT_FOUND;
   }
   
-  if (MemLogLen > MEM_LOG_INITIAL_SIZE && !AllowGrownSize) {
+  Log = GetBooterLogWithSummary(AllowGrownSize ? 0 : MEM_LOG_INITIAL_SIZE, &LogLen);
+  if (Log != NULL) {
+    if (!AllowGrownSize && LogLen + 1 == MEM_LOG_INITIAL_SIZE) {
+      LogLen++;
+    }
+    Status = LogDataHub(&gEfiMiscSubClassGuid, L"boot-log", Log, (UINT32)LogLen);
+    FreePool(Log);
+  } else if (MemLogLen > MEM_LOG_INITIAL_SIZE && !AllowGrownSize) {
     CHAR8 PrevChar = MemLogBuffer[MEM_LOG_INITIAL_SIZE-1];
     MemLogBuffer[MEM_LOG_INITIAL_SIZE-1] = '\0';
     Status = LogDataHub(&gEfiMiscSubClassGuid, L"boot-log", MemLogBuffer, MEM_LOG_INITIAL_SIZE);
@@ -214,8 +358,11 @@ EFI_STATUS SetupBooterLog(BOOLEAN AllowGrownSize)
 // so we need a different way of saving the msg log - apianti
 EFI_STATUS SaveBooterLog(IN EFI_FILE_HANDLE BaseDir OPTIONAL, IN CHAR16 *FileName)
 {
+  EFI_STATUS              Status;
   CHAR8                   *MemLogBuffer;
   UINTN                   MemLogLen;
+  CHAR8                   *Log;
+  UINTN                   LogLen;
   
   MemLogBuffer = GetMemLogBuffer();
   MemLogLen = GetMemLogLen();
@@ -224,6 +371,12 @@ EFI_STATUS SaveBooterLog(IN EFI_FILE_HANDLE BaseDir OPTIONAL, IN CHAR16 *FileNam
 		return EFI_NOT_FOUND;
   }
   
-  return egSaveFile(BaseDir, FileName, (UINT8*)MemLogBuffer, MemLogLen);
+  // the boot phase summary goes to the file, not to the msg log itself
+  Log = GetBooterLogWithSummary(0, &LogLen);
+  if (Log == NULL) {
+    return egSaveFile(BaseDir, FileName, (UINT8*)MemLogBuffer, MemLogLen);
+  }
+  Status = egSaveFile(BaseDir, FileName, (UINT8*)Log, LogLen);
+  FreePool(Log);
+  return Status;
 }
-
@@ -0,0 +1,256 @@
+/*
+ * DriverManifest.c - outcome of loading the drivers of the last boots
+ *
+ * The manifest lives in NVRAM together with a fingerprint of the drivers
+ * directory: name, size and modification time of every file, the config.plist
+ * in use, its driver black list and the firmware. Any change there starts a
+ * new manifest. A driver which the firmware refused to load or start on two
+ * boots in a row with the same fingerprint is skipped, but only for
+ * DRIVER_SKIP_LIMIT boots, then it is tried again. A driver which started and
+ * failed by itself (missing hardware or dependency) is always loaded.
+ */
+
+#include "Platform.h"
+
+#ifndef DEBUG_ALL
+#define DEBUG_MANIFEST 1
+#else
+#define DEBUG_MANIFEST DEBUG_ALL
+#endif
+
+#if DEBUG_MANIFEST == 0
+#define DBG(...)
+#else
+#define DBG(...) DebugLog(DEBUG_MANIFEST, __VA_ARGS__)
+#endif
+
+#define DRIVER_MANIFEST_VAR         L"Clover.DriverManifest"
+#define DRIVER_MANIFEST_SIGNATURE   SIGNATURE_32('D','R','V','M')
+#define DRIVER_MANIFEST_MAX         48
+
+#define DRIVER_REJECTED             0x01  // LoadImage or StartImage refused the image
+#define DRIVER_BINDING              0x02  // has EFI_DRIVER_BINDING_PROTOCOL
+
+#define DRIVER_REJECT_LIMIT         2     // boots in a row before it is skipped
+#define DRIVER_SKIP_LIMIT           8     // boots it is skipped before a retry
+
+typedef struct {
+  UINT32  Id;       // hash of name, size and time of the file
+  UINT8   Flags;
+  UINT8   RejectCount;
+  UINT8   SkipCount;
+  UINT8   Reserved;
+} DRIVER_MANIFEST_ENTRY;
+
+typedef struct {
+  UINT32                 Signature;
+  UINT32                 Fingerprint;
+  UINT32                 Count;
+  DRIVER_MANIFEST_ENTRY  Entry[DRIVER_MANIFEST_MAX];
+} DRIVER_MANIFEST;
+
+DRIVER_MANIFEST  mDriverManifest;      // as read from NVRAM
+DRIVER_MANIFEST  mDriverManifestNew;   // drivers of this boot
+BOOLEAN          mDriverManifestValid = FALSE;
+UINTN            mDriversSkipped;
+
+STATIC UINT32 ManifestHash(IN UINT32 Hash, IN VOID *Data, IN UINTN Size)
+{
+  UINT8 *Bytes = (UINT8 *)Data;
+  UINTN i;
+  for (i = 0; i < Size; i++) {
+    Hash ^= Bytes[i];
+    Hash *= 16777619U; //FNV prime
+  }
+  return Hash;
+}
+
+STATIC UINT32 ManifestHashString(IN UINT32 Hash, IN CHAR16 *String)
+{
+  if (String == NULL) {
+    return Hash;
+  }
+  return ManifestHash(Hash, String, StrSize(String));
+}
+
+/** Identity of a driver file */
+STATIC UINT32 DriverFileId(IN EFI_FILE_INFO *DirEntry)
+{
+  UINT32   Id = 2166136261U; //FNV offset basis
+  EFI_TIME *Time = &DirEntry->ModificationTime;
+
+  Id = ManifestHashString(Id, DirEntry->FileName);
+  Id = ManifestHash(Id, &DirEntry->FileSize, sizeof(DirEntry->FileSize));
+  Id = ManifestHash(Id, &Time->Year, sizeof(Time->Year));
+  Id = ManifestHash(Id, &Time->Month, sizeof(Time->Month));
+  Id = ManifestHash(Id, &Time->Day, sizeof(Time->Day));
+  Id = ManifestHash(Id, &Time->Hour, sizeof(Time->Hour));
+  Id = ManifestHash(Id, &Time->Minute, sizeof(Time->Minute));
+  Id = ManifestHash(Id, &Time->Second, sizeof(Time->Second));
+  return Id;
+}
+
+/** Identity of the config.plist in use: the OEM one or EFI\CLOVER\config.plist */
+STATIC UINT32 ConfigFileHash(IN UINT32 Hash)
+{
+  CHAR16        *Path;
+  EFI_FILE      *File = NULL;
+  EFI_FILE_INFO *Info;
+  EFI_STATUS    Status = EFI_NOT_FOUND;
+
+  Hash = ManifestHashString(Hash, gSettings.ConfigName);
+  Path = PoolPrint(L"%s\\config.plist", OEMPath);
+  if (Path != NULL) {
+    Status = SelfRootDir->Open(SelfRootDir, &File, Path, EFI_FILE_MODE_READ, 0);
+    FreePool(Path);
+  }
+  if (EFI_ERROR(Status)) {
+    Status = SelfRootDir->Open(SelfRootDir, &File, L"EFI\\CLOVER\\config.plist", EFI_FILE_MODE_READ, 0);
+  }
+  if (EFI_ERROR(Status)) {
+    return Hash;
+  }
+  Info = EfiLibFileInfo(File);
+  File->Close(File);
+  if (Info != NULL) {
+    Hash = ManifestHash(Hash, &Info->FileSize, sizeof(Info->FileSize));
+    Hash = ManifestHash(Hash, &Info->ModificationTime, sizeof(Info->ModificationTime));
+    FreePool(Info);
+  }
+  return Hash;
+}
+
+/** Fingerprint the drivers directory Path and take the manifest from NVRAM if it matches */
+VOID DriverManifestLoad(IN CHAR16 *Path)
+{
+  REFIT_DIR_ITER  DirIter;
+  EFI_FILE_INFO   *DirEntry;
+  DRIVER_MANIFEST *Manifest;
+  UINTN           Size = 0;
+  UINT32          Fingerprint = 2166136261U; //FNV offset basis
+  UINT32          Id;
+  INTN            i;
+
+  Fingerprint = ManifestHashString(Fingerprint, Path);
+  Fingerprint = ManifestHashString(Fingerprint, gST->FirmwareVendor);
+  Fingerprint = ManifestHash(Fingerprint, &gST->FirmwareRevision, sizeof(gST->FirmwareRevision));
+  Fingerprint = ManifestHash(Fingerprint, &gFirmwareClover, sizeof(gFirmwareClover));
+  Fingerprint = ConfigFileHash(Fingerprint);
+  for (i = 0; i < gSettings.BlackListCount; i++) {
+    Fingerprint = ManifestHashString(Fingerprint, gSettings.BlackList[i]);
+  }
+  DirIterOpen(SelfRootDir, Path, &DirIter);
+  while (DirIterNext(&DirIter, 2, L"*.EFI", &DirEntry)) {
+    Id = DriverFileId(DirEntry);
+    Fingerprint = ManifestHash(Fingerprint, &Id, sizeof(Id));
+  }
+  DirIterClose(&DirIter);
+
+  ZeroMem(&mDriverManifestNew, sizeof(mDriverManifestNew));
+  mDriverManifestNew.Signature = DRIVER_MANIFEST_SIGNATURE;
+  mDriverManifestNew.Fingerprint = Fingerprint;
+  ZeroMem(&mDriverManifest, sizeof(mDriverManifest));
+  mDriverManifestValid = FALSE;
+  mDriversSkipped = 0;
+
+  Manifest = GetNvramVariable(DRIVER_MANIFEST_VAR, &gCloverCacheVariableGuid, NULL, &Size);
+  if (Manifest != NULL) {
+    if ((Size == sizeof(DRIVER_MANIFEST)) &&
+        (Manifest->Signature == DRIVER_MANIFEST_SIGNATURE) &&
+        (Manifest->Fingerprint == Fingerprint) &&
+        (Manifest->Count <= DRIVER_MANIFEST_MAX)) {
+      CopyMem(&mDriverManifest, Manifest, sizeof(mDriverManifest));
+      mDriverManifestValid = TRUE;
+    }
+    FreePool(Manifest);
+  }
+  DBG("Driver manifest: fingerprint %08x, %a (%d drivers)\n", Fingerprint,
+      mDriverManifestValid ? "match" : "new", mDriverManifest.Count);
+}
+
+STATIC DRIVER_MANIFEST_ENTRY *FindManifestEntry(IN DRIVER_MANIFEST *Manifest, IN UINT32 Id)
+{
+  UINTN i;
+  for (i = 0; i < Manifest->Count; i++) {
+    if (Manifest->Entry[i].Id == Id) {
+      return &Manifest->Entry[i];
+    }
+  }
+  return NULL;
+}
+
+/** TRUE if the firmware refused the image itself, not the driver its hardware or dependencies */
+STATIC BOOLEAN IsHardFailure(IN EFI_STATUS Status, IN UINTN ErrorInStep)
+{
+  switch (ErrorInStep) {
+    case 1: // LoadImage
+      return (Status == EFI_LOAD_ERROR) || (Status == EFI_UNSUPPORTED) ||
+             (Status == EFI_INCOMPATIBLE_VERSION) || (Status == EFI_SECURITY_VIOLATION);
+    case 3: // StartImage, anything else comes from the entry point of the driver
+      return (Status == EFI_LOAD_ERROR) || (Status == EFI_INCOMPATIBLE_VERSION) ||
+             (Status == EFI_SECURITY_VIOLATION);
+    default:
+      return FALSE;
+  }
+}
+
+/** TRUE if the firmware refused the driver on the last boots and it should not be loaded */
+BOOLEAN DriverManifestSkip(IN EFI_FILE_INFO *DirEntry)
+{
+  DRIVER_MANIFEST_ENTRY *Entry;
+  DRIVER_MANIFEST_ENTRY *New;
+
+  if (!mDriverManifestValid) {
+    return FALSE;
+  }
+  Entry = FindManifestEntry(&mDriverManifest, DriverFileId(DirEntry));
+  if ((Entry == NULL) || (Entry->RejectCount < DRIVER_REJECT_LIMIT) ||
+      (Entry->SkipCount >= DRIVER_SKIP_LIMIT)) {
+    // DriverManifestSet decides on it after this retry
+    return FALSE;
+  }
+  mDriversSkipped++;
+  // keep it in the manifest of this boot
+  if (mDriverManifestNew.Count < DRIVER_MANIFEST_MAX) {
+    New = &mDriverManifestNew.Entry[mDriverManifestNew.Count++];
+    CopyMem(New, Entry, sizeof(DRIVER_MANIFEST_ENTRY));
+    New->SkipCount++;
+  }
+  return TRUE;
+}
+
+/** Remember the outcome of StartEFIImage for the driver, Status and ErrorInStep as it returned them */
+VOID DriverManifestSet(IN EFI_FILE_INFO *DirEntry, IN EFI_STATUS Status, IN UINTN ErrorInStep, IN BOOLEAN HasBinding)
+{
+  DRIVER_MANIFEST_ENTRY *Entry;
+  DRIVER_MANIFEST_ENTRY *Old;
+  UINT32                Id;
+
+  if (mDriverManifestNew.Count == DRIVER_MANIFEST_MAX) {
+    return;
+  }
+  Id = DriverFileId(DirEntry);
+  Entry = &mDriverManifestNew.Entry[mDriverManifestNew.Count++];
+  Entry->Id = Id;
+  Entry->Flags = HasBinding ? DRIVER_BINDING : 0;
+  if (EFI_ERROR(Status) && IsHardFailure(Status, ErrorInStep)) {
+    Old = mDriverManifestValid ? FindManifestEntry(&mDriverManifest, Id) : NULL;
+    Entry->Flags |= DRIVER_REJECTED;
+    Entry->RejectCount = (UINT8)((Old != NULL) ? MIN(Old->RejectCount + 1, DRIVER_REJECT_LIMIT) : 1);
+  }
+}
+
+/** Write the manifest back if it changed */
+VOID DriverManifestSave(VOID)
+{
+  EFI_STATUS Status;
+
+  MsgLog("Driver manifest: %d drivers, %d rejected ones not loaded\n", mDriverManifestNew.Count, mDriversSkipped);
+  if (CompareMem(&mDriverManifest, &mDriverManifestNew, sizeof(DRIVER_MANIFEST)) == 0) {
+    return;
+  }
+  Status = SetNvramVariable(DRIVER_MANIFEST_VAR, &gCloverCacheVariableGuid,
+                            EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+                            sizeof(mDriverManifestNew), &mDriverManifestNew);
+  DBG("Driver manifest saved: %r\n", Status);
+}
@@ -198,7 +198,14 @@ OnExitBootServices(IN EFI_EVENT Event, IN VOID *Context)
 	//
 	// Patch kernel and kexts if needed
 	//
+	MemLogSpanBegin("KernelAndKextsPatcherStart");
 	KernelAndKextsPatcherStart((LOADER_ENTRY *)Context);
+	MemLogSpanEnd("KernelAndKextsPatcherStart");
+	// boot-log is already in DataHub, so the time can only be shown on screen
+	if ((Context != NULL) && (((LOADER_ENTRY *)Context)->KernelAndKextPatches != NULL) &&
+	    ((LOADER_ENTRY *)Context)->KernelAndKextPatches->KPDebug) {
+		AsciiPrint("KernelAndKextsPatcherStart took %ldms\n", GetMemLogSpanMs("KernelAndKextsPatcherStart"));
+	}
 	
 //    gBS->Stall(2000000);
 	//PauseForKey(L"press any key to MemoryFix");
@@ -316,6 +323,7 @@ OnSimpleFileSystem (
 	
 	OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
 	gEvent = 1;
+	gDirSnapshotGeneration++; //volume snapshots are stale now
 	//  ReinitRefitLib();
 	//ScanVolumes();
 	//enter GUI
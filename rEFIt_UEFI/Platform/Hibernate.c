@@ -233,6 +233,38 @@ EFI_BLOCK_READ OrigBlockIoRead = NULL;
 UINT64  gSleepImageOffset = 0;
 UINT32  gSleepTime = 0;
 
+//
+// Where the sleepimage of an OS X volume was found, kept in NVRAM: the image
+// volume, the offset on its disk and the identity of the file. A header at that
+// offset with a sleep time other than the cached one was written by a new
+// hibernation, it is taken without the plist or the file. Otherwise the offset
+// is used only while the sleepimage is still the same file: same image volume,
+// path, size and creation time. The header is read from the disk at the offset
+// directly, without the BlockIo hook.
+//
+#define SLEEP_IMAGE_CACHE_VAR         L"Clover.SleepImageCache"
+#define SLEEP_IMAGE_CACHE_SIGNATURE   SIGNATURE_32('S','L','P','C')
+#define SLEEP_IMAGE_CACHE_MAX         4
+
+typedef struct {
+  EFI_GUID  VolumeGuid;       // OS X volume
+  EFI_GUID  ImageVolumeGuid;  // volume with the sleepimage
+  UINT64    Offset;           // of the sleepimage on the whole disk
+  UINT64    FileSize;         // of the sleepimage file
+  EFI_TIME  CreateTime;       // of the sleepimage file, changes when it is recreated
+  UINT32    NameCrc;          // of the sleepimage path
+  UINT32    SleepTime;        // of the last valid header found there
+} SLEEP_IMAGE_CACHE_ENTRY;
+
+typedef struct {
+  UINT32                   Signature;
+  UINT32                   Count;
+  SLEEP_IMAGE_CACHE_ENTRY  Entry[SLEEP_IMAGE_CACHE_MAX];
+} SLEEP_IMAGE_CACHE;
+
+SLEEP_IMAGE_CACHE mSleepImageCache;
+BOOLEAN           mSleepImageCacheLoaded = FALSE;
+
 
 /** BlockIo->Read() override. */
 EFI_STATUS
@@ -290,6 +322,192 @@ EFIAPI OurBlockIoRead (
   return Status;
 }
 
+/** Fills the identity of the open sleepimage File with path ImageName into Id */
+STATIC BOOLEAN
+GetSleepImageFileId (IN EFI_FILE *File, IN CHAR16 *ImageName, OUT SLEEP_IMAGE_CACHE_ENTRY *Id)
+{
+  EFI_FILE_INFO *Info;
+
+  ZeroMem(Id, sizeof(SLEEP_IMAGE_CACHE_ENTRY));
+  Info = EfiLibFileInfo(File);
+  if (Info == NULL) {
+    return FALSE;
+  }
+  Id->FileSize = Info->FileSize;
+  CopyMem(&Id->CreateTime, &Info->CreateTime, sizeof(EFI_TIME));
+  FreePool(Info);
+  Id->NameCrc = GetCrc32((UINT8 *)ImageName, StrSize(ImageName));
+  return TRUE;
+}
+
+/** Cache entry for the volume with partition VolumeGuid or NULL */
+STATIC SLEEP_IMAGE_CACHE_ENTRY *
+FindSleepImageCacheEntry (IN EFI_GUID *VolumeGuid)
+{
+  SLEEP_IMAGE_CACHE *Cache;
+  UINTN             Size = 0;
+  UINTN             Index;
+
+  if (!mSleepImageCacheLoaded) {
+    mSleepImageCacheLoaded = TRUE;
+    ZeroMem(&mSleepImageCache, sizeof(mSleepImageCache));
+    mSleepImageCache.Signature = SLEEP_IMAGE_CACHE_SIGNATURE;
+    Cache = GetNvramVariable(SLEEP_IMAGE_CACHE_VAR, &gCloverCacheVariableGuid, NULL, &Size);
+    if (Cache != NULL) {
+      if ((Size == sizeof(SLEEP_IMAGE_CACHE)) &&
+          (Cache->Signature == SLEEP_IMAGE_CACHE_SIGNATURE) &&
+          (Cache->Count <= SLEEP_IMAGE_CACHE_MAX)) {
+        CopyMem(&mSleepImageCache, Cache, sizeof(mSleepImageCache));
+      }
+      FreePool(Cache);
+    }
+  }
+
+  for (Index = 0; Index < mSleepImageCache.Count; Index++) {
+    if (CompareGuid(&mSleepImageCache.Entry[Index].VolumeGuid, VolumeGuid)) {
+      return &mSleepImageCache.Entry[Index];
+    }
+  }
+  return NULL;
+}
+
+/** Volume of the GPT partition Guid or NULL */
+STATIC REFIT_VOLUME *
+FindVolumeByPartitionGuid (IN EFI_GUID *Guid)
+{
+  UINTN     Index;
+  EFI_GUID  *VolumeGuid;
+
+  for (Index = 0; Index < VolumesCount; Index++) {
+    VolumeGuid = FindGPTPartitionGuidInDevicePath(Volumes[Index]->DevicePath);
+    if ((VolumeGuid != NULL) && CompareGuid(VolumeGuid, Guid)) {
+      return Volumes[Index];
+    }
+  }
+  return NULL;
+}
+
+/** Remember that the sleepimage Id of Volume is at Offset of the disk of ImageVolume */
+STATIC VOID
+SetSleepImageCache (IN REFIT_VOLUME *Volume, IN REFIT_VOLUME *ImageVolume,
+                    IN SLEEP_IMAGE_CACHE_ENTRY *Id, IN UINT64 Offset)
+{
+  EFI_STATUS              Status;
+  EFI_GUID                *VolumeGuid;
+  EFI_GUID                *ImageVolumeGuid;
+  SLEEP_IMAGE_CACHE_ENTRY *Entry;
+
+  VolumeGuid = FindGPTPartitionGuidInDevicePath(Volume->DevicePath);
+  ImageVolumeGuid = FindGPTPartitionGuidInDevicePath(ImageVolume->DevicePath);
+  if ((VolumeGuid == NULL) || (ImageVolumeGuid == NULL) || (gSleepTime == 0)) {
+    // without a sleep time the header can't be told from an old one
+    return;
+  }
+
+  Entry = FindSleepImageCacheEntry(VolumeGuid);
+  if (Entry == NULL) {
+    if (mSleepImageCache.Count == SLEEP_IMAGE_CACHE_MAX) {
+      // forget the oldest one
+      CopyMem(&mSleepImageCache.Entry[0], &mSleepImageCache.Entry[1],
+              (SLEEP_IMAGE_CACHE_MAX - 1) * sizeof(SLEEP_IMAGE_CACHE_ENTRY));
+      mSleepImageCache.Count--;
+    }
+    Entry = &mSleepImageCache.Entry[mSleepImageCache.Count++];
+    ZeroMem(Entry, sizeof(SLEEP_IMAGE_CACHE_ENTRY));
+    CopyGuid(&Entry->VolumeGuid, VolumeGuid);
+  } else if (CompareGuid(&Entry->ImageVolumeGuid, ImageVolumeGuid) &&
+             (Entry->Offset == Offset) && (Entry->SleepTime == gSleepTime) &&
+             (Entry->NameCrc == Id->NameCrc) && (Entry->FileSize == Id->FileSize) &&
+             (CompareMem(&Entry->CreateTime, &Id->CreateTime, sizeof(EFI_TIME)) == 0)) {
+    return;
+  }
+  CopyGuid(&Entry->ImageVolumeGuid, ImageVolumeGuid);
+  Entry->Offset = Offset;
+  Entry->FileSize = Id->FileSize;
+  CopyMem(&Entry->CreateTime, &Id->CreateTime, sizeof(EFI_TIME));
+  Entry->NameCrc = Id->NameCrc;
+  Entry->SleepTime = gSleepTime;
+
+  Status = SetNvramVariable(SLEEP_IMAGE_CACHE_VAR, &gCloverCacheVariableGuid,
+                            EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+                            sizeof(mSleepImageCache), &mSleepImageCache);
+  DBG("    sleepimage cache saved: %r\n", Status);
+}
+
+/** Returns TRUE if there is a valid sleepimage header at byte Offset of the disk with ImageVolume.
+ *  Sets gSleepTime from the header, as OurBlockIoRead() does.
+ */
+STATIC BOOLEAN
+ReadSleepImageHeader (IN REFIT_VOLUME *ImageVolume, IN UINT64 Offset)
+{
+  EFI_STATUS                    Status;
+  EFI_BLOCK_IO_PROTOCOL         *BlockIo;
+  IOHibernateImageHeaderMin     *Header;
+  IOHibernateImageHeaderMinSnow *Header2;
+  VOID                          *Buffer;
+  UINT32                        BlockSize;
+  UINT32                        Remainder;
+  EFI_LBA                       Lba;
+  INTN                          Pages;
+  BOOLEAN                       Valid = FALSE;
+
+  BlockIo = ImageVolume->WholeDiskBlockIO;
+  if ((BlockIo == NULL) || (BlockIo->Media == NULL)) {
+    return FALSE;
+  }
+  BlockSize = BlockIo->Media->BlockSize;
+  if (BlockSize < sizeof(IOHibernateImageHeaderMin)) {
+    return FALSE;
+  }
+  Lba = DivU64x32Remainder(Offset, BlockSize, &Remainder);
+  if ((Remainder != 0) || (Lba > BlockIo->Media->LastBlock)) {
+    return FALSE;
+  }
+
+  // use 4KB aligned page to avoid possible issues with BlockIo buffer alignment
+  Pages = EFI_SIZE_TO_PAGES(BlockSize);
+  Buffer = AllocatePages(Pages);
+  if (Buffer == NULL) {
+    return FALSE;
+  }
+  Status = BlockIo->ReadBlocks(BlockIo, BlockIo->Media->MediaId, Lba, BlockSize, Buffer);
+  if (!EFI_ERROR(Status)) {
+    Header = (IOHibernateImageHeaderMin *) Buffer;
+    Header2 = (IOHibernateImageHeaderMinSnow *) Buffer;
+    if (Header->signature == kIOHibernateHeaderSignature) {
+      gSleepTime = Header->sleepTime;
+      Valid = TRUE;
+    } else if (Header2->signature == kIOHibernateHeaderSignature) {
+      gSleepTime = 0;
+      Valid = TRUE;
+    }
+  }
+  FreePages(Buffer, Pages);
+  return Valid;
+}
+
+/** Returns TRUE if any of the nvram vars written by the kernel when it hibernates is present */
+STATIC BOOLEAN
+HasHibernateNvramVars (VOID)
+{
+  EFI_STATUS  Status;
+  UINTN       Size;
+
+  Size = 0;
+  Status = gRT->GetVariable(L"Boot0082", &gEfiGlobalVariableGuid, NULL, &Size, NULL);
+  if (Status == EFI_BUFFER_TOO_SMALL) {
+    return TRUE;
+  }
+  Size = 0;
+  Status = gRT->GetVariable(L"IOHibernateRTCVariables", &gEfiAppleBootGuid, NULL, &Size, NULL);
+  if (Status == EFI_BUFFER_TOO_SMALL) {
+    return TRUE;
+  }
+  Size = 0;
+  Status = gRT->GetVariable(L"boot-image", &gEfiAppleBootGuid, NULL, &Size, NULL);
+  return (Status == EFI_BUFFER_TOO_SMALL);
+}
+
 /** Get slep image location (volume and name) */
 VOID
 GetSleepImageLocation(IN REFIT_VOLUME *Volume, REFIT_VOLUME **SleepImageVolume, CHAR16 **SleepImageName)
@@ -389,6 +607,11 @@ GetSleepImagePosition (IN REFIT_VOLUME *Volume, REFIT_VOLUME **SleepImageVolume)
   UINTN               BufferSize;
   CHAR16              *ImageName;
   REFIT_VOLUME        *ImageVolume;
+  EFI_GUID            *VolumeGuid;
+  EFI_GUID            *ImageVolumeGuid;
+  SLEEP_IMAGE_CACHE_ENTRY *CacheEntry;
+  SLEEP_IMAGE_CACHE_ENTRY Id;
+  BOOLEAN             HasId;
   
   if (!Volume) {
     DBG("    no volume to get sleepimage\n");
@@ -409,7 +632,28 @@ GetSleepImagePosition (IN REFIT_VOLUME *Volume, REFIT_VOLUME **SleepImageVolume)
     DBG("    returning previously calculated offset: %lx\n", Volume->SleepImageOffset);
     return Volume->SleepImageOffset;
   }
-  
+
+  // A new hibernation writes its header where the sleepimage was found before,
+  // try there before the plist is parsed and the sleepimage is opened. A header
+  // with the cached sleep time may be left over from a sleepimage which moved.
+  VolumeGuid = FindGPTPartitionGuidInDevicePath(Volume->DevicePath);
+  CacheEntry = (VolumeGuid != NULL) ? FindSleepImageCacheEntry(VolumeGuid) : NULL;
+  ImageVolume = (CacheEntry != NULL) ? FindVolumeByPartitionGuid(&CacheEntry->ImageVolumeGuid) : NULL;
+  if (ImageVolume != NULL) {
+    CopyMem(&Id, CacheEntry, sizeof(Id));
+    if (ReadSleepImageHeader(ImageVolume, Id.Offset) && (gSleepTime != 0) && (gSleepTime != Id.SleepTime)) {
+      DBG("    new sleepimage header at cached offset %lx, sleepTime %d (was %d)\n",
+          Id.Offset, gSleepTime, Id.SleepTime);
+      ImageVolume->SleepImageOffset = Id.Offset;
+      SetSleepImageCache(Volume, ImageVolume, &Id, Id.Offset);
+      if (SleepImageVolume != NULL) {
+        *SleepImageVolume = ImageVolume;
+      }
+      return ImageVolume->SleepImageOffset;
+    }
+    DBG("    no new sleepimage header at cached offset %lx\n", Id.Offset);
+  }
+
   // Get sleepimage name and volume
   GetSleepImageLocation(Volume,&ImageVolume,&ImageName);
 
@@ -419,12 +663,35 @@ GetSleepImagePosition (IN REFIT_VOLUME *Volume, REFIT_VOLUME **SleepImageVolume)
     DBG("    sleepimage not found -> %r\n", Status);
     return 0;
   }
+  HasId = GetSleepImageFileId(File, ImageName, &Id);
+
+  // Try the offset where the same sleepimage was found before
+  ImageVolumeGuid = FindGPTPartitionGuidInDevicePath(ImageVolume->DevicePath);
+  if ((CacheEntry != NULL) && HasId && (ImageVolumeGuid != NULL) &&
+      CompareGuid(&CacheEntry->ImageVolumeGuid, ImageVolumeGuid) &&
+      (CacheEntry->NameCrc == Id.NameCrc) && (CacheEntry->FileSize == Id.FileSize) &&
+      (CompareMem(&CacheEntry->CreateTime, &Id.CreateTime, sizeof(EFI_TIME)) == 0)) {
+    // a header without sleep time is not trusted at the cached offset
+    if (ReadSleepImageHeader(ImageVolume, CacheEntry->Offset) && (gSleepTime != 0)) {
+      DBG("    sleepimage header at cached offset %lx, sleepTime %d (was %d)\n",
+          CacheEntry->Offset, gSleepTime, CacheEntry->SleepTime);
+      File->Close(File);
+      ImageVolume->SleepImageOffset = CacheEntry->Offset;
+      SetSleepImageCache(Volume, ImageVolume, &Id, CacheEntry->Offset);
+      if (SleepImageVolume != NULL) {
+        *SleepImageVolume = ImageVolume;
+      }
+      return ImageVolume->SleepImageOffset;
+    }
+    DBG("    no sleepimage header at cached offset %lx\n", CacheEntry->Offset);
+  }
 
   // We want to read the first 512 bytes from sleepimage
   BufferSize = 512;
   Buffer = AllocatePool(BufferSize);
   if (Buffer == NULL) {
     DBG("    could not allocate buffer for sleepimage\n");
+    File->Close(File);
     return 0;
   }
 
@@ -462,6 +729,9 @@ GetSleepImagePosition (IN REFIT_VOLUME *Volume, REFIT_VOLUME **SleepImageVolume)
   if (gSleepImageOffset != 0) {
     DBG("     sleepimage offset acquired successfully: %lx\n", gSleepImageOffset);
     ImageVolume->SleepImageOffset = gSleepImageOffset;
+    if (HasId) {
+      SetSleepImageCache(Volume, ImageVolume, &Id, gSleepImageOffset);
+    }
   } else {
     DBG("     sleepimage offset could not be acquired\n");
   }
@@ -562,6 +832,21 @@ IsOsxHibernated (IN REFIT_VOLUME *Volume)
 
   DBG("    Check if volume Is Hibernated:\n");
 
+  //if we choose "cancel hibernate wake" then it must be canceled
+  if (GlobalConfig.NeverHibernate) {
+    DBG("     hibernated: set as never\n");
+    return FALSE;
+  }
+
+  // UEFI with NVRAM: the kernel leaves Boot0082 and its hibernate vars there,
+  // without them there is nothing to wake and the disk is not read at all
+  if (!gFirmwareClover &&
+      !gDriversFlags.EmuVariableLoaded &&
+      !HasHibernateNvramVars()) {
+    DBG("     hibernated: no - nvram\n");
+    return FALSE;
+  }
+
   // CloverEFI or UEFI with EmuVariable
   if (IsSleepImageValidBySignature(Volume)) {
     if ((gSleepTime == 0) || IsSleepImageValidBySleepTime(Volume)) {
@@ -576,13 +861,6 @@ IsOsxHibernated (IN REFIT_VOLUME *Volume)
     return FALSE;
   }
   
-  //if sleep image is good but OSX was not hibernated.
-  //or we choose "cancel hibernate wake" then it must be canceled
-  if (GlobalConfig.NeverHibernate) {
-    DBG("     hibernated: set as never\n");
-    return FALSE;
-  }
-  
   if (!gFirmwareClover &&
       !gDriversFlags.EmuVariableLoaded) {
     DBG("     UEFI with NVRAM: ");
@@ -43,6 +43,28 @@ CHAR16                   *gEfiBootLoaderPath;
 // contains GPT GUID from gEfiBootDeviceData or gBootCampHD (if exists)
 EFI_GUID                 *gEfiBootDeviceGuid;
 
+//
+// NVRAM_HINT file: remembers where nvram.plist was found on last boot
+//
+#define NVRAM_PLIST_HINT_SIGNATURE  SIGNATURE_32('N', 'V', 'H', 'T')
+
+typedef struct {
+  UINT32   Signature;
+  UINT32   PlistVolumeDevicePathSize;
+  UINT32   BootVolumeDevicePathSize;
+  UINT32   Reserved;
+  UINT64   ModifTimeMs;
+  // followed by volume dev path of nvram.plist and dev path of booted volume
+} NVRAM_PLIST_HINT;
+
+// volume with nvram.plist loaded into gNvramDict and its modification time
+REFIT_VOLUME             *mNvramPlistVolume;
+UINT64                   mNvramPlistModifTimeMs;
+
+// NVRAM_HINT from last boot
+NVRAM_PLIST_HINT         *mNvramPlistHint;
+UINTN                    mNvramPlistHintSize;
+
 
 
 /** returns given time as miliseconds.
@@ -579,16 +601,151 @@ LoadNvramPlist (
 }
 
 
-/** Searches all volumes for the most recent nvram.plist and loads it into gNvramDict. */
+/** Gets modification time (in ms) of nvram.plist in the root of given volume. */
+EFI_STATUS
+GetNvramPlistModifTime (
+  IN  REFIT_VOLUME *Volume,
+  OUT UINT64       *ModifTimeMs
+  )
+{
+  EFI_STATUS      Status;
+  EFI_FILE_HANDLE FileHandle;
+  EFI_FILE_INFO   *FileInfo;
+
+  if (!Volume->RootDir) {
+    return EFI_NOT_FOUND;
+  }
+
+  // check if nvram.plist exists
+  Status = Volume->RootDir->Open (Volume->RootDir, &FileHandle, L"nvram.plist", EFI_FILE_MODE_READ, 0);
+  if (EFI_ERROR(Status)) {
+    return Status;
+  }
+
+  // get nvram.plist modification date
+  FileInfo = EfiLibFileInfo(FileHandle);
+  FileHandle->Close(FileHandle);
+  if (FileInfo == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  *ModifTimeMs = GetEfiTimeInMs (&FileInfo->ModificationTime);
+  FreePool (FileInfo);
+  return EFI_SUCCESS;
+}
+
+
+/** Returns volume with given device path or NULL. */
+REFIT_VOLUME *
+FindVolumeByDevicePath (
+  IN  EFI_DEVICE_PATH_PROTOCOL *DevicePath,
+  IN  UINTN                    DevicePathSize
+  )
+{
+  UINTN        Index;
+  REFIT_VOLUME *Volume;
+
+  if (DevicePathSize == 0) {
+    return NULL;
+  }
+  for (Index = 0; Index < VolumesCount; ++Index) {
+    Volume = Volumes[Index];
+    if (Volume->DevicePath != NULL &&
+        GetDevicePathSize (Volume->DevicePath) == DevicePathSize &&
+        CompareMem (Volume->DevicePath, DevicePath, DevicePathSize) == 0) {
+      return Volume;
+    }
+  }
+  return NULL;
+}
+
+
+/** Loads NVRAM_HINT written on last boot into mNvramPlistHint. */
+EFI_STATUS
+LoadNvramPlistHint ()
+{
+  EFI_STATUS       Status;
+  NVRAM_PLIST_HINT *Hint;
+  UINTN            Size;
+
+  if (mNvramPlistHint != NULL) {
+    return EFI_SUCCESS;
+  }
+
+  Status = egLoadFile (SelfRootDir, NVRAM_HINT, (UINT8**)&Hint, &Size);
+  if (EFI_ERROR(Status)) {
+    return Status;
+  }
+
+  if (Size < sizeof(NVRAM_PLIST_HINT) ||
+      Hint->Signature != NVRAM_PLIST_HINT_SIGNATURE ||
+      Hint->PlistVolumeDevicePathSize == 0 ||
+      Size != sizeof(NVRAM_PLIST_HINT) + Hint->PlistVolumeDevicePathSize + Hint->BootVolumeDevicePathSize) {
+    FreePool (Hint);
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  mNvramPlistHint     = Hint;
+  mNvramPlistHintSize = Size;
+  return EFI_SUCCESS;
+}
+
+
+/** Saves NVRAM_HINT with volume of loaded nvram.plist and volume that is booted now,
+ *  so next boot can check only those two volumes instead of searching all of them.
+ *  The booted OS writes its nvram.plist to one of those on shutdown.
+ */
+VOID
+SaveNvramPlistHint (
+  IN  REFIT_VOLUME *BootVolume
+  )
+{
+  EFI_STATUS       Status;
+  NVRAM_PLIST_HINT *Hint;
+  UINTN            PlistVolumeDevicePathSize;
+  UINTN            BootVolumeDevicePathSize;
+  UINTN            Size;
+
+  if (mNvramPlistVolume == NULL || mNvramPlistVolume->DevicePath == NULL) {
+    return;
+  }
+
+  PlistVolumeDevicePathSize = GetDevicePathSize (mNvramPlistVolume->DevicePath);
+  BootVolumeDevicePathSize  = (BootVolume != NULL && BootVolume->DevicePath != NULL) ? GetDevicePathSize (BootVolume->DevicePath) : 0;
+  Size = sizeof(NVRAM_PLIST_HINT) + PlistVolumeDevicePathSize + BootVolumeDevicePathSize;
+
+  Hint = AllocateZeroPool (Size);
+  if (Hint == NULL) {
+    return;
+  }
+  Hint->Signature                 = NVRAM_PLIST_HINT_SIGNATURE;
+  Hint->PlistVolumeDevicePathSize = (UINT32)PlistVolumeDevicePathSize;
+  Hint->BootVolumeDevicePathSize  = (UINT32)BootVolumeDevicePathSize;
+  Hint->ModifTimeMs               = mNvramPlistModifTimeMs;
+  CopyMem (Hint + 1, mNvramPlistVolume->DevicePath, PlistVolumeDevicePathSize);
+  if (BootVolumeDevicePathSize != 0) {
+    CopyMem ((UINT8*)(Hint + 1) + PlistVolumeDevicePathSize, BootVolume->DevicePath, BootVolumeDevicePathSize);
+  }
+
+  // write only if something changed
+  if (mNvramPlistHint == NULL || mNvramPlistHintSize != Size || CompareMem (mNvramPlistHint, Hint, Size) != 0) {
+    Status = egSaveFile (SelfRootDir, NVRAM_HINT, (UINT8*)Hint, Size);
+    DBG ("SaveNvramPlistHint: %r\n", Status);
+  }
+  FreePool (Hint);
+}
+
+
+/** Searches all volumes for the most recent nvram.plist and loads it into gNvramDict.
+ *  If NVRAM_HINT from last boot is present, only volumes recorded there are checked.
+ */
 EFI_STATUS
 LoadLatestNvramPlist ()
 {
   EFI_STATUS      Status;
   UINTN           Index;
   REFIT_VOLUME    *Volume;
-//  EFI_GUID        *Guid;
-  EFI_FILE_HANDLE FileHandle;
-  EFI_FILE_INFO   *FileInfo;
+  REFIT_VOLUME    *Candidates[2];
   UINT64          LastModifTimeMs;
   UINT64          ModifTimeMs;
   REFIT_VOLUME    *VolumeWithLatestNvramPlist;
@@ -612,8 +769,35 @@ LoadLatestNvramPlist ()
   LastModifTimeMs = 0;
   VolumeWithLatestNvramPlist = NULL;
   
+  //
+  // try volumes from last boot first: one with nvram.plist and the booted one
+  //
+  if (!EFI_ERROR(LoadNvramPlistHint ())) {
+    Candidates[0] = FindVolumeByDevicePath ((EFI_DEVICE_PATH_PROTOCOL*)(mNvramPlistHint + 1),
+                                            mNvramPlistHint->PlistVolumeDevicePathSize);
+    Candidates[1] = FindVolumeByDevicePath ((EFI_DEVICE_PATH_PROTOCOL*)((UINT8*)(mNvramPlistHint + 1) + mNvramPlistHint->PlistVolumeDevicePathSize),
+                                            mNvramPlistHint->BootVolumeDevicePathSize);
+    
+    // nvram.plist on hinted volume must still be there and must not be older
+    if (Candidates[0] != NULL &&
+        !EFI_ERROR(GetNvramPlistModifTime (Candidates[0], &ModifTimeMs)) &&
+        ModifTimeMs >= mNvramPlistHint->ModifTimeMs) {
+      VolumeWithLatestNvramPlist = Candidates[0];
+      LastModifTimeMs = ModifTimeMs;
+      
+      if (Candidates[1] != NULL && Candidates[1] != Candidates[0] &&
+          !EFI_ERROR(GetNvramPlistModifTime (Candidates[1], &ModifTimeMs)) &&
+          LastModifTimeMs < ModifTimeMs) {
+        VolumeWithLatestNvramPlist = Candidates[1];
+        LastModifTimeMs = ModifTimeMs;
+      }
+    } else {
+      DBG ("nvram.plist hint is stale\n");
+    }
+  }
+  
   // search all volumes
-  for (Index = 0; Index < VolumesCount; ++Index) {
+  for (Index = 0; Index < VolumesCount && VolumeWithLatestNvramPlist == NULL; ++Index) {
     Volume = Volumes[Index];
     
     if (!Volume->RootDir) {
@@ -628,8 +812,8 @@ LoadLatestNvramPlist ()
       DBG (" - not GPT");
     } */
     
-    // check if nvram.plist exists
-    Status = Volume->RootDir->Open (Volume->RootDir, &FileHandle, L"nvram.plist", EFI_FILE_MODE_READ, 0);
+    // check if nvram.plist exists and get its modification date
+    Status = GetNvramPlistModifTime (Volume, &ModifTimeMs);
     if (EFI_ERROR(Status)) {
 //      DBG (" - no nvram.plist - skipping!\n");
       continue;
@@ -637,26 +821,10 @@ LoadLatestNvramPlist ()
     
     if (GlobalConfig.FastBoot) {
       VolumeWithLatestNvramPlist = Volume;
+      LastModifTimeMs = ModifTimeMs;
       break;
     }
     
-    // get nvram.plist modification date
-    FileInfo = EfiLibFileInfo(FileHandle);
-    if (FileInfo == NULL) {
-//      DBG (" - no nvram.plist file info - skipping!\n");
-      FileHandle->Close(FileHandle);
-      continue;
-    }
-    
-//    DBG (" Modified = ");
-    ModifTimeMs = GetEfiTimeInMs (&FileInfo->ModificationTime);
-/*    DBG ("%d-%d-%d %d:%d:%d (%ld ms)",
-        FileInfo->ModificationTime.Year, FileInfo->ModificationTime.Month, FileInfo->ModificationTime.Day,
-        FileInfo->ModificationTime.Hour, FileInfo->ModificationTime.Minute, FileInfo->ModificationTime.Second,
-        ModifTimeMs); */
-    FreePool (FileInfo);
-    FileHandle->Close(FileHandle);
-    
     // check if newer
     if (LastModifTimeMs < ModifTimeMs) {
 //      DBG (" - newer - will use this one\n");
@@ -675,6 +843,10 @@ LoadLatestNvramPlist ()
   if (VolumeWithLatestNvramPlist != NULL) {
     DBG ("Loading nvram.plist from Vol '%s' -", VolumeWithLatestNvramPlist->VolName);
     Status = LoadNvramPlist (VolumeWithLatestNvramPlist->RootDir, L"nvram.plist");
+    if (!EFI_ERROR(Status)) {
+      mNvramPlistVolume      = VolumeWithLatestNvramPlist;
+      mNvramPlistModifTimeMs = LastModifTimeMs;
+    }
     
   } else {
  //   DBG (" nvram.plist not found!\n");
@@ -686,16 +858,21 @@ LoadLatestNvramPlist ()
 
 /** Puts all vars from nvram.plist to RT vars. Should be used in CloverEFI only
  *  or if some UEFI boot uses EmuRuntimeDxe driver.
+ *  With EmuVariableUefi all vars are imported at once through EMU_VARIABLE_IMPORT_PROTOCOL.
  */
 VOID
 PutNvramPlistToRtVars ()
 {
-  EFI_STATUS Status;
-  TagPtr     Tag;
-  TagPtr     ValTag;
-  INTN       Size, i;
-  CHAR16     KeyBuf[128];
-  VOID       *Value;
+  EFI_STATUS                   Status;
+  TagPtr                       Tag;
+  TagPtr                       ValTag;
+  INTN                         Size, i;
+  CHAR16                       KeyBuf[128];
+  VOID                         *Value;
+  EMU_VARIABLE_IMPORT_PROTOCOL *EmuVariableImport;
+  EMU_VARIABLE_IMPORT_ENTRY    *Entries;
+  UINTN                        EntriesCount;
+  UINTN                        Index;
   
   
   if (gNvramDict == NULL) {
@@ -707,6 +884,21 @@ PutNvramPlistToRtVars ()
   }
   
   DBG ("PutNvramPlistToRtVars ...\n");
+  
+  // there can't be more vars than dict elements
+  EntriesCount = 0;
+  for (Tag = gNvramDict->tag; Tag != NULL; Tag = Tag->tagNext) {
+    EntriesCount++;
+  }
+  if (EntriesCount == 0) {
+    return;
+  }
+  Entries = AllocateZeroPool (EntriesCount * sizeof(EMU_VARIABLE_IMPORT_ENTRY));
+  if (Entries == NULL) {
+    return;
+  }
+  EntriesCount = 0;
+  
   // iterate over dict elements
   for (Tag = gNvramDict->tag; Tag != NULL; Tag = Tag->tagNext) {
     
@@ -773,26 +965,44 @@ PutNvramPlistToRtVars ()
       continue;
     }
     
-    // set RT var: all vars visible in nvram.plist are gEfiAppleBootGuid
-/*   Status = gRS->SetVariable (
-                    KeyBuf,
-                    &gEfiAppleBootGuid,
-                    EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
-                    Size,
-                    Value
-                    ); */
-
-    SetNvramVariable (
-                      KeyBuf,
-                      &gEfiAppleBootGuid,
-                      EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
-                      Size,
-                      Value
-                      );
+    // all vars visible in nvram.plist are gEfiAppleBootGuid
+    Entries[EntriesCount].Name       = AllocateCopyPool (StrSize (KeyBuf), KeyBuf);
+    Entries[EntriesCount].Guid       = &gEfiAppleBootGuid;
+    Entries[EntriesCount].Attributes = EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS;
+    Entries[EntriesCount].DataSize   = Size;
+    Entries[EntriesCount].Data       = Value;
+    if (Entries[EntriesCount].Name != NULL) {
+      EntriesCount++;
+    }
     if (!GlobalConfig.DebugLog) {
       DBG ("\n");
     }
   }
+  
+  //
+  // import all vars at once if EmuVariableUefi is in charge, otherwise set them one by one
+  //
+  Status = gBS->LocateProtocol (&gEmuVariableImportProtocolGuid, NULL, (VOID**)&EmuVariableImport);
+  if (!EFI_ERROR(Status)) {
+    Status = EmuVariableImport->ImportVariables (EmuVariableImport, EntriesCount, Entries);
+    DBG (" imported %d vars: %r\n", EntriesCount, Status);
+  }
+  if (EFI_ERROR(Status)) {
+    for (Index = 0; Index < EntriesCount; Index++) {
+      SetNvramVariable (
+                        Entries[Index].Name,
+                        Entries[Index].Guid,
+                        Entries[Index].Attributes,
+                        Entries[Index].DataSize,
+                        Entries[Index].Data
+                        );
+    }
+  }
+  
+  for (Index = 0; Index < EntriesCount; Index++) {
+    FreePool (Entries[Index].Name);
+  }
+  FreePool (Entries);
 }
 
 
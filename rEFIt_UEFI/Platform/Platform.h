@@ -61,6 +61,7 @@ Headers collection for procedures
 #include <Protocol/MsgLog.h>
 #include <Protocol/efiConsoleControl.h>
 #include <Protocol/EmuVariableControl.h>
+#include <Protocol/EmuVariableImport.h>
 
 #include "../refit/lib.h"
 #include "string.h"
@@ -124,6 +125,7 @@ Headers collection for procedures
 #define MSG_LOG_SIZE (256 * 1024)
 #define PREBOOT_LOG  L"EFI\\CLOVER\\misc\\preboot.log"
 #define LEGBOOT_LOG  L"EFI\\CLOVER\\misc\\legacy_boot.log"
+#define NVRAM_HINT   L"EFI\\CLOVER\\misc\\nvram.hint"
 #define BOOT_LOG     L"EFI\\CLOVER\\misc\\boot.log"
 #define SYSTEM_LOG   L"EFI\\CLOVER\\misc\\system.log"
 #define DEBUG_LOG    L"EFI\\CLOVER\\misc\\debug.log"
@@ -1533,6 +1535,11 @@ SaveBooterLog (
   IN  CHAR16 *FileName
   );
 
+VOID
+FlushDebugLog (
+  IN  BOOLEAN Close
+  );
+
 VOID
 DebugLog (
   IN        INTN  DebugMode,
@@ -1602,6 +1609,57 @@ getCurrentEdid ();
 EFI_STATUS
 GetEdidDiscovered ();
 
+//ProbeCache.c
+#define PROBE_HDA_CODEC   0x01
+#define PROBE_ID(Kind, Bus, Dev, Func) \
+  (((UINT32)(Kind) << 24) | (((UINT32)(Bus) & 0xFF) << 16) | (((UINT32)(Dev) & 0x1F) << 8) | ((UINT32)(Func) & 0x07))
+
+VOID
+ProbeCacheAddPciDevice (
+  IN PCI_TYPE00 *Pci
+  );
+
+VOID
+ProbeCacheLoad (VOID);
+
+BOOLEAN
+ProbeCacheGet (
+  IN  UINT32 Id,
+  OUT UINT32 *Value
+  );
+
+VOID
+ProbeCacheSet (
+  IN UINT32 Id,
+  IN UINT32 Value,
+  IN UINT64 StartTsc
+  );
+
+VOID
+ProbeCacheSave (VOID);
+
+//DriverManifest.c
+VOID
+DriverManifestLoad (
+  IN CHAR16 *Path
+  );
+
+BOOLEAN
+DriverManifestSkip (
+  IN EFI_FILE_INFO *DirEntry
+  );
+
+VOID
+DriverManifestSet (
+  IN EFI_FILE_INFO *DirEntry,
+  IN EFI_STATUS    Status,
+  IN UINTN         ErrorInStep,
+  IN BOOLEAN       HasBinding
+  );
+
+VOID
+DriverManifestSave (VOID);
+
 //Settings.c
 UINT32
 GetCrc32 (
@@ -1730,6 +1788,11 @@ EFI_GUID
 VOID
 PutNvramPlistToRtVars ();
 
+VOID
+SaveNvramPlistHint (
+  IN  REFIT_VOLUME *BootVolume
+  );
+
 VOID
 GetSmcKeys ();
 
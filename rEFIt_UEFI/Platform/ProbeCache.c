@@ -0,0 +1,158 @@
+/*
+ * ProbeCache.c - results of slow hardware probes kept across boots
+ *
+ * The cache lives in NVRAM together with a fingerprint of the machine:
+ * CPUID signature and the list of PCI vendor/device/subsystem ids seen by
+ * GetDevices(). If the fingerprint of this boot is the same, the probes
+ * take their values from the cache, else they run and the cache is rewritten.
+ */
+
+#include "Platform.h"
+
+#ifndef DEBUG_ALL
+#define DEBUG_PROBE 1
+#else
+#define DEBUG_PROBE DEBUG_ALL
+#endif
+
+#if DEBUG_PROBE == 0
+#define DBG(...)
+#else
+#define DBG(...) DebugLog(DEBUG_PROBE, __VA_ARGS__)
+#endif
+
+#define PROBE_CACHE_VAR         L"Clover.ProbeCache"
+#define PROBE_CACHE_SIGNATURE   SIGNATURE_32('P','R','B','C')
+#define PROBE_CACHE_MAX         16
+
+typedef struct {
+  UINT32  Id;       // PROBE_xxx | PCI location
+  UINT32  Value;
+  UINT32  TimeUs;   // how long the real probe took
+} PROBE_CACHE_ENTRY;
+
+typedef struct {
+  UINT32             Signature;
+  UINT32             Fingerprint;
+  UINT32             Count;
+  PROBE_CACHE_ENTRY  Entry[PROBE_CACHE_MAX];
+} PROBE_CACHE;
+
+PROBE_CACHE   mProbeCache;
+UINT32        mProbeFingerprint = 2166136261U; //FNV offset basis
+BOOLEAN       mProbeCacheValid = FALSE;
+BOOLEAN       mProbeCacheDirty = FALSE;
+
+VOID ProbeFingerprintAdd(UINT32 Value)
+{
+  UINTN i;
+  for (i = 0; i < 4; i++) {
+    mProbeFingerprint ^= (Value >> (i * 8)) & 0xFF;
+    mProbeFingerprint *= 16777619U; //FNV prime
+  }
+}
+
+/** Called by GetDevices() for every PCI device */
+VOID ProbeCacheAddPciDevice(PCI_TYPE00 *Pci)
+{
+  ProbeFingerprintAdd(((UINT32)Pci->Hdr.VendorId << 16) | Pci->Hdr.DeviceId);
+  ProbeFingerprintAdd(((UINT32)Pci->Device.SubsystemVendorID << 16) | Pci->Device.SubsystemID);
+}
+
+/** Finish the fingerprint and take the cache from NVRAM if it is for this machine */
+VOID ProbeCacheLoad(VOID)
+{
+  PROBE_CACHE *Cache;
+  UINTN       Size = 0;
+
+  ProbeFingerprintAdd(gCPUStructure.Signature);
+  ZeroMem(&mProbeCache, sizeof(mProbeCache));
+  mProbeCache.Signature = PROBE_CACHE_SIGNATURE;
+  mProbeCache.Fingerprint = mProbeFingerprint;
+  mProbeCacheValid = FALSE;
+  mProbeCacheDirty = FALSE;
+
+  Cache = GetNvramVariable(PROBE_CACHE_VAR, &gCloverCacheVariableGuid, NULL, &Size);
+  if (Cache != NULL) {
+    if ((Size == sizeof(PROBE_CACHE)) &&
+        (Cache->Signature == PROBE_CACHE_SIGNATURE) &&
+        (Cache->Fingerprint == mProbeFingerprint) &&
+        (Cache->Count <= PROBE_CACHE_MAX)) {
+      CopyMem(&mProbeCache, Cache, sizeof(mProbeCache));
+      mProbeCacheValid = TRUE;
+    }
+    FreePool(Cache);
+  }
+  // a stale cache must be rewritten even if nothing new gets probed
+  mProbeCacheDirty = (Cache != NULL) && !mProbeCacheValid;
+  MsgLog("Probe cache: fingerprint %08x, %a (%d entries)\n", mProbeFingerprint,
+         mProbeCacheValid ? "match" : "reprobe", mProbeCache.Count);
+  mProbeFingerprint = 2166136261U; //ready for the next GetDevices()
+}
+
+/** Cached value of the probe; time of the real probe goes to the log */
+BOOLEAN ProbeCacheGet(UINT32 Id, UINT32 *Value)
+{
+  UINTN i;
+
+  if (!mProbeCacheValid) {
+    return FALSE;
+  }
+  for (i = 0; i < mProbeCache.Count; i++) {
+    if (mProbeCache.Entry[i].Id == Id) {
+      *Value = mProbeCache.Entry[i].Value;
+      DBG("Probe %08x from cache = %08x, saved %dus\n", Id, *Value, mProbeCache.Entry[i].TimeUs);
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/** Remember the result of a probe which started at StartTsc */
+VOID ProbeCacheSet(UINT32 Id, UINT32 Value, UINT64 StartTsc)
+{
+  UINTN  i;
+  UINT64 Ticks = AsmReadTsc() - StartTsc;
+  UINT32 TimeUs = 0;
+
+  if (gCPUStructure.TSCFrequency != 0) {
+    TimeUs = (UINT32)DivU64x64Remainder(MultU64x32(Ticks, 1000000), gCPUStructure.TSCFrequency, NULL);
+  }
+  DBG("Probe %08x = %08x took %dus\n", Id, Value, TimeUs);
+  for (i = 0; i < mProbeCache.Count; i++) {
+    if (mProbeCache.Entry[i].Id == Id) {
+      break;
+    }
+  }
+  if (i == PROBE_CACHE_MAX) {
+    return;
+  }
+  if ((i < mProbeCache.Count) && (mProbeCache.Entry[i].Value == Value)) {
+    return;
+  }
+  mProbeCache.Entry[i].Id = Id;
+  mProbeCache.Entry[i].Value = Value;
+  mProbeCache.Entry[i].TimeUs = TimeUs;
+  if (i == mProbeCache.Count) {
+    mProbeCache.Count++;
+  }
+  mProbeCacheDirty = TRUE;
+}
+
+/** Write the cache back if a probe gave something new */
+VOID ProbeCacheSave(VOID)
+{
+  EFI_STATUS Status;
+
+  if (!mProbeCacheDirty) {
+    return;
+  }
+  Status = SetNvramVariable(PROBE_CACHE_VAR, &gCloverCacheVariableGuid,
+                            EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+                            sizeof(mProbeCache), &mProbeCache);
+  DBG("Probe cache saved: %r\n", Status);
+  if (!EFI_ERROR(Status)) {
+    mProbeCacheDirty = FALSE;
+    mProbeCacheValid = TRUE;
+  }
+}
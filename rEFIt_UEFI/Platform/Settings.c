@@ -3353,6 +3353,7 @@ GetUserSettings(
   TagPtr     DictPointer;
   UINTN      i;
   
+  MemLogSpanBegin ("GetUserSettings");
   Dict              = CfgDict;
   if (Dict != NULL) {
     DBG ("Loading main settings\n");
@@ -4769,6 +4770,7 @@ GetUserSettings(
     SaveSettings();
   }
 //DBG ("config.plist read and return %r\n", Status);
+  MemLogSpanEnd ("GetUserSettings");
   return EFI_SUCCESS;
 }
 
@@ -4793,7 +4795,7 @@ CHAR8 *GetOSVersion(IN LOADER_ENTRY *Entry)
   if (OSTYPE_IS_OSX(Entry->LoaderType)) {
     // Detect exact version for Mac OS X Regular/Server
     i = 0;
-    while (SystemPlists[i] != NULL && !FileExists(Entry->Volume->RootDir, SystemPlists[i])) {
+    while (SystemPlists[i] != NULL && !VolumeFileExists(Entry->Volume, SystemPlists[i])) {
       i++;
     }
 
@@ -4812,7 +4814,7 @@ CHAR8 *GetOSVersion(IN LOADER_ENTRY *Entry)
     // Detect exact version for 2nd stage Installer (thanks to dmazar for this idea)
     // This should work for most installer cases. Rest cases will be read from boot.efi before booting.
     CHAR16 *InstallerPlist = L"\\.IABootFiles\\com.apple.Boot.plist";
-    if (FileExists (Entry->Volume->RootDir, InstallerPlist)) {
+    if (VolumeFileExists (Entry->Volume, InstallerPlist)) {
       Status = egLoadFile (Entry->Volume->RootDir, InstallerPlist, (UINT8 **)&PlistBuffer, &PlistLen);
       if (!EFI_ERROR (Status) && PlistBuffer != NULL && ParseXML (PlistBuffer, &Dict, 0) == EFI_SUCCESS) {
         Prop = GetProperty (Dict, "Kernel Flags");
@@ -4841,7 +4843,7 @@ CHAR8 *GetOSVersion(IN LOADER_ENTRY *Entry)
   if (OSTYPE_IS_OSX_RECOVERY (Entry->LoaderType)) {
     // Detect exact version for OS X Recovery
     CHAR16 *RecoveryPlist = L"\\com.apple.recovery.boot\\SystemVersion.plist";
-    if (FileExists (Entry->Volume->RootDir, RecoveryPlist)) {
+    if (VolumeFileExists (Entry->Volume, RecoveryPlist)) {
       Status = egLoadFile (Entry->Volume->RootDir, RecoveryPlist, (UINT8 **)&PlistBuffer, &PlistLen);
       if (!EFI_ERROR (Status) && PlistBuffer != NULL && ParseXML (PlistBuffer, &Dict, 0) == EFI_SUCCESS) {
         Prop       = GetProperty (Dict, "ProductVersion");
@@ -4849,7 +4851,7 @@ CHAR8 *GetOSVersion(IN LOADER_ENTRY *Entry)
           OSVersion = AllocateCopyPool (AsciiStrSize (Prop->string), Prop->string);
         }
       }
-    } else if (FileExists (Entry->Volume->RootDir, L"\\com.apple.recovery.boot\\boot.efi")) {
+    } else if (VolumeFileExists (Entry->Volume, L"\\com.apple.recovery.boot\\boot.efi")) {
       // Special case - com.apple.recovery.boot/boot.efi exists but SystemVersion.plist doesn't --> 10.9 recovery
       OSVersion    = AllocateZeroPool (5);
       UnicodeStrToAsciiStr (L"10.9", OSVersion);
@@ -4929,13 +4931,13 @@ GetRootUUID (
   }
 
   SystemPlistR = L"\\com.apple.boot.R\\Library\\Preferences\\SystemConfiguration\\com.apple.Boot.plist";
-  HasRock      = FileExists (Volume->RootDir,     SystemPlistR);
+  HasRock      = VolumeFileExists (Volume,     SystemPlistR);
 
   SystemPlistP = L"\\com.apple.boot.P\\Library\\Preferences\\SystemConfiguration\\com.apple.Boot.plist";
-  HasPaper     = FileExists (Volume->RootDir,    SystemPlistP);
+  HasPaper     = VolumeFileExists (Volume,    SystemPlistP);
 
   SystemPlistS = L"\\com.apple.boot.S\\Library\\Preferences\\SystemConfiguration\\com.apple.Boot.plist";
-  HasScissors  = FileExists (Volume->RootDir, SystemPlistS);
+  HasScissors  = VolumeFileExists (Volume, SystemPlistS);
 
   PlistBuffer = NULL;
   // Playing Rock, Paper, Scissors to chose which settings to load.
@@ -5027,6 +5029,8 @@ GetDevices ()
                           &Pci
                           );
         
+        ProbeCacheAddPciDevice (&Pci);
+
         DBG ("PCI (%02x|%02x:%02x.%02x) : %04x %04x class=%02x%02x%02x\n",
             Segment,
             Bus,
@@ -5209,6 +5213,9 @@ GetDevices ()
       }
     }
   }
+
+  // PCI list is known now, see if the probe cache is for this machine
+  ProbeCacheLoad ();
 }
 
 
@@ -0,0 +1,320 @@
+/*
+ * SmbiosFlat.c - flat SMBIOS table helpers
+ *
+ * Length of a structure, index of the original structures by type and
+ * instance, and the string pool of the structure being patched that
+ * LogSmbiosTable() writes out. They work on memory only, so they are also
+ * built on the host by the test in the test folder.
+ */
+
+#include "SmbiosFlat.h"
+
+#ifndef HOST_POSIX
+#ifndef DEBUG_ALL
+#define DEBUG_SMBIOS 1
+#else
+#define DEBUG_SMBIOS DEBUG_ALL
+#endif
+
+#if DEBUG_SMBIOS == 0
+#define DBG(...)
+#else
+#define DBG(...) DebugLog(DEBUG_SMBIOS, __VA_ARGS__)
+#endif
+#endif
+
+UINT16                      NumberOfRecords;
+UINT16                      MaxStructureSize;
+UINT8*                      Current; //pointer to the current end of tables
+
+// This function determines ascii string length ending by space. 
+// search restricted to MaxLen, for example
+// iStrLen("ABC    ", 20) == 3
+// if MaxLen=0 then as usual strlen but bugless
+UINTN iStrLen(CHAR8* String, UINTN MaxLen)
+{
+	UINTN	Len = 0;
+	CHAR8*	BA;
+	if(MaxLen > 0) {
+		for (Len=0; Len<MaxLen; Len++) {
+			if (String[Len] == 0) {
+				break;
+			}
+		}
+		BA = &String[Len - 1];
+		while ((Len != 0) && ((*BA == ' ') || (*BA == 0))) {
+			BA--; Len--;
+		}
+	} else {
+		BA = String;
+		while(*BA){BA++; Len++;}
+	}
+	return Len;
+}
+
+
+// Internal functions for flat SMBIOS
+
+UINT16 SmbiosTableLength (SMBIOS_STRUCTURE_POINTER SmbiosTableN)
+{
+	CHAR8  *AChar;
+	UINT16  Length;
+
+	AChar = (CHAR8 *)(SmbiosTableN.Raw + SmbiosTableN.Hdr->Length);
+	while ((*AChar != 0) || (*(AChar + 1) != 0)) {
+		AChar ++; //stop at 00 - first 0
+	}
+	Length = (UINT16)((UINTN)AChar - (UINTN)SmbiosTableN.Raw + 2); //length includes 00
+	return Length;
+}
+
+
+// Index of the original (OEM) structures by type and instance.
+// Built once by IndexSmbiosTables() so the many GetSmbiosTableFromType()
+// calls in the patching code don't walk the flat table from its start
+// every time. mSmbiosTypeFirst[Type]..mSmbiosTypeFirst[Type+1]-1 are the
+// positions of the instances of that type in mSmbiosIndex.
+UINT8**                     mSmbiosIndex = NULL;
+UINT16                      mSmbiosTypeFirst[257];
+UINTN                       mSmbiosIndexCount = 0;
+SMBIOS_TABLE_ENTRY_POINT*   mSmbiosIndexPoint = NULL; //entry point of the indexed table
+
+// String pool of the structure being patched.
+// UpdateSmbiosString() used to shift the string-set of newSmbiosTable on every
+// call. Now the strings are loaded into the pool at the first update, replaced
+// there, and written once by LogSmbiosTable() together with the formatted area.
+#define SMBIOS_POOL_MAX_STRINGS   255
+#define SMBIOS_POOL_SIZE          (MAX_TABLE_SIZE + 16 * (SMBIOS_STRING_MAX_LENGTH + 1))
+
+UINT8*                      mPoolOwner = NULL; //structure the pool belongs to
+UINTN                       mPoolCount;
+UINTN                       mPoolUsed;
+UINT16                      mPoolOffset[SMBIOS_POOL_MAX_STRINGS];
+UINT16                      mPoolLength[SMBIOS_POOL_MAX_STRINGS];
+CHAR8                       mPoolData[SMBIOS_POOL_SIZE];
+
+// walk the flat table once and remember where each structure is
+VOID IndexSmbiosTables (SMBIOS_TABLE_ENTRY_POINT *SmbiosPoint)
+{
+	SMBIOS_STRUCTURE_POINTER SmbiosTableN;
+	UINT8                    *TableEnd;
+	UINT16                   TypeCount[256];
+	UINTN                    Count;
+	UINTN                    Pass;
+	UINTN                    TableType;
+
+	if (mSmbiosIndex) {
+		FreePool(mSmbiosIndex);
+		mSmbiosIndex = NULL;
+	}
+	mSmbiosIndexCount = 0;
+	mSmbiosIndexPoint = SmbiosPoint;
+	if (!SmbiosPoint || !SmbiosPoint->TableAddress) {
+		return;
+	}
+	//some firmwares leave TableLength zero, then the end marker is the only limit
+	TableEnd = (UINT8 *)(UINTN)SmbiosPoint->TableAddress +
+	           (SmbiosPoint->TableLength ? SmbiosPoint->TableLength : MAX_UINT16);
+
+	// pass 0 counts the instances, pass 1 stores the pointers
+	for (Pass = 0; Pass < 2; Pass++) {
+		ZeroMem(TypeCount, sizeof(TypeCount));
+		Count = 0;
+		SmbiosTableN.Raw = (UINT8 *)(UINTN)SmbiosPoint->TableAddress;
+		while ((SmbiosTableN.Raw + sizeof(SMBIOS_TABLE_HEADER) < TableEnd) &&
+		       (SmbiosTableN.Hdr->Length >= sizeof(SMBIOS_TABLE_HEADER))) {
+			TableType = SmbiosTableN.Hdr->Type;
+			if (Pass == 1) {
+				mSmbiosIndex[mSmbiosTypeFirst[TableType] + TypeCount[TableType]] = SmbiosTableN.Raw;
+			}
+			TypeCount[TableType]++;
+			Count++;
+			if (TableType == SMBIOS_TYPE_END_OF_TABLE) {
+				break; //the walk finds the end marker as type 127 too, it is indexed
+			}
+			SmbiosTableN.Raw = (UINT8 *)(SmbiosTableN.Raw + SmbiosTableLength (SmbiosTableN));
+		}
+		if (Pass == 0) {
+			if (Count == 0) {
+				return;
+			}
+			mSmbiosTypeFirst[0] = 0;
+			for (TableType = 0; TableType < 256; TableType++) {
+				mSmbiosTypeFirst[TableType + 1] = (UINT16)(mSmbiosTypeFirst[TableType] + TypeCount[TableType]);
+			}
+			mSmbiosIndex = AllocatePool(Count * sizeof(UINT8*));
+			if (!mSmbiosIndex) {
+				return;
+			}
+		}
+	}
+	mSmbiosIndexCount = Count;
+	DBG("SMBIOS: indexed %d structures\n", Count);
+}
+
+// load the string-set of the structure into the pool
+VOID LoadSmbiosStringPool (SMBIOS_STRUCTURE_POINTER SmbiosTableN)
+{
+	CHAR8  *AString;
+	UINTN  Len;
+
+	mPoolOwner = SmbiosTableN.Raw;
+	mPoolCount = 0;
+	mPoolUsed = 0;
+	AString = (CHAR8*)(SmbiosTableN.Raw + SmbiosTableN.Hdr->Length); //first string
+	while (*AString != 0 && mPoolCount < SMBIOS_POOL_MAX_STRINGS) {
+		Len = AsciiStrLen(AString);
+		if (mPoolUsed + Len > SMBIOS_POOL_SIZE) {
+			break;
+		}
+		CopyMem(&mPoolData[mPoolUsed], AString, Len);
+		mPoolOffset[mPoolCount] = (UINT16)mPoolUsed;
+		mPoolLength[mPoolCount] = (UINT16)Len;
+		mPoolCount++;
+		mPoolUsed += Len;
+		AString += Len + 1;
+	}
+}
+
+EFI_SMBIOS_HANDLE LogSmbiosTable (SMBIOS_STRUCTURE_POINTER SmbiosTableN)
+{
+	UINT16  Length;
+	UINTN   IndexStr;
+	UINT8   *Start = Current;
+
+	if (mPoolOwner != NULL && mPoolOwner == SmbiosTableN.Raw) {
+		//formatted area and the pooled strings are written once here
+		CopyMem(Current, SmbiosTableN.Raw, SmbiosTableN.Hdr->Length);
+		Current += SmbiosTableN.Hdr->Length;
+		for (IndexStr = 0; IndexStr < mPoolCount; IndexStr++) {
+			CopyMem(Current, &mPoolData[mPoolOffset[IndexStr]], mPoolLength[IndexStr]);
+			Current += mPoolLength[IndexStr];
+			*Current++ = 0;
+		}
+		if (mPoolCount == 0) {
+			*Current++ = 0;
+		}
+		*Current++ = 0; //end of the structure
+		Length = (UINT16)(Current - Start);
+	} else {
+		Length = SmbiosTableLength(SmbiosTableN);
+		CopyMem(Current, SmbiosTableN.Raw, Length);
+		Current += Length;
+	}
+	mPoolOwner = NULL;
+	if (Length > MaxStructureSize) {
+		MaxStructureSize = Length;
+	}
+	NumberOfRecords++;
+	return SmbiosTableN.Hdr->Handle;
+}
+
+EFI_STATUS UpdateSmbiosString (SMBIOS_STRUCTURE_POINTER SmbiosTableN, SMBIOS_TABLE_STRING* Field, CHAR8* Buffer)
+{
+	UINTN	BLength;
+	UINTN	IndexStr;
+
+	if ((SmbiosTableN.Raw == NULL) || !Buffer || !Field) {
+		return EFI_NOT_FOUND;
+	}
+	if (mPoolOwner != SmbiosTableN.Raw) {
+		LoadSmbiosStringPool(SmbiosTableN);
+	}
+	BLength = iStrLen(Buffer, SMBIOS_STRING_MAX_LENGTH);
+	if (BLength == 0) {
+		//an empty string can't be in the string-set, it would end the set there;
+		//string number 0 means no string. The pool is left as it is, other fields
+		//may refer to the old string too
+		*Field = 0;
+		return EFI_SUCCESS;
+	}
+	if (mPoolUsed + BLength > SMBIOS_POOL_SIZE) {
+		return EFI_BUFFER_TOO_SMALL;
+	}
+	if ((*Field == 0) || (*Field > mPoolCount)) {
+		//new string at the end of the set
+		if (mPoolCount >= SMBIOS_POOL_MAX_STRINGS) {
+			return EFI_BUFFER_TOO_SMALL;
+		}
+		IndexStr = mPoolCount++;
+		*Field = (SMBIOS_TABLE_STRING)mPoolCount;
+	} else {
+		IndexStr = *Field - 1;
+	}
+//	DBG("Table type %d field %d\n", SmbiosTableN.Hdr->Type, *Field);
+	//old text stays in the pool unused, it is not written out
+	CopyMem(&mPoolData[mPoolUsed], Buffer, BLength);
+	mPoolOffset[IndexStr] = (UINT16)mPoolUsed;
+	mPoolLength[IndexStr] = (UINT16)BLength;
+	mPoolUsed += BLength;
+
+	return EFI_SUCCESS;
+}
+
+SMBIOS_STRUCTURE_POINTER GetSmbiosTableFromType (
+	SMBIOS_TABLE_ENTRY_POINT *SmbiosPoint, UINT8 SmbiosType, UINTN IndexTable)
+{
+	SMBIOS_STRUCTURE_POINTER SmbiosTableN;
+	UINTN                    SmbiosTypeIndex;
+
+	if ((SmbiosPoint == mSmbiosIndexPoint) && (mSmbiosIndexCount != 0)) {
+		SmbiosTypeIndex = mSmbiosTypeFirst[SmbiosType] + IndexTable;
+		if (SmbiosTypeIndex < mSmbiosTypeFirst[SmbiosType + 1]) {
+			SmbiosTableN.Raw = mSmbiosIndex[SmbiosTypeIndex];
+		} else {
+			SmbiosTableN.Raw = NULL;
+		}
+		return SmbiosTableN;
+	}
+
+	SmbiosTypeIndex = 0;
+	SmbiosTableN.Raw = (UINT8 *)((UINTN)SmbiosPoint->TableAddress);
+	if (SmbiosTableN.Raw == NULL) {
+		return SmbiosTableN;
+	}
+	while ((SmbiosTypeIndex != IndexTable) || (SmbiosTableN.Hdr->Type != SmbiosType)) {
+		if (SmbiosTableN.Hdr->Type == SMBIOS_TYPE_END_OF_TABLE) {
+			SmbiosTableN.Raw = NULL;
+			return SmbiosTableN;
+		}
+		if (SmbiosTableN.Hdr->Type == SmbiosType) {
+			SmbiosTypeIndex++;
+		}
+		SmbiosTableN.Raw = (UINT8 *)(SmbiosTableN.Raw + SmbiosTableLength (SmbiosTableN));
+	}
+	return SmbiosTableN;
+}
+
+CHAR8* GetSmbiosString (
+	SMBIOS_STRUCTURE_POINTER SmbiosTableN, SMBIOS_TABLE_STRING StringN)
+{
+	CHAR8      *AString;
+	UINT8      Ind;
+
+	Ind = 1;
+	AString = (CHAR8 *)(SmbiosTableN.Raw + SmbiosTableN.Hdr->Length); //first string
+	while (Ind != StringN) {
+		while (*AString != 0) {
+			AString ++;
+		}
+		AString ++; //skip zero ending
+		if (*AString == 0) {
+			return AString; //this is end of the table
+		}
+		Ind++;
+	}
+
+	return AString; //return pointer to Ascii string
+}
+
+VOID AddSmbiosEndOfTable()
+{	
+	SMBIOS_TABLE_HEADER* StructurePtr = (SMBIOS_TABLE_HEADER*)Current;
+	StructurePtr->Type		= SMBIOS_TYPE_END_OF_TABLE; 
+	StructurePtr->Length	= sizeof(SMBIOS_TABLE_HEADER);
+	StructurePtr->Handle	= SMBIOS_TYPE_INACTIVE; //spec 2.7 p.120
+	Current += sizeof(SMBIOS_TABLE_HEADER);
+	*Current++ = 0;
+	*Current++ = 0; //double 0 at the end
+	NumberOfRecords++;
+}
@@ -0,0 +1,40 @@
+/*
+ * SmbiosFlat.h - flat SMBIOS table helpers, see SmbiosFlat.c
+ */
+
+#ifndef __SMBIOS_FLAT_H__
+#define __SMBIOS_FLAT_H__
+
+#ifdef HOST_POSIX
+#include "smbios_posix_base.h"
+#else
+#include "Platform.h"
+#endif
+
+#define MAX_TABLE_SIZE    512
+
+extern UINT16                      NumberOfRecords;
+extern UINT16                      MaxStructureSize;
+extern UINT8*                      Current; //pointer to the current end of tables
+extern UINT8*                      mPoolOwner; //structure the string pool belongs to
+
+UINT16 SmbiosTableLength (SMBIOS_STRUCTURE_POINTER SmbiosTableN);
+
+// index the structures of the table, GetSmbiosTableFromType() uses it for this entry point
+VOID IndexSmbiosTables (SMBIOS_TABLE_ENTRY_POINT *SmbiosPoint);
+
+SMBIOS_STRUCTURE_POINTER GetSmbiosTableFromType (
+	SMBIOS_TABLE_ENTRY_POINT *SmbiosPoint, UINT8 SmbiosType, UINTN IndexTable);
+
+CHAR8* GetSmbiosString (
+	SMBIOS_STRUCTURE_POINTER SmbiosTableN, SMBIOS_TABLE_STRING StringN);
+
+// set the string Field of the structure refers to, empty Buffer leaves Field without string
+EFI_STATUS UpdateSmbiosString (SMBIOS_STRUCTURE_POINTER SmbiosTableN, SMBIOS_TABLE_STRING* Field, CHAR8* Buffer);
+
+// write the structure with its updated strings at Current
+EFI_SMBIOS_HANDLE LogSmbiosTable (SMBIOS_STRUCTURE_POINTER SmbiosTableN);
+
+VOID AddSmbiosEndOfTable();
+
+#endif
@@ -545,6 +545,11 @@ UINT32 HDA_getCodecVendorAndDeviceIds(EFI_PCI_IO_PROTOCOL *PciIo) {
   EFI_STATUS	Status;
   //UINT8		ver[2];
   UINT32		data32 = 0;
+  UINT32		probeId = 0;
+  UINT64		probeStart;
+  UINTN		Segment, Bus, Device, Function;
+  
+  probeStart = AsmReadTsc();
   
   // check HDA version - should be 1.0
   /*
@@ -572,9 +577,22 @@ UINT32 HDA_getCodecVendorAndDeviceIds(EFI_PCI_IO_PROTOCOL *PciIo) {
     
     return 0;
   }
+  
+  // codec verbs are slow, take the id from the probe cache if this is the same machine;
+  // only for a running controller, one in reset answers no verbs whatever the cache says
+  if (!EFI_ERROR(PciIo->GetLocation(PciIo, &Segment, &Bus, &Device, &Function))) {
+    probeId = PROBE_ID(PROBE_HDA_CODEC, Bus, Device, Function);
+    if (ProbeCacheGet(probeId, &data32)) {
+      return data32;
+    }
+  }
   //Slice - TODO check codecAdr=2 - it is my Dell 1525.
   // all ok - read Ids
-  return HDA_IC_sendVerb(PciIo, 0/*codecAdr*/, 0/*nodeId*/, 0xF0000/*verb*/);
+  data32 = HDA_IC_sendVerb(PciIo, 0/*codecAdr*/, 0/*nodeId*/, 0xF0000/*verb*/);
+  if (probeId && data32) {
+    ProbeCacheSet(probeId, data32, probeStart);
+  }
+  return data32;
 }
 
 UINT32 getLayoutIdFromVendorAndDeviceId(UINT32 vendorDeviceId)
@@ -1456,7 +1456,10 @@ KernelAndKextsPatcherStart(IN LOADER_ENTRY *Entry)
       deviceTreeLength = bootArgs2->deviceTreeLength;
     } else return;
     
+    MemLogSpanBegin("InjectKexts");
     Status = InjectKexts(deviceTreeP, &deviceTreeLength, Entry);
+    MemLogSpanEnd("InjectKexts");
+    DBG_RT(Entry, "InjectKexts took %ldms\n", GetMemLogSpanMs("InjectKexts"));
     
     if (!EFI_ERROR(Status)) KernelBooterExtensionsPatch(KernelData, Entry);
   }
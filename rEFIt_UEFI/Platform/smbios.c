@@ -20,6 +20,7 @@
  **/
 
 #include "Platform.h"
+#include "SmbiosFlat.h"
 
 #ifndef DEBUG_ALL
 #define DEBUG_SMBIOS 1
@@ -48,9 +49,6 @@ SMBIOS_TABLE_ENTRY_POINT		*SmbiosEpsNew; //new SmbiosEps
 //for patching
 SMBIOS_STRUCTURE_POINTER		SmbiosTable;
 SMBIOS_STRUCTURE_POINTER		newSmbiosTable;
-UINT16                      NumberOfRecords;
-UINT16                      MaxStructureSize;
-UINT8*                      Current; //pointer to the current end of tables
 EFI_SMBIOS_TABLE_HEADER			*Record;
 EFI_SMBIOS_HANDLE           Handle;
 EFI_SMBIOS_TYPE             Type;
@@ -82,7 +80,6 @@ UINT8 gRAMCount = 0;
 
 #define MAX_HANDLE        0xFEFF
 #define SMBIOS_PTR        SIGNATURE_32('_','S','M','_')
-#define MAX_TABLE_SIZE    512
 
 
 /* Functions */
@@ -150,177 +147,6 @@ VOID* GetSmbiosTablesFromConfigTables (VOID)
 	return Table;
 }
 
-// This function determines ascii string length ending by space. 
-// search restricted to MaxLen, for example
-// iStrLen("ABC    ", 20) == 3
-// if MaxLen=0 then as usual strlen but bugless
-UINTN iStrLen(CHAR8* String, UINTN MaxLen)
-{
-	UINTN	Len = 0;
-	CHAR8*	BA;
-	if(MaxLen > 0) {
-		for (Len=0; Len<MaxLen; Len++) {
-			if (String[Len] == 0) {
-				break;
-			}
-		}
-		BA = &String[Len - 1];
-		while ((Len != 0) && ((*BA == ' ') || (*BA == 0))) {
-			BA--; Len--;
-		}
-	} else {
-		BA = String;
-		while(*BA){BA++; Len++;}
-	}
-	return Len;
-}
-
-
-// Internal functions for flat SMBIOS
-
-UINT16 SmbiosTableLength (SMBIOS_STRUCTURE_POINTER SmbiosTableN)
-{
-	CHAR8  *AChar;
-	UINT16  Length;
-
-	AChar = (CHAR8 *)(SmbiosTableN.Raw + SmbiosTableN.Hdr->Length);
-	while ((*AChar != 0) || (*(AChar + 1) != 0)) {
-		AChar ++; //stop at 00 - first 0
-	}
-	Length = (UINT16)((UINTN)AChar - (UINTN)SmbiosTableN.Raw + 2); //length includes 00
-	return Length;
-}
-
-
-EFI_SMBIOS_HANDLE LogSmbiosTable (SMBIOS_STRUCTURE_POINTER SmbiosTableN)
-{
-	UINT16  Length = SmbiosTableLength(SmbiosTableN);
-	if (Length > MaxStructureSize) {
-		MaxStructureSize = Length;
-	}
-	CopyMem(Current, SmbiosTableN.Raw, Length);
-	Current += Length;
-	NumberOfRecords++;
-	return SmbiosTableN.Hdr->Handle;
-}
-
-EFI_STATUS UpdateSmbiosString (SMBIOS_STRUCTURE_POINTER SmbiosTableN, SMBIOS_TABLE_STRING* Field, CHAR8* Buffer)
-{
-	CHAR8*	AString;
-	CHAR8*	C1; //pointers for copy
-	CHAR8*	C2;
-	UINTN	Length = SmbiosTableLength(SmbiosTableN);
-	UINTN	ALength, BLength;
-	UINT8	IndexStr = 1;
-
-	if ((SmbiosTableN.Raw == NULL) || !Buffer || !Field) {
-		return EFI_NOT_FOUND;
-	}
-	AString = (CHAR8*)(SmbiosTableN.Raw + SmbiosTableN.Hdr->Length); //first string
-	while (IndexStr != *Field) {
-		if (*AString) {
-			IndexStr++;
-		}
-		while (*AString != 0) AString++; //skip string at index
-		AString++; //next string
-		if (*AString == 0) {
-			//this is end of the table
-			if (*Field == 0) {
-				AString[1] = 0; //one more zero
-			}
-			*Field = IndexStr; //index of the next string that  is empty
-			if (IndexStr == 1) {
-				AString--; //first string has no leading zero
-			}
-			break;
-		}		
-	}
-	// AString is at place to copy
-	ALength = iStrLen(AString, 0);
-	BLength = iStrLen(Buffer, SMBIOS_STRING_MAX_LENGTH);
-//	DBG("Table type %d field %d\n", SmbiosTable.Hdr->Type, *Field);
-//	DBG("Old string length=%d new length=%d\n", ALength, BLength);
-	if (BLength > ALength) {
-		//Shift right
-		C1 = (CHAR8*)SmbiosTableN.Raw + Length; //old end
-		C2 = C1  + BLength - ALength; //new end
-		*C2 = 0;
-		while (C1 != AString) *(--C2) = *(--C1);
-
-	} else if (BLength < ALength) {
-		//Shift left
-		C1 = AString + ALength; //old start
-		C2 = AString + BLength; //new start
-		while (C1 != ((CHAR8*)SmbiosTableN.Raw + Length)) {
-			*C2++ = *C1++;
-		}
-		*C2 = 0;
-		*(--C2) = 0; //end of table
-	}
-	CopyMem(AString, Buffer, BLength);
-	*(AString + BLength) = 0; // not sure there is 0	
-
-	return EFI_SUCCESS;
-}
-
-SMBIOS_STRUCTURE_POINTER GetSmbiosTableFromType (
-	SMBIOS_TABLE_ENTRY_POINT *SmbiosPoint, UINT8 SmbiosType, UINTN IndexTable)
-{
-	SMBIOS_STRUCTURE_POINTER SmbiosTableN;
-	UINTN                    SmbiosTypeIndex;
-
-	SmbiosTypeIndex = 0;
-	SmbiosTableN.Raw = (UINT8 *)((UINTN)SmbiosPoint->TableAddress);
-	if (SmbiosTableN.Raw == NULL) {
-		return SmbiosTableN;
-	}
-	while ((SmbiosTypeIndex != IndexTable) || (SmbiosTableN.Hdr->Type != SmbiosType)) {
-		if (SmbiosTableN.Hdr->Type == SMBIOS_TYPE_END_OF_TABLE) {
-			SmbiosTableN.Raw = NULL;
-			return SmbiosTableN;
-		}
-		if (SmbiosTableN.Hdr->Type == SmbiosType) {
-			SmbiosTypeIndex++;
-		}
-		SmbiosTableN.Raw = (UINT8 *)(SmbiosTableN.Raw + SmbiosTableLength (SmbiosTableN));
-	}
-	return SmbiosTableN;
-}
-
-CHAR8* GetSmbiosString (
-	SMBIOS_STRUCTURE_POINTER SmbiosTableN, SMBIOS_TABLE_STRING StringN)
-{
-	CHAR8      *AString;
-	UINT8      Ind;
-
-	Ind = 1;
-	AString = (CHAR8 *)(SmbiosTableN.Raw + SmbiosTableN.Hdr->Length); //first string
-	while (Ind != StringN) {
-		while (*AString != 0) {
-			AString ++;
-		}
-		AString ++; //skip zero ending
-		if (*AString == 0) {
-			return AString; //this is end of the table
-		}
-		Ind++;
-	}
-
-	return AString; //return pointer to Ascii string
-}
-
-VOID AddSmbiosEndOfTable()
-{	
-	SMBIOS_TABLE_HEADER* StructurePtr = (SMBIOS_TABLE_HEADER*)Current;
-	StructurePtr->Type		= SMBIOS_TYPE_END_OF_TABLE; 
-	StructurePtr->Length	= sizeof(SMBIOS_TABLE_HEADER);
-	StructurePtr->Handle	= SMBIOS_TYPE_INACTIVE; //spec 2.7 p.120
-	Current += sizeof(SMBIOS_TABLE_HEADER);
-	*Current++ = 0;
-	*Current++ = 0; //double 0 at the end
-	NumberOfRecords++;
-}
-
 /* Patching Functions */
 VOID PatchTableType0()
 {
@@ -1776,6 +1602,7 @@ EFI_STATUS PrepatchSmbios()
 	
 	//original EPS and tables
 	EntryPoint = (SMBIOS_TABLE_ENTRY_POINT*)Smbios; //yes, it is old SmbiosEPS
+	IndexSmbiosTables(EntryPoint);
 //	Smbios = (VOID*)(UINT32)EntryPoint->TableAddress; // here is flat Smbios database. Work with it
 	//how many we need to add for tables 128, 130, 131, 132 and for strings?
 	BufferLen = 0x20 + EntryPoint->TableLength + 64 * 10; 
@@ -1833,6 +1660,7 @@ EFI_STATUS PrepatchSmbios()
 VOID PatchSmbios(VOID) //continue
 {
   newSmbiosTable.Raw = (UINT8*)AllocateZeroPool(MAX_TABLE_SIZE);
+	mPoolOwner = NULL;
 	//Slice - order of patching is significant
 	PatchTableType0();
 	PatchTableType1();
@@ -46,6 +46,10 @@ extern UINT16 TotalCount;
 
 PCI_TYPE00          gPci;
 BOOLEAN             smbIntel;
+BOOLEAN             smbBlock;     // I2C block reads work on this controller
+BOOLEAN             smbSpdWd;     // SPD write disable is set in HOSTC
+UINT64              smbTimeout;   // 5ms in TSC ticks
+BOOLEAN             spdCached;    // spd buffer is already filled from the cache
 
 CHAR8 *spd_memory_types[] =
 {
@@ -102,6 +106,24 @@ UINT8 spd_mem_to_smbios[] =
 #define SMBHSTCMD_NV 3 /* command */
 #define SMBHSTDAT_NV 4 /* 32 data registers */
 //
+// Intel SMB status, control and config bits
+#define SMBHSTSTS_BUSY       0x01
+#define SMBHSTSTS_INTR       0x02
+#define SMBHSTSTS_DEV_ERR    0x04
+#define SMBHSTSTS_BUS_ERR    0x08
+#define SMBHSTSTS_FAILED     0x10
+#define SMBHSTSTS_BYTE_DONE  0x80
+#define SMBHSTSTS_ERRORS     (SMBHSTSTS_DEV_ERR | SMBHSTSTS_BUS_ERR | SMBHSTSTS_FAILED)
+#define SMBHSTCNT_I2C_BLOCK  0x18
+#define SMBHSTCNT_LAST_BYTE  0x20
+#define SMBHSTCNT_START      0x40
+#define SMBAUXCTL            0x0D
+#define SMBAUXCTL_E32B       0x02
+#define SMBHSTCFG_SPD_WD     0x10
+#define SMB_BLOCK_MAX        32
+// MCP and nForce status: done flag and error code
+#define SMBHSTSTS_NV_DONE    0x80
+#define SMBHSTSTS_NV_ERRORS  0x1F
 
 // XMP memory profile
 #define SPD_XMP_SIG1 176
@@ -141,25 +163,57 @@ UINT8 spd_indexes[] = {
 };
 #define SPD_INDEXES_SIZE (sizeof(spd_indexes) / sizeof(INT8))
 
-/** Read one byte from i2c, used for reading SPD */
+// SPD cache in NVRAM: the bytes we use of every module, keyed by its serial and
+// the SPD checksum. Next boot only the type, the serial and the checksum are
+// read from a slot that matches. Modules without a serial are never cached.
+#define SPD_CACHE_VAR        L"Clover.SPDCache"
+#define SPD_CACHE_DATA_SIZE  128
+
+typedef struct {
+  UINT16  Start;
+  UINT16  Count;
+} SPD_RANGE;
+
+// everything init_spd, getVendorName, getDDRSerial and getDDRPartNum look at, 116 bytes
+SPD_RANGE spd_cache_ranges[] = {
+  {SPD_MEMORY_TYPE, 16},
+  {64, 29},                   /* DDR2 vendor and part number */
+  {95, 4},                    /* DDR2 serial */
+  {SPD_DDR3_MEMORY_BANK, 2},
+  {122, 26},                  /* DDR3 serial and part number */
+  {SPD_XMP_SIG1, 8},
+  {SPD_XMP_PROF1_RATIO, 1},
+  {SPD_XMP_PROF2_RATIO, 1},
+  {SPD_DDR4_MANUFACTURER_ID_CODE, SPD_DDR4_REVISION_CODE - SPD_DDR4_MANUFACTURER_ID_CODE}
+};
+#define SPD_CACHE_RANGES (sizeof(spd_cache_ranges) / sizeof(SPD_RANGE))
 
-UINT8 smb_read_byte(UINT32 base, UINT8 adr, UINT16 cmd)
+typedef struct {
+  UINT8   Slot;
+  UINT8   Type;
+  UINT8   Serial[4];
+  UINT8   Check[2];
+  UINT8   Data[SPD_CACHE_DATA_SIZE];
+} SPD_CACHE_ENTRY;
+
+/** Read one byte from i2c, used for reading SPD.
+ Returns EFI_NOT_FOUND when nobody answers at the address, so empty slots
+ are detected at the address phase instead of waiting for the timeout */
+
+EFI_STATUS smb_transfer_byte(UINT32 base, UINT8 adr, UINT16 cmd, UINT8 *data)
 {
-  //   INTN l1, h1, l2, h2;
-  UINT64 t, t1, t2;
+  UINT64 t1;
+  UINT8  sts;
   
+  *data = 0xFF;
   if (smbIntel) {
     IoWrite8(base + SMBHSTSTS, 0x1f);				// reset SMBus Controller
     IoWrite8(base + SMBHSTDAT, 0xff);
     
-    t1 = AsmReadTsc(); //rdtsc(l1, h1);
-    while ( IoRead8(base + SMBHSTSTS) & 0x01) {   // wait until read
-      t2 = AsmReadTsc(); //rdtsc(l2, h2);
-      t = DivU64x64Remainder((t2 - t1),
-                             DivU64x32(gCPUStructure.TSCFrequency, 1000),
-                             0);
-      if (t > 5)
-        return 0xFF;                  // break
+    t1 = AsmReadTsc();
+    while ( IoRead8(base + SMBHSTSTS) & SMBHSTSTS_BUSY) {   // wait until read
+      if (AsmReadTsc() - t1 > smbTimeout)
+        return EFI_TIMEOUT;                  // break
     }
     
     IoWrite16(base + SMBHSTCMD, cmd);
@@ -167,27 +221,24 @@ UINT8 smb_read_byte(UINT32 base, UINT8 adr, UINT16 cmd)
     IoWrite8(base + SMBHSTCNT, 0x48 );
     
     t1 = AsmReadTsc();
-    
-    while (!( IoRead8(base + SMBHSTSTS) & 0x02)) {	// wait til command finished
-      t2 = AsmReadTsc();
-      t = DivU64x64Remainder((t2 - t1), DivU64x32(gCPUStructure.TSCFrequency, 1000), 0);
-      if (t > 5)
+    // wait til command finished or failed
+    while (!((sts = IoRead8(base + SMBHSTSTS)) & (SMBHSTSTS_INTR | SMBHSTSTS_ERRORS))) {
+      if (AsmReadTsc() - t1 > smbTimeout)
         break;									// break after 5ms
     }
-    return IoRead8(base + SMBHSTDAT);
+    if (sts & SMBHSTSTS_DEV_ERR) {
+      return EFI_NOT_FOUND;           // no ACK
+    }
+    *data = IoRead8(base + SMBHSTDAT);
   }
   else {
     IoWrite8(base + SMBHSTSTS_NV, 0x1f);			// reset SMBus Controller
     IoWrite8(base + SMBHSTDAT_NV, 0xff);
     
-    t1 = AsmReadTsc(); //rdtsc(l1, h1);
+    t1 = AsmReadTsc();
     while ( IoRead8(base + SMBHSTSTS_NV) & 0x01) {    // wait until read
-      t2 = AsmReadTsc(); //rdtsc(l2, h2);
-      t = DivU64x64Remainder((t2 - t1),
-                             DivU64x32(gCPUStructure.TSCFrequency, 1000),
-                             0);
-      if (t > 5)
-        return 0xFF;                  // break
+      if (AsmReadTsc() - t1 > smbTimeout)
+        return EFI_TIMEOUT;                  // break
     }
     
     IoWrite8(base + SMBHSTSTS_NV, 0x00); // clear status register
@@ -196,34 +247,134 @@ UINT8 smb_read_byte(UINT32 base, UINT8 adr, UINT16 cmd)
     IoWrite8(base + SMBHPRTCL_NV, 0x07 );
     t1 = AsmReadTsc();
     
-    while (!( IoRead8(base + SMBHSTSTS_NV) & 0x9F)) {		// wait till command finished
-      t2 = AsmReadTsc();
-      t = DivU64x64Remainder((t2 - t1),
-                             DivU64x32(gCPUStructure.TSCFrequency, 1000),
-                             0);
-      if (t > 5)
+    while (!((sts = IoRead8(base + SMBHSTSTS_NV)) & (SMBHSTSTS_NV_DONE | SMBHSTSTS_NV_ERRORS))) {		// wait till command finished
+      if (AsmReadTsc() - t1 > smbTimeout)
         break; // break after 5ms
     }
-    return IoRead8(base + SMBHSTDAT_NV);
+    if (sts & SMBHSTSTS_NV_ERRORS) {
+      return EFI_NOT_FOUND;
+    }
+    *data = IoRead8(base + SMBHSTDAT_NV);
+  }
+  return EFI_SUCCESS;
+}
+
+UINT8 smb_read_byte(UINT32 base, UINT8 adr, UINT16 cmd)
+{
+  UINT8 data;
+  smb_transfer_byte(base, adr, cmd, &data);
+  return data;
+}
+
+/** Read up to SMB_BLOCK_MAX consecutive bytes in one I2C block transaction.
+ Intel only, byte-by-byte mode of the host controller as in ICH5+ datasheets */
+EFI_STATUS smb_read_block(UINT32 base, UINT8 adr, UINT8 cmd, UINT8 *buf, UINTN count)
+{
+  UINT64 t1;
+  UINT8  sts = 0;
+  UINTN  i;
+  
+  if (!smbIntel || count == 0 || count > SMB_BLOCK_MAX) {
+    return EFI_UNSUPPORTED;
+  }
+  t1 = AsmReadTsc();
+  while (IoRead8(base + SMBHSTSTS) & SMBHSTSTS_BUSY) {
+    if (AsmReadTsc() - t1 > smbTimeout)
+      return EFI_TIMEOUT;
+  }
+  IoWrite8(base + SMBHSTSTS, SMBHSTSTS_BYTE_DONE | SMBHSTSTS_INTR | SMBHSTSTS_ERRORS);
+  IoWrite8(base + SMBAUXCTL, IoRead8(base + SMBAUXCTL) & ~SMBAUXCTL_E32B); // no 32-byte buffer
+  // R/W bit must be clear for I2C read per ICH5 datasheet, but set when SPD write is disabled
+  IoWrite8(base + SMBHSTADD, (adr << 1) | (smbSpdWd ? 0x01 : 0x00));
+  IoWrite8(base + SMBHSTDAT1, cmd);            // DATA1 is the offset for I2C read
+  IoWrite8(base + SMBHSTCNT, SMBHSTCNT_START | SMBHSTCNT_I2C_BLOCK);
+  
+  for (i = 0; i < count; i++) {
+    if (i == count - 1) {
+      IoWrite8(base + SMBHSTCNT, SMBHSTCNT_I2C_BLOCK | SMBHSTCNT_LAST_BYTE);
+    }
+    t1 = AsmReadTsc();
+    while (!((sts = IoRead8(base + SMBHSTSTS)) & (SMBHSTSTS_BYTE_DONE | SMBHSTSTS_ERRORS))) {
+      if (AsmReadTsc() - t1 > smbTimeout)
+        break;
+    }
+    if (!(sts & SMBHSTSTS_BYTE_DONE) || (sts & SMBHSTSTS_ERRORS)) {
+      IoWrite8(base + SMBHSTSTS, SMBHSTSTS_BYTE_DONE | SMBHSTSTS_INTR | SMBHSTSTS_ERRORS);
+      return EFI_DEVICE_ERROR;
+    }
+    buf[i] = IoRead8(base + SBMBLKDAT);
+    IoWrite8(base + SMBHSTSTS, SMBHSTSTS_BYTE_DONE);  // next byte
   }
+  
+  t1 = AsmReadTsc();
+  while (!((sts = IoRead8(base + SMBHSTSTS)) & (SMBHSTSTS_INTR | SMBHSTSTS_ERRORS))) {
+    if (AsmReadTsc() - t1 > smbTimeout)
+      break;
+  }
+  IoWrite8(base + SMBHSTSTS, SMBHSTSTS_BYTE_DONE | SMBHSTSTS_INTR | SMBHSTSTS_ERRORS);
+  return (sts & SMBHSTSTS_INTR) ? EFI_SUCCESS : EFI_DEVICE_ERROR;
 }
 
 /* SPD i2c read optimization: prefetch only what we need, read non prefetcheable bytes on the fly */
-#define READ_SPD(spd, base, slot, x) spd[x] = smb_read_byte(base, 0x50 + slot, x)
+#define READ_SPD(spd, base, slot, x) if (!spdCached) spd[x] = smb_read_byte(base, 0x50 + slot, x)
+
+/** Read spd[start..start+count-1], by I2C blocks where the controller can do it.
+ Offsets above 255 are on the second DDR4 page, they keep the byte reads */
+VOID read_spd_range(UINT8* spd, UINT32 base, UINT8 slot, UINT16 start, UINT16 count)
+{
+  UINT16 n, i;
+  
+  if (spdCached) {
+    return;
+  }
+  while (count > 0) {
+    n = (count > SMB_BLOCK_MAX) ? SMB_BLOCK_MAX : count;
+    if (smbBlock && (start + n <= 256) &&
+        EFI_ERROR(smb_read_block(base, 0x50 + slot, (UINT8)start, &spd[start], n))) {
+      DBG("SMBus block read failed, back to byte reads\n");
+      smbBlock = FALSE;
+    }
+    if (!smbBlock || (start + n > 256)) {
+      for (i = start; i < start + n; i++) {
+        READ_SPD(spd, base, slot, i);
+      }
+    }
+    start += n;
+    count -= n;
+  }
+}
 
 
 /** Read from spd *used* values only*/
 VOID init_spd(UINT8* spd, UINT32 base, UINT8 slot)
 {
-	INTN i;
+	INTN    i;
+	UINT16  start, end;
+	BOOLEAN wanted[256];
+
+	ZeroMem(wanted, sizeof(wanted));
 	for (i=0; i< SPD_INDEXES_SIZE; i++) {
-		READ_SPD(spd, base, slot, spd_indexes[i]);
+		wanted[spd_indexes[i]] = TRUE;
+  }
+  // read runs of wanted bytes; with block reads a couple of unused bytes
+  // are cheaper than a new transaction
+  for (i = 0; i < 256; i++) {
+    if (!wanted[i]) {
+      continue;
+    }
+    start = (UINT16)i;
+    end = start + 1;
+    while ((end < 256) &&
+           (wanted[end] || (smbBlock && (end + 2 < 256) && (wanted[end + 1] || wanted[end + 2])))) {
+      end++;
+    }
+    read_spd_range(spd, base, slot, start, end - start);
+    i = end;
   }
 
   if (spd[SPD_MEMORY_TYPE] == SPD_MEMORY_TYPE_SDRAM_DDR4) {
-    for (i = SPD_DDR4_MANUFACTURER_ID_CODE; i < SPD_DDR4_REVISION_CODE; i++) {
-      READ_SPD(spd, base, slot, (UINT16)i);
-    }
+    read_spd_range(spd, base, slot, SPD_DDR4_MANUFACTURER_ID_CODE,
+                   SPD_DDR4_REVISION_CODE - SPD_DDR4_MANUFACTURER_ID_CODE);
   }
 
 }
@@ -427,6 +578,7 @@ CHAR8* getDDRPartNum(UINT8* spd, UINT32 base, UINT8 slot)
 {
   UINT16 i, start=0, index = 0;
   CHAR8 c;
+  BOOLEAN prefetched;
 	CHAR8* asciiPartNo = AllocatePool(32); //[32];
 
   if (spd[SPD_MEMORY_TYPE] == SPD_MEMORY_TYPE_SDRAM_DDR4) {
@@ -440,8 +592,15 @@ CHAR8* getDDRPartNum(UINT8* spd, UINT32 base, UINT8 slot)
 	
   // Check that the spd part name is zero terminated and that it is ascii:
   ZeroMem(asciiPartNo, 32);  //sizeof(asciiPartNo));
+  // one block read is faster than stopping early at the end of the name
+  prefetched = smbBlock && (start + 20 <= 256);
+  if (prefetched) {
+    read_spd_range(spd, base, slot, start, 20);
+  }
 	for (i = start; i < start + 20; i++) {
-		READ_SPD(spd, base, slot, (UINT8)i); // only read once the corresponding model part (ddr3 or ddr2)
+    if (!prefetched) {
+      READ_SPD(spd, base, slot, (UINT8)i); // only read once the corresponding model part (ddr3 or ddr2)
+    }
 		c = spd[i];
 		if (IS_ALFA(c) || IS_DIGIT(c) || IS_PUNCT(c)) // It seems that System Profiler likes only letters and digits...
 			asciiPartNo[index++] = c;
@@ -452,6 +611,64 @@ CHAR8* getDDRPartNum(UINT8* spd, UINT32 base, UINT8 slot)
 	return asciiPartNo;
 }
 
+/** Offset of the 4 byte module serial number, 0 if we don't know the type */
+UINT16 getSerialOffset(UINT8 type)
+{
+  switch (type) {
+    case SPD_MEMORY_TYPE_SDRAM_DDR4:
+      return 325;
+    case SPD_MEMORY_TYPE_SDRAM_DDR3:
+      return 122;
+    case SPD_MEMORY_TYPE_SDRAM_DDR2:
+    case SPD_MEMORY_TYPE_SDRAM_DDR:
+      return 95;
+    default:
+      return 0;
+  }
+}
+
+/** Offset of the 2 checksum bytes: the CRC for DDR3 and DDR4, the SPD revision
+ and the checksum of bytes 0-62 for DDR and DDR2 */
+UINT16 getCheckOffset(UINT8 type)
+{
+  switch (type) {
+    case SPD_MEMORY_TYPE_SDRAM_DDR4:
+    case SPD_MEMORY_TYPE_SDRAM_DDR3:
+      return 126;
+    case SPD_MEMORY_TYPE_SDRAM_DDR2:
+    case SPD_MEMORY_TYPE_SDRAM_DDR:
+      return 62;
+    default:
+      return 0;
+  }
+}
+
+/** A serial of all 00 or all FF is not programmed, it can't tell modules apart */
+BOOLEAN isCacheableSerial(UINT8* serial)
+{
+  UINTN i;
+  BOOLEAN allZero = TRUE, allOnes = TRUE;
+  for (i = 0; i < 4; i++) {
+    allZero = allZero && (serial[i] == 0x00);
+    allOnes = allOnes && (serial[i] == 0xFF);
+  }
+  return !allZero && !allOnes;
+}
+
+/** Copy cached ranges between spd buffer and cache entry */
+VOID packSpdCache(SPD_CACHE_ENTRY* entry, UINT8* spd, BOOLEAN toCache)
+{
+  UINTN i, pos = 0;
+  for (i = 0; i < SPD_CACHE_RANGES; i++) {
+    if (toCache) {
+      CopyMem(&entry->Data[pos], &spd[spd_cache_ranges[i].Start], spd_cache_ranges[i].Count);
+    } else {
+      CopyMem(&spd[spd_cache_ranges[i].Start], &entry->Data[pos], spd_cache_ranges[i].Count);
+    }
+    pos += spd_cache_ranges[i].Count;
+  }
+}
+
 //INTN mapping []= {0,2,1,3,4,6,5,7,8,10,9,11};
 #define PCI_COMMAND_OFFSET                          0x04
 
@@ -469,6 +686,13 @@ VOID read_smb(EFI_PCI_IO_PROTOCOL *PciIo)
 	UINT16			vid, did;
 	
     UINT8                  TotalSlotsCount;
+  SPD_CACHE_ENTRY*  OldCache;
+  SPD_CACHE_ENTRY*  NewCache;
+  UINTN             OldCount = 0;
+  UINTN             NewCount = 0;
+  UINTN             CacheSize = 0;
+  UINTN             j;
+  UINT16            serial, check;
 
 	vid = gPci.Hdr.VendorId;
 	did = gPci.Hdr.DeviceId;
@@ -534,10 +758,19 @@ VOID read_smb(EFI_PCI_IO_PROTOCOL *PciIo)
   MsgLog("Scanning SMBus [%04x:%04x], mmio: 0x%x, ioport: 0x%x, hostc: 0x%x\n",
          vid, did, mmio, base, hostc);
   
+  smbTimeout = DivU64x32(gCPUStructure.TSCFrequency, 200); //5ms
+  smbBlock = smbIntel;  // cleared at the first failed block read
+  smbSpdWd = ((hostc & SMBHSTCFG_SPD_WD) != 0);
+  
 	// needed at least for laptops
   //fullBanks = (gDMI->MemoryModules == gDMI->CntMemorySlots);
   
 	spdbuf = AllocateZeroPool(MAX_SPD_SIZE);
+  
+  OldCache = GetNvramVariable(SPD_CACHE_VAR, &gCloverCacheVariableGuid, NULL, &CacheSize);
+  if (OldCache != NULL && (CacheSize % sizeof(SPD_CACHE_ENTRY)) == 0) {
+    OldCount = CacheSize / sizeof(SPD_CACHE_ENTRY);
+  }
 	
   // Search MAX_RAM_SLOTS slots
   //==>
@@ -547,11 +780,33 @@ VOID read_smb(EFI_PCI_IO_PROTOCOL *PciIo)
   } */
   TotalSlotsCount = 8; //MAX_RAM_SLOTS;  -- spd can read only 8 slots
   DBG("Slots to scan [%d]...\n", TotalSlotsCount);
+  NewCache = AllocateZeroPool(TotalSlotsCount * sizeof(SPD_CACHE_ENTRY));
   for (i = 0; i <  TotalSlotsCount; i++){
   //<==
     ZeroMem(spdbuf, MAX_SPD_SIZE);
-    READ_SPD(spdbuf, base, i, SPD_MEMORY_TYPE);
-    if (spdbuf[SPD_MEMORY_TYPE] == 0xFF) continue;
+    spdCached = FALSE;
+    // empty slot doesn't ACK, no need to wait for a timeout
+    if (EFI_ERROR(smb_transfer_byte(base, 0x50 + i, SPD_MEMORY_TYPE, &spdbuf[SPD_MEMORY_TYPE])) ||
+        (spdbuf[SPD_MEMORY_TYPE] == 0xFF)) {
+      continue;
+    }
+    // same module as the last boot? then only its serial and checksum are read
+    serial = getSerialOffset(spdbuf[SPD_MEMORY_TYPE]);
+    check = getCheckOffset(spdbuf[SPD_MEMORY_TYPE]);
+    for (j = 0; serial && j < OldCount; j++) {
+      if ((OldCache[j].Slot == i) && (OldCache[j].Type == spdbuf[SPD_MEMORY_TYPE])) {
+        read_spd_range(spdbuf, base, i, serial, 4);
+        read_spd_range(spdbuf, base, i, check, 2);
+        if (isCacheableSerial(&spdbuf[serial]) &&
+            CompareMem(&spdbuf[serial], OldCache[j].Serial, 4) == 0 &&
+            CompareMem(&spdbuf[check], OldCache[j].Check, 2) == 0) {
+          packSpdCache(&OldCache[j], spdbuf, FALSE);
+          spdCached = TRUE;
+          DBG("SPD[%d]: serial matches, using cached data\n", i);
+        }
+        break;
+      }
+    }
     // Copy spd data into buffer
     init_spd(spdbuf, base, i);
     DBG("SPD[%d]: Type %d @0x%x \n", i, spdbuf[SPD_MEMORY_TYPE], 0x50 + i);
@@ -635,6 +890,18 @@ VOID read_smb(EFI_PCI_IO_PROTOCOL *PciIo)
     
     gRAM.SPD[i].InUse = TRUE;
     ++(gRAM.SPDInUse);
+    
+    serial = getSerialOffset(spdbuf[SPD_MEMORY_TYPE]);
+    check = getCheckOffset(spdbuf[SPD_MEMORY_TYPE]);
+    if (NewCache != NULL && serial && isCacheableSerial(&spdbuf[serial])) {
+      read_spd_range(spdbuf, base, i, check, 2);
+      NewCache[NewCount].Slot = i;
+      NewCache[NewCount].Type = spdbuf[SPD_MEMORY_TYPE];
+      CopyMem(NewCache[NewCount].Serial, &spdbuf[serial], 4);
+      CopyMem(NewCache[NewCount].Check, &spdbuf[check], 2);
+      packSpdCache(&NewCache[NewCount], spdbuf, TRUE);
+      NewCount++;
+    }
     //}
     
     // laptops sometimes show slot 0 and 2 with slot 1 empty when only 2 slots are presents so:
@@ -643,6 +910,21 @@ VOID read_smb(EFI_PCI_IO_PROTOCOL *PciIo)
 		//slot->spd = NULL;
     
   } // for
+  spdCached = FALSE;
+  
+  // SetNvramVariable doesn't write if nothing changed
+  if (NewCount > 0) {
+    SetNvramVariable(SPD_CACHE_VAR, &gCloverCacheVariableGuid,
+                     EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+                     NewCount * sizeof(SPD_CACHE_ENTRY), NewCache);
+  }
+  if (NewCache != NULL) {
+    FreePool(NewCache);
+  }
+  if (OldCache != NULL) {
+    FreePool(OldCache);
+  }
+  FreePool(spdbuf);
 }
 
 VOID ScanSPD()
@@ -0,0 +1,222 @@
+/**
+ * \file smbflat.c
+ * Test of the flat SMBIOS table helpers in the POSIX user space environment.
+ *
+ * Structures are generated from a seed: a formatted area with string
+ * fields, a string-set, and random updates of the fields, some of them
+ * with empty strings. The structure written by LogSmbiosTable() must be
+ * well formed and every field must name the string a simple model of the
+ * updates expects. The index of the structures must give the same
+ * results as the walk of the table.
+ */
+
+#include <stdio.h>
+#include <sys/mman.h>
+
+#include "SmbiosFlat.h"
+
+#define FIELDS      6
+#define MAX_STRINGS 40
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: seed %d: failed: %s\n", __FILE__, __LINE__, seed, #cond); failures++; return; } } while (0)
+
+static void random_string(char *s, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        s[i] = 'A' + rand() % 26;
+    s[len] = 0;
+}
+
+/* string-set of the structure at p is well formed and has no empty string inside */
+static int string_set_count(UINT8 *p, UINTN *length)
+{
+    SMBIOS_STRUCTURE_POINTER t;
+    CHAR8 *s;
+    int n = 0;
+
+    t.Raw = p;
+    s = (CHAR8 *)(p + t.Hdr->Length);
+    if (s[0] == 0) {
+        *length = t.Hdr->Length + 2;
+        return s[1] == 0 ? 0 : -1;
+    }
+    while (*s != 0) {
+        s += strlen(s) + 1;
+        n++;
+    }
+    *length = (UINTN)((UINT8 *)s + 1 - p);
+    return n;
+}
+
+static void test_string_pool(int seed)
+{
+    static UINT8 table[MAX_TABLE_SIZE], out[4096];
+    static char strings[MAX_STRINGS][SMBIOS_STRING_MAX_LENGTH + 1];
+    char update[SMBIOS_STRING_MAX_LENGTH + 1];
+    SMBIOS_STRUCTURE_POINTER t, o;
+    UINT8 *p, length;
+    int count, updates, i, f, len, k;
+    UINTN outlen;
+
+    srand(seed);
+    memset(table, 0, sizeof(table));
+    t.Raw = table;
+    t.Hdr->Type = 1 + rand() % 40;
+    length = sizeof(SMBIOS_TABLE_HEADER) + FIELDS + rand() % 8;
+    t.Hdr->Length = length;
+    t.Hdr->Handle = (UINT16)seed;
+    for (i = sizeof(SMBIOS_TABLE_HEADER) + FIELDS; i < length; i++)
+        table[i] = (UINT8)rand();
+
+    /* original strings, fields may refer to a string twice or past the end */
+    count = rand() % 6;
+    p = table + length;
+    for (i = 0; i < count; i++) {
+        random_string(strings[i], 1 + rand() % 20);
+        strcpy((char *)p, strings[i]);
+        p += strlen(strings[i]) + 1;
+    }
+    if (count == 0)
+        *p++ = 0;
+    *p++ = 0;
+    for (f = 0; f < FIELDS; f++)
+        table[sizeof(SMBIOS_TABLE_HEADER) + f] = (UINT8)(rand() % (count + 2));
+
+    /* updates, applied to the model too */
+    mPoolOwner = NULL;
+    updates = rand() % 12;
+    for (k = 0; k < updates; k++) {
+        SMBIOS_TABLE_STRING *field;
+
+        f = rand() % FIELDS;
+        field = &table[sizeof(SMBIOS_TABLE_HEADER) + f];
+        len = (rand() % 3 == 0) ? 0 : 1 + rand() % SMBIOS_STRING_MAX_LENGTH;
+        random_string(update, len);
+        CHECK(UpdateSmbiosString(t, field, update) == EFI_SUCCESS);
+        if (len == 0) {
+            CHECK(*field == 0);
+        } else if (*field >= 1 && *field <= count) {
+            strcpy(strings[*field - 1], update);
+        } else {
+            CHECK(*field == count + 1);
+            strcpy(strings[count++], update);
+        }
+    }
+
+    memset(out, 0xAA, sizeof(out));
+    Current = out;
+    NumberOfRecords = 0;
+    MaxStructureSize = 0;
+    CHECK(LogSmbiosTable(t) == (UINT16)seed);
+    CHECK(NumberOfRecords == 1);
+
+    o.Raw = out;
+    CHECK(memcmp(out, table, length) == 0);
+    CHECK(string_set_count(out, &outlen) >= 0);
+    CHECK(outlen == (UINTN)(Current - out));
+    CHECK(outlen == SmbiosTableLength(o));
+    CHECK(MaxStructureSize == outlen);
+    if (updates == 0) {
+        CHECK(memcmp(out, table, outlen) == 0);
+    }
+    for (f = 0; f < FIELDS; f++) {
+        k = out[sizeof(SMBIOS_TABLE_HEADER) + f];
+        if (k == 0 || k > count)
+            continue;
+        CHECK(strcmp(GetSmbiosString(o, (SMBIOS_TABLE_STRING)k), strings[k - 1]) == 0);
+    }
+}
+
+#define INDEX_TABLE_SIZE 16384
+
+/* TableAddress of the entry point is 32 bit */
+static UINT8 *low_table(void)
+{
+    UINT8 *table = NULL;
+
+#ifdef MAP_32BIT
+    table = mmap(NULL, INDEX_TABLE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (table == MAP_FAILED)
+        table = NULL;
+#else
+    table = malloc(INDEX_TABLE_SIZE);
+#endif
+    if (table != NULL && (UINTN)(UINT32)(UINTN)table != (UINTN)table)
+        table = NULL;
+    return table;
+}
+
+static void test_index(UINT8 *table, int seed)
+{
+    static SMBIOS_TABLE_ENTRY_POINT eps, other;
+    SMBIOS_STRUCTURE_POINTER a, b;
+    UINT8 *p;
+    int n, i, type, index;
+
+    srand(seed);
+    memset(table, 0, INDEX_TABLE_SIZE);
+    p = table;
+    n = rand() % 60;
+    for (i = 0; i < n; i++) {
+        SMBIOS_STRUCTURE_POINTER t;
+
+        t.Raw = p;
+        t.Hdr->Type = (rand() % 4 == 0) ? 17 : rand() % 140;
+        if (t.Hdr->Type == SMBIOS_TYPE_END_OF_TABLE)
+            t.Hdr->Type = 1;
+        t.Hdr->Length = sizeof(SMBIOS_TABLE_HEADER) + rand() % 30;
+        t.Hdr->Handle = (UINT16)i;
+        p += t.Hdr->Length;
+        if (rand() % 2) {
+            strcpy((char *)p, "String");
+            p += 7;
+        } else {
+            *p++ = 0;
+        }
+        *p++ = 0;
+    }
+    ((SMBIOS_TABLE_HEADER *)p)->Type = SMBIOS_TYPE_END_OF_TABLE;
+    ((SMBIOS_TABLE_HEADER *)p)->Length = sizeof(SMBIOS_TABLE_HEADER);
+    p += sizeof(SMBIOS_TABLE_HEADER) + 2;
+
+    eps.TableAddress = (UINT32)(UINTN)table;
+    eps.TableLength = (seed % 3 == 0) ? 0 : (UINT16)(p - table);
+    other = eps;
+    IndexSmbiosTables(&eps);
+
+    /* the index answers for eps, the other entry point walks the table */
+    for (type = 0; type < 256; type++) {
+        for (index = 0; index < 20; index++) {
+            a = GetSmbiosTableFromType(&eps, (UINT8)type, index);
+            b = GetSmbiosTableFromType(&other, (UINT8)type, index);
+            CHECK(a.Raw == b.Raw);
+        }
+    }
+}
+
+int main(void)
+{
+    UINT8 *table;
+    int seed;
+
+    for (seed = 0; seed < 100000; seed++)
+        test_string_pool(seed);
+    table = low_table();
+    if (table != NULL) {
+        for (seed = 0; seed < 2000; seed++)
+            test_index(table, seed);
+    } else {
+        printf("index test skipped, no memory below 4GB\n");
+    }
+
+    if (failures != 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("all passed\n");
+    return 0;
+}
@@ -0,0 +1,56 @@
+/**
+ * \file smbios_posix_base.h
+ * Base definitions for building SmbiosFlat.c in the POSIX user space environment.
+ */
+
+#ifndef _SMBIOS_POSIX_BASE_H_
+#define _SMBIOS_POSIX_BASE_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IN
+#define OUT
+
+typedef uint8_t     BOOLEAN;
+typedef uint8_t     UINT8;
+typedef uint16_t    UINT16;
+typedef uint32_t    UINT32;
+typedef uint64_t    UINT64;
+typedef uintptr_t   UINTN;
+typedef char        CHAR8;
+typedef void        VOID;
+typedef UINTN       EFI_STATUS;
+
+typedef struct {
+    UINT32  Data1;
+    UINT16  Data2;
+    UINT16  Data3;
+    UINT8   Data4[8];
+} EFI_GUID;
+
+#define TRUE        1
+#define FALSE       0
+#define MAX_UINT16  0xFFFF
+
+#define EFI_SUCCESS             0
+#define EFI_BUFFER_TOO_SMALL    ((EFI_STATUS)1 << (sizeof(EFI_STATUS) * 8 - 1) | 5)
+#define EFI_NOT_FOUND           ((EFI_STATUS)1 << (sizeof(EFI_STATUS) * 8 - 1) | 14)
+
+#include <IndustryStandard/SmbiosA.h>
+
+typedef UINT16      EFI_SMBIOS_HANDLE;
+
+#define DBG(...)
+
+#define CopyMem(Destination, Source, Length)    memmove(Destination, Source, Length)
+#define ZeroMem(Buffer, Length)                 memset(Buffer, 0, Length)
+#define AllocatePool(AllocationSize)            malloc(AllocationSize)
+#define FreePool(Buffer)                        free(Buffer)
+#define AsciiStrLen(String)                     strlen(String)
+
+/* Platform.h */
+UINTN iStrLen(CHAR8* String, UINTN MaxLen);
+
+#endif
@@ -128,6 +128,143 @@ EG_IMAGE* ScanVolumeDefaultIcon(REFIT_VOLUME *Volume, IN UINT8 OSType) //IN UINT
   return NULL;
 }
 
+//
+// Icons of the main menu entries are decoded when they are drawn; only the
+// ENTRY_IMAGES_MAX entries drawn last keep them, older ones are freed and
+// decoded again from their ENTRY_IMAGES record if they come back to the
+// screen. The bound is well above the entries a main menu shows at once, so
+// scrolling doesn't decode them again, and a menu with hundreds of entries
+// doesn't keep hundreds of icons.
+//
+
+#define ENTRY_IMAGES_MAX 64
+
+typedef struct {
+  REFIT_MENU_ENTRY *Entry;
+  BOOLEAN           OwnsImage;   //Entry->Image was decoded here, not given by the caller
+} LOADED_ENTRY_IMAGES;
+
+STATIC LOADED_ENTRY_IMAGES mImageEntries[ENTRY_IMAGES_MAX];   // most recently drawn first
+STATIC UINTN               mImageEntryCount = 0;
+
+STATIC VOID FreeEntryImagesRecord(IN REFIT_MENU_ENTRY *Entry)
+{
+  if (Entry->Images->OSIconName != NULL) {
+    FreePool(Entry->Images->OSIconName);
+  }
+  FreePool(Entry->Images);
+  Entry->Images = NULL;
+}
+
+STATIC VOID DropEntryImages(IN LOADED_ENTRY_IMAGES *Loaded)
+{
+  REFIT_MENU_ENTRY *Entry = Loaded->Entry;
+
+  if ((Entry->SubScreen != NULL) && (Entry->SubScreen->TitleImage == Entry->Image)) {
+    Entry->SubScreen->TitleImage = NULL;
+  }
+  if (Loaded->OwnsImage && (Entry->Image != NULL)) {
+    egFreeImage(Entry->Image);
+  }
+  Entry->Image = NULL;
+  if (Entry->BadgeImage != NULL) {
+    egFreeImage(Entry->BadgeImage);
+    Entry->BadgeImage = NULL;
+  }
+}
+
+VOID LoadEntryImages(IN REFIT_MENU_ENTRY *Entry)
+{
+  ENTRY_IMAGES        *Images;
+  LOADED_ENTRY_IMAGES Loaded;
+  UINTN               Index;
+
+  if ((Entry == NULL) || (Entry->Images == NULL)) {
+    return;
+  }
+  // custom sub entries with their own sub screen are never drawn as icons,
+  // their sub screen still wants its title image. They go first, so they
+  // can't push the entry being drawn out of the list.
+  if (Entry->SubScreen != NULL) {
+    for (Index = 0; Index < (UINTN)Entry->SubScreen->EntryCount; Index++) {
+      if (Entry->SubScreen->Entries[Index]->SubScreen != NULL) {
+        LoadEntryImages(Entry->SubScreen->Entries[Index]);
+      }
+    }
+  }
+
+  for (Index = 0; Index < mImageEntryCount; Index++) {
+    if (mImageEntries[Index].Entry == Entry) {
+      break;
+    }
+  }
+  if (Index < mImageEntryCount) {
+    Loaded = mImageEntries[Index];
+  } else {
+    if (mImageEntryCount == ENTRY_IMAGES_MAX) {
+      DropEntryImages(&mImageEntries[--mImageEntryCount]);
+    }
+    Index = mImageEntryCount++;
+    Loaded.Entry = Entry;
+    Loaded.OwnsImage = TRUE;
+
+    Images = Entry->Images;
+    if (Images->VolumeIcon && VolumeFileExists(Images->Volume, L"\\.VolumeIcon.icns")) {
+      Entry->Image = LoadIcns(Images->Volume->RootDir, L"\\.VolumeIcon.icns", 128);
+      DBG("using VolumeIcon.icns image from Volume\n");
+    } else if (Images->Image != NULL) {
+      Entry->Image = Images->Image;
+      Loaded.OwnsImage = FALSE;
+    } else {
+      Entry->Image = LoadOSIcon(Images->OSIconName, Images->FallbackIconName, 128, FALSE, TRUE);
+    }
+    if (Entry->DriveImage == NULL) {
+      Entry->DriveImage = (Images->DriveImage != NULL) ? Images->DriveImage : ScanVolumeDefaultIcon(Images->Volume, Images->OSType);
+    }
+    if (GlobalConfig.HideBadges & HDBADGES_SHOW) {
+      if (GlobalConfig.HideBadges & HDBADGES_SWAP) {
+        Entry->BadgeImage = egCopyScaledImage(Entry->DriveImage, GlobalConfig.BadgeScale);
+      } else {
+        Entry->BadgeImage = egCopyScaledImage(Entry->Image, GlobalConfig.BadgeScale);
+      }
+    }
+    if ((Entry->SubScreen != NULL) && (Entry->SubScreen->TitleImage == NULL)) {
+      Entry->SubScreen->TitleImage = Entry->Image;
+    }
+  }
+  // move to the front
+  if (Index > 0) {
+    CopyMem(&mImageEntries[1], &mImageEntries[0], Index * sizeof(LOADED_ENTRY_IMAGES));
+  }
+  mImageEntries[0] = Loaded;
+}
+
+STATIC VOID FreeScreenEntryImagesRecords(IN REFIT_MENU_SCREEN *Screen)
+{
+  REFIT_MENU_ENTRY *Entry;
+  INTN             Index;
+
+  for (Index = 0; Index < Screen->EntryCount; Index++) {
+    Entry = Screen->Entries[Index];
+    if (Entry->Images != NULL) {
+      FreeEntryImagesRecord(Entry);
+    }
+    if (Entry->SubScreen != NULL) {
+      FreeScreenEntryImagesRecords(Entry->SubScreen);
+    }
+  }
+}
+
+// Free the icons and the records of all entries, before the main menu is
+// emptied and built again
+VOID FreeEntryImages(VOID)
+{
+  while (mImageEntryCount > 0) {
+    DropEntryImages(&mImageEntries[--mImageEntryCount]);
+  }
+  FreeScreenEntryImagesRecords(&MainMenu);
+}
+
 extern BOOLEAN CopyKernelAndKextPatches(IN OUT KERNEL_AND_KEXT_PATCHES *Dst, IN KERNEL_AND_KEXT_PATCHES *Src);
 
 LOADER_ENTRY * DuplicateLoaderEntry(IN LOADER_ENTRY *Entry)
@@ -124,12 +124,20 @@ static LEGACY_ENTRY * AddLegacyEntry(IN CHAR16 *FullTitle, IN CHAR16 *LoaderTitl
   Entry->me.Tag          = TAG_LEGACY;
   Entry->me.Row          = 0;
   Entry->me.ShortcutLetter = (Hotkey == 0) ? ShortcutLetter : Hotkey;
-  if (Image) {
+  // icons are loaded when the entry is drawn
+  Entry->me.Images = AllocateZeroPool(sizeof(ENTRY_IMAGES));
+  if (Entry->me.Images == NULL) {
+    // no record, the entry is drawn with the images given by the caller only
     Entry->me.Image = Image;
+    Entry->me.DriveImage = DriveImage;
   } else {
-    Entry->me.Image = LoadOSIcon(Volume->LegacyOS->IconName, L"legacy", 128, FALSE, TRUE);
+    Entry->me.Images->Volume = Volume;
+    Entry->me.Images->Image = Image;
+    Entry->me.Images->DriveImage = DriveImage;
+    Entry->me.Images->OSIconName = (Volume->LegacyOS->IconName != NULL) ? EfiStrDuplicate(Volume->LegacyOS->IconName) : NULL;
+    Entry->me.Images->FallbackIconName = L"legacy";
+    Entry->me.Images->OSType = Volume->LegacyOS->Type;
   }
-  Entry->me.DriveImage = (DriveImage != NULL) ? DriveImage : ScanVolumeDefaultIcon(Volume, Volume->LegacyOS->Type);
   //  DBG("HideBadges=%d Volume=%s\n", GlobalConfig.HideBadges, Volume->VolName);
   //  DBG("Title=%s OSName=%s OSIconName=%s\n", LoaderTitle, Volume->OSName, Volume->OSIconName);
   
@@ -138,14 +146,6 @@ static LEGACY_ENTRY * AddLegacyEntry(IN CHAR16 *FullTitle, IN CHAR16 *LoaderTitl
   Entry->me.AtDoubleClick = ActionEnter;
   Entry->me.AtRightClick = ActionDetails;
   
-  if (GlobalConfig.HideBadges & HDBADGES_SHOW) {
-    if (GlobalConfig.HideBadges & HDBADGES_SWAP) {
-      Entry->me.BadgeImage = egCopyScaledImage(Entry->me.DriveImage, GlobalConfig.BadgeScale);
-    } else {
-      Entry->me.BadgeImage = egCopyScaledImage(Entry->me.Image, GlobalConfig.BadgeScale);
-    }
-  }
-  
   Entry->Volume           = Volume;
   Entry->DevicePathString = Volume->DevicePathString;
   Entry->LoadOptions      = (Volume->DiskKind == DISK_KIND_OPTICAL) ? L"CD" :
@@ -0,0 +1,157 @@
+/*
+ * refit/scan/linuxboot.c
+ *
+ * Lookups in the index of \boot of a Linux volume, built by loader.c.
+ * Names are compared exactly: \boot is usually on a case sensitive
+ * filesystem, where initrd.img-X and Initrd.img-X are different files.
+ */
+
+#include "linuxboot.h"
+
+STATIC INTN TimeCmp(IN EFI_TIME *Time1,
+                    IN EFI_TIME *Time2)
+{
+   INTN Comparison;
+   if (Time1 == NULL) {
+     if (Time2 == NULL) {
+       return 0;
+     } else {
+       return -1;
+     }
+   } else if (Time2 == NULL) {
+     return 1;
+   }
+   Comparison = Time1->Year - Time2->Year;
+   if (Comparison == 0) {
+     Comparison = Time1->Month - Time2->Month;
+     if (Comparison == 0) {
+       Comparison = Time1->Day - Time2->Day;
+       if (Comparison == 0) {
+         Comparison = Time1->Hour - Time2->Hour;
+         if (Comparison == 0) {
+           Comparison = Time1->Minute - Time2->Minute;
+           if (Comparison == 0) {
+             Comparison = Time1->Second - Time2->Second;
+             if (Comparison == 0) {
+               Comparison = Time1->Nanosecond - Time2->Nanosecond;
+             }
+           }
+         }
+       }
+     }
+   }
+   return Comparison;
+}
+
+VOID LinuxBootIndexSort(IN OUT LINUX_BOOT_INDEX *Index)
+{
+  UINTN Lo, Hi, Mid;
+  if ((Index == NULL) || (Index->Sorted == NULL)) {
+    return;
+  }
+  for (Hi = 0; Hi < Index->Count; Hi++) {
+    LINUX_BOOT_FILE *File = &Index->Files[Hi];
+    Lo = 0;
+    Mid = Hi;
+    while (Lo < Mid) {
+      UINTN Middle = (Lo + Mid) / 2;
+      if (StrCmp(Index->Sorted[Middle]->FileName, File->FileName) <= 0) {
+        Lo = Middle + 1;
+      } else {
+        Mid = Middle;
+      }
+    }
+    CopyMem(&Index->Sorted[Lo + 1], &Index->Sorted[Lo], (Hi - Lo) * sizeof(LINUX_BOOT_FILE *));
+    Index->Sorted[Lo] = File;
+  }
+}
+
+BOOLEAN LinuxBootFileExists(IN LINUX_BOOT_INDEX *Index,
+                            IN CHAR16           *FileName)
+{
+  UINTN Lo = 0, Hi, Mid;
+  INTN  Cmp;
+  if ((Index == NULL) || (Index->Sorted == NULL) || (FileName == NULL)) {
+    return FALSE;
+  }
+  Hi = Index->Count;
+  while (Lo < Hi) {
+    Mid = (Lo + Hi) / 2;
+    Cmp = StrCmp(Index->Sorted[Mid]->FileName, FileName);
+    if (Cmp == 0) {
+      return TRUE;
+    }
+    if (Cmp < 0) {
+      Lo = Mid + 1;
+    } else {
+      Hi = Mid;
+    }
+  }
+  return FALSE;
+}
+
+// Next kernel in directory order, start with *Position = 0
+LINUX_BOOT_FILE *LinuxBootNextKernel(IN     LINUX_BOOT_INDEX *Index,
+                                     IN OUT UINTN            *Position)
+{
+  LINUX_BOOT_FILE *File;
+  if (Index == NULL) {
+    return NULL;
+  }
+  while (*Position < Index->Count) {
+    File = &Index->Files[(*Position)++];
+    if ((File->FileSize > 0) && MetaiMatch(File->FileName, LINUX_LOADER_SEARCH_PATH)) {
+      return File;
+    }
+  }
+  return NULL;
+}
+
+// The kernel chosen by KernelScan, NULL for KERNEL_SCAN_ALL and KERNEL_SCAN_NONE
+LINUX_BOOT_FILE *LinuxBootFindKernel(IN LINUX_BOOT_INDEX *Index,
+                                     IN UINT8             KernelScan)
+{
+  LINUX_BOOT_FILE *Found = NULL;
+  LINUX_BOOT_FILE *File;
+  UINTN            Position = 0;
+  while ((File = LinuxBootNextKernel(Index, &Position)) != NULL) {
+    if (Found == NULL) {
+      Found = File;
+      if (KernelScan == KERNEL_SCAN_FIRST) {
+        break;
+      }
+      continue;
+    }
+    switch (KernelScan) {
+    case KERNEL_SCAN_LAST:
+      Found = File;
+      break;
+    case KERNEL_SCAN_NEWEST:
+      if (TimeCmp(&(Found->ModificationTime), &(File->ModificationTime)) < 0) {
+        Found = File;
+      }
+      break;
+    case KERNEL_SCAN_OLDEST:
+      if (TimeCmp(&(Found->ModificationTime), &(File->ModificationTime)) > 0) {
+        Found = File;
+      }
+      break;
+    case KERNEL_SCAN_MOSTRECENT:
+      if (StrCmp(Found->FileName, File->FileName) < 0) {
+        Found = File;
+      }
+      break;
+    case KERNEL_SCAN_EARLIEST:
+      if (StrCmp(Found->FileName, File->FileName) > 0) {
+        Found = File;
+      }
+      break;
+    default:
+      return NULL;
+    }
+  }
+  if ((KernelScan == KERNEL_SCAN_ALL) || (KernelScan == KERNEL_SCAN_NONE)) {
+    return NULL;
+  }
+  return Found;
+}
@@ -0,0 +1,28 @@
+/*
+ * refit/scan/linuxboot.h
+ *
+ * Lookups in the index of \boot of a Linux volume. Kept apart from loader.c
+ * so that VBoxFsDxe/test can build them on the host.
+ */
+
+#ifndef __LINUXBOOT_H__
+#define __LINUXBOOT_H__
+
+#ifdef HOST_POSIX
+#include "linuxboot_posix_base.h"
+#else
+#include "Platform.h"
+#endif
+
+#define LINUX_LOADER_SEARCH_PATH L"vmlinuz*"
+
+// Fills Index->Sorted, allocated for Index->Count entries, by exact name
+VOID LinuxBootIndexSort(IN OUT LINUX_BOOT_INDEX *Index);
+BOOLEAN LinuxBootFileExists(IN LINUX_BOOT_INDEX *Index,
+                            IN CHAR16           *FileName);
+LINUX_BOOT_FILE *LinuxBootNextKernel(IN     LINUX_BOOT_INDEX *Index,
+                                     IN OUT UINTN            *Position);
+LINUX_BOOT_FILE *LinuxBootFindKernel(IN LINUX_BOOT_INDEX *Index,
+                                     IN UINT8             KernelScan);
+
+#endif
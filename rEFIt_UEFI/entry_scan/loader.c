@@ -34,6 +34,7 @@
  */
 
 #include "entry_scan.h"
+#include "linuxboot.h"
 
 #ifndef DEBUG_ALL
 #define DEBUG_SCAN_LOADER 1
@@ -56,7 +57,6 @@
 #define LINUX_BOOT_ALT_PATH L"\\boot"
 #define LINUX_LOADER_PATH L"vmlinuz"
 #define LINUX_FULL_LOADER_PATH LINUX_BOOT_PATH L"\\" LINUX_LOADER_PATH
-#define LINUX_LOADER_SEARCH_PATH L"vmlinuz*"
 #define LINUX_DEFAULT_OPTIONS L"ro add_efi_memmap quiet splash vt.handoff=7"
 
 #if defined(MDE_CPU_X64)
@@ -112,41 +112,6 @@ STATIC CHAR16 *OSXInstallerPaths[] = {
 };
 STATIC CONST UINTN OSXInstallerPathsCount = (sizeof(OSXInstallerPaths) / sizeof(CHAR16 *));
 
-STATIC INTN TimeCmp(IN EFI_TIME *Time1,
-                    IN EFI_TIME *Time2)
-{
-   INTN Comparison;
-   if (Time1 == NULL) {
-     if (Time2 == NULL) {
-       return 0;
-     } else {
-       return -1;
-     }
-   } else if (Time2 == NULL) {
-     return 1;
-   }
-   Comparison = Time1->Year - Time2->Year;
-   if (Comparison == 0) {
-     Comparison = Time1->Month - Time2->Month;
-     if (Comparison == 0) {
-       Comparison = Time1->Day - Time2->Day;
-       if (Comparison == 0) {
-         Comparison = Time1->Hour - Time2->Hour;
-         if (Comparison == 0) {
-           Comparison = Time1->Minute - Time2->Minute;
-           if (Comparison == 0) {
-             Comparison = Time1->Second - Time2->Second;
-             if (Comparison == 0) {
-               Comparison = Time1->Nanosecond - Time2->Nanosecond;
-             }
-           }
-         }
-       }
-     }
-   }
-   return Comparison;
-}
-
 UINT8 GetOSTypeFromPath(IN CHAR16 *Path)
 {
   if (Path == NULL) {
@@ -219,19 +184,97 @@ STATIC CHAR16 *LinuxInitImagePath[] = {
 };
 STATIC CONST UINTN LinuxInitImagePathCount = (sizeof(LinuxInitImagePath) / sizeof(CHAR16 *));
 
-STATIC CHAR16 *LinuxKernelOptions(IN EFI_FILE_PROTOCOL *Dir,
+// Builds the index of \boot of the volume, once
+STATIC LINUX_BOOT_INDEX *GetLinuxBootIndex(IN REFIT_VOLUME *Volume)
+{
+  LINUX_BOOT_INDEX *Index;
+  REFIT_DIR_ITER    Iter;
+  EFI_FILE_INFO    *FileInfo = NULL;
+  UINTN             Capacity = 0;
+
+  if ((Volume == NULL) || (Volume->RootDir == NULL)) {
+    return NULL;
+  }
+  if (Volume->LinuxBootIndex != NULL) {
+    return Volume->LinuxBootIndex;
+  }
+  Index = AllocateZeroPool(sizeof(LINUX_BOOT_INDEX));
+  if (Index == NULL) {
+    return NULL;
+  }
+  DirIterOpen(Volume->RootDir, LINUX_BOOT_PATH, &Iter);
+  while (DirIterNext(&Iter, 2, NULL, &FileInfo)) {
+    if (Index->Count == Capacity) {
+      LINUX_BOOT_FILE *Files = AllocateZeroPool((Capacity + 32) * sizeof(LINUX_BOOT_FILE));
+      if (Files == NULL) {
+        break;
+      }
+      if (Index->Files != NULL) {
+        CopyMem(Files, Index->Files, Capacity * sizeof(LINUX_BOOT_FILE));
+        FreePool(Index->Files);
+      }
+      Index->Files = Files;
+      Capacity += 32;
+    }
+    Index->Files[Index->Count].FileName = EfiStrDuplicate(FileInfo->FileName);
+    if (Index->Files[Index->Count].FileName == NULL) {
+      break;
+    }
+    Index->Files[Index->Count].FileSize = FileInfo->FileSize;
+    Index->Files[Index->Count].ModificationTime = FileInfo->ModificationTime;
+    Index->Count++;
+    // FileInfo is freed by DirIterNext
+  }
+  DirIterClose(&Iter);
+  Volume->LinuxBootIndex = Index;
+  // sort by name for the initrd lookups
+  if (Index->Count > 0) {
+    Index->Sorted = AllocatePool(Index->Count * sizeof(LINUX_BOOT_FILE *));
+    if (Index->Sorted == NULL) {
+      FreeLinuxBootIndex(Volume);
+      return NULL;
+    }
+    LinuxBootIndexSort(Index);
+    DBG("    %d files in %s\n", Index->Count, LINUX_BOOT_PATH);
+  }
+  return Index;
+}
+
+VOID FreeLinuxBootIndex(IN REFIT_VOLUME *Volume)
+{
+  LINUX_BOOT_INDEX *Index;
+  UINTN             i;
+
+  if ((Volume == NULL) || (Volume->LinuxBootIndex == NULL)) {
+    return;
+  }
+  Index = Volume->LinuxBootIndex;
+  for (i = 0; i < Index->Count; i++) {
+    FreePool(Index->Files[i].FileName);
+  }
+  if (Index->Files != NULL) {
+    FreePool(Index->Files);
+  }
+  if (Index->Sorted != NULL) {
+    FreePool(Index->Sorted);
+  }
+  FreePool(Index);
+  Volume->LinuxBootIndex = NULL;
+}
+
+STATIC CHAR16 *LinuxKernelOptions(IN LINUX_BOOT_INDEX  *Index,
                                   IN CHAR16            *Version,
                                   IN CHAR16            *PartUUID,
                                   IN CHAR16            *Options OPTIONAL)
 {
-  UINTN Index = 0;
-  if ((Dir == NULL) || (PartUUID == NULL)) {
+  UINTN i = 0;
+  if ((Index == NULL) || (PartUUID == NULL)) {
     return (Options == NULL) ? NULL : EfiStrDuplicate(Options);
   }
-  while (Index < LinuxInitImagePathCount) {
-    CHAR16 *InitRd = PoolPrint(LinuxInitImagePath[Index++], (Version == NULL) ? L"" : Version);
+  while (i < LinuxInitImagePathCount) {
+    CHAR16 *InitRd = PoolPrint(LinuxInitImagePath[i++], (Version == NULL) ? L"" : Version);
     if (InitRd != NULL) {
-      if (FileExists(Dir, InitRd)) {
+      if (LinuxBootFileExists(Index, InitRd)) {
         CHAR16 *CustomOptions = PoolPrint(L"root=/dev/disk/by-partuuid/%s initrd=%s\\%s %s %s", PartUUID, LINUX_BOOT_ALT_PATH, InitRd, LINUX_DEFAULT_OPTIONS, (Options == NULL) ? L"" : Options);
         FreePool(InitRd);
         return CustomOptions;
@@ -268,7 +311,7 @@ STATIC EFI_STATUS GetOSXVolumeName(LOADER_ENTRY *Entry)
   CHAR8* 	fileBuffer;
   CHAR8*  targetString;
   UINTN   fileLen = 0;
-  if(FileExists(Entry->Volume->RootDir, targetNameFile)) {
+  if(VolumeFileExists(Entry->Volume, targetNameFile)) {
     Status = egLoadFile(Entry->Volume->RootDir, targetNameFile, (UINT8 **)&fileBuffer, &fileLen);
     if(!EFI_ERROR(Status)) {
       CHAR16  *tmpName;
@@ -557,29 +600,20 @@ STATIC LOADER_ENTRY *CreateLoaderEntry(IN CHAR16 *LoaderPath,
   
   Entry->me.ShortcutLetter = (Hotkey == 0) ? ShortcutLetter : Hotkey;
   
-  // get custom volume icon if present
-
-    if (GlobalConfig.CustomIcons && FileExists(Volume->RootDir, L"\\.VolumeIcon.icns")){
-      Entry->me.Image = LoadIcns(Volume->RootDir, L"\\.VolumeIcon.icns", 128);
-      DBG("using VolumeIcon.icns image from Volume\n");
-    } else if (Image) {
-      Entry->me.Image = Image;
-    } else {      
-      Entry->me.Image = LoadOSIcon(OSIconName, L"unknown", 128, FALSE, TRUE);
-    }
-
-  // Load DriveImage
-  Entry->me.DriveImage = (DriveImage != NULL) ? DriveImage : ScanVolumeDefaultIcon(Volume, Entry->LoaderType);
-  
-  // DBG("HideBadges=%d Volume=%s ", GlobalConfig.HideBadges, Volume->VolName);
-  if (GlobalConfig.HideBadges & HDBADGES_SHOW) {
-    if (GlobalConfig.HideBadges & HDBADGES_SWAP) {
-      Entry->me.BadgeImage = egCopyScaledImage(Entry->me.DriveImage, GlobalConfig.BadgeScale);
-      // DBG(" Show badge as Drive.");
-    } else {
-      Entry->me.BadgeImage = egCopyScaledImage(Entry->me.Image, GlobalConfig.BadgeScale);
-      // DBG(" Show badge as OSImage.");
-    }
+  // custom volume icon, OS icon, drive icon and badge are loaded when the entry is drawn
+  Entry->me.Images = AllocateZeroPool(sizeof(ENTRY_IMAGES));
+  if (Entry->me.Images == NULL) {
+    // no record, the entry is drawn with the images given by the caller only
+    Entry->me.Image = Image;
+    Entry->me.DriveImage = DriveImage;
+  } else {
+    Entry->me.Images->Volume = Volume;
+    Entry->me.Images->Image = Image;
+    Entry->me.Images->DriveImage = DriveImage;
+    Entry->me.Images->OSIconName = (OSIconName != NULL) ? EfiStrDuplicate(OSIconName) : NULL;
+    Entry->me.Images->FallbackIconName = L"unknown";
+    Entry->me.Images->OSType = Entry->LoaderType;
+    Entry->me.Images->VolumeIcon = GlobalConfig.CustomIcons;
   }
   
   if (BootBgColor != NULL) {
@@ -804,7 +838,7 @@ STATIC VOID AddDefaultMenu(IN LOADER_ENTRY *Entry)
     
     // check for Apple hardware diagnostics
     StrCpy(DiagsFileName, L"\\System\\Library\\CoreServices\\.diagnostics\\diags.efi");
-    if (FileExists(Volume->RootDir, DiagsFileName) && !(GlobalConfig.DisableFlags & HIDEUI_FLAG_HWTEST)) {
+    if (VolumeFileExists(Volume, DiagsFileName) && !(GlobalConfig.DisableFlags & HIDEUI_FLAG_HWTEST)) {
       DBG("  - Apple Hardware Test found\n");
       
       // NOTE: Sothor - I'm not sure if to duplicate parent entry here.
@@ -914,7 +948,7 @@ STATIC BOOLEAN AddLoaderEntry(IN CHAR16 *LoaderPath, IN CHAR16 *LoaderOptions,
 {
   LOADER_ENTRY *Entry;
   INTN HVi;
-  if ((LoaderPath == NULL) || (Volume == NULL) || (Volume->RootDir == NULL) || !FileExists(Volume->RootDir, LoaderPath)) {
+  if ((LoaderPath == NULL) || (Volume == NULL) || (Volume->RootDir == NULL) || !VolumeFileExists(Volume, LoaderPath)) {
     return FALSE;
   }
   DBG("    AddLoaderEntry for Volume Name=%s\n", Volume->VolName);
@@ -982,7 +1016,7 @@ VOID ScanLoader(VOID)
     
     // Use standard location for boot.efi, unless the file /.IAPhysicalMedia is present
     // That file indentifies a 2nd-stage Install Media, so when present, skip standard path to avoid entry duplication
-    if (!FileExists(Volume->RootDir, L"\\.IAPhysicalMedia")) {
+    if (!VolumeFileExists(Volume, L"\\.IAPhysicalMedia")) {
       if(EFI_ERROR(GetRootUUID(Volume)) || isFirstRootUUID(Volume)) {
         AddLoaderEntry(MACOSX_LOADER_PATH, NULL, L"Mac OS X", Volume, NULL, OSTYPE_OSX, 0);
       }
@@ -1012,199 +1046,30 @@ VOID ScanLoader(VOID)
     // check for linux loaders
     for (Index = 0; Index < LinuxEntryDataCount; ++Index) {
       AddLoaderEntry(LinuxEntryData[Index].Path, L"", LinuxEntryData[Index].Title, Volume,
-                     LoadOSIcon(LinuxEntryData[Index].Icon, L"unknown", 128, FALSE, TRUE), OSTYPE_LIN, OSFLAG_NODEFAULTARGS);
+                     NULL, OSTYPE_LIN, OSFLAG_NODEFAULTARGS);
     }
     // check for linux kernels
     PartGUID = FindGPTPartitionGuidInDevicePath(Volume->DevicePath);
     if ((PartGUID != NULL) && (Volume->RootDir != NULL)) {
-      REFIT_DIR_ITER  Iter;
-      EFI_FILE_INFO  *FileInfo = NULL;
-      EFI_TIME        PreviousTime;
-      CHAR16         *Path = NULL;
-      CHAR16         *Options;
+      LINUX_BOOT_INDEX *BootIndex;
+      LINUX_BOOT_FILE  *Kernel;
+      UINTN             Position = 0;
+      CHAR16           *Path;
+      CHAR16           *Options;
       // Get the partition UUID and make sure it's lower case
       CHAR16          PartUUID[40];
-      ZeroMem(&PreviousTime, sizeof(EFI_TIME));
       UnicodeSPrint(PartUUID, sizeof(PartUUID), L"%g", PartGUID);
       StrToLower(PartUUID);
-      // open the /boot directory (or whatever directory path)
-      DirIterOpen(Volume->RootDir, LINUX_BOOT_PATH, &Iter);
+      // read the /boot directory (or whatever directory path) once
+      BootIndex = GetLinuxBootIndex(Volume);
       // Check which kernel scan to use
-      switch (gSettings.KernelScan) {
-      case KERNEL_SCAN_FIRST:
-        // First kernel found only
-        while (DirIterNext(&Iter, 2, LINUX_LOADER_SEARCH_PATH, &FileInfo)) {
-          if (FileInfo != NULL) {
-            if (FileInfo->FileSize == 0) {
-              FreePool(FileInfo);
-              FileInfo = NULL;
-              continue;
-            }
-            // get the kernel file path
-            Path = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, FileInfo->FileName);
-            if (Path != NULL) {
-              Options = LinuxKernelOptions(Iter.DirHandle, Basename(Path) + StrLen(LINUX_LOADER_PATH), PartUUID, NULL);
-              // Add the entry
-              AddLoaderEntry(Path, (Options == NULL) ? LINUX_DEFAULT_OPTIONS : Options, NULL, Volume, NULL, OSTYPE_LINEFI, OSFLAG_NODEFAULTARGS);
-              if (Options != NULL) {
-                FreePool(Options);
-              }
-              FreePool(Path);
-            }
-            // free the file info
-            FreePool(FileInfo);
-            FileInfo = NULL;
-            break;
-          }
-        }
-        break;
-
-      case KERNEL_SCAN_LAST:
-        // Last kernel found only
-        while (DirIterNext(&Iter, 2, LINUX_LOADER_SEARCH_PATH, &FileInfo)) {
-          if (FileInfo != NULL) {
-            if (FileInfo->FileSize > 0) {
-              // get the kernel file path
-              if (Path != NULL) {
-                FreePool(Path);
-              }
-              Path = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, FileInfo->FileName);
-            }
-            // free the file info
-            FreePool(FileInfo);
-            FileInfo = NULL;
-          }
-        }
-        if (Path != NULL) {
-          Options = LinuxKernelOptions(Iter.DirHandle, Basename(Path) + StrLen(LINUX_LOADER_PATH), PartUUID, NULL);
-          // Add the entry
-          AddLoaderEntry(Path, (Options == NULL) ? LINUX_DEFAULT_OPTIONS : Options, NULL, Volume, NULL, OSTYPE_LINEFI, OSFLAG_NODEFAULTARGS);
-          if (Options != NULL) {
-            FreePool(Options);
-          }
-          FreePool(Path);
-        }
-        break;
-
-      case KERNEL_SCAN_NEWEST:
-        // Newest dated kernel only
-        while (DirIterNext(&Iter, 2, LINUX_LOADER_SEARCH_PATH, &FileInfo)) {
-          if (FileInfo != NULL) {
-            if (FileInfo->FileSize > 0) {
-              // get the kernel file path
-              if ((PreviousTime.Year == 0) || (TimeCmp(&PreviousTime, &(FileInfo->ModificationTime)) < 0)) {
-                if (Path != NULL) {
-                  FreePool(Path);
-                }
-                Path = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, FileInfo->FileName);
-                PreviousTime = FileInfo->ModificationTime;
-              }
-            }
-            // free the file info
-            FreePool(FileInfo);
-            FileInfo = NULL;
-          }
-        }
-        if (Path != NULL) {
-          Options = LinuxKernelOptions(Iter.DirHandle, Basename(Path) + StrLen(LINUX_LOADER_PATH), PartUUID, NULL);
-          // Add the entry
-          AddLoaderEntry(Path, (Options == NULL) ? LINUX_DEFAULT_OPTIONS : Options, NULL, Volume, NULL, OSTYPE_LINEFI, OSFLAG_NODEFAULTARGS);
-          if (Options != NULL) {
-            FreePool(Options);
-          }
-          FreePool(Path);
-        }
-        break;
-
-      case KERNEL_SCAN_OLDEST:
-        // Oldest dated kernel only
-        while (DirIterNext(&Iter, 2, LINUX_LOADER_SEARCH_PATH, &FileInfo)) {
-          if (FileInfo != NULL) {
-            if (FileInfo->FileSize > 0) {
-              // get the kernel file path
-              if ((PreviousTime.Year == 0) || (TimeCmp(&PreviousTime, &(FileInfo->ModificationTime)) > 0)) {
-                if (Path != NULL) {
-                  FreePool(Path);
-                }
-                Path = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, FileInfo->FileName);
-                PreviousTime = FileInfo->ModificationTime;
-              }
-            }
-            // free the file info
-            FreePool(FileInfo);
-            FileInfo = NULL;
-          }
-        }
-        if (Path != NULL) {
-          Options = LinuxKernelOptions(Iter.DirHandle, Basename(Path) + StrLen(LINUX_LOADER_PATH), PartUUID, NULL);
-          // Add the entry
-          AddLoaderEntry(Path, (Options == NULL) ? LINUX_DEFAULT_OPTIONS : Options, NULL, Volume, NULL, OSTYPE_LINEFI, OSFLAG_NODEFAULTARGS);
-          if (Options != NULL) {
-            FreePool(Options);
-          }
-          FreePool(Path);
-        }
-        break;
-
-      case KERNEL_SCAN_MOSTRECENT:
-        // most recent kernel version only
-        while (DirIterNext(&Iter, 2, LINUX_LOADER_SEARCH_PATH, &FileInfo)) {
-          if (FileInfo != NULL) {
-            if (FileInfo->FileSize > 0) {
-              // get the kernel file path
-              CHAR16 *NewPath = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, FileInfo->FileName);
-              if (NewPath != NULL) {
-                if ((Path == NULL) || (StrCmp(Path, NewPath) < 0)) {
-                  if (Path != NULL) {
-                    FreePool(Path);
-                  }
-                  Path = NewPath;
-                } else {
-                  FreePool(NewPath);
-                }
-              }
-            }
-            // free the file info
-            FreePool(FileInfo);
-            FileInfo = NULL;
-          }
-        }
-        if (Path != NULL) {
-          Options = LinuxKernelOptions(Iter.DirHandle, Basename(Path) + StrLen(LINUX_LOADER_PATH), PartUUID, NULL);
-          // Add the entry
-          AddLoaderEntry(Path, (Options == NULL) ? LINUX_DEFAULT_OPTIONS : Options, NULL, Volume, NULL, OSTYPE_LINEFI, OSFLAG_NODEFAULTARGS);
-          if (Options != NULL) {
-            FreePool(Options);
-          }
-          FreePool(Path);
-        }
-        break;
-
-      case KERNEL_SCAN_EARLIEST:
-        // earliest kernel version only
-        while (DirIterNext(&Iter, 2, LINUX_LOADER_SEARCH_PATH, &FileInfo)) {
-          if (FileInfo != NULL) {
-            if (FileInfo->FileSize > 0) {
-              // get the kernel file path
-              CHAR16 *NewPath = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, FileInfo->FileName);
-              if (NewPath != NULL) {
-                if ((Path == NULL) || (StrCmp(Path, NewPath) > 0)) {
-                  if (Path != NULL) {
-                    FreePool(Path);
-                  }
-                  Path = NewPath;
-                } else {
-                  FreePool(NewPath);
-                }
-              }
-            }
-            // free the file info
-            FreePool(FileInfo);
-            FileInfo = NULL;
-          }
-        }
+      Kernel = (gSettings.KernelScan == KERNEL_SCAN_ALL) ? LinuxBootNextKernel(BootIndex, &Position) :
+                                                           LinuxBootFindKernel(BootIndex, gSettings.KernelScan);
+      while (Kernel != NULL) {
+        // get the kernel file path
+        Path = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, Kernel->FileName);
         if (Path != NULL) {
-          Options = LinuxKernelOptions(Iter.DirHandle, Basename(Path) + StrLen(LINUX_LOADER_PATH), PartUUID, NULL);
+          Options = LinuxKernelOptions(BootIndex, Kernel->FileName + StrLen(LINUX_LOADER_PATH), PartUUID, NULL);
           // Add the entry
           AddLoaderEntry(Path, (Options == NULL) ? LINUX_DEFAULT_OPTIONS : Options, NULL, Volume, NULL, OSTYPE_LINEFI, OSFLAG_NODEFAULTARGS);
           if (Options != NULL) {
@@ -1212,39 +1077,9 @@ VOID ScanLoader(VOID)
           }
           FreePool(Path);
         }
-        break;
-
-      case KERNEL_SCAN_ALL:
         // get all the filename matches
-        while (DirIterNext(&Iter, 2, LINUX_LOADER_SEARCH_PATH, &FileInfo)) {
-          if (FileInfo != NULL) {
-            if (FileInfo->FileSize > 0) {
-              // get the kernel file path
-              Path = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, FileInfo->FileName);
-              if (Path != NULL) {
-                Options = LinuxKernelOptions(Iter.DirHandle, Basename(Path) + StrLen(LINUX_LOADER_PATH), PartUUID, NULL);
-                // Add the entry
-                AddLoaderEntry(Path, (Options == NULL) ? LINUX_DEFAULT_OPTIONS : Options, NULL, Volume, NULL, OSTYPE_LINEFI, OSFLAG_NODEFAULTARGS);
-                if (Options != NULL) {
-                  FreePool(Options);
-                }
-                FreePool(Path);
-              }
-            }
-            // free the file info
-            FreePool(FileInfo);
-            FileInfo = NULL;
-          }
-        }
-        break;
-
-      default:
-      case KERNEL_SCAN_NONE:
-        // No kernel scan
-        break;
+        Kernel = (gSettings.KernelScan == KERNEL_SCAN_ALL) ? LinuxBootNextKernel(BootIndex, &Position) : NULL;
       }
-      //close the directory
-      DirIterClose(&Iter);
     }
     } //if linux scan
     //     DBG("search for  optical UEFI\n");
@@ -1269,8 +1104,9 @@ STATIC VOID AddCustomEntry(IN UINTN                CustomIndex,
 {
   UINTN           VolumeIndex;
   REFIT_VOLUME   *Volume;
-  REFIT_DIR_ITER  SIter;
-  REFIT_DIR_ITER *Iter = &SIter;
+  LINUX_BOOT_INDEX *BootIndex = NULL;
+  LINUX_BOOT_FILE *Kernel;
+  UINTN           Position = 0;
   CHAR16          PartUUID[40];
   BOOLEAN         IsSubEntry = (SubMenu != NULL);
   BOOLEAN         FindCustomPath = (CustomPath == NULL);
@@ -1332,6 +1168,10 @@ STATIC VOID AddCustomEntry(IN UINTN                CustomIndex,
     if (Volume->VolName == NULL) {
       Volume->VolName = L"Unknown";
     }
+    if (FindCustomPath) {
+      // kernel path of the previous volume was freed
+      CustomPath = NULL;
+    }
     
     DBG("    Checking volume \"%s\" (%s) ... ", Volume->VolName, Volume->DevicePathString);
     
@@ -1382,16 +1222,14 @@ STATIC VOID AddCustomEntry(IN UINTN                CustomIndex,
       DBG("skipped because filesystem is not readable\n");
       continue;
     }
-    if (StriCmp(CustomPath, MACOSX_LOADER_PATH) == 0 && FileExists(Volume->RootDir, L"\\.IAPhysicalMedia")) {
+    if (StriCmp(CustomPath, MACOSX_LOADER_PATH) == 0 && VolumeFileExists(Volume, L"\\.IAPhysicalMedia")) {
       DBG("skipped standard OSX path because volume is 2nd stage Install Media\n");
       continue;
     }
     Guid = FindGPTPartitionGuidInDevicePath(Volume->DevicePath);
-    // Open the boot directory to search for kernels
+    // Search the boot directory for kernels
     if (FindCustomPath) {
-      EFI_FILE_INFO *FileInfo = NULL;
-      EFI_TIME       PreviousTime;
-      ZeroMem(&PreviousTime, sizeof(EFI_TIME));
+      Position = 0;
       // Get the partition UUID and make sure it's lower case
       if (Guid == NULL) {
         DBG("skipped because volume does not have partition uuid\n");
@@ -1399,132 +1237,20 @@ STATIC VOID AddCustomEntry(IN UINTN                CustomIndex,
       }
       UnicodeSPrint(PartUUID, sizeof(PartUUID), L"%g", Guid);
       StrToLower(PartUUID);
-      // open the /boot directory (or whatever directory path)
-      DirIterOpen(Volume->RootDir, LINUX_BOOT_PATH, Iter);
+      // /boot directory (or whatever directory path) is read once per volume
+      BootIndex = GetLinuxBootIndex(Volume);
       // Check if user wants to find newest kernel only
       switch (Custom->KernelScan) {
       case KERNEL_SCAN_FIRST:
-        // First kernel found only
-        while (DirIterNext(Iter, 2, LINUX_LOADER_SEARCH_PATH, &FileInfo)) {
-          if (FileInfo != NULL) {
-            if (FileInfo->FileSize == 0) {
-              FreePool(FileInfo);
-              FileInfo = NULL;
-              continue;
-            }
-            // get the kernel file path
-            CustomPath = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, FileInfo->FileName);
-            // free the file info
-            FreePool(FileInfo);
-            FileInfo = NULL;
-            break;
-          }
-        }
-        break;
-
       case KERNEL_SCAN_LAST:
-        // Last kernel found only
-        while (DirIterNext(Iter, 2, LINUX_LOADER_SEARCH_PATH, &FileInfo)) {
-          if (FileInfo != NULL) {
-            if (FileInfo->FileSize > 0) {
-              // get the kernel file path
-              if (CustomPath != NULL) {
-                FreePool(CustomPath);
-              }
-              CustomPath = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, FileInfo->FileName);
-            }
-            // free the file info
-            FreePool(FileInfo);
-            FileInfo = NULL;
-          }
-        }
-        break;
-
       case KERNEL_SCAN_NEWEST:
-        // Newest dated kernel only
-        while (DirIterNext(Iter, 2, LINUX_LOADER_SEARCH_PATH, &FileInfo)) {
-          if (FileInfo != NULL) {
-            if (FileInfo->FileSize > 0) {
-              // get the kernel file path
-              if ((PreviousTime.Year == 0) || (TimeCmp(&PreviousTime, &(FileInfo->ModificationTime)) < 0)) {
-                if (CustomPath != NULL) {
-                  FreePool(CustomPath);
-                }
-                CustomPath = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, FileInfo->FileName);
-                PreviousTime = FileInfo->ModificationTime;
-              }
-            }
-            // free the file info
-            FreePool(FileInfo);
-            FileInfo = NULL;
-          }
-        }
-        break;
-
       case KERNEL_SCAN_OLDEST:
-        // Oldest dated kernel only
-        while (DirIterNext(Iter, 2, LINUX_LOADER_SEARCH_PATH, &FileInfo)) {
-          if (FileInfo != NULL) {
-            if (FileInfo->FileSize > 0) {
-              // get the kernel file path
-              if ((PreviousTime.Year == 0) || (TimeCmp(&PreviousTime, &(FileInfo->ModificationTime)) > 0)) {
-                if (CustomPath != NULL) {
-                  FreePool(CustomPath);
-                }
-                CustomPath = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, FileInfo->FileName);
-                PreviousTime = FileInfo->ModificationTime;
-              }
-            }
-            // free the file info
-            FreePool(FileInfo);
-            FileInfo = NULL;
-          }
-        }
-        break;
-
       case KERNEL_SCAN_MOSTRECENT:
-        // most recent kernel version only
-        while (DirIterNext(Iter, 2, LINUX_LOADER_SEARCH_PATH, &FileInfo)) {
-          if (FileInfo != NULL) {
-            if (FileInfo->FileSize > 0) {
-              // get the kernel file path
-              CHAR16 *NewPath = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, FileInfo->FileName);
-              if ((CustomPath == NULL) || (StrCmp(CustomPath, NewPath) < 0)) {
-                if (CustomPath != NULL) {
-                  FreePool(CustomPath);
-                }
-                CustomPath = NewPath;
-              } else {
-                FreePool(NewPath);
-              }
-            }
-            // free the file info
-            FreePool(FileInfo);
-            FileInfo = NULL;
-          }
-        }
-        break;
-
       case KERNEL_SCAN_EARLIEST:
-        // earliest kernel version only
-        while (DirIterNext(Iter, 2, LINUX_LOADER_SEARCH_PATH, &FileInfo)) {
-          if (FileInfo != NULL) {
-            if (FileInfo->FileSize > 0) {
-              // get the kernel file path
-              CHAR16 *NewPath = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, FileInfo->FileName);
-              if ((CustomPath == NULL) || (StrCmp(CustomPath, NewPath) > 0)) {
-                if (CustomPath != NULL) {
-                  FreePool(CustomPath);
-                }
-                CustomPath = NewPath;
-              } else {
-                FreePool(NewPath);
-              }
-            }
-            // free the file info
-            FreePool(FileInfo);
-            FileInfo = NULL;
-          }
+        Kernel = LinuxBootFindKernel(BootIndex, Custom->KernelScan);
+        if (Kernel != NULL) {
+          // get the kernel file path
+          CustomPath = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, Kernel->FileName);
         }
         break;
 
@@ -1533,7 +1259,7 @@ STATIC VOID AddCustomEntry(IN UINTN                CustomIndex,
         Custom->KernelScan = KERNEL_SCAN_ALL;
         break;
       }
-    } else if (!FileExists(Volume->RootDir, CustomPath)) {
+    } else if (!VolumeFileExists(Volume, CustomPath)) {
       DBG("skipped because path does not exist\n");
       continue;
     }
@@ -1576,21 +1302,14 @@ STATIC VOID AddCustomEntry(IN UINTN                CustomIndex,
       // Search for linux kernels
       CHAR16 *CustomOptions = Custom->Options;
       if (FindCustomPath && (Custom->KernelScan == KERNEL_SCAN_ALL)) {
-        EFI_FILE_INFO *FileInfo = NULL;
         // Get the next kernel path or stop looking
-        if (!DirIterNext(Iter, 2, LINUX_LOADER_SEARCH_PATH, &FileInfo) || (FileInfo == NULL)) {
+        Kernel = LinuxBootNextKernel(BootIndex, &Position);
+        if (Kernel == NULL) {
           DBG("\n");
           break;
         }
-        // who knows....
-        if (FileInfo->FileSize == 0) {
-          FreePool(FileInfo);
-          continue;
-        }
         // get the kernel file path
-        CustomPath = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, FileInfo->FileName);
-        // free the file info
-        FreePool(FileInfo);
+        CustomPath = PoolPrint(L"%s\\%s", LINUX_BOOT_PATH, Kernel->FileName);
       }
       if (CustomPath == NULL) {
         DBG("skipped\n");
@@ -1599,7 +1318,7 @@ STATIC VOID AddCustomEntry(IN UINTN                CustomIndex,
       // Check to make sure we should update custom options or not
       if (FindCustomPath && OSFLAG_ISUNSET(Custom->Flags, OSFLAG_NODEFAULTARGS)) {
         // Find the init ram image and select root
-        CustomOptions = LinuxKernelOptions(Iter->DirHandle, Basename(CustomPath) + StrLen(LINUX_LOADER_PATH), PartUUID, Custom->Options);
+        CustomOptions = LinuxKernelOptions(BootIndex, Basename(CustomPath) + StrLen(LINUX_LOADER_PATH), PartUUID, Custom->Options);
       }
       // Check to make sure that this entry is not hidden or disabled by another custom entry
       if (!IsSubEntry) {
@@ -1772,10 +1491,6 @@ STATIC VOID AddCustomEntry(IN UINTN                CustomIndex,
         FreePool(CustomOptions);
       }
     } while (FindCustomPath && (Custom->KernelScan == KERNEL_SCAN_ALL));
-    // Close the kernel boot directory
-    if (FindCustomPath) {
-      DirIterClose(Iter);
-    }
   }
 }
 
@@ -76,7 +76,7 @@ STATIC BOOLEAN AddToolEntry(IN CHAR16 *LoaderPath, IN CHAR16 *FullTitle, IN CHAR
   LOADER_ENTRY *Entry;
   // Check the loader exists
   if ((LoaderPath == NULL) || (Volume == NULL) || (Volume->RootDir == NULL) ||
-      !FileExists(Volume->RootDir, LoaderPath)) {
+      !VolumeFileExists(Volume, LoaderPath)) {
     return FALSE;
   }
   // Allocate the entry
@@ -231,9 +231,10 @@ VOID ScanTool(VOID)
         // We will delete /EFI file here and leave only /EFI directory.
         if (DeleteFile(Volume->RootDir, L"EFI")) {
           DBG(" Deleted /EFI label\n");
+          FreeDirSnapshots(Volume);
         }
         
-        if (FileExists(Volume->RootDir, CLOVER_MEDIA_FILE_NAME)) {
+        if (VolumeFileExists(Volume, CLOVER_MEDIA_FILE_NAME)) {
           DBG(" Found Clover\n");
           // Volume->BootType = BOOTING_BY_EFI;
           AddCloverEntry(CLOVER_MEDIA_FILE_NAME, L"Clover Boot Options", Volume);
@@ -310,7 +311,7 @@ VOID AddCustomTool(VOID)
         DBG("skipped because volume is not readable\n");
         continue;
       }
-      if (!FileExists(Volume->RootDir, Custom->Path)) {
+      if (!VolumeFileExists(Volume, Custom->Path)) {
         DBG("skipped because path does not exist\n");
         continue;
       }
@@ -71,6 +71,7 @@ EFI_FILE         *OemThemeDir = NULL;
 REFIT_VOLUME     *SelfVolume = NULL;
 REFIT_VOLUME     **Volumes = NULL;
 UINTN            VolumesCount = 0;
+UINTN            gDirSnapshotGeneration = 0; // bumped when a file system comes or goes
 //
 // Unicode collation protocol interface
 //
@@ -1187,6 +1188,8 @@ static VOID UninitVolumes(VOID)
       Volume->RootDir = NULL;
     }
     
+    FreeLinuxBootIndex(Volume);
+    FreeDirSnapshots(Volume);
     Volume->DeviceHandle = NULL;
     Volume->BlockIO = NULL;
     Volume->WholeDiskBlockIO = NULL;
@@ -1295,6 +1298,207 @@ BOOLEAN FileExists(IN EFI_FILE *Root, IN CHAR16 *RelativePath)
   return FALSE;
 }
 
+//
+// Directory snapshots: every directory asked about is read once per volume
+// and the existence checks of the entry scan are answered from its names.
+//
+
+#define DIR_SNAPSHOT_MAX_NAMES  512
+
+STATIC DIR_SNAPSHOT *GetDirSnapshot(IN REFIT_VOLUME *Volume, IN CHAR16 *Path)
+{
+  DIR_SNAPSHOT    *Snap;
+  REFIT_DIR_ITER  Iter;
+  EFI_FILE_INFO   *FileInfo = NULL;
+  EFI_STATUS      Status;
+  UINTN           Capacity = 0;
+  UINTN           Lo, Hi, Mid;
+
+  for (Snap = Volume->DirSnapshots; Snap != NULL; Snap = Snap->Next) {
+    if (StriCmp(Snap->Path, Path) == 0) {
+      return Snap;
+    }
+  }
+
+  Snap = AllocateZeroPool(sizeof(DIR_SNAPSHOT));
+  if (Snap == NULL) {
+    return NULL;
+  }
+  Snap->Path = EfiStrDuplicate(Path);
+  if (Snap->Path == NULL) {
+    FreePool(Snap);
+    return NULL;
+  }
+
+  // a directory missing from the listing of its parent is not opened at all
+  if ((*Path != L'\0') && !VolumeFileExists(Volume, Path)) {
+    Snap->Missing = TRUE;
+  } else {
+    if (*Path == L'\0') {
+      Volume->RootDir->SetPosition(Volume->RootDir, 0);
+      DirIterOpen(Volume->RootDir, NULL, &Iter);
+    } else {
+      DirIterOpen(Volume->RootDir, Path, &Iter);
+    }
+    while (DirIterNext(&Iter, 0, NULL, &FileInfo)) {
+      if (Snap->Count == DIR_SNAPSHOT_MAX_NAMES) {
+        Snap->Partial = TRUE;
+        break;
+      }
+      if (Snap->Count == Capacity) {
+        CHAR16 **Names = AllocatePool((Capacity + 32) * sizeof(CHAR16 *));
+        if (Names == NULL) {
+          Snap->Partial = TRUE;
+          break;
+        }
+        if (Snap->Names != NULL) {
+          CopyMem(Names, Snap->Names, Capacity * sizeof(CHAR16 *));
+          FreePool(Snap->Names);
+        }
+        Snap->Names = Names;
+        Capacity += 32;
+      }
+      // insert sorted
+      Lo = 0;
+      Hi = Snap->Count;
+      while (Lo < Hi) {
+        Mid = (Lo + Hi) / 2;
+        if (StriCmp(Snap->Names[Mid], FileInfo->FileName) <= 0) {
+          Lo = Mid + 1;
+        } else {
+          Hi = Mid;
+        }
+      }
+      CopyMem(&Snap->Names[Lo + 1], &Snap->Names[Lo], (Snap->Count - Lo) * sizeof(CHAR16 *));
+      Snap->Names[Lo] = EfiStrDuplicate(FileInfo->FileName);
+      if (Snap->Names[Lo] == NULL) {
+        CopyMem(&Snap->Names[Lo], &Snap->Names[Lo + 1], (Snap->Count - Lo) * sizeof(CHAR16 *));
+        Snap->Partial = TRUE;
+        break;
+      }
+      Snap->Count++;
+    }
+    Status = DirIterClose(&Iter);
+    if (*Path == L'\0') {
+      Volume->RootDir->SetPosition(Volume->RootDir, 0);
+    }
+    if (Status == EFI_NOT_FOUND) {
+      Snap->Missing = TRUE;
+    } else if (EFI_ERROR(Status)) {
+      Snap->Partial = TRUE;
+    }
+    DBG("    snapshot \\%s: %d names%a\n", Path, Snap->Count,
+        Snap->Missing ? ", not found" : (Snap->Partial ? ", partial" : ""));
+  }
+
+  Snap->Next = Volume->DirSnapshots;
+  Volume->DirSnapshots = Snap;
+  return Snap;
+}
+
+VOID FreeDirSnapshots(IN REFIT_VOLUME *Volume)
+{
+  DIR_SNAPSHOT *Snap;
+  UINTN         i;
+
+  if (Volume == NULL) {
+    return;
+  }
+  while (Volume->DirSnapshots != NULL) {
+    Snap = Volume->DirSnapshots;
+    Volume->DirSnapshots = Snap->Next;
+    for (i = 0; i < Snap->Count; i++) {
+      FreePool(Snap->Names[i]);
+    }
+    if (Snap->Names != NULL) {
+      FreePool(Snap->Names);
+    }
+    FreePool(Snap->Path);
+    FreePool(Snap);
+  }
+}
+
+/** Same as FileExists(Volume->RootDir, RelativePath) but with one directory
+ *  read per parent instead of an Open for every probe.
+ */
+BOOLEAN VolumeFileExists(IN REFIT_VOLUME *Volume, IN CHAR16 *RelativePath)
+{
+  DIR_SNAPSHOT  *Snap;
+  CHAR16        *Path, *Name, *Src, *Dst;
+  UINTN         Lo, Hi, Mid;
+  INTN          Cmp;
+  BOOLEAN       Exists = FALSE;
+
+  if ((Volume == NULL) || (Volume->RootDir == NULL) || (RelativePath == NULL)) {
+    return FALSE;
+  }
+  if (Volume->DirSnapshotGeneration != gDirSnapshotGeneration) {
+    FreeDirSnapshots(Volume);
+    Volume->DirSnapshotGeneration = gDirSnapshotGeneration;
+  }
+
+  // "\\EFI\\BOOT\\" and "EFI/BOOT" are the same
+  Path = AllocatePool(StrSize(RelativePath));
+  if (Path == NULL) {
+    return FileExists(Volume->RootDir, RelativePath);
+  }
+  Name = Path;
+  for (Src = RelativePath, Dst = Path; *Src != L'\0'; Src++) {
+    if ((*Src == L'\\') || (*Src == L'/')) {
+      if ((Dst != Path) && (Dst[-1] != L'\\')) {
+        *Dst++ = L'\\';
+      }
+    } else {
+      if ((Dst == Path) || (Dst[-1] == L'\\')) {
+        Name = Dst;
+      }
+      *Dst++ = *Src;
+    }
+  }
+  if ((Dst != Path) && (Dst[-1] == L'\\')) {
+    Dst--;
+  }
+  *Dst = L'\0';
+  if (*Path == L'\0') {
+    FreePool(Path);
+    return TRUE;
+  }
+  if ((StrCmp(Name, L".") == 0) || (StrCmp(Name, L"..") == 0) || (StrStr(Path, L".\\") != NULL)) {
+    FreePool(Path);
+    return FileExists(Volume->RootDir, RelativePath);
+  }
+
+  if (Name == Path) {
+    Snap = GetDirSnapshot(Volume, L"");
+  } else {
+    Name[-1] = L'\0';
+    Snap = GetDirSnapshot(Volume, Path);
+  }
+
+  if ((Snap == NULL) || Snap->Partial) {
+    Exists = FileExists(Volume->RootDir, RelativePath);
+  } else if (!Snap->Missing) {
+    Lo = 0;
+    Hi = Snap->Count;
+    while (Lo < Hi) {
+      Mid = (Lo + Hi) / 2;
+      Cmp = StriCmp(Snap->Names[Mid], Name);
+      if (Cmp == 0) {
+        // names differing only in case are left to the file system, it may be case sensitive
+        Exists = (StrCmp(Snap->Names[Mid], Name) == 0) || FileExists(Volume->RootDir, RelativePath);
+        break;
+      }
+      if (Cmp < 0) {
+        Lo = Mid + 1;
+      } else {
+        Hi = Mid;
+      }
+    }
+  }
+  FreePool(Path);
+  return Exists;
+}
+
 BOOLEAN DeleteFile(IN EFI_FILE *Root, IN CHAR16 *RelativePath)
 {
   EFI_STATUS  Status;
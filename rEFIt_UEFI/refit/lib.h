@@ -159,6 +159,30 @@ typedef struct {
   CHAR16              *Name;
 } LEGACY_OS;
 
+typedef struct {
+  CHAR16              *FileName;
+  UINT64              FileSize;
+  EFI_TIME            ModificationTime;
+} LINUX_BOOT_FILE;
+
+// Files of \boot, read once per volume for all kernel scans
+typedef struct {
+  UINTN               Count;
+  LINUX_BOOT_FILE     *Files;     // in directory order
+  LINUX_BOOT_FILE     **Sorted;   // by name, exact
+} LINUX_BOOT_INDEX;
+
+// Names found in one directory of a volume, for existence checks without Open
+typedef struct DIR_SNAPSHOT DIR_SNAPSHOT;
+struct DIR_SNAPSHOT {
+  DIR_SNAPSHOT        *Next;
+  CHAR16              *Path;      // no leading or trailing '\', L"" for root
+  BOOLEAN             Missing;    // directory does not exist
+  BOOLEAN             Partial;    // too big to keep, ask the file system
+  UINTN               Count;
+  CHAR16              **Names;    // sorted, case insensitive
+};
+
 typedef struct {
   EFI_DEVICE_PATH     *DevicePath;
   EFI_HANDLE          DeviceHandle;
@@ -182,6 +206,9 @@ typedef struct {
   UINT32              DriveCRC32;
   EFI_GUID            RootUUID;
   UINT64              SleepImageOffset;
+  LINUX_BOOT_INDEX    *LinuxBootIndex;
+  DIR_SNAPSHOT        *DirSnapshots;
+  UINTN               DirSnapshotGeneration;
 } REFIT_VOLUME;
 
 typedef enum {
@@ -301,6 +328,7 @@ extern INTN ScrollbarYMovement;
 #define MAX_ANIME  40
 
 typedef struct _refit_menu_screen REFIT_MENU_SCREEN;
+typedef struct _entry_images ENTRY_IMAGES;
 
 typedef struct _refit_menu_entry {
   CHAR16            *Title;
@@ -317,6 +345,7 @@ typedef struct _refit_menu_entry {
   ACTION             AtRightClick;
   ACTION             AtMouseOver;
   REFIT_MENU_SCREEN *SubScreen;
+  ENTRY_IMAGES      *Images;   //where the icons come from, to decode them again once freed
 } REFIT_MENU_ENTRY;
 
 typedef struct _refit_input_dialog {
@@ -526,6 +555,17 @@ typedef struct {
   CHAR16           *LoaderPath; //will be set to NULL
 } LEGACY_ENTRY;
 
+// Icons of a main menu entry are decoded when the entry is drawn first
+struct _entry_images {
+  REFIT_VOLUME     *Volume;
+  EG_IMAGE         *Image;            //given by the caller, kept
+  EG_IMAGE         *DriveImage;       //given by the caller, kept
+  CHAR16           *OSIconName;       //for LoadOSIcon()
+  CHAR16           *FallbackIconName;
+  UINT8             OSType;           //for the default drive icon
+  BOOLEAN           VolumeIcon;       //try .VolumeIcon.icns of the volume first
+};
+
 #define ANIME_INFINITE ((UINTN)-1)
 //some unreal values
 #define SCREEN_EDGE_LEFT    50000
@@ -567,6 +607,7 @@ extern GUI_ANIME        *GuiAnime;
 extern REFIT_VOLUME     *SelfVolume;
 extern REFIT_VOLUME     **Volumes;
 extern UINTN            VolumesCount;
+extern UINTN            gDirSnapshotGeneration;
 
 extern EG_IMAGE         *Banner;
 extern EG_IMAGE         *BigBack;
@@ -596,10 +637,13 @@ VOID GetListOfThemes(VOID);
 EFI_STATUS ExtractLegacyLoaderPaths(EFI_DEVICE_PATH **PathList, UINTN MaxPaths, EFI_DEVICE_PATH **HardcodedPathList);
 
 VOID ScanVolumes(VOID);
+VOID FreeLinuxBootIndex(IN REFIT_VOLUME *Volume);
 
 REFIT_VOLUME *FindVolumeByName(IN CHAR16 *VolName);
 
 BOOLEAN FileExists(IN EFI_FILE *BaseDir, IN CHAR16 *RelativePath);
+BOOLEAN VolumeFileExists(IN REFIT_VOLUME *Volume, IN CHAR16 *RelativePath);
+VOID    FreeDirSnapshots(IN REFIT_VOLUME *Volume);
 
 BOOLEAN DeleteFile(IN EFI_FILE *Root, IN CHAR16 *RelativePath);
 
@@ -611,6 +655,7 @@ EFI_STATUS DirIterClose(IN OUT REFIT_DIR_ITER *DirIter);
 
 CHAR16 * Basename(IN CHAR16 *Path);
 VOID   ReplaceExtension(IN OUT CHAR16 *Path, IN CHAR16 *Extension);
+BOOLEAN MetaiMatch(IN CHAR16 *String, IN CHAR16 *Pattern);
 
 INTN FindMem(IN VOID *Buffer, IN UINTN BufferLength, IN VOID *SearchString, IN UINTN SearchStringLength);
 
@@ -758,6 +803,8 @@ EG_IMAGE * BuiltinIcon(IN UINTN Id);
 VOID AddMenuInfoLine(IN REFIT_MENU_SCREEN *Screen, IN CHAR16 *InfoLine);
 VOID AddMenuEntry(IN REFIT_MENU_SCREEN *Screen, IN REFIT_MENU_ENTRY *Entry);
 VOID FreeMenu(IN REFIT_MENU_SCREEN *Screen);
+VOID LoadEntryImages(IN REFIT_MENU_ENTRY *Entry);
+VOID FreeEntryImages(VOID);
 UINTN RunMenu(IN REFIT_MENU_SCREEN *Screen, OUT REFIT_MENU_ENTRY **ChosenEntry);
 UINTN RunMainMenu(IN REFIT_MENU_SCREEN *Screen, IN INTN DefaultSelection, OUT REFIT_MENU_ENTRY **ChosenEntry);
 VOID DrawMenuText(IN CHAR16 *Text, IN INTN SelectedWidth, IN INTN XPos, IN INTN YPos, IN INTN Cursor);
@@ -525,6 +525,7 @@ static EFI_STATUS StartEFILoadedImage(IN EFI_HANDLE ChildImageHandle,
   //PauseForKey(L"continue");
   
   // close open file handles
+  FlushDebugLog(TRUE);
   UninitRefitLib();
   
   // turn control over to the image
@@ -539,6 +540,8 @@ static EFI_STATUS StartEFILoadedImage(IN EFI_HANDLE ChildImageHandle,
   // Clear the Watchdog Timer after the image returns
   //
   gBS->SetWatchdogTimer (0x0000, 0x0000, 0x0000, NULL);
+  // Clover runs again, debug.log may be buffered
+  FlushDebugLog(FALSE);
   
   //PauseForKey(L"Returned from StartImage\n");
   
@@ -828,11 +831,18 @@ static VOID StartLoader(IN LOADER_ENTRY *Entry)
         gEmuVariableControl->InstallEmulation(gEmuVariableControl);
     }
 
+    // remember where nvram.plist is, so next boot doesn't have to search all volumes
+    if (gFirmwareClover || gDriversFlags.EmuVariableLoaded) {
+      SaveNvramPlistHint(Entry->Volume);
+    }
+
     // first patchACPI and find PCIROOT and RTC
     // but before ACPI patch we need smbios patch
     PatchSmbios();
 //    DBG("PatchACPI\n");
+    MemLogSpanBegin("PatchACPI");
     PatchACPI(Entry->Volume, Entry->OSVersion);
+    MemLogSpanEnd("PatchACPI");
 
     // If KPDebug is true boot in verbose mode to see the debug messages
     if ((Entry->KernelAndKextPatches != NULL) && Entry->KernelAndKextPatches->KPDebug) {
@@ -842,7 +852,11 @@ static VOID StartLoader(IN LOADER_ENTRY *Entry)
     }
 
 //    DBG("SetDevices\n");
+    MemLogSpanBegin("SetDevices");
     SetDevices(Entry);
+    MemLogSpanEnd("SetDevices");
+    // codec ids and other probe results for the next boot
+    ProbeCacheSave();
 //    DBG("SetFSInjection\n");
     SetFSInjection(Entry);
     //PauseForKey(L"SetFSInjection");
@@ -871,7 +885,9 @@ static VOID StartLoader(IN LOADER_ENTRY *Entry)
 //    DBG("LoadKexts\n");
     // LoadKexts writes to DataHub, where large writes can prevent hibernate wake (happens when several kexts present in Clover's kexts dir)
     if (!DoHibernateWake) {
+      MemLogSpanBegin("LoadKexts");
       LoadKexts(Entry);
+      MemLogSpanEnd("LoadKexts");
     }
     
     // blocking boot.efi output if -v is not specified
@@ -1090,6 +1106,7 @@ static VOID StartLegacy(IN LEGACY_ENTRY *Entry)
                       (UGAHeight - BootLogoImage->Height) >> 1,
                       &StdBackgroundPixel, 16);
   
+    FlushDebugLog(TRUE);
     if (StrCmp(gSettings.LegacyBoot, L"Apple") != 0) { // not Apple-style LegacyBoot
       //try my LegacyBoot
       switch (Entry->Volume->BootType) {
@@ -1164,10 +1181,13 @@ static VOID ScanDriverDir(IN CHAR16 *Path, OUT EFI_HANDLE **DriversToConnect, OU
   EFI_HANDLE              *DriversArr;
   INTN                    i;
   BOOLEAN                 Skip;
+  BOOLEAN                 HasBinding;
+  UINTN                   ErrorInStep;
   
   DriversArrSize = 0;
   DriversArrNum = 0;
   DriversArr = NULL;
+  DriverManifestLoad(Path);
   
   // look through contents of the directory
   DirIterOpen(SelfRootDir, Path, &DirIter);
@@ -1201,11 +1221,17 @@ static VOID ScanDriverDir(IN CHAR16 *Path, OUT EFI_HANDLE **DriversToConnect, OU
       }
       gDriversFlags.MemFixLoaded = TRUE;
     }
+    if (DriverManifestSkip(DirEntry)) {
+      DBG("%s skipped - it could not be started on the last boots\n", DirEntry->FileName);
+      continue;
+    }
 
     UnicodeSPrint(FileName, 512, L"%s\\%s", Path, DirEntry->FileName);
+    ErrorInStep = 0;
     Status = StartEFIImage(FileDevicePath(SelfLoadedImage->DeviceHandle, FileName),
-                           L"", DirEntry->FileName, DirEntry->FileName, NULL, &DriverHandle);
+                           L"", DirEntry->FileName, DirEntry->FileName, &ErrorInStep, &DriverHandle);
     if (EFI_ERROR(Status)) {
+      DriverManifestSet(DirEntry, Status, ErrorInStep, FALSE);
       continue;
     }
     if (StrStr(FileName, L"EmuVariable") != NULL) {
@@ -1217,11 +1243,13 @@ static VOID ScanDriverDir(IN CHAR16 *Path, OUT EFI_HANDLE **DriversToConnect, OU
     } else if (StrStr(FileName, L"HFS") != NULL) {
       gDriversFlags.HFSLoaded = TRUE;
     }
+    HasBinding = FALSE;
     if (DriverHandle != NULL && DriversToConnectNum != NULL && DriversToConnect != NULL) {
       // driver loaded - check for EFI_DRIVER_BINDING_PROTOCOL
       Status = gBS->HandleProtocol(DriverHandle, &gEfiDriverBindingProtocolGuid, (VOID **) &DriverBinding);
       if (!EFI_ERROR(Status) && DriverBinding != NULL) {
         DBG(" - driver needs connecting\n");
+        HasBinding = TRUE;
         // standard UEFI driver - we would reconnect after loading - add to array
         if (DriversArrSize == 0) {
           // new array
@@ -1239,8 +1267,10 @@ static VOID ScanDriverDir(IN CHAR16 *Path, OUT EFI_HANDLE **DriversToConnect, OU
         DriversArr[DriversArrNum] = NULL;
       }
     }
+    DriverManifestSet(DirEntry, EFI_SUCCESS, 0, HasBinding);
   }
   Status = DirIterClose(&DirIter);
+  DriverManifestSave();
   if (Status != EFI_NOT_FOUND) {
     UnicodeSPrint(FileName, 512, L"while scanning the %s directory", Path);
     CheckError(Status, FileName);
@@ -1992,7 +2022,9 @@ RefitMain (IN EFI_HANDLE           ImageHandle,
   MainMenu.TimeoutSeconds = GlobalConfig.Timeout >= 0 ? GlobalConfig.Timeout : 0;
   
   DBG("LoadDrivers() start\n");
+  MemLogSpanBegin("LoadDrivers");
   LoadDrivers();
+  MemLogSpanEnd("LoadDrivers");
   DBG("LoadDrivers() end\n");
   
   if (!gFirmwareClover &&
@@ -2151,9 +2183,12 @@ RefitMain (IN EFI_HANDLE           ImageHandle,
   AfterTool = FALSE;
   gGuiIsReady = TRUE;
   do {
+    FreeEntryImages();
     MainMenu.EntryCount = 0;
     OptionMenu.EntryCount = 0;
+    MemLogSpanBegin("ScanVolumes");
     ScanVolumes();
+    MemLogSpanEnd("ScanVolumes");
 
     // as soon as we have Volumes, find latest nvram.plist and copy it to RT vars
     if (!AfterTool) {
@@ -2163,6 +2198,7 @@ RefitMain (IN EFI_HANDLE           ImageHandle,
     }
 
     if (!GlobalConfig.FastBoot) {
+      MemLogSpanBegin("InitTheme");
       if (gThemeNeedInit) {
         InitTheme(TRUE, &Now);
         gThemeNeedInit = FALSE;
@@ -2171,6 +2207,7 @@ RefitMain (IN EFI_HANDLE           ImageHandle,
         InitTheme(FALSE, NULL);
         FreeMenu(&OptionMenu);
       }
+      MemLogSpanEnd("InitTheme");
       gThemeChanged = FALSE;
       DBG("Choosing theme %s\n", GlobalConfig.Theme);
       
@@ -2192,7 +2229,9 @@ RefitMain (IN EFI_HANDLE           ImageHandle,
     if (gSettings.DisableEntryScan) {
       DBG("Entry scan disabled\n");
     } else {
+      MemLogSpanBegin("ScanLoader");
       ScanLoader();
+      MemLogSpanEnd("ScanLoader");
     }
 
     if (!GlobalConfig.FastBoot) {
@@ -2242,6 +2281,8 @@ RefitMain (IN EFI_HANDLE           ImageHandle,
 
     DefaultIndex = FindDefaultEntry();
       DBG("DefaultIndex=%d and MainMenu.EntryCount=%d\n", DefaultIndex, MainMenu.EntryCount);
+    // scan is done, write the log before waiting in the menu
+    FlushDebugLog(FALSE);
     if ((DefaultIndex >= 0) && (DefaultIndex < (INTN)MainMenu.EntryCount)) {
       DefaultEntry = MainMenu.Entries[DefaultIndex];
     } else {
@@ -2329,6 +2370,7 @@ RefitMain (IN EFI_HANDLE           ImageHandle,
       switch (ChosenEntry->Tag) {
 
         case TAG_RESET:    // Restart
+          FlushDebugLog(TRUE);
           // Attempt warm reboot
           gRS->ResetSystem(EfiResetWarm, EFI_SUCCESS, 0, NULL);
           // Warm reboot may not be supported attempt cold reboot
@@ -2534,6 +2576,8 @@ RefitMain (IN EFI_HANDLE           ImageHandle,
   UninstallSecureBoot();
 #endif // ENABLE_SECURE_BOOT
 
+  FlushDebugLog(TRUE);
+
   // Unload EmuVariable before returning to EFI GUI, as it should not be present when booting other Operating Systems.
   // This seems critical in some UEFI implementations, such as Phoenix UEFI 2.0
   if (gEmuVariableControl != NULL) {